@@ -1,3 +1,6 @@
-for n in `lv2ls`; do timeout 5s ./dev/pywrap.sh examples/python/load_plugin.py "$n"; sleep 0.1 || break; done
+# Instantiates and runs every installed plugin once, each in its own
+# process (see src/horst_bench.cc). Use make bench for real numbers.
+./src/horst-bench --seconds 0.05 --timeout 5 --sample-rates 48000 --block-lengths 128 "$@"
+# for n in `lv2ls`; do timeout 5s ./dev/pywrap.sh examples/python/load_plugin.py "$n"; sleep 0.1 || break; done
 # for n in `lv2ls`; do timeout 5s ./src/horst_cli "$n"; sleep 0.1 || break; done
 # echo `lv2ls` | xargs ./pywrap.sh check_uri.py
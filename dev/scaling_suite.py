@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+
+# Chains N instances of a reference plugin between system:capture_1
+# and system:playback_1 using different hosting strategies and records,
+# for each N: JACK DSP load (mean and max), xruns, resident memory,
+# thread count and the time from launch until the chain is connected.
+#
+# Strategies:
+#   jacked_horst: one jacked_horst (one JACK client) per instance, all
+#     in one Python process
+#   jalv: one jalv process per instance
+#
+# There is no in-process engine (several plugins in one JACK client)
+# yet. Add a strategy to STRATEGIES once there is.
+#
+# A strategy is not tried with larger N once it fails to start, times
+# out or its mean DSP load reaches --max-load.
+#
+# Needs a running jackd and src/jack-cpu-load (make src/jack-cpu-load).
+#
+# Usage: ./dev/pywrap.sh dev/scaling_suite.py --output scaling.json --plot scaling.png
+
+import argparse
+import json
+import os
+import select
+import subprocess
+import sys
+import threading
+import time
+
+DEFAULT_URI = "http://fps.io/plugins/state-variable-filter-v2"
+DEFAULT_COUNTS = "1,2,5,10,20,50,100,200,300,400,500"
+REPOSITORY = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+def chain(names, is_alive, timeout):
+  # Waits for the audio ports of the clients named names to appear and
+  # connects them in series between system:capture_1 and
+  # system:playback_1
+  import lv2_horst as h
+
+  cm = h.connection_manager("scaling-suite")
+  end = time.time() + timeout
+  while True:
+    if time.time() > end:
+      raise TimeoutError()
+    if not is_alive():
+      raise RuntimeError("instance exited")
+    inputs = [cm.get_ports("^" + name + ":", "audio", h.INPUT) for name in names]
+    outputs = [cm.get_ports("^" + name + ":", "audio", h.OUTPUT) for name in names]
+    if all(inputs) and all(outputs):
+      break
+    time.sleep(0.1)
+
+  connections = [("system:capture_1", inputs[0][0]), (outputs[-1][0], "system:playback_1")]
+  connections += [(outputs[n - 1][0], inputs[n][0]) for n in range(1, len(names))]
+  cm.connect(connections)
+
+def host_jacked_horsts(uri, count):
+  # Runs in the child process of the jacked_horst strategy
+  import lv2_horst as h
+
+  plugins = h.plugins()
+  names = ["scale-horst-" + str(n) for n in range(count)]
+  units = [h.jacked_horst(plugins, uri, name) for name in names]
+  chain(names, lambda: True, 10)
+
+  print("ready", flush=True)
+  # Runs until the parent closes stdin
+  sys.stdin.read()
+
+def process_stats(pids):
+  rss_kb = 0
+  threads = 0
+  for pid in pids:
+    try:
+      with open(f'/proc/{pid}/status') as f:
+        for line in f:
+          if line.startswith('VmRSS:'):
+            rss_kb += int(line.split()[1])
+          if line.startswith('Threads:'):
+            threads += int(line.split()[1])
+    except FileNotFoundError:
+      pass
+  return rss_kb, threads
+
+class jack_monitor:
+  # Reads jack-cpu-load continuously, so samples are never stale
+  def __init__(self, interval_ms):
+    self.p = subprocess.Popen([os.path.join(REPOSITORY, 'src', 'jack-cpu-load'), str(interval_ms)], stdout=subprocess.PIPE, text=True, bufsize=1)
+    self.lines = []
+    self.lock = threading.Lock()
+    self.reader = threading.Thread(target=self.read, daemon=True)
+    self.reader.start()
+
+  def read(self):
+    for line in self.p.stdout:
+      with self.lock:
+        self.lines.append(line)
+
+  def sample(self, seconds):
+    # Returns the loads and the number of xruns over the next seconds
+    with self.lock:
+      self.lines = []
+    time.sleep(seconds)
+    with self.lock:
+      lines = self.lines
+
+    if not lines:
+      raise RuntimeError("no output from jack-cpu-load")
+
+    samples = [(float(load), int(xruns)) for load, xruns in (line.split() for line in lines)]
+    return [load for load, _ in samples], samples[-1][1] - samples[0][1]
+
+  def close(self):
+    self.p.terminate()
+    self.p.wait()
+
+def start_jacked_horst(uri, count, timeout):
+  p = subprocess.Popen([sys.executable, os.path.abspath(__file__), '--host-jacked-horsts', str(count), '--uri', uri], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+  # Reads the raw pipe with select, so a host that hangs before saying
+  # "ready" does not block past the deadline
+  ready = False
+  try:
+    end = time.time() + timeout
+    output = b''
+    while not ready:
+      remaining = end - time.time()
+      if remaining <= 0:
+        raise TimeoutError()
+      readable, _, _ = select.select([p.stdout], [], [], remaining)
+      if not readable:
+        continue
+      data = os.read(p.stdout.fileno(), 4096)
+      if not data:
+        raise RuntimeError("host process exited")
+      output += data
+      ready = b'ready' in (line.strip() for line in output.split(b'\n')[:-1])
+    return [p]
+  finally:
+    if not ready:
+      p.kill()
+      p.wait()
+
+def start_jalv(uri, count, timeout):
+  names = ["scale-jalv-" + str(n) for n in range(count)]
+  processes = [subprocess.Popen(["jalv", "-n", name, uri], stdin=subprocess.PIPE, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL) for name in names]
+
+  try:
+    chain(names, lambda: all(p.poll() is None for p in processes), timeout)
+  except (RuntimeError, TimeoutError):
+    stop(processes)
+    raise
+  return processes
+
+def stop(processes):
+  for p in processes:
+    try:
+      p.stdin.close()
+    except Exception:
+      pass
+    p.terminate()
+  for p in processes:
+    try:
+      p.wait(5)
+    except subprocess.TimeoutExpired:
+      p.kill()
+      p.wait()
+
+STRATEGIES = {
+  'jacked_horst': start_jacked_horst,
+  'jalv': start_jalv,
+}
+
+def run(args):
+  results = []
+  monitor = jack_monitor(args.sample_interval)
+
+  try:
+    for strategy in args.strategies.split(','):
+      start = STRATEGIES[strategy]
+
+      for count in [int(c) for c in args.counts.split(',')]:
+        print(f'{strategy}: N = {count}', file=sys.stderr, flush=True)
+        result = {'strategy': strategy, 'count': count}
+
+        launch = time.time()
+        try:
+          processes = start(args.uri, count, args.startup_timeout)
+        except (RuntimeError, TimeoutError) as e:
+          result['error'] = str(e) or type(e).__name__
+          results.append(result)
+          break
+
+        result['startup_seconds'] = time.time() - launch
+
+        time.sleep(args.settle)
+        loads, xruns = monitor.sample(args.measure)
+        rss_kb, threads = process_stats([p.pid for p in processes])
+
+        stop(processes)
+
+        result['mean_load'] = sum(loads) / len(loads) if loads else 0
+        result['max_load'] = max(loads) if loads else 0
+        result['xruns'] = xruns
+        result['rss_kb'] = rss_kb
+        result['threads'] = threads
+        results.append(result)
+        print(f'  {json.dumps(result)}', file=sys.stderr, flush=True)
+
+        # Let JACK settle before the next round
+        time.sleep(1)
+
+        if result['mean_load'] >= args.max_load:
+          break
+  finally:
+    monitor.close()
+
+  return results
+
+def plot(results, path):
+  import matplotlib
+  matplotlib.use('Agg')
+  import matplotlib.pyplot as plt
+
+  metrics = [('mean_load', 'mean DSP load (%)'), ('xruns', 'xruns'), ('rss_kb', 'RSS (kB)'), ('threads', 'threads'), ('startup_seconds', 'startup (s)')]
+  figure, axes = plt.subplots(len(metrics), 1, figsize=(8, 3 * len(metrics)), sharex=True)
+
+  for strategy in sorted(set(r['strategy'] for r in results)):
+    rows = [r for r in results if r['strategy'] == strategy and 'error' not in r]
+    for axis, (key, label) in zip(axes, metrics):
+      axis.plot([r['count'] for r in rows], [r[key] for r in rows], marker='o', label=strategy)
+      axis.set_ylabel(label)
+
+  axes[0].legend()
+  axes[-1].set_xscale('log')
+  axes[-1].set_xlabel('instances')
+  figure.tight_layout()
+  figure.savefig(path)
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Instance count scaling suite')
+  parser.add_argument('--uri', default=DEFAULT_URI)
+  parser.add_argument('--counts', default=DEFAULT_COUNTS)
+  parser.add_argument('--strategies', default=','.join(STRATEGIES.keys()))
+  parser.add_argument('--settle', type=float, default=2, help='seconds to wait after startup before measuring')
+  parser.add_argument('--measure', type=float, default=5, help='seconds to measure')
+  parser.add_argument('--sample-interval', type=int, default=100, help='DSP load sample interval in ms')
+  parser.add_argument('--startup-timeout', type=float, default=120)
+  parser.add_argument('--max-load', type=float, default=95, help='stop increasing N once the mean DSP load reaches this (%%)')
+  parser.add_argument('--output', default='scaling.json')
+  parser.add_argument('--plot', default='')
+  parser.add_argument('--host-jacked-horsts', type=int, default=0, help=argparse.SUPPRESS)
+  args = parser.parse_args()
+
+  if args.host_jacked_horsts:
+    host_jacked_horsts(args.uri, args.host_jacked_horsts)
+    sys.exit(0)
+
+  results = run(args)
+
+  with open(args.output, 'w') as f:
+    json.dump(results, f, indent=2)
+
+  if args.plot:
+    plot(results, args.plot)
@@ -0,0 +1,29 @@
+import lv2_horst as h
+import lv2_horsting as hing
+
+# The plugin's URI
+uri = "http://calf.sourceforge.net/plugins/VintageDelay"
+
+p = hing.horst(uri)
+
+# Instead of stepping values from a python loop we upload complete
+# breakpoint curves which are then played back in the process
+# callback. Times are in seconds.
+feedback = h.automation_curve(p.feedback_.index, [
+    h.automation_point(0.0, 0.1),
+    h.automation_point(2.0, 0.9, h.automation_segment_type.exponential),
+    h.automation_point(4.0, 0.1)
+], loop_start = 0.0, loop_end = 4.0)
+
+amount = h.automation_curve(p.amount_.index, [
+    h.automation_point(0.0, 0.0, h.automation_segment_type.step),
+    h.automation_point(1.0, 1.0)
+])
+
+# Evaluate the curves every 64 frames
+p.set_automation_control_period(64)
+p.set_automation([feedback, amount])
+
+hing.connect(hing.system, p, hing.system)
+
+input("Press enter to exit")
@@ -0,0 +1,34 @@
+import lv2_horst as h
+import asyncio
+import time
+import sys
+
+# Loading racks releases the GIL, so the event loop keeps serving while
+# they load on worker threads, and several racks load in parallel.
+setups = sys.argv[1:] or ["../../dev/ogfx-setup-many-plugins.json"] * 2
+
+async def heartbeat():
+  while True:
+    start = time.perf_counter()
+    await asyncio.sleep(0.01)
+    late = time.perf_counter() - start - 0.01
+    if late > 0.005:
+      print(f'event loop stalled for {late * 1000:.1f} ms')
+
+async def main():
+  beat = asyncio.create_task(heartbeat())
+
+  plugins = await asyncio.to_thread(h.plugins)
+
+  start = time.perf_counter()
+  rigs = await asyncio.gather(*[asyncio.to_thread(h.load_ogfx_rig, plugins, setup) for setup in setups])
+  print(f'loaded {len(rigs)} rigs in {time.perf_counter() - start:.3f} s')
+
+  for rig in rigs:
+    print([[unit.get_jack_client_name() for unit in rack] for rack in rig.units])
+
+  beat.cancel()
+  return rigs
+
+rigs = asyncio.run(main())
+input("Press enter to exit")
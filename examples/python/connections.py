@@ -0,0 +1,28 @@
+import lv2_horst as h
+import time
+import sys
+
+# A connection manager is a long lived client that mirrors the JACK
+# graph. Applying a connection set only connects and disconnects what
+# differs from the current graph, so re-applying is almost free.
+cm = h.connection_manager("connections_example")
+
+snapshot = h.load_aj_snapshot(sys.argv[1] if len(sys.argv) > 1 else "dev/test.connections")
+
+d = cm.diff(snapshot)
+print(f'{len(snapshot)} connections, {len(d.connect)} missing')
+
+start = time.perf_counter()
+d = cm.apply(snapshot)
+print(f'apply: {(time.perf_counter() - start) * 1000:.2f} ms, connected {len(d.connect)}, failed {len(d.failed)}')
+
+start = time.perf_counter()
+d = cm.apply(snapshot)
+print(f're-apply: {(time.perf_counter() - start) * 1000:.2f} ms, connected {len(d.connect)}')
+
+# exclusive also removes connections between the snapshot's clients that
+# are not in the snapshot, like aj-snapshot -x but leaving other clients alone
+d = cm.apply(snapshot, exclusive = True)
+print(f'removed: {d.disconnect}')
+
+print(cm.get_connections())
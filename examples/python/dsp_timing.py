@@ -0,0 +1,21 @@
+import lv2_horst as h
+import lv2_horsting as hing
+import time
+
+# The plugin's URI
+uri = "http://calf.sourceforge.net/plugins/VintageDelay"
+
+p = hing.horst(uri)
+p.set_dsp_timing_enabled(True)
+
+hing.connect(hing.system, p, hing.system)
+
+# All times are fractions of the period length, so 0.1 means the
+# plugin used 10% of the budget
+while True:
+    time.sleep(1)
+    for phase in [h.dsp_timing_phase.process, h.dsp_timing_phase.run]:
+        t = p.get_dsp_timing(phase)
+        print(f'{phase.name}: periods: {t.count} min: {t.min:.4f} mean: {t.mean:.4f} p99: {t.p99:.4f} max: {t.max:.4f}')
+    # Start over for the next second without stopping audio
+    p.reset_dsp_timing()
@@ -0,0 +1,26 @@
+import lv2_horst as h
+import time
+
+# Runs a plugin without a JACK server. The dummy driver plays the part
+# of jackd: it owns system:capture_N and system:playback_N and, with
+# loopback enabled, feeds what reaches playback_N back into capture_N
+# one period later.
+driver = h.dummy_driver(sample_rate = 48000, buffer_size = 256, channels = 2, loopback = True)
+
+plugins = h.plugins()
+delay = h.jacked_horst(plugins, "http://calf.sourceforge.net/plugins/VintageDelay", "delay", backend = h.dummy_backend(driver))
+
+cm = h.connection_manager(h.dummy_backend(driver))
+cm.connect([("system:capture_1", "delay:in_l"), ("delay:out_l", "system:playback_1")])
+print(cm.get_ports("delay", "", h.OUTPUT))
+
+# Deterministic: run exactly 1000 periods
+for n in range(1000):
+  driver.cycle()
+
+# Or let the driver's thread run: at real time pace (counting xruns when
+# a period takes too long), or with realtime = False as fast as possible
+driver.start(realtime = True)
+time.sleep(2)
+driver.stop()
+print(f'frames: {driver.get_frames()} xruns: {driver.get_xruns()}')
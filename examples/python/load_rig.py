@@ -0,0 +1,17 @@
+import lv2_horst as h
+
+plugins = h.plugins()
+
+# Parses the setup, instantiates all units concurrently, applies values
+# and MIDI bindings before activating them and makes all connections in
+# one batch.
+rig = h.load_ogfx_rig(plugins, "../../dev/ogfx-setup-many-plugins.json")
+
+t = rig.timing
+print("parse: %.3f s, instantiate: %.3f s, configure: %.3f s, activate: %.3f s, connect: %.3f s, total: %.3f s" % (t.parse, t.instantiate, t.configure, t.activate, t.connect, t.total()))
+print("%d connections, %d failed" % (len(rig.connections), rig.failed_connections))
+
+for rack in rig.units:
+  print([unit.get_jack_client_name() for unit in rack])
+
+input("Press enter to exit")
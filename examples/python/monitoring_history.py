@@ -0,0 +1,27 @@
+import lv2_horst as h
+import lv2_horsting as hing
+import time
+
+# The plugin's URI
+uri = "http://calf.sourceforge.net/plugins/VintageDelay"
+
+p = hing.horst(uri)
+p.set_audio_output_monitoring_enabled(True)
+
+# Record the peak and rms of both outputs for every period
+p.set_history_columns([
+    h.history_column(p.out_l_.index, h.history_source.peak),
+    h.history_column(p.out_r_.index, h.history_source.peak),
+    h.history_column(p.out_l_.index, h.history_source.rms),
+    h.history_column(p.out_r_.index, h.history_source.rms)
+], capacity = 8192)
+
+hing.connect(hing.system, p, hing.system)
+
+# Each call returns all periods recorded since the last one as a
+# (periods x columns) numpy array, so nothing is missed in between
+while True:
+    time.sleep(0.1)
+    rows = p.drain_history()
+    if len(rows) > 0:
+        print(f'{len(rows)} periods, max peak: {rows[:, 0:2].max():.5f}, overruns: {p.get_history_overruns()}')
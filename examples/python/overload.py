@@ -0,0 +1,24 @@
+import lv2_horst as h
+import lv2_horsting as hing
+import time
+
+# A delay that must never drop out and a reverb that may be bypassed
+# when the graph runs out of time
+delay = hing.horst("http://calf.sourceforge.net/plugins/VintageDelay")
+reverb = hing.horst("http://calf.sourceforge.net/plugins/Reverb")
+reverb.set_priority(-1)
+
+hing.connect(hing.system, delay, reverb, hing.system)
+
+# On an xrun first stop splitting periods at MIDI events, then bypass
+# units with a priority below 0. Every action is undone again after 10
+# seconds without an xrun.
+h.set_overload_policy(h.overload_policy(reduce_splitting = True, bypass_low_priority = True, bypass_below_priority = 0, recovery_seconds = 10))
+h.set_overload_management_enabled(True)
+
+while True:
+    time.sleep(1)
+    for p in [delay, reverb]:
+        print(f'{p.get_jack_client_name()}: load: {p.get_load():.3f} peak: {p.get_peak_load():.3f} attributed xruns: {p.get_attributed_xruns()} shed: {p.is_shed()}')
+    for action in h.get_overload_log():
+        print(f'{action.time:.1f}: {action.description}')
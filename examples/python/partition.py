@@ -0,0 +1,33 @@
+import lv2_horst as h
+
+# A rack: two chains and a plugin on its own
+uris = [
+  "http://calf.sourceforge.net/plugins/Compressor",
+  "http://calf.sourceforge.net/plugins/Reverb",
+  "http://calf.sourceforge.net/plugins/VintageDelay",
+  "http://calf.sourceforge.net/plugins/MultiChorus",
+  "http://calf.sourceforge.net/plugins/Saturator"
+]
+dependencies = [(0, 1), (2, 3)]
+
+sample_rate = 48000
+block_length = 128
+
+# Calibration run on dummy buffers, before anything runs for real
+plugins = h.plugins()
+costs = []
+for uri in uris:
+    p = h.horst(plugins, uri)
+    p.instantiate(sample_rate, block_length)
+    c = h.measure_cost(p, sample_rate, block_length)
+    print(f'{uri}: mean: {c.mean_load:.4f} max: {c.max_load:.4f}')
+    costs.append(c.mean_load)
+
+partitioner = h.partitioner(costs, dependencies, 2)
+plan = partitioner.plan
+for group, load in zip(plan.groups, plan.predicted_loads):
+    print(f'{[uris[unit] for unit in group]}: predicted load: {load:.4f}')
+print(f'critical path: {plan.critical_path_load:.4f}')
+
+# Later feed in measured costs (e.g. get_dsp_timing(h.dsp_timing_phase.process).mean
+# of the running instances). partitioner.update() re-plans if they drifted.
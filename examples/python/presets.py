@@ -0,0 +1,26 @@
+import lv2_horst as h
+import lv2_horsting as hing
+
+# The plugin's URI
+uri = "http://calf.sourceforge.net/plugins/Gate"
+
+p = hing.horst(uri)
+index = { port.symbol: port.index for port in [p[n] for n in range(len(p.ports))] }
+
+# Every preset is switched as a whole in the process callback, so the
+# plugin never sees a mix of old and new values.
+p.set_preset_bank([
+    h.preset("open", { index["threshold"]: 0.0, index["range"]: 1.0 }),
+    h.preset("closed", { index["threshold"]: 1.0, index["range"]: 0.0 })
+])
+
+# Or one preset per ogfx setup, from the first unit of the first rack
+p.load_ogfx_presets(["../../dev/ogfx-setup-many-plugins.json"], rack = 0, unit = 0)
+print([preset.name for preset in p.get_preset_bank()])
+
+hing.connect(hing.system, p, hing.system)
+
+# Switch at frame 128 of the next period
+p.select_preset(0, frame = 128)
+
+input("Press enter to exit")
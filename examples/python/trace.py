@@ -0,0 +1,23 @@
+import lv2_horst as h
+import lv2_horsting as hing
+import time
+
+# The plugin's URI
+uri = "http://calf.sourceforge.net/plugins/VintageDelay"
+
+# Turn tracing on before creating instances, so their threads get
+# buffers when JACK starts them
+h.set_trace_enabled(True)
+
+# Keep a flight recording and write the last two seconds whenever JACK
+# reports an xrun (to /tmp/horst-xrun.0.json, /tmp/horst-xrun.1.json, ...)
+h.set_trace_xrun_dump_path("/tmp/horst-xrun")
+
+p = hing.horst(uri)
+hing.connect(hing.system, p, hing.system)
+
+time.sleep(5)
+
+# Or dump the last second on demand. Open the file in chrome://tracing
+# or https://ui.perfetto.dev
+h.dump_trace("/tmp/horst-trace.json", seconds = 1)
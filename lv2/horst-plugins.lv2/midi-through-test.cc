@@ -0,0 +1,105 @@
+#include "lv2/core/lv2.h"
+#include "lv2/atom/atom.h"
+#include "lv2/atom/util.h"
+
+#include <cstdint>
+
+#define HORST_PLUGINS_MIDI_THROUGH_TEST_URI "https://dfdx.eu/plugins/horst-plugins/midi-through-test"
+
+/*
+ * Copies the events on its atom input to its atom output, keeping
+ * their frames. Useful for checking the host's event timing.
+ */
+#define NUMBER_OF_PORTS 2
+
+struct midi_through_test
+{
+  const LV2_Atom_Sequence *m_input;
+  LV2_Atom_Sequence *m_output;
+};
+
+static LV2_Handle
+instantiate
+(
+  const LV2_Descriptor* descriptor,
+  double rate,
+  const char* path,
+  const LV2_Feature* const* features
+)
+{
+  return (LV2_Handle)new midi_through_test;
+}
+
+static void
+connect_port
+(
+  LV2_Handle instance,
+  uint32_t port,
+  void *data
+)
+{
+  midi_through_test *m = (midi_through_test*)instance;
+
+  switch (port)
+  {
+    case 0:
+      m->m_input = (const LV2_Atom_Sequence*)data;
+      break;
+    case 1:
+      m->m_output = (LV2_Atom_Sequence*)data;
+      break;
+  }
+}
+
+static void
+run
+(
+  LV2_Handle instance,
+  uint32_t sample_count
+)
+{
+  midi_through_test *m = (midi_through_test*)instance;
+
+  // The host sets the size of an output sequence to its capacity
+  const uint32_t capacity = m->m_output->atom.size;
+
+  lv2_atom_sequence_clear (m->m_output);
+  m->m_output->atom.type = m->m_input->atom.type;
+  m->m_output->body.unit = 0;
+  m->m_output->body.pad = 0;
+
+  LV2_ATOM_SEQUENCE_FOREACH (m->m_input, event)
+  {
+    if (!lv2_atom_sequence_append_event (m->m_output, capacity, event)) break;
+  }
+}
+
+static void cleanup
+(
+  LV2_Handle instance
+)
+{
+  delete (midi_through_test*)instance;
+}
+
+static const LV2_Descriptor descriptor =
+{
+  HORST_PLUGINS_MIDI_THROUGH_TEST_URI,
+  instantiate,
+  connect_port,
+  0,
+  run,
+  0,
+  cleanup,
+  0
+};
+
+LV2_SYMBOL_EXPORT
+const LV2_Descriptor*
+lv2_descriptor
+(
+  uint32_t index
+)
+{
+  return index == 0 ? &descriptor : 0;
+}
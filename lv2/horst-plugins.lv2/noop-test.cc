@@ -0,0 +1,83 @@
+#include "lv2/core/lv2.h"
+
+#include <cstdint>
+
+#define HORST_PLUGINS_NOOP_TEST_URI "https://dfdx.eu/plugins/horst-plugins/noop-test"
+
+/*
+ * Does nothing at all. Its ports (2 audio inputs, 2 audio outputs,
+ * 16 control inputs and a control output) make it useful for
+ * measuring the host's own overhead.
+ */
+#define NUMBER_OF_PORTS 21
+
+struct noop_test
+{
+  void *m_ports[NUMBER_OF_PORTS];
+};
+
+static LV2_Handle
+instantiate
+(
+  const LV2_Descriptor* descriptor,
+  double rate,
+  const char* path,
+  const LV2_Feature* const* features
+)
+{
+  return (LV2_Handle)new noop_test;
+}
+
+static void
+connect_port
+(
+  LV2_Handle instance,
+  uint32_t port,
+  void *data
+)
+{
+  if (port < NUMBER_OF_PORTS)
+  {
+    ((noop_test*)instance)->m_ports[port] = data;
+  }
+}
+
+static void
+run
+(
+  LV2_Handle instance,
+  uint32_t sample_count
+)
+{
+
+}
+
+static void cleanup
+(
+  LV2_Handle instance
+)
+{
+  delete (noop_test*)instance;
+}
+
+static const LV2_Descriptor descriptor =
+{
+  HORST_PLUGINS_NOOP_TEST_URI,
+  instantiate,
+  connect_port,
+  0,
+  run,
+  0,
+  cleanup,
+  0
+};
+
+LV2_SYMBOL_EXPORT
+const LV2_Descriptor*
+lv2_descriptor
+(
+  uint32_t index
+)
+{
+  return index == 0 ? &descriptor : 0;
+}
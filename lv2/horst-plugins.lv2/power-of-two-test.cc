@@ -0,0 +1,96 @@
+#include "lv2/core/lv2.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define HORST_PLUGINS_POWER_OF_TWO_TEST_URI "https://dfdx.eu/plugins/horst-plugins/power-of-two-test"
+
+/*
+ * Copies its audio input to its audio output. Requires power of two
+ * block lengths and aborts if it is ever run with another one.
+ */
+#define NUMBER_OF_PORTS 2
+
+struct power_of_two_test
+{
+  const float *m_input;
+  float *m_output;
+};
+
+static LV2_Handle
+instantiate
+(
+  const LV2_Descriptor* descriptor,
+  double rate,
+  const char* path,
+  const LV2_Feature* const* features
+)
+{
+  return (LV2_Handle)new power_of_two_test;
+}
+
+static void
+connect_port
+(
+  LV2_Handle instance,
+  uint32_t port,
+  void *data
+)
+{
+  power_of_two_test *p = (power_of_two_test*)instance;
+
+  switch (port)
+  {
+    case 0:
+      p->m_input = (const float*)data;
+      break;
+    case 1:
+      p->m_output = (float*)data;
+      break;
+  }
+}
+
+static void
+run
+(
+  LV2_Handle instance,
+  uint32_t sample_count
+)
+{
+  power_of_two_test *p = (power_of_two_test*)instance;
+
+  if (sample_count & (sample_count - 1)) abort ();
+
+  memcpy (p->m_output, p->m_input, sample_count * sizeof (float));
+}
+
+static void cleanup
+(
+  LV2_Handle instance
+)
+{
+  delete (power_of_two_test*)instance;
+}
+
+static const LV2_Descriptor descriptor =
+{
+  HORST_PLUGINS_POWER_OF_TWO_TEST_URI,
+  instantiate,
+  connect_port,
+  0,
+  run,
+  0,
+  cleanup,
+  0
+};
+
+LV2_SYMBOL_EXPORT
+const LV2_Descriptor*
+lv2_descriptor
+(
+  uint32_t index
+)
+{
+  return index == 0 ? &descriptor : 0;
+}
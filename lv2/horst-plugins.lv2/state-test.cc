@@ -1,23 +1,37 @@
 #include "lv2/core/lv2.h"
 #include "lv2/core/lv2_util.h"
 #include "lv2/state/state.h"
+#include "lv2/urid/urid.h"
+#include "lv2/atom/atom.h"
 
 #include <cstring>
 #include <cstdlib>
 #include <vector>
 
 #define HORST_PLUGINS_STATE_TEST_URI "https://dfdx.eu/plugins/horst-plugins/state-test"
+#define HORST_PLUGINS_STATE_TEST__data HORST_PLUGINS_STATE_TEST_URI "#data"
 
-#define STATE_ITEM_SIZE
+#define STATE_ITEM_SIZE (1024 * 1024)
 
+/*
+ * Saves and restores a 1 MiB chunk which is filled with a pattern
+ * depending on the sample rate, so hosts can check a round trip
+ * between instances created with different rates.
+ */
 struct state_test
 {
-  std::vector<char> m_data;
+  std::vector<uint8_t> m_data;
+  LV2_URID_Map *m_map;
+  LV2_URID m_data_key;
+  LV2_URID m_chunk_type;
 
-  state_test() :
+  state_test(double rate) :
     m_data (STATE_ITEM_SIZE)
   {
-
+    for (size_t index = 0; index < STATE_ITEM_SIZE; ++index)
+    {
+      m_data[index] = (index + (size_t)rate) % 0xff;
+    }
   }
 };
 
@@ -30,17 +44,25 @@ instantiate
   const LV2_Feature* const* features
 )
 {
-  state_test *w = new state_test;
+  state_test *s = new state_test (rate);
 
-  /*
   const char *missing = lv2_features_query
   (
     features,
-    LV2_STATE__interface, &w->m_schedule,   true,
+    LV2_URID__map, &s->m_map, true,
     0
   );
-  */
-  return (LV2_Handle)w;
+
+  if (missing)
+  {
+    delete s;
+    return 0;
+  }
+
+  s->m_data_key = s->m_map->map (s->m_map->handle, HORST_PLUGINS_STATE_TEST__data);
+  s->m_chunk_type = s->m_map->map (s->m_map->handle, LV2_ATOM__Chunk);
+
+  return (LV2_Handle)s;
 }
 
 static void
@@ -50,9 +72,47 @@ run
   uint32_t sample_cout
 )
 {
-  // state_test *w = (state_test*)instance;
+  // state_test *s = (state_test*)instance;
+}
+
+static LV2_State_Status
+save
+(
+  LV2_Handle instance,
+  LV2_State_Store_Function store,
+  LV2_State_Handle handle,
+  uint32_t flags,
+  const LV2_Feature* const* features
+)
+{
+  state_test *s = (state_test*)instance;
+
+  return store (handle, s->m_data_key, &s->m_data[0], s->m_data.size (), s->m_chunk_type, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 }
 
+static LV2_State_Status
+restore
+(
+  LV2_Handle instance,
+  LV2_State_Retrieve_Function retrieve,
+  LV2_State_Handle handle,
+  uint32_t flags,
+  const LV2_Feature* const* features
+)
+{
+  state_test *s = (state_test*)instance;
+
+  size_t size = 0;
+  uint32_t type = 0;
+  uint32_t value_flags = 0;
+  const void *data = retrieve (handle, s->m_data_key, &size, &type, &value_flags);
+
+  if (data == 0) return LV2_STATE_ERR_NO_PROPERTY;
+  if (type != s->m_chunk_type || size != s->m_data.size ()) return LV2_STATE_ERR_BAD_TYPE;
+
+  memcpy (&s->m_data[0], data, size);
+  return LV2_STATE_SUCCESS;
+}
 
 static const void*
 extension_data
@@ -60,13 +120,12 @@ extension_data
   const char* uri
 )
 {
-  /*
-  static const LV2_STATE__interface worker = {work, work_response, 0};
+  static const LV2_State_Interface state = {save, restore};
 
   if (!strcmp(uri, LV2_STATE__interface)) {
-    return &worker;
+    return &state;
   }
-  */
+
   return 0;
 }
 
@@ -6,26 +6,50 @@
 #include <cstdlib>
 #include <vector>
 #include <iostream>
+#include <atomic>
+#include <cstdint>
 
 #define HORST_PLUGINS_WORKER_TEST_URI "https://dfdx.eu/plugins/horst-plugins/worker-test"
 
 #define WORK_ITEM_SIZE (12345)
 
+/*
+ * Work items start with the id of the instance that scheduled them,
+ * so work or responses handed to the wrong instance abort.
+ */
+#define WORK_ITEM_HEADER_SIZE (sizeof (uint64_t))
+
+static std::atomic<uint64_t> number_of_instances (0);
+
 struct worker_test
 {
   std::vector<uint8_t> m_data;
   LV2_Worker_Schedule *m_schedule;
+  uint64_t m_id;
 
   worker_test() :
-    m_data (WORK_ITEM_SIZE)
+    m_data (WORK_ITEM_SIZE),
+    m_id (++number_of_instances)
   {
-    for (size_t index = 0; index < WORK_ITEM_SIZE; ++index)
+    memcpy (&m_data[0], &m_id, WORK_ITEM_HEADER_SIZE);
+
+    for (size_t index = WORK_ITEM_HEADER_SIZE; index < WORK_ITEM_SIZE; ++index)
     {
       m_data[index] = index % 0xff;
     }
   }
 };
 
+static bool
+same_instance
+(
+  LV2_Handle instance,
+  const void *data
+)
+{
+  return memcmp (data, &((worker_test*)instance)->m_id, WORK_ITEM_HEADER_SIZE) == 0;
+}
+
 static LV2_Handle
 instantiate
 (
@@ -75,12 +99,12 @@ work
   const void* data
 )
 {
-  if (size != WORK_ITEM_SIZE)
+  if (size != WORK_ITEM_SIZE || !same_instance (instance, data))
   {
     abort();
   }
 
-  for (size_t index = 0; index < WORK_ITEM_SIZE; ++index)
+  for (size_t index = WORK_ITEM_HEADER_SIZE; index < WORK_ITEM_SIZE; ++index)
   {
     if (((uint8_t*)data)[index] != index % 0xff)
     {
@@ -104,12 +128,12 @@ work_response
 {
   std::cout << "work_response()\n";
 
-  if (size != WORK_ITEM_SIZE)
+  if (size != WORK_ITEM_SIZE || !same_instance (instance, data))
   {
     abort ();
   }
   
-  for (size_t index = 0; index < WORK_ITEM_SIZE; ++index)
+  for (size_t index = WORK_ITEM_HEADER_SIZE; index < WORK_ITEM_SIZE; ++index)
   {
     if (((uint8_t*)data)[index] != (index + 1) % 0xff)
     {
@@ -0,0 +1,301 @@
+#include <lv2_horst/horst.h>
+#include <lv2_horst/cost_model.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/*
+ * Benchmarks LV2 plugins without JACK: every plugin (or the URIs given)
+ * at every combination of sample rate and block length. Each
+ * combination runs in a forked child, so crashing or hanging plugins
+ * only cost their own rows and memory numbers are not skewed by
+ * earlier instances.
+ *
+ * Usage: horst-bench [--format csv|json] [--signal noise|sine|silence]
+ *   [--seconds S] [--timeout S] [--sample-rates R,R,...]
+ *   [--block-lengths N,N,...] [uri...]
+ *
+ * Results go to stdout, progress and whatever the plugins print to
+ * stderr.
+ */
+
+enum class bench_status
+{
+  ok,
+  error,
+  crashed,
+  timed_out
+};
+
+static const char *status_names[] = { "ok", "error", "crashed", "timed_out" };
+
+/*
+ * Written by the child into a pipe
+ */
+struct bench_result
+{
+  bench_status m_status;
+  double m_instantiate_ms;
+  double m_activate_ms;
+  long m_rss_kb;
+  double m_ns_per_sample;
+  double m_max_ns_per_sample;
+  char m_error[256];
+};
+
+struct bench_row
+{
+  std::string m_uri;
+  double m_sample_rate;
+  size_t m_block_length;
+  bench_result m_result;
+};
+
+static long resident_kb ()
+{
+  long pages = 0, resident = 0;
+  FILE *f = fopen ("/proc/self/statm", "r");
+  if (f == 0) return 0;
+  if (fscanf (f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose (f);
+  return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static bench_result run_bench
+(
+  lv2_horst::lilv_plugins_ptr plugins,
+  const std::string &uri,
+  double sample_rate,
+  size_t block_length,
+  double seconds,
+  lv2_horst::dummy_signal signal
+)
+{
+  bench_result r {};
+  r.m_status = bench_status::ok;
+
+  try
+  {
+    const long rss_before = resident_kb ();
+    const auto start = std::chrono::steady_clock::now ();
+
+    lv2_horst::horst_ptr h (new lv2_horst::horst (plugins, uri));
+    h->instantiate (sample_rate, block_length);
+
+    const double total_ms = 1000 * std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+    r.m_activate_ms = 1000 * h->m_plugin_instance->m_activate_seconds;
+    r.m_instantiate_ms = total_ms - r.m_activate_ms;
+    r.m_rss_kb = resident_kb () - rss_before;
+
+    const size_t periods = std::max<size_t> (16, seconds * sample_rate / block_length);
+    const lv2_horst::unit_cost c = lv2_horst::measure_cost (h, sample_rate, block_length, periods, periods / 10, signal);
+
+    r.m_ns_per_sample = 1e9 * c.m_mean_seconds / block_length;
+    r.m_max_ns_per_sample = 1e9 * c.m_max_seconds / block_length;
+  }
+  catch (const std::exception &e)
+  {
+    r.m_status = bench_status::error;
+    strncpy (r.m_error, e.what (), sizeof (r.m_error) - 1);
+  }
+
+  return r;
+}
+
+static bench_result run_bench_in_child
+(
+  lv2_horst::lilv_plugins_ptr plugins,
+  const std::string &uri,
+  double sample_rate,
+  size_t block_length,
+  double seconds,
+  double timeout,
+  lv2_horst::dummy_signal signal
+)
+{
+  bench_result r {};
+
+  int fds[2];
+  if (pipe (fds) != 0)
+  {
+    r.m_status = bench_status::error;
+    strncpy (r.m_error, "Failed to create pipe", sizeof (r.m_error) - 1);
+    return r;
+  }
+
+  const pid_t pid = fork ();
+  if (pid == 0)
+  {
+    close (fds[0]);
+    // Keep plugin and library chatter out of the results
+    dup2 (STDERR_FILENO, STDOUT_FILENO);
+
+    r = run_bench (plugins, uri, sample_rate, block_length, seconds, signal);
+    if (write (fds[1], &r, sizeof (r)) != sizeof (r)) _exit (1);
+    _exit (0);
+  }
+
+  close (fds[1]);
+
+  const auto start = std::chrono::steady_clock::now ();
+  int status = 0;
+  while (waitpid (pid, &status, WNOHANG) == 0)
+  {
+    if (std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count () > timeout)
+    {
+      kill (pid, SIGKILL);
+      waitpid (pid, &status, 0);
+      close (fds[0]);
+
+      r.m_status = bench_status::timed_out;
+      return r;
+    }
+    usleep (1000);
+  }
+
+  const bool complete = read (fds[0], &r, sizeof (r)) == sizeof (r);
+  close (fds[0]);
+
+  if (!complete)
+  {
+    r = bench_result {};
+    r.m_status = bench_status::crashed;
+    if (WIFSIGNALED(status)) snprintf (r.m_error, sizeof (r.m_error), "signal %d", WTERMSIG(status));
+  }
+
+  return r;
+}
+
+template<class T>
+static std::vector<T> parse_list (const std::string &s)
+{
+  std::vector<T> values;
+  std::stringstream stream (s);
+  std::string item;
+  while (std::getline (stream, item, ','))
+  {
+    std::stringstream item_stream (item);
+    T value;
+    if (item_stream >> value) values.push_back (value);
+  }
+  return values;
+}
+
+static std::string json_string (const std::string &s)
+{
+  std::string escaped = "\"";
+  for (char c : s)
+  {
+    if (c == '"' || c == '\\') escaped += '\\';
+    if ((unsigned char)c < 0x20) { escaped += ' '; continue; }
+    escaped += c;
+  }
+  return escaped + "\"";
+}
+
+static std::string csv_string (const std::string &s)
+{
+  std::string escaped = "\"";
+  for (char c : s)
+  {
+    if (c == '"') escaped += '"';
+    escaped += c;
+  }
+  return escaped + "\"";
+}
+
+static void print_csv (const std::vector<bench_row> &rows)
+{
+  printf ("uri,sample_rate,block_length,status,instantiate_ms,activate_ms,rss_kb,ns_per_sample,max_ns_per_sample,realtime_load,error\n");
+  for (const bench_row &row : rows)
+  {
+    const bench_result &r = row.m_result;
+    printf ("%s,%g,%zu,%s,%.3f,%.3f,%ld,%.3f,%.3f,%.6f,%s\n", csv_string (row.m_uri).c_str (), row.m_sample_rate, row.m_block_length, status_names[(int)r.m_status], r.m_instantiate_ms, r.m_activate_ms, r.m_rss_kb, r.m_ns_per_sample, r.m_max_ns_per_sample, r.m_ns_per_sample * row.m_sample_rate / 1e9, csv_string (r.m_error).c_str ());
+  }
+}
+
+static void print_json (const std::vector<bench_row> &rows)
+{
+  printf ("[\n");
+  for (size_t index = 0; index < rows.size (); ++index)
+  {
+    const bench_row &row = rows[index];
+    const bench_result &r = row.m_result;
+    printf ("  {\"uri\": %s, \"sample_rate\": %g, \"block_length\": %zu, \"status\": \"%s\", \"instantiate_ms\": %.3f, \"activate_ms\": %.3f, \"rss_kb\": %ld, \"ns_per_sample\": %.3f, \"max_ns_per_sample\": %.3f, \"realtime_load\": %.6f, \"error\": %s}%s\n", json_string (row.m_uri).c_str (), row.m_sample_rate, row.m_block_length, status_names[(int)r.m_status], r.m_instantiate_ms, r.m_activate_ms, r.m_rss_kb, r.m_ns_per_sample, r.m_max_ns_per_sample, r.m_ns_per_sample * row.m_sample_rate / 1e9, json_string (r.m_error).c_str (), index + 1 < rows.size () ? "," : "");
+  }
+  printf ("]\n");
+}
+
+int main (int argc, char *argv[])
+{
+  std::string format = "csv";
+  lv2_horst::dummy_signal signal = lv2_horst::dummy_signal::noise;
+  double seconds = 1;
+  double timeout = 30;
+  std::vector<double> sample_rates = { 44100, 48000, 88200, 96000, 176400, 192000 };
+  std::vector<size_t> block_lengths = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+  std::vector<std::string> uris;
+
+  for (int index = 1; index < argc; ++index)
+  {
+    const std::string arg = argv[index];
+    const bool has_value = index + 1 < argc;
+
+    if (arg == "--format" && has_value) format = argv[++index];
+    else if (arg == "--seconds" && has_value) seconds = atof (argv[++index]);
+    else if (arg == "--timeout" && has_value) timeout = atof (argv[++index]);
+    else if (arg == "--sample-rates" && has_value) sample_rates = parse_list<double> (argv[++index]);
+    else if (arg == "--block-lengths" && has_value) block_lengths = parse_list<size_t> (argv[++index]);
+    else if (arg == "--signal" && has_value)
+    {
+      const std::string s = argv[++index];
+      if (s == "sine") signal = lv2_horst::dummy_signal::sine;
+      else if (s == "silence") signal = lv2_horst::dummy_signal::silence;
+      else signal = lv2_horst::dummy_signal::noise;
+    }
+    else if (arg.rfind ("--", 0) == 0)
+    {
+      std::cerr << "Unknown option or missing value: " << arg << "\n";
+      return 1;
+    }
+    else uris.push_back (arg);
+  }
+
+  if (format != "csv" && format != "json")
+  {
+    std::cerr << "Unknown format: " << format << "\n";
+    return 1;
+  }
+
+  // Loaded once here, so the children do not each scan all bundles
+  lv2_horst::lilv_plugins_ptr plugins (new lv2_horst::lilv_plugins);
+  if (uris.empty ()) uris = plugins->m_uris;
+
+  std::vector<bench_row> rows;
+  for (size_t uri_index = 0; uri_index < uris.size (); ++uri_index)
+  {
+    std::cerr << "[" << uri_index + 1 << "/" << uris.size () << "] " << uris[uri_index] << "\n";
+
+    for (double sample_rate : sample_rates)
+    {
+      for (size_t block_length : block_lengths)
+      {
+        rows.push_back (bench_row { uris[uri_index], sample_rate, block_length, run_bench_in_child (plugins, uris[uri_index], sample_rate, block_length, seconds, timeout, signal) });
+      }
+    }
+  }
+
+  if (format == "json") print_json (rows);
+  else print_csv (rows);
+
+  return 0;
+}
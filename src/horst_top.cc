@@ -0,0 +1,209 @@
+#include <lv2_horst/stats.h>
+
+#include <map>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <csignal>
+#include <iostream>
+#include <algorithm>
+
+#include <dirent.h>
+#include <termios.h>
+#include <poll.h>
+
+/*
+ * A top like view of all instances published by all processes on this
+ * machine (see lv2_horst::stats_publisher). Only reads shared memory,
+ * so it never interferes with any process thread.
+ *
+ * Usage: horst-top [refresh interval in ms]
+ *
+ * Keys: d/p/m sort by mean/p99/max DSP time, x by xruns, a by xruns
+ * attributed to the instance, k by output peak, n by name, q quits.
+ */
+
+struct mapped_segment
+{
+  const lv2_horst::stats_segment *m_segment;
+};
+
+struct row
+{
+  int m_pid;
+  std::string m_name;
+  lv2_horst::stats_values m_values;
+};
+
+static termios original_termios;
+
+static void restore_terminal ()
+{
+  tcsetattr (STDIN_FILENO, TCSANOW, &original_termios);
+  std::cout << "\033[?25h" << std::flush;
+}
+
+static void handle_signal (int)
+{
+  restore_terminal ();
+  _exit (0);
+}
+
+static const lv2_horst::stats_segment *map_segment (const std::string &name)
+{
+  const int fd = shm_open (name.c_str (), O_RDONLY, 0);
+  if (fd < 0) return 0;
+
+  struct stat s;
+  if (fstat (fd, &s) != 0 || (size_t)s.st_size < sizeof (lv2_horst::stats_segment))
+  {
+    close (fd);
+    return 0;
+  }
+
+  void *address = mmap (0, sizeof (lv2_horst::stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (address == MAP_FAILED) return 0;
+
+  const lv2_horst::stats_segment *segment = (const lv2_horst::stats_segment*)address;
+  if (segment->m_magic != HORST_STATS_MAGIC || segment->m_version != HORST_STATS_VERSION)
+  {
+    munmap (address, sizeof (lv2_horst::stats_segment));
+    return 0;
+  }
+
+  return segment;
+}
+
+/*
+ * Maps new segments, unmaps those that are gone and removes the ones
+ * left behind by processes that do not exist anymore.
+ */
+static void scan_segments (std::map<std::string, mapped_segment> &segments)
+{
+  std::map<std::string, mapped_segment> found;
+
+  DIR *dir = opendir ("/dev/shm");
+  if (dir == 0) return;
+
+  while (dirent *entry = readdir (dir))
+  {
+    const std::string file_name = entry->d_name;
+    if (file_name.rfind (HORST_STATS_SEGMENT_PREFIX, 0) != 0) continue;
+
+    const std::string name = "/" + file_name;
+    const int pid = atoi (file_name.c_str () + strlen (HORST_STATS_SEGMENT_PREFIX));
+
+    if (kill (pid, 0) != 0 && errno == ESRCH)
+    {
+      shm_unlink (name.c_str ());
+      continue;
+    }
+
+    auto it = segments.find (name);
+    if (it != segments.end ())
+    {
+      found[name] = it->second;
+      segments.erase (it);
+      continue;
+    }
+
+    const lv2_horst::stats_segment *segment = map_segment (name);
+    if (segment) found[name] = mapped_segment { segment };
+  }
+  closedir (dir);
+
+  for (auto &s : segments) munmap ((void*)s.second.m_segment, sizeof (lv2_horst::stats_segment));
+  segments.swap (found);
+}
+
+static std::string percent (float fraction)
+{
+  if (fraction < 0) return "-";
+  char buffer[32];
+  snprintf (buffer, sizeof (buffer), "%.1f", 100 * fraction);
+  return buffer;
+}
+
+static std::string decibel (float peak)
+{
+  if (peak <= 0) return "-inf";
+  char buffer[32];
+  snprintf (buffer, sizeof (buffer), "%.1f", 20 * log10f (peak));
+  return buffer;
+}
+
+int main (int argc, char *argv[])
+{
+  const int interval_ms = argc > 1 ? std::max (10, atoi (argv[1])) : 100;
+
+  tcgetattr (STDIN_FILENO, &original_termios);
+  termios raw = original_termios;
+  raw.c_lflag &= ~(ICANON | ECHO);
+  tcsetattr (STDIN_FILENO, TCSANOW, &raw);
+  atexit (restore_terminal);
+  signal (SIGINT, handle_signal);
+  signal (SIGTERM, handle_signal);
+
+  std::map<std::string, mapped_segment> segments;
+  char sort_key = 'd';
+
+  while (true)
+  {
+    scan_segments (segments);
+
+    std::vector<row> rows;
+    for (auto &s : segments)
+    {
+      const lv2_horst::stats_segment *segment = s.second.m_segment;
+      for (size_t slot = 0; slot < segment->m_capacity && slot < HORST_STATS_MAX_INSTANCES; ++slot)
+      {
+        const lv2_horst::stats_record &r = segment->m_records[slot];
+        if (!r.m_in_use.load (std::memory_order_acquire)) continue;
+        rows.push_back (row { segment->m_pid, std::string (r.m_name, strnlen (r.m_name, HORST_STATS_NAME_SIZE)), r.read () });
+      }
+    }
+
+    std::sort (rows.begin (), rows.end (), [sort_key] (const row &a, const row &b)
+    {
+      switch (sort_key)
+      {
+        case 'p': return a.m_values.m_dsp_p99 > b.m_values.m_dsp_p99;
+        case 'm': return a.m_values.m_dsp_max > b.m_values.m_dsp_max;
+        case 'x': return a.m_values.m_xruns > b.m_values.m_xruns;
+        case 'a': return a.m_values.m_attributed_xruns > b.m_values.m_attributed_xruns;
+        case 'k': return a.m_values.m_output_peak > b.m_values.m_output_peak;
+        case 'n': return a.m_name < b.m_name;
+        default: return a.m_values.m_dsp_mean > b.m_values.m_dsp_mean;
+      }
+    });
+
+    float total = 0;
+    for (const row &r : rows) total += std::max (0.0f, r.m_values.m_dsp_mean);
+
+    printf ("\033[?25l\033[H\033[2J");
+    printf ("horst-top - %zu processes, %zu instances, total mean DSP: %s%% - sort: %c (d/p/m/x/a/k/n, q to quit)\n\n", segments.size (), rows.size (), percent (total).c_str (), sort_key);
+    printf ("%7s %-32s %7s %7s %7s %10s %6s %6s %6s %6s %6s %6s %7s %3s\n", "PID", "NAME", "MEAN%", "P99%", "MAX%", "CYCLES", "XRUNS", "ATTR", "WORKQ", "RESPQ", "LOGQ", "MISSED", "PEAKdB", "ON");
+
+    for (const row &r : rows)
+    {
+      const lv2_horst::stats_values &v = r.m_values;
+      printf ("%7d %-32.32s %7s %7s %7s %10llu %6llu %6llu %6u %6u %6u %6llu %7s %3s\n", r.m_pid, r.m_name.c_str (), percent (v.m_dsp_mean).c_str (), percent (v.m_dsp_p99).c_str (), percent (v.m_dsp_max).c_str (), (unsigned long long)v.m_cycles, (unsigned long long)v.m_xruns, (unsigned long long)v.m_attributed_xruns, v.m_work_queue_bytes, v.m_work_response_queue_bytes, v.m_log_queue_bytes, (unsigned long long)v.m_missed_log_messages, decibel (v.m_output_peak).c_str (), v.m_enabled ? "y" : "n");
+    }
+    fflush (stdout);
+
+    pollfd p { STDIN_FILENO, POLLIN, 0 };
+    if (poll (&p, 1, interval_ms) > 0)
+    {
+      char c;
+      if (read (STDIN_FILENO, &c, 1) == 1)
+      {
+        if (c == 'q') break;
+        if (strchr ("dpmxakn", c)) sort_key = c;
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <lv2_horst/error.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+namespace lv2_horst
+{
+  /*
+   * Reads the JACK connections (source, destination) from an
+   * aj-snapshot file (see dev/test.connections):
+   *
+   * <aj-snapshot>
+   *   <jack>
+   *     <client name="system">
+   *       <port name="capture_1">
+   *         <connection port="Calf Gate:in_l" />
+   *
+   * The ALSA section is ignored. This is not a general XML parser, it
+   * understands just enough for files aj-snapshot writes: elements,
+   * quoted attributes, entities, comments and processing instructions.
+   */
+  struct aj_snapshot_parser
+  {
+    const std::string &m_text;
+    size_t m_position;
+
+    aj_snapshot_parser
+    (
+      const std::string &text
+    ) :
+      m_text (text),
+      m_position (0)
+    {
+
+    }
+
+    static std::string decode
+    (
+      const std::string &s
+    )
+    {
+      std::string decoded;
+      for (size_t index = 0; index < s.size (); ++index)
+      {
+        if (s[index] != '&')
+        {
+          decoded += s[index];
+          continue;
+        }
+
+        const size_t end = s.find (';', index);
+        if (end == std::string::npos) THROW("Unterminated entity: " + s);
+
+        const std::string entity = s.substr (index + 1, end - index - 1);
+        if (entity == "amp") decoded += '&';
+        else if (entity == "lt") decoded += '<';
+        else if (entity == "gt") decoded += '>';
+        else if (entity == "quot") decoded += '"';
+        else if (entity == "apos") decoded += '\'';
+        else if (entity.size () > 1 && entity[0] == '#')
+        {
+          const long code = entity[1] == 'x' ? strtol (entity.c_str () + 2, 0, 16) : strtol (entity.c_str () + 1, 0, 10);
+          if (code <= 0 || code > 0x7f) THROW("Unsupported character reference: " + entity);
+          decoded += (char)code;
+        }
+        else THROW("Unknown entity: " + entity);
+
+        index = end;
+      }
+      return decoded;
+    }
+
+    struct tag
+    {
+      std::string m_name;
+      std::vector<std::pair<std::string, std::string>> m_attributes;
+      bool m_closing;
+      bool m_self_closing;
+
+      std::string attribute
+      (
+        const std::string &name
+      ) const
+      {
+        for (const auto &a : m_attributes) if (a.first == name) return a.second;
+        THROW("<" + m_name + "> without attribute " + name);
+      }
+    };
+
+    /*
+     * The next tag, skipping text, comments and declarations. False at
+     * the end of the input.
+     */
+    bool next
+    (
+      tag &t
+    )
+    {
+      while (true)
+      {
+        m_position = m_text.find ('<', m_position);
+        if (m_position == std::string::npos) return false;
+
+        if (m_text.compare (m_position, 4, "<!--") == 0)
+        {
+          m_position = m_text.find ("-->", m_position);
+          if (m_position == std::string::npos) THROW("Unterminated comment");
+          continue;
+        }
+
+        const size_t end = m_text.find ('>', m_position);
+        if (end == std::string::npos) THROW("Unterminated tag");
+
+        if (m_text[m_position + 1] == '?' || m_text[m_position + 1] == '!')
+        {
+          m_position = end;
+          continue;
+        }
+
+        const std::string content = m_text.substr (m_position + 1, end - m_position - 1);
+        m_position = end + 1;
+
+        t = tag { "", {}, false, false };
+        size_t p = 0;
+
+        if (p < content.size () && content[p] == '/')
+        {
+          t.m_closing = true;
+          ++p;
+        }
+
+        if (!content.empty () && content.back () == '/') t.m_self_closing = true;
+        const size_t content_end = t.m_self_closing ? content.size () - 1 : content.size ();
+
+        while (p < content_end && !isspace ((unsigned char)content[p])) t.m_name += content[p++];
+
+        while (true)
+        {
+          while (p < content_end && isspace ((unsigned char)content[p])) ++p;
+          if (p >= content_end) break;
+
+          const size_t equals = content.find ('=', p);
+          if (equals == std::string::npos || equals + 1 >= content_end) THROW("Malformed attribute in <" + t.m_name + ">");
+
+          std::string name = content.substr (p, equals - p);
+          while (!name.empty () && isspace ((unsigned char)name.back ())) name.pop_back ();
+
+          size_t quote = equals + 1;
+          while (quote < content_end && isspace ((unsigned char)content[quote])) ++quote;
+          if (quote >= content_end || (content[quote] != '"' && content[quote] != '\'')) THROW("Unquoted attribute in <" + t.m_name + ">");
+
+          const size_t value_end = content.find (content[quote], quote + 1);
+          if (value_end == std::string::npos || value_end >= content_end) THROW("Unterminated attribute in <" + t.m_name + ">");
+
+          t.m_attributes.emplace_back (name, decode (content.substr (quote + 1, value_end - quote - 1)));
+          p = value_end + 1;
+        }
+
+        return true;
+      }
+    }
+
+    std::vector<std::pair<std::string, std::string>> parse ()
+    {
+      std::vector<std::pair<std::string, std::string>> connections;
+
+      bool in_jack = false;
+      std::string client;
+      std::string port;
+
+      tag t;
+      while (next (t))
+      {
+        if (t.m_name == "jack")
+        {
+          in_jack = !t.m_closing && !t.m_self_closing;
+          continue;
+        }
+
+        if (!in_jack || t.m_closing) continue;
+
+        if (t.m_name == "client") client = t.attribute ("name");
+        else if (t.m_name == "port") port = t.attribute ("name");
+        else if (t.m_name == "connection")
+        {
+          if (client.empty () || port.empty ()) THROW("<connection> outside of <client> and <port>");
+          connections.emplace_back (client + ":" + port, t.attribute ("port"));
+        }
+      }
+
+      return connections;
+    }
+  };
+
+  inline std::vector<std::pair<std::string, std::string>> parse_aj_snapshot
+  (
+    const std::string &text
+  )
+  {
+    return aj_snapshot_parser (text).parse ();
+  }
+
+  inline std::vector<std::pair<std::string, std::string>> load_aj_snapshot
+  (
+    const std::string &path
+  )
+  {
+    std::ifstream file (path);
+    if (!file) THROW("Failed to open: " + path);
+
+    std::stringstream text;
+    text << file.rdbuf ();
+    return parse_aj_snapshot (text.str ());
+  }
+}
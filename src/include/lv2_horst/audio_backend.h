@@ -0,0 +1,195 @@
+#pragma once
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lv2_horst
+{
+  /*
+   * What jacked_horst and connection_manager need from an audio
+   * server: one client with ports, callbacks and connections.
+   *
+   * JACK's types and callback signatures serve as the vocabulary, so
+   * the JACK implementation (jack_backend) is a thin forwarder. Other
+   * implementations (see dummy_backend) hand out pointers to their own
+   * port objects as jack_port_t * and keep MIDI buffers in their own
+   * format, which is why MIDI buffers are only accessed through the
+   * backend.
+   *
+   * port_get_buffer () and the midi_* functions are called from the
+   * process callback and must be realtime safe.
+   */
+  struct audio_backend
+  {
+    virtual ~audio_backend () {}
+
+    /*
+     * Throws if the client cannot be opened. The actual name may
+     * differ from the requested one (see client_name ()).
+     */
+    virtual void open
+    (
+      const std::string &client_name
+    ) = 0;
+    virtual void close () = 0;
+    virtual std::string client_name () const = 0;
+
+    virtual jack_nframes_t sample_rate () const = 0;
+    virtual jack_nframes_t buffer_size () const = 0;
+
+    /*
+     * Returns 0 on failure.
+     */
+    virtual jack_port_t *port_register
+    (
+      const std::string &name,
+      const char *type,
+      unsigned long flags
+    ) = 0;
+    virtual void *port_get_buffer
+    (
+      jack_port_t *port,
+      jack_nframes_t nframes
+    ) = 0;
+    virtual void port_get_latency_range
+    (
+      jack_port_t *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    ) = 0;
+    virtual void port_set_latency_range
+    (
+      jack_port_t *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    ) = 0;
+
+    /*
+     * name is the short name (without the client name)
+     */
+    virtual int port_rename
+    (
+      jack_port_t *port,
+      const std::string &name
+    ) = 0;
+
+    /*
+     * The setters return 0 on success, like their JACK counterparts.
+     * They must be called before activate ().
+     */
+    virtual int set_process_callback
+    (
+      JackProcessCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_buffer_size_callback
+    (
+      JackBufferSizeCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_sample_rate_callback
+    (
+      JackSampleRateCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_thread_init_callback
+    (
+      JackThreadInitCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_latency_callback
+    (
+      JackLatencyCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_xrun_callback
+    (
+      JackXRunCallback callback,
+      void *arg
+    ) = 0;
+
+    /*
+     * Graph notifications. Like with JACK they arrive on a non
+     * realtime thread and only while the client is active.
+     */
+    virtual int set_port_registration_callback
+    (
+      JackPortRegistrationCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_port_connect_callback
+    (
+      JackPortConnectCallback callback,
+      void *arg
+    ) = 0;
+    virtual int set_port_rename_callback
+    (
+      JackPortRenameCallback callback,
+      void *arg
+    ) = 0;
+
+    virtual int activate () = 0;
+    virtual int deactivate () = 0;
+
+    /*
+     * Port names are full names (client:port). Patterns are regular
+     * expressions, empty ones match everything.
+     */
+    virtual int connect
+    (
+      const std::string &source,
+      const std::string &destination
+    ) = 0;
+    virtual int disconnect
+    (
+      const std::string &source,
+      const std::string &destination
+    ) = 0;
+    virtual std::vector<std::string> get_ports
+    (
+      const std::string &port_name_pattern,
+      const std::string &port_type_pattern,
+      unsigned long flags
+    ) = 0;
+
+    /*
+     * "" if there is no such port (anymore).
+     */
+    virtual std::string port_name_by_id
+    (
+      jack_port_id_t id
+    ) = 0;
+    virtual std::vector<std::string> port_get_connections
+    (
+      const std::string &port_name
+    ) = 0;
+
+    virtual uint32_t midi_get_event_count
+    (
+      void *buffer
+    ) = 0;
+    virtual int midi_event_get
+    (
+      jack_midi_event_t *event,
+      void *buffer,
+      uint32_t event_index
+    ) = 0;
+    virtual void midi_clear_buffer
+    (
+      void *buffer
+    ) = 0;
+    virtual int midi_event_write
+    (
+      void *buffer,
+      jack_nframes_t time,
+      const jack_midi_data_t *data,
+      size_t size
+    ) = 0;
+  };
+
+  typedef std::shared_ptr<audio_backend> audio_backend_ptr;
+}
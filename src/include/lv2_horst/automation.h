@@ -0,0 +1,169 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace lv2_horst
+{
+  /*
+   * The shape of the segment starting at a breakpoint and ending
+   * at the next one.
+   */
+  enum class automation_segment_type
+  {
+    linear,
+    exponential,
+    step
+  };
+
+  struct automation_point
+  {
+    double m_time;
+    float m_value;
+    automation_segment_type m_type;
+
+    automation_point
+    (
+      double time = 0,
+      float value = 0,
+      automation_segment_type type = automation_segment_type::linear
+    ) :
+      m_time (time),
+      m_value (value),
+      m_type (type)
+    {
+
+    }
+  };
+
+  /*
+   * A breakpoint curve driving a single control input port. Times
+   * are in seconds relative to the start of playback. If m_loop_end
+   * is larger than m_loop_start playback wraps around from m_loop_end
+   * to m_loop_start. Otherwise the last value is held.
+   */
+  struct automation_curve
+  {
+    size_t m_port_index;
+    std::vector<automation_point> m_points;
+    double m_loop_start;
+    double m_loop_end;
+
+    /*
+     * Index of the segment the last evaluation ended up in. Only
+     * touched by the process thread. Evaluation usually progresses
+     * monotonically, so this makes the lookup O(1) amortized.
+     */
+    size_t m_segment;
+
+    automation_curve
+    (
+      size_t port_index = 0,
+      const std::vector<automation_point> &points = std::vector<automation_point> (),
+      double loop_start = 0,
+      double loop_end = 0
+    ) :
+      m_port_index (port_index),
+      m_points (points),
+      m_loop_start (loop_start),
+      m_loop_end (loop_end),
+      m_segment (0)
+    {
+      std::stable_sort
+      (
+        m_points.begin (),
+        m_points.end (),
+        [] (const automation_point &a, const automation_point &b) { return a.m_time < b.m_time; }
+      );
+    }
+
+    inline bool is_looping () const
+    {
+      return m_loop_end > m_loop_start;
+    }
+
+    inline float value_at (double time)
+    {
+      const size_t number_of_points = m_points.size ();
+
+      if (is_looping () && time >= m_loop_end)
+      {
+        time = m_loop_start + fmod (time - m_loop_start, m_loop_end - m_loop_start);
+      }
+
+      if (time <= m_points[0].m_time)
+      {
+        m_segment = 0;
+        return m_points[0].m_value;
+      }
+
+      if (time >= m_points[number_of_points - 1].m_time)
+      {
+        m_segment = number_of_points - 1;
+        return m_points[number_of_points - 1].m_value;
+      }
+
+      if (m_segment >= number_of_points - 1 || time < m_points[m_segment].m_time)
+      {
+        m_segment = 0;
+      }
+
+      while (time >= m_points[m_segment + 1].m_time)
+      {
+        ++m_segment;
+      }
+
+      const automation_point &p0 = m_points[m_segment];
+      const automation_point &p1 = m_points[m_segment + 1];
+
+      const double x = (time - p0.m_time) / (p1.m_time - p0.m_time);
+
+      switch (p0.m_type)
+      {
+        case automation_segment_type::step:
+          return p0.m_value;
+
+        case automation_segment_type::exponential:
+          if ((p0.m_value > 0 && p1.m_value > 0) || (p0.m_value < 0 && p1.m_value < 0))
+          {
+            return p0.m_value * pow (p1.m_value / p0.m_value, x);
+          }
+          // Exponential segments crossing or touching zero degrade to linear
+          [[fallthrough]];
+
+        case automation_segment_type::linear:
+        default:
+          return p0.m_value + (p1.m_value - p0.m_value) * x;
+      }
+    }
+  };
+
+  /*
+   * A complete set of curves for one plugin instance. Sets are built
+   * on the control thread and handed to the process thread as a whole,
+   * so the process thread never allocates.
+   */
+  struct automation
+  {
+    std::vector<automation_curve> m_curves;
+
+    automation
+    (
+      const std::vector<automation_curve> &curves
+    ) :
+      m_curves (curves)
+    {
+      for (size_t index = 0; index < m_curves.size (); ++index)
+      {
+        if (m_curves[index].m_points.empty ())
+        {
+          THROW("Automation curve without points for port: " + std::to_string (m_curves[index].m_port_index));
+        }
+      }
+    }
+  };
+}
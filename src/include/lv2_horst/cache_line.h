@@ -0,0 +1,48 @@
+#pragma once
+
+#include <new>
+#include <cstddef>
+
+namespace lv2_horst
+{
+  #define HORST_CACHE_LINE_SIZE 64
+
+  /*
+   * Allocates whole cache lines, so data written by different threads
+   * in separate containers never shares a line.
+   */
+  template<class T>
+  struct cache_aligned_allocator
+  {
+    typedef T value_type;
+
+    cache_aligned_allocator () { }
+
+    template<class U>
+    cache_aligned_allocator (const cache_aligned_allocator<U> &) { }
+
+    T *allocate
+    (
+      size_t n
+    )
+    {
+      const size_t size = (n * sizeof (T) + HORST_CACHE_LINE_SIZE - 1) / HORST_CACHE_LINE_SIZE * HORST_CACHE_LINE_SIZE;
+      return (T*)::operator new (size, std::align_val_t (HORST_CACHE_LINE_SIZE));
+    }
+
+    void deallocate
+    (
+      T *p,
+      size_t
+    )
+    {
+      ::operator delete (p, std::align_val_t (HORST_CACHE_LINE_SIZE));
+    }
+
+    template<class U>
+    bool operator== (const cache_aligned_allocator<U> &) const { return true; }
+
+    template<class U>
+    bool operator!= (const cache_aligned_allocator<U> &) const { return false; }
+  };
+}
@@ -1,33 +1,142 @@
+#pragma once
+
 #include <jack/jack.h>
+#include <lv2_horst/jack_backend.h>
 #include <lv2_horst/dbg.h>
 #include <lv2_horst/error.h>
 
 #include <vector>
 #include <utility>
 #include <algorithm>
+#include <set>
+#include <map>
+#include <mutex>
+#include <cerrno>
 
 namespace lv2_horst
 {
+  extern "C"
+  {
+    void connection_manager_port_registration_callback
+    (
+      jack_port_id_t id,
+      int registered,
+      void *arg
+    );
+
+    void connection_manager_port_connect_callback
+    (
+      jack_port_id_t source,
+      jack_port_id_t destination,
+      int connected,
+      void *arg
+    );
+
+    void connection_manager_port_rename_callback
+    (
+      jack_port_id_t id,
+      const char *old_name,
+      const char *new_name,
+      void *arg
+    );
+  }
+
+  /*
+   * The steps to get from the current graph to a desired one and the
+   * ones of them that failed when applied.
+   */
+  struct connection_diff
+  {
+    std::vector<std::pair<std::string, std::string>> m_connect;
+    std::vector<std::pair<std::string, std::string>> m_disconnect;
+    std::vector<std::pair<std::string, std::string>> m_failed;
+  };
+
+  /*
+   * A long lived client that keeps a mirror of all connections
+   * (source, destination) in the graph. The mirror is read once on
+   * construction and then kept up to date by the port registration,
+   * connect and rename notifications, so applying a connection set
+   * only talks to the server for the connections that actually
+   * change.
+   *
+   * If a notification names a port the manager can not resolve
+   * anymore the mirror is marked stale and read again on next use.
+   * Every change to the mirror bumps m_graph_generation, so a read
+   * that raced with one is done again (see refresh_graph ()).
+   */
   struct connection_manager
   {
-    jack_client_t *m_jack_client;
+    audio_backend_ptr m_backend;
+
+    std::mutex m_graph_mutex;
+    std::set<std::pair<std::string, std::string>> m_graph;
+    std::map<jack_port_id_t, std::string> m_port_names;
+    bool m_graph_stale;
+    uint64_t m_graph_generation;
 
     connection_manager
     (
       const std::string &jack_client_name = "lv2_horst_connection_manager"
     ) :
-      m_jack_client (jack_client_open (jack_client_name.c_str(), JackNullOption, 0))
+      m_backend (new jack_backend),
+      m_graph_stale (true),
+      m_graph_generation (0)
     {
       DBG_ENTER
+      m_backend->open (jack_client_name);
+      init ();
+      DBG_EXIT
+    }
 
-      if (m_jack_client == 0)
-      {
-        THROW(std::string("Failed to open jack client: ") + jack_client_name);
-      }
+    /*
+     * Opens a client named client_name on backend
+     */
+    connection_manager
+    (
+      audio_backend_ptr backend,
+      const std::string &client_name = "lv2_horst_connection_manager"
+    ) :
+      m_backend (backend),
+      m_graph_stale (true),
+      m_graph_generation (0)
+    {
+      DBG_ENTER
+      if (!m_backend) THROW("No backend");
+      m_backend->open (client_name);
+      init ();
+      DBG_EXIT
+    }
+
+    connection_manager (const connection_manager&) = delete;
+    connection_manager &operator= (const connection_manager&) = delete;
 
+    /*
+     * No notifications after this. The client is closed along with the
+     * backend.
+     */
+    ~connection_manager ()
+    {
+      DBG_ENTER
+      m_backend->deactivate ();
       DBG_EXIT
     }
 
+    /*
+     * Notifications only arrive once active, so the first read has to
+     * come after activating. Anything changing while it runs makes
+     * refresh_graph () read again.
+     */
+    void init ()
+    {
+      if (m_backend->set_port_registration_callback (connection_manager_port_registration_callback, (void*)this)) THROW("Failed to set port registration callback");
+      if (m_backend->set_port_connect_callback (connection_manager_port_connect_callback, (void*)this)) THROW("Failed to set port connect callback");
+      if (m_backend->set_port_rename_callback (connection_manager_port_rename_callback, (void*)this)) THROW("Failed to set port rename callback");
+      if (m_backend->activate ()) THROW("Failed to activate client");
+
+      refresh_graph ();
+    }
+
     std::vector<std::string> get_ports
     (
       const std::string &port_name_patttern = "",
@@ -35,62 +144,342 @@ namespace lv2_horst
       unsigned long flags = 0
     )
     {
-      std::vector<std::string> ports;
+      return m_backend->get_ports (port_name_patttern, port_type_pattern, flags);
+    }
 
-      const char **jack_ports = jack_get_ports (m_jack_client, port_name_patttern.c_str (), port_type_pattern.c_str (), flags);
+    /*
+     * Reads all connections from the server into the mirror. The read
+     * is not atomic, so if the mirror changed meanwhile (a
+     * notification or apply ()) the read is thrown away and done
+     * again rather than dropping that change.
+     */
+    void refresh_graph ()
+    {
+      while (true)
+      {
+        uint64_t generation;
+        {
+          std::lock_guard<std::mutex> lock (m_graph_mutex);
+          generation = m_graph_generation;
+        }
 
-      if (0 == jack_ports) return ports;
+        std::set<std::pair<std::string, std::string>> graph;
+        for (const std::string &source : m_backend->get_ports ("", "", JackPortIsOutput))
+        {
+          for (const std::string &destination : m_backend->port_get_connections (source)) graph.insert ({ source, destination });
+        }
 
-      const char **jack_ports_iterator = jack_ports;
-      while (*jack_ports_iterator != 0)
+        std::lock_guard<std::mutex> lock (m_graph_mutex);
+        if (generation != m_graph_generation) continue;
+
+        m_graph.swap (graph);
+        m_graph_stale = false;
+        ++m_graph_generation;
+        return;
+      }
+    }
+
+    /*
+     * The connections in the graph as currently mirrored
+     */
+    std::vector<std::pair<std::string, std::string>> get_connections ()
+    {
+      refresh_graph_if_stale ();
+
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      return std::vector<std::pair<std::string, std::string>> (m_graph.begin (), m_graph.end ());
+    }
+
+    /*
+     * What apply () would do: the connections in desired missing from
+     * the graph and, if exclusive, the connections in the graph that
+     * are not in desired but run between clients named in desired.
+     * Connections with an end in any other client are left alone
+     * either way.
+     */
+    connection_diff diff
+    (
+      const std::vector<std::pair<std::string, std::string>> &desired,
+      bool exclusive = false
+    )
+    {
+      refresh_graph_if_stale ();
+
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      return diff_locked (desired, exclusive);
+    }
+
+    /*
+     * Makes the graph match desired (see diff ()). Failed steps are
+     * reported in m_failed rather than thrown.
+     */
+    connection_diff apply
+    (
+      const std::vector<std::pair<std::string, std::string>> &desired,
+      bool exclusive = false
+    )
+    {
+      // Not holding the graph mutex while talking to the server: the
+      // notifications may be delivered synchronously
+      connection_diff d = diff (desired, exclusive);
+
+      std::vector<std::pair<std::string, std::string>> disconnected;
+      for (const auto &connection : d.m_disconnect)
       {
-        DBG("port: " << (*jack_ports_iterator))
-        ports.push_back (*jack_ports_iterator);
+        DBG("Disconnecting: \"" << connection.first << "\" -> \"" << connection.second << "\"")
+        if (m_backend->disconnect (connection.first, connection.second) == 0) disconnected.push_back (connection);
+        else if (still_connected (connection)) d.m_failed.push_back (connection);
+      }
 
-        // free (*jack_ports);
-        ++jack_ports_iterator;
+      std::vector<std::pair<std::string, std::string>> connected;
+      for (const auto &connection : d.m_connect)
+      {
+        DBG("Connecting: \"" << connection.first << "\" -> \"" << connection.second << "\"")
+        const int ret = m_backend->connect (connection.first, connection.second);
+        if (ret == 0 || ret == EEXIST) connected.push_back (connection);
+        else d.m_failed.push_back (connection);
       }
 
-      if (0 != jack_ports) free (jack_ports);
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      for (const auto &connection : disconnected) m_graph.erase (connection);
+      for (const auto &connection : connected) m_graph.insert (connection);
+      ++m_graph_generation;
 
-      return ports;
+      return d;
     }
 
+    /*
+     * Connects the_connections that are not connected yet.
+     */
     void connect
     (
-      std::vector<std::pair<std::string, std::string>> &the_connections,
+      const std::vector<std::pair<std::string, std::string>> &the_connections,
       bool throw_on_error = false
     )
     {
-      for (size_t index = 0; index < the_connections.size (); ++index)
-      {
-        DBG("Connecting: \"" << the_connections[index].first << "\" -> \"" << the_connections[index].second << "\"")
-        int ret = jack_connect (m_jack_client, the_connections[index].first.c_str (), the_connections[index].second.c_str ());
+      const connection_diff d = apply (the_connections);
 
-        if (0 != ret && throw_on_error)
-        {
-          THROW(std::string("Failed to connect: \"") + the_connections[index].first + "\" -> \"" + the_connections[index].second)
-        }
+      if (!d.m_failed.empty () && throw_on_error)
+      {
+        THROW(std::string("Failed to connect: \"") + d.m_failed[0].first + "\" -> \"" + d.m_failed[0].second)
       }
     }
 
+    /*
+     * Disconnects the_connections that are connected.
+     */
     void disconnect
     (
-      std::vector<std::pair<std::string, std::string>> &the_connections
+      const std::vector<std::pair<std::string, std::string>> &the_connections
     )
     {
-      for (size_t index = 0; index < the_connections.size (); ++index)
+      refresh_graph_if_stale ();
+
+      std::vector<std::pair<std::string, std::string>> connected;
+      {
+        std::lock_guard<std::mutex> lock (m_graph_mutex);
+        for (const auto &connection : the_connections) if (m_graph.count (connection)) connected.push_back (connection);
+      }
+
+      for (const auto &connection : connected)
       {
-        DBG("Disonnecting: \"" << the_connections[index].first << "\" -> \"" << the_connections[index].second << "\"")
-        int ret = jack_disconnect (m_jack_client, the_connections[index].first.c_str (), the_connections[index].second.c_str ());
+        DBG("Disonnecting: \"" << connection.first << "\" -> \"" << connection.second << "\"")
+        int ret = m_backend->disconnect (connection.first, connection.second);
 
-        if (0 != ret)
+        if (0 != ret && still_connected (connection))
         {
-          THROW(std::string("Failed to disconnect: \"") + the_connections[index].first + "\" -> \"" + the_connections[index].second)
+          THROW(std::string("Failed to disconnect: \"") + connection.first + "\" -> \"" + connection.second)
         }
+
+        std::lock_guard<std::mutex> lock (m_graph_mutex);
+        m_graph.erase (connection);
+        ++m_graph_generation;
       }
     }
+
+    /*
+     * False if someone else disconnected it meanwhile
+     */
+    bool still_connected
+    (
+      const std::pair<std::string, std::string> &connection
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      return m_graph.count (connection) > 0;
+    }
+
+    void refresh_graph_if_stale ()
+    {
+      {
+        std::lock_guard<std::mutex> lock (m_graph_mutex);
+        if (!m_graph_stale) return;
+      }
+      refresh_graph ();
+    }
+
+    connection_diff diff_locked
+    (
+      const std::vector<std::pair<std::string, std::string>> &desired,
+      bool exclusive
+    )
+    {
+      connection_diff d;
+
+      const std::set<std::pair<std::string, std::string>> wanted (desired.begin (), desired.end ());
+      for (const auto &connection : wanted)
+      {
+        if (m_graph.count (connection) == 0) d.m_connect.push_back (connection);
+      }
+
+      if (!exclusive) return d;
+
+      auto client = [] (const std::string &port) { return port.substr (0, port.find (':')); };
+
+      std::set<std::string> clients;
+      for (const auto &connection : wanted)
+      {
+        clients.insert (client (connection.first));
+        clients.insert (client (connection.second));
+      }
+
+      for (const auto &connection : m_graph)
+      {
+        if (wanted.count (connection)) continue;
+        if (clients.count (client (connection.first)) && clients.count (client (connection.second))) d.m_disconnect.push_back (connection);
+      }
+
+      return d;
+    }
+
+    /*
+     * The name of port id, remembered so it can still be resolved
+     * after the port is gone. "" if unknown.
+     */
+    std::string port_name_locked
+    (
+      jack_port_id_t id
+    )
+    {
+      auto it = m_port_names.find (id);
+      if (it != m_port_names.end ()) return it->second;
+
+      const std::string name = m_backend->port_name_by_id (id);
+      if (!name.empty ()) m_port_names[id] = name;
+      return name;
+    }
+
+    void port_registration_callback
+    (
+      jack_port_id_t id,
+      int registered
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      ++m_graph_generation;
+      if (registered)
+      {
+        port_name_locked (id);
+        return;
+      }
+
+      // JACK reuses port ids
+      auto it = m_port_names.find (id);
+      if (it == m_port_names.end ()) return;
+
+      const std::string name = it->second;
+      m_port_names.erase (it);
+
+      for (auto connection = m_graph.begin (); connection != m_graph.end ();)
+      {
+        if (connection->first == name || connection->second == name) connection = m_graph.erase (connection);
+        else ++connection;
+      }
+    }
+
+    /*
+     * JACK passes the source first
+     */
+    void port_connect_callback
+    (
+      jack_port_id_t source,
+      jack_port_id_t destination,
+      int connected
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      ++m_graph_generation;
+
+      const std::string source_name = port_name_locked (source);
+      const std::string destination_name = port_name_locked (destination);
+      if (source_name.empty () || destination_name.empty ())
+      {
+        m_graph_stale = true;
+        return;
+      }
+
+      if (connected) m_graph.insert ({ source_name, destination_name });
+      else m_graph.erase ({ source_name, destination_name });
+    }
+
+    /*
+     * Renames the port in the mirror's connections
+     */
+    void port_rename_callback
+    (
+      jack_port_id_t id,
+      const std::string &old_name,
+      const std::string &new_name
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_graph_mutex);
+      ++m_graph_generation;
+
+      m_port_names[id] = new_name;
+
+      std::set<std::pair<std::string, std::string>> graph;
+      for (const auto &connection : m_graph)
+      {
+        graph.insert ({ connection.first == old_name ? new_name : connection.first, connection.second == old_name ? new_name : connection.second });
+      }
+      m_graph.swap (graph);
+    }
   };
 
   typedef std::shared_ptr<connection_manager> connection_manager_ptr;
+
+  extern "C"
+  {
+    void connection_manager_port_registration_callback
+    (
+      jack_port_id_t id,
+      int registered,
+      void *arg
+    )
+    {
+      ((connection_manager*)arg)->port_registration_callback (id, registered);
+    }
+
+    void connection_manager_port_connect_callback
+    (
+      jack_port_id_t source,
+      jack_port_id_t destination,
+      int connected,
+      void *arg
+    )
+    {
+      ((connection_manager*)arg)->port_connect_callback (source, destination, connected);
+    }
+
+    void connection_manager_port_rename_callback
+    (
+      jack_port_id_t id,
+      const char *old_name,
+      const char *new_name,
+      void *arg
+    )
+    {
+      ((connection_manager*)arg)->port_rename_callback (id, old_name, new_name);
+    }
+  }
 }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <jack/jack.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace lv2_horst
+{
+  /*
+   * The plugin ports backed by JACK audio ports (audio, cv and exposed
+   * control ports), as dense arrays so the process thread does not
+   * need to look at port properties per period.
+   *
+   * m_connected holds the location each plugin port was last connected
+   * to, so ports are only reconnected when it changes.
+   */
+  struct connection_plan
+  {
+    std::vector<size_t> m_port_indices;
+    std::vector<jack_port_t *> m_jack_ports;
+    std::vector<uint8_t> m_is_input;
+    std::vector<float *> m_connected;
+
+    void add
+    (
+      size_t port_index,
+      jack_port_t *jack_port,
+      bool is_input
+    )
+    {
+      m_port_indices.push_back (port_index);
+      m_jack_ports.push_back (jack_port);
+      m_is_input.push_back (is_input);
+      m_connected.push_back (0);
+    }
+
+    size_t size () const
+    {
+      return m_port_indices.size ();
+    }
+
+    /*
+     * Forces all ports to be reconnected, e.g. after the plugin was
+     * re-instantiated.
+     */
+    void invalidate ()
+    {
+      for (size_t index = 0; index < m_connected.size (); ++index)
+      {
+        m_connected[index] = 0;
+      }
+    }
+  };
+}
@@ -85,6 +85,18 @@ namespace lv2_horst
       return read_chunk_size ();
     }
 
+    /*
+     * Returns the number of bytes in use (including chunk headers).
+     * Safe to call from any thread, though the result might be
+     * outdated immediately.
+     */
+    inline int used () const
+    {
+      const int head = m_head.load (std::memory_order_relaxed);
+      const int tail = m_tail.load (std::memory_order_relaxed);
+      return (head - tail + m_base_buffer_size) % m_base_buffer_size;
+    }
+
     /*
      * Returns the maximum size available for the next chunk
      * for writing.
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <lv2_horst/seqlock.h>
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace lv2_horst
+{
+  struct control_values
+  {
+    /*
+     * The period the values were published in. Counts periods since
+     * the snapshot was created.
+     */
+    uint64_t m_period;
+
+    std::vector<size_t> m_port_indices;
+    std::vector<float> m_values;
+  };
+
+  /*
+   * Values of a set of control ports, published by the process thread
+   * once per period as a whole. Readers always see the values of a
+   * single period.
+   *
+   * m_values is indexed by port index so single values can be read
+   * without a lookup. Only entries for m_port_indices are written.
+   */
+  struct control_snapshot
+  {
+    seqlock m_lock;
+
+    const std::vector<size_t> m_port_indices;
+
+    std::atomic<uint64_t> m_period;
+    std::vector<std::atomic<float>> m_values;
+
+    control_snapshot
+    (
+      size_t number_of_ports,
+      const std::vector<size_t> &port_indices
+    ) :
+      m_port_indices (port_indices),
+      m_period (0),
+      m_values (number_of_ports)
+    {
+      for (size_t index = 0; index < number_of_ports; ++index)
+      {
+        m_values[index] = 0;
+      }
+    }
+
+    /*
+     * port_values is indexed by port index.
+     */
+    inline void publish
+    (
+      uint64_t period,
+      const float *port_values
+    )
+    {
+      m_lock.write_begin ();
+
+      for (size_t index = 0; index < m_port_indices.size (); ++index)
+      {
+        const size_t port_index = m_port_indices[index];
+        m_values[port_index].store (port_values[port_index], std::memory_order_relaxed);
+      }
+      m_period.store (period, std::memory_order_relaxed);
+
+      m_lock.write_end ();
+    }
+
+    control_values read () const
+    {
+      control_values values { 0, m_port_indices, std::vector<float> (m_port_indices.size ()) };
+
+      uint64_t sequence;
+      do
+      {
+        sequence = m_lock.read_begin ();
+
+        for (size_t index = 0; index < m_port_indices.size (); ++index)
+        {
+          values.m_values[index] = m_values[m_port_indices[index]].load (std::memory_order_relaxed);
+        }
+        values.m_period = m_period.load (std::memory_order_relaxed);
+      } while (m_lock.read_retry (sequence));
+
+      return values;
+    }
+
+    inline float value
+    (
+      size_t port_index
+    ) const
+    {
+      return m_values[port_index].load (std::memory_order_relaxed);
+    }
+
+    /*
+     * A single value along with the period it was published in
+     */
+    inline float value
+    (
+      size_t port_index,
+      uint64_t &period
+    ) const
+    {
+      float v;
+      uint64_t sequence;
+      do
+      {
+        sequence = m_lock.read_begin ();
+        v = m_values[port_index].load (std::memory_order_relaxed);
+        period = m_period.load (std::memory_order_relaxed);
+      } while (m_lock.read_retry (sequence));
+
+      return v;
+    }
+  };
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <lv2_horst/horst.h>
+#include <lv2_horst/dummy_ports.h>
+#include <lv2_horst/dsp_timing.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace lv2_horst
+{
+  /*
+   * The cost of one period. Loads are fractions of the period length.
+   */
+  struct unit_cost
+  {
+    size_t m_block_length;
+    double m_mean_seconds;
+    double m_max_seconds;
+    double m_mean_load;
+    double m_max_load;
+  };
+
+  /*
+   * A calibration run: runs h on dummy buffers for warmup + periods
+   * periods of block_length frames and times each run (). h must be
+   * instantiated for at least block_length frames and must not be run
+   * anywhere else meanwhile, so one hosted by a jacked_horst is
+   * refused. Its ports are connected back to where they were
+   * afterwards.
+   */
+  inline unit_cost measure_cost
+  (
+    horst_ptr h,
+    double sample_rate,
+    size_t block_length,
+    size_t periods = 1000,
+    size_t warmup = 100,
+    dummy_signal signal = dummy_signal::noise
+  )
+  {
+    if (periods == 0) THROW("Need at least one period to measure");
+    if (!h->m_plugin_instance) THROW("Not instantiated: " + h->m_name);
+    if (h->m_hosted) THROW("Run by a jacked_horst: " + h->m_name);
+    if (block_length > h->m_max_block_length)
+    {
+      THROW("Block length " + std::to_string (block_length) + " exceeds the maximum of " + std::to_string (h->m_max_block_length) + " " + h->m_name + " was instantiated with");
+    }
+
+    const std::vector<void *> connections = h->m_port_connections;
+    auto reconnect = [&] ()
+    {
+      for (size_t index = 0; index < connections.size (); ++index) h->connect_port (index, connections[index]);
+    };
+
+    uint64_t total_ticks = 0;
+    uint64_t max_ticks = 0;
+    try
+    {
+      dummy_ports ports (h, block_length, signal, sample_rate);
+
+      for (size_t period = 0; period < warmup; ++period) ports.run ();
+
+      for (size_t period = 0; period < periods; ++period)
+      {
+        ports.prepare ();
+        const uint64_t start_ticks = cycle_counter ();
+        h->run (block_length);
+        const uint64_t ticks = cycle_counter () - start_ticks;
+
+        total_ticks += ticks;
+        max_ticks = std::max (max_ticks, ticks);
+      }
+    }
+    catch (...)
+    {
+      reconnect ();
+      throw;
+    }
+    reconnect ();
+
+    const double ticks_per_second = cycle_counter_ticks_per_second ();
+    const double period_seconds = block_length / sample_rate;
+
+    unit_cost c;
+    c.m_block_length = block_length;
+    c.m_mean_seconds = total_ticks / ticks_per_second / periods;
+    c.m_max_seconds = max_ticks / ticks_per_second;
+    c.m_mean_load = c.m_mean_seconds / period_seconds;
+    c.m_max_load = c.m_max_seconds / period_seconds;
+    return c;
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <lv2_horst/cache_line.h>
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <bit>
+
+namespace lv2_horst
+{
+  /*
+   * A set of indices marked by control threads and consumed by the
+   * process thread.
+   *
+   * Marking sets a bit and bumps a version. The process thread only
+   * looks at the bits when the version moved since its last look, so
+   * an idle set costs a single load per period.
+   *
+   * Data belonging to a marked index must be stored before mark ()
+   * and is visible to the process thread in consume ().
+   */
+  struct dirty_set
+  {
+    std::vector<std::atomic<uint64_t>, cache_aligned_allocator<std::atomic<uint64_t>>> m_words;
+
+    alignas(HORST_CACHE_LINE_SIZE) std::atomic<uint64_t> m_version;
+
+    /*
+     * Process thread only
+     */
+    alignas(HORST_CACHE_LINE_SIZE) uint64_t m_consumed_version;
+
+    dirty_set
+    (
+      size_t size
+    ) :
+      m_words ((size + 63) / 64),
+      m_version (0),
+      m_consumed_version (0)
+    {
+      for (size_t index = 0; index < m_words.size (); ++index)
+      {
+        m_words[index] = 0;
+      }
+    }
+
+    /*
+     * Returns the version the mark was made with. Once
+     * m_consumed_version reaches it the mark has been consumed.
+     */
+    inline uint64_t mark
+    (
+      size_t index
+    )
+    {
+      m_words[index / 64].fetch_or ((uint64_t)1 << (index % 64), std::memory_order_release);
+      return m_version.fetch_add (1, std::memory_order_release) + 1;
+    }
+
+    /*
+     * Calls f (index) for every index marked since the last call and
+     * clears the marks.
+     */
+    template<class F>
+    inline void consume
+    (
+      F f
+    )
+    {
+      const uint64_t version = m_version.load (std::memory_order_acquire);
+      if (version == m_consumed_version) return;
+      m_consumed_version = version;
+
+      for (size_t word = 0; word < m_words.size (); ++word)
+      {
+        if (m_words[word].load (std::memory_order_relaxed) == 0) continue;
+
+        uint64_t bits = m_words[word].exchange (0, std::memory_order_acquire);
+        while (bits)
+        {
+          f (word * 64 + (size_t)std::countr_zero (bits));
+          bits &= bits - 1;
+        }
+      }
+    }
+  };
+}
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <lv2_horst/seqlock.h>
+
+#include <array>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+namespace lv2_horst
+{
+  /*
+   * A cheap monotonic tick counter: the TSC on x86, the virtual
+   * counter on aarch64 and the steady clock elsewhere.
+   */
+  inline uint64_t cycle_counter ()
+  {
+    #if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc ();
+    #elif defined(__aarch64__)
+      uint64_t ticks;
+      asm volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+      return ticks;
+    #else
+      return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+    #endif
+  }
+
+  /*
+   * Measured once against the steady clock. The first call blocks for
+   * a few milliseconds, so make it outside the process thread.
+   */
+  inline double cycle_counter_ticks_per_second ()
+  {
+    static const double ticks_per_second = [] ()
+    {
+      const auto start = std::chrono::steady_clock::now ();
+      const uint64_t start_ticks = cycle_counter ();
+      std::this_thread::sleep_for (std::chrono::milliseconds (20));
+      const uint64_t end_ticks = cycle_counter ();
+      const auto end = std::chrono::steady_clock::now ();
+      return (end_ticks - start_ticks) / std::chrono::duration<double> (end - start).count ();
+    } ();
+    return ticks_per_second;
+  }
+
+  enum class dsp_timing_phase
+  {
+    // The whole process callback including the host's own work
+    process,
+    // The plugin's run ()
+    run,
+    // Delivering worker responses to the plugin
+    work_response,
+    // The plugin's end_run ()
+    end_run
+  };
+
+  const size_t number_of_dsp_timing_phases = 4;
+
+  /*
+   * All times are fractions of the period length.
+   */
+  struct timing_summary
+  {
+    uint64_t m_count;
+    float m_min;
+    float m_mean;
+    float m_p99;
+    float m_max;
+
+    /*
+     * m_histogram[bin] counts the periods with a time in
+     * [m_bin_edges[bin], m_bin_edges[bin + 1]).
+     */
+    std::vector<uint64_t> m_histogram;
+    std::vector<float> m_bin_edges;
+  };
+
+  /*
+   * A histogram of times as fractions of the period with four bins per
+   * octave from 2^-16 up to 2^4 periods. Bin 0 collects everything
+   * shorter.
+   */
+  struct timing_histogram
+  {
+    static const int bins_per_octave = 4;
+    static const int lowest_octave = -16;
+    static const size_t number_of_bins = 1 + 20 * bins_per_octave;
+
+    std::atomic<uint64_t> m_count;
+
+    // A float sum stops growing after a few million periods
+    std::atomic<double> m_sum;
+    std::atomic<float> m_min;
+    std::atomic<float> m_max;
+    std::array<std::atomic<uint64_t>, number_of_bins> m_bins;
+
+    timing_histogram ()
+    {
+      clear ();
+    }
+
+    static inline size_t bin
+    (
+      float fraction
+    )
+    {
+      if (!(fraction > 0)) return 0;
+      const float position = (log2f (fraction) - lowest_octave) * bins_per_octave;
+      if (position < 0) return 0;
+      return std::min<size_t> (number_of_bins - 1, 1 + (size_t)position);
+    }
+
+    /*
+     * The lower edge of a bin. The lower edge of bin
+     * number_of_bins is the upper edge of the last bin.
+     */
+    static inline float bin_edge
+    (
+      size_t bin
+    )
+    {
+      if (bin == 0) return 0;
+      return exp2f (lowest_octave + (bin - 1) / (float)bins_per_octave);
+    }
+
+    /*
+     * Single writer
+     */
+    inline void clear ()
+    {
+      m_count.store (0, std::memory_order_relaxed);
+      m_sum.store (0, std::memory_order_relaxed);
+      m_min.store (0, std::memory_order_relaxed);
+      m_max.store (0, std::memory_order_relaxed);
+      for (size_t index = 0; index < number_of_bins; ++index) m_bins[index].store (0, std::memory_order_relaxed);
+    }
+
+    /*
+     * Single writer
+     */
+    inline void record
+    (
+      float fraction
+    )
+    {
+      const uint64_t count = m_count.load (std::memory_order_relaxed);
+      m_count.store (count + 1, std::memory_order_relaxed);
+      m_sum.store (m_sum.load (std::memory_order_relaxed) + fraction, std::memory_order_relaxed);
+      if (count == 0 || fraction < m_min.load (std::memory_order_relaxed)) m_min.store (fraction, std::memory_order_relaxed);
+      if (count == 0 || fraction > m_max.load (std::memory_order_relaxed)) m_max.store (fraction, std::memory_order_relaxed);
+
+      std::atomic<uint64_t> &b = m_bins[bin (fraction)];
+      b.store (b.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Not synchronized by itself (see dsp_timing::read ()).
+     */
+    timing_summary summary () const
+    {
+      timing_summary s;
+      s.m_count = m_count.load (std::memory_order_relaxed);
+      s.m_min = m_min.load (std::memory_order_relaxed);
+      s.m_max = m_max.load (std::memory_order_relaxed);
+      s.m_mean = s.m_count ? (float)(m_sum.load (std::memory_order_relaxed) / s.m_count) : 0;
+      s.m_p99 = 0;
+
+      s.m_histogram.resize (number_of_bins);
+      s.m_bin_edges.resize (number_of_bins + 1);
+
+      for (size_t index = 0; index < number_of_bins; ++index)
+      {
+        s.m_histogram[index] = m_bins[index].load (std::memory_order_relaxed);
+      }
+
+      for (size_t index = 0; index <= number_of_bins; ++index)
+      {
+        s.m_bin_edges[index] = bin_edge (index);
+      }
+
+      // The p99 is the upper edge of the bin it falls into
+      uint64_t cumulative = 0;
+      for (size_t index = 0; index < number_of_bins; ++index)
+      {
+        cumulative += s.m_histogram[index];
+        if (s.m_count > 0 && cumulative * 100 >= s.m_count * 99)
+        {
+          s.m_p99 = std::min (s.m_max, s.m_bin_edges[index + 1]);
+          break;
+        }
+      }
+
+      return s;
+    }
+  };
+
+  /*
+   * Per instance DSP time profiling. The process thread accumulates
+   * the ticks spent in each phase during a period and records them
+   * into the histograms at the end of it (see end_period ()).
+   *
+   * Nothing is measured unless enabled. Resetting is requested by a
+   * control thread and carried out by the process thread.
+   */
+  struct dsp_timing
+  {
+    std::atomic<bool> m_atomic_enabled;
+    std::atomic<bool> m_atomic_reset;
+
+    seqlock m_lock;
+    std::array<timing_histogram, number_of_dsp_timing_phases> m_histograms;
+
+    /*
+     * Process thread only
+     */
+    std::array<uint64_t, number_of_dsp_timing_phases> m_period_ticks;
+
+    dsp_timing () :
+      m_atomic_enabled (false),
+      m_atomic_reset (false)
+    {
+      m_period_ticks.fill (0);
+    }
+
+    inline bool enabled () const
+    {
+      return m_atomic_enabled.load (std::memory_order_relaxed);
+    }
+
+    inline void add
+    (
+      dsp_timing_phase phase,
+      uint64_t ticks
+    )
+    {
+      m_period_ticks[(size_t)phase] += ticks;
+    }
+
+    /*
+     * ticks_per_period is the length of the period in cycle_counter ()
+     * ticks.
+     */
+    inline void end_period
+    (
+      double ticks_per_period
+    )
+    {
+      m_lock.write_begin ();
+
+      if (m_atomic_reset.exchange (false, std::memory_order_relaxed))
+      {
+        for (timing_histogram &h : m_histograms) h.clear ();
+      }
+
+      for (size_t phase = 0; phase < number_of_dsp_timing_phases; ++phase)
+      {
+        m_histograms[phase].record ((float)(m_period_ticks[phase] / ticks_per_period));
+        m_period_ticks[phase] = 0;
+      }
+
+      m_lock.write_end ();
+    }
+
+    timing_summary read
+    (
+      dsp_timing_phase phase
+    ) const
+    {
+      timing_summary s;
+
+      uint64_t sequence;
+      do
+      {
+        sequence = m_lock.read_begin ();
+        s = m_histograms[(size_t)phase].summary ();
+      } while (m_lock.read_retry (sequence));
+
+      return s;
+    }
+
+    void reset ()
+    {
+      m_atomic_reset = true;
+    }
+  };
+}
@@ -0,0 +1,1234 @@
+#pragma once
+
+#include <lv2_horst/audio_backend.h>
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <jack/jack.h>
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <regex>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <map>
+
+namespace lv2_horst
+{
+  struct dummy_midi_event
+  {
+    jack_nframes_t m_time;
+    size_t m_offset;
+    size_t m_size;
+  };
+
+  /*
+   * A MIDI port buffer with fixed capacity. Events are kept sorted by
+   * time (stable for equal times). Writes that do not fit are dropped,
+   * like with JACK.
+   */
+  struct dummy_midi_buffer
+  {
+    std::vector<dummy_midi_event> m_events;
+    size_t m_number_of_events;
+
+    std::vector<jack_midi_data_t> m_data;
+    size_t m_data_used;
+
+    dummy_midi_buffer
+    (
+      size_t max_events = 1024,
+      size_t max_data = 16384
+    ) :
+      m_events (max_events),
+      m_number_of_events (0),
+      m_data (max_data),
+      m_data_used (0)
+    {
+
+    }
+
+    void clear ()
+    {
+      m_number_of_events = 0;
+      m_data_used = 0;
+    }
+
+    int write
+    (
+      jack_nframes_t time,
+      const jack_midi_data_t *data,
+      size_t size
+    )
+    {
+      if (m_number_of_events == m_events.size () || m_data_used + size > m_data.size ()) return ENOBUFS;
+
+      size_t position = m_number_of_events;
+      while (position > 0 && m_events[position - 1].m_time > time)
+      {
+        m_events[position] = m_events[position - 1];
+        --position;
+      }
+
+      m_events[position] = dummy_midi_event { time, m_data_used, size };
+      memcpy (&m_data[m_data_used], data, size);
+
+      m_data_used += size;
+      ++m_number_of_events;
+      return 0;
+    }
+
+    int get
+    (
+      jack_midi_event_t *event,
+      uint32_t event_index
+    )
+    {
+      if (event_index >= m_number_of_events) return ENODATA;
+
+      const dummy_midi_event &e = m_events[event_index];
+      event->time = e.m_time;
+      event->size = e.m_size;
+      event->buffer = &m_data[e.m_offset];
+      return 0;
+    }
+  };
+
+  struct dummy_client;
+
+  struct dummy_port
+  {
+    std::string m_name;
+    std::string m_type;
+    unsigned long m_flags;
+    dummy_client *m_client;
+    jack_port_id_t m_id;
+
+    std::vector<float> m_audio_buffer;
+    dummy_midi_buffer m_midi_buffer;
+
+    // Only used for inputs
+    std::vector<dummy_port *> m_sources;
+    // Only used for outputs
+    std::vector<dummy_port *> m_destinations;
+
+    jack_latency_range_t m_capture_latency;
+    jack_latency_range_t m_playback_latency;
+
+    dummy_port
+    (
+      const std::string &name,
+      const std::string &type,
+      unsigned long flags,
+      dummy_client *client,
+      jack_port_id_t id,
+      jack_nframes_t buffer_size
+    ) :
+      m_name (name),
+      m_type (type),
+      m_flags (flags),
+      m_client (client),
+      m_id (id),
+      m_audio_buffer (is_midi () ? 0 : buffer_size, 0),
+      m_midi_buffer (is_midi () ? 1024 : 0, is_midi () ? 16384 : 0),
+      m_capture_latency { 0, 0 },
+      m_playback_latency { 0, 0 }
+    {
+
+    }
+
+    bool is_midi () const
+    {
+      return m_type == JACK_DEFAULT_MIDI_TYPE;
+    }
+
+    bool is_input () const
+    {
+      return m_flags & JackPortIsInput;
+    }
+  };
+
+  typedef std::unique_ptr<dummy_port> dummy_port_ptr;
+
+  struct dummy_client
+  {
+    std::string m_name;
+    std::vector<dummy_port_ptr> m_ports;
+    bool m_active;
+    bool m_thread_initialized;
+
+    JackProcessCallback m_process_callback;
+    void *m_process_arg;
+    JackBufferSizeCallback m_buffer_size_callback;
+    void *m_buffer_size_arg;
+    JackSampleRateCallback m_sample_rate_callback;
+    void *m_sample_rate_arg;
+    JackThreadInitCallback m_thread_init_callback;
+    void *m_thread_init_arg;
+    JackLatencyCallback m_latency_callback;
+    void *m_latency_arg;
+    JackXRunCallback m_xrun_callback;
+    void *m_xrun_arg;
+    JackPortRegistrationCallback m_port_registration_callback;
+    void *m_port_registration_arg;
+    JackPortConnectCallback m_port_connect_callback;
+    void *m_port_connect_arg;
+    JackPortRenameCallback m_port_rename_callback;
+    void *m_port_rename_arg;
+
+    dummy_client
+    (
+      const std::string &name
+    ) :
+      m_name (name),
+      m_active (false),
+      m_thread_initialized (false),
+      m_process_callback (0),
+      m_process_arg (0),
+      m_buffer_size_callback (0),
+      m_buffer_size_arg (0),
+      m_sample_rate_callback (0),
+      m_sample_rate_arg (0),
+      m_thread_init_callback (0),
+      m_thread_init_arg (0),
+      m_latency_callback (0),
+      m_latency_arg (0),
+      m_xrun_callback (0),
+      m_xrun_arg (0),
+      m_port_registration_callback (0),
+      m_port_registration_arg (0),
+      m_port_connect_callback (0),
+      m_port_connect_arg (0),
+      m_port_rename_callback (0),
+      m_port_rename_arg (0)
+    {
+
+    }
+  };
+
+  /*
+   * An in-process stand-in for a JACK server: it runs the process
+   * callbacks of the clients registered through dummy_backend, either
+   * when cycle () is called, or from an internal thread started with
+   * start (). That thread runs at real-time pace (counting xruns when
+   * a cycle takes longer than a period) or as fast as possible.
+   *
+   * The driver owns the client "system" with the ports capture_N and
+   * playback_N. With loopback enabled, what reaches playback_N in one
+   * cycle comes out of capture_N in the next.
+   *
+   * Clients are run in the order of their connections (a client
+   * feeding another runs first). Inputs with several sources are
+   * mixed. Feedback loops are run in registration order.
+   *
+   * Port registration and connection notifications are delivered
+   * synchronously, after the graph change, on the thread making it.
+   */
+  struct dummy_driver
+  {
+    std::atomic<jack_nframes_t> m_sample_rate;
+    std::atomic<jack_nframes_t> m_buffer_size;
+    const bool m_loopback;
+
+    /*
+     * Protects the graph. Held for the whole of a cycle, so everything
+     * holding it is excluded from running concurrently with process
+     * callbacks.
+     */
+    std::mutex m_mutex;
+
+    dummy_client m_system;
+    std::vector<dummy_port *> m_capture_ports;
+    std::vector<dummy_port *> m_playback_ports;
+
+    // In registration order, including m_system
+    std::vector<dummy_client *> m_clients;
+    std::map<jack_port_id_t, dummy_port *> m_ports_by_id;
+    jack_port_id_t m_next_port_id;
+    std::vector<dummy_client *> m_order;
+    bool m_order_dirty;
+
+    std::atomic<uint64_t> m_atomic_frames;
+    std::atomic<uint64_t> m_atomic_xruns;
+
+    std::atomic<bool> m_atomic_running;
+    std::thread m_thread;
+
+    dummy_driver
+    (
+      jack_nframes_t sample_rate = 48000,
+      jack_nframes_t buffer_size = 256,
+      size_t channels = 2,
+      bool loopback = true
+    ) :
+      m_sample_rate (sample_rate),
+      m_buffer_size (buffer_size),
+      m_loopback (loopback),
+      m_system ("system"),
+      m_next_port_id (1),
+      m_order_dirty (true),
+      m_atomic_frames (0),
+      m_atomic_xruns (0),
+      m_atomic_running (false)
+    {
+      if (sample_rate == 0 || buffer_size == 0) THROW("Sample rate and buffer size must not be 0");
+
+      for (size_t channel = 1; channel <= channels; ++channel)
+      {
+        m_capture_ports.push_back (add_port (&m_system, "capture_" + std::to_string (channel), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput | JackPortIsPhysical | JackPortIsTerminal));
+        m_playback_ports.push_back (add_port (&m_system, "playback_" + std::to_string (channel), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput | JackPortIsPhysical | JackPortIsTerminal));
+      }
+
+      m_system.m_active = true;
+      m_clients.push_back (&m_system);
+    }
+
+    ~dummy_driver ()
+    {
+      stop ();
+    }
+
+    /*
+     * Runs one period
+     */
+    void cycle ()
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      const jack_nframes_t nframes = m_buffer_size;
+
+      if (m_loopback)
+      {
+        for (size_t index = 0; index < m_capture_ports.size (); ++index)
+        {
+          m_capture_ports[index]->m_audio_buffer = m_playback_ports[index]->m_audio_buffer;
+        }
+      }
+
+      if (m_order_dirty) update_order ();
+
+      for (dummy_client *client : m_order)
+      {
+        mix_inputs (client, nframes);
+
+        if (client->m_process_callback == 0) continue;
+
+        if (!client->m_thread_initialized)
+        {
+          if (client->m_thread_init_callback) client->m_thread_init_callback (client->m_thread_init_arg);
+          client->m_thread_initialized = true;
+        }
+
+        client->m_process_callback (nframes, client->m_process_arg);
+      }
+
+      mix_inputs (&m_system, nframes);
+
+      m_atomic_frames += nframes;
+    }
+
+    /*
+     * Runs cycles from an internal thread until stop () is called.
+     * With realtime false they run back to back.
+     */
+    void start
+    (
+      bool realtime = true
+    )
+    {
+      if (m_atomic_running) THROW("The dummy driver is already running");
+
+      m_atomic_running = true;
+      m_thread = std::thread ([this, realtime] () { run (realtime); });
+    }
+
+    void stop ()
+    {
+      m_atomic_running = false;
+      if (m_thread.joinable ()) m_thread.join ();
+    }
+
+    void set_buffer_size
+    (
+      jack_nframes_t buffer_size
+    )
+    {
+      if (buffer_size == 0) THROW("Buffer size must not be 0");
+
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_buffer_size = buffer_size;
+
+      for (dummy_client *client : m_clients)
+      {
+        for (dummy_port_ptr &port : client->m_ports)
+        {
+          if (!port->is_midi ()) port->m_audio_buffer.assign (buffer_size, 0);
+        }
+
+        if (client->m_active && client->m_buffer_size_callback) client->m_buffer_size_callback (buffer_size, client->m_buffer_size_arg);
+      }
+    }
+
+    uint64_t get_frames () const
+    {
+      return m_atomic_frames;
+    }
+
+    uint64_t get_xruns () const
+    {
+      return m_atomic_xruns;
+    }
+
+    /*
+     * The rest is used by dummy_backend. Functions with "locked" in
+     * their name expect m_mutex to be held.
+     */
+    void add_client
+    (
+      dummy_client *client,
+      const std::string &requested_name
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      // Like JACK: name, name-01, name-02, ...
+      std::string name = requested_name;
+      for (int suffix = 1; find_client_locked (name) != 0; ++suffix)
+      {
+        char buffer[16];
+        snprintf (buffer, sizeof (buffer), "-%02d", suffix);
+        name = requested_name + buffer;
+      }
+
+      client->m_name = name;
+      m_clients.push_back (client);
+      m_order_dirty = true;
+    }
+
+    void remove_client
+    (
+      dummy_client *client
+    )
+    {
+      notifications n;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+
+        m_clients.erase (std::remove (m_clients.begin (), m_clients.end (), client), m_clients.end ());
+        m_order_dirty = true;
+
+        for (dummy_port_ptr &port : client->m_ports) disconnect_all_locked (port.get (), n);
+        for (dummy_port_ptr &port : client->m_ports)
+        {
+          m_ports_by_id.erase (port->m_id);
+          notify_port_registration_locked (n, port->m_id, 0);
+        }
+      }
+      deliver (n);
+    }
+
+    dummy_port *register_port
+    (
+      dummy_client *client,
+      const std::string &name,
+      const std::string &type,
+      unsigned long flags
+    )
+    {
+      notifications n;
+      dummy_port *port;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+
+        if (type != JACK_DEFAULT_AUDIO_TYPE && type != JACK_DEFAULT_MIDI_TYPE) return 0;
+        if (find_port_locked (client->m_name + ":" + name) != 0) return 0;
+
+        port = add_port (client, name, type, flags);
+        notify_port_registration_locked (n, port->m_id, 1);
+      }
+      deliver (n);
+      return port;
+    }
+
+    int rename_port
+    (
+      dummy_port *port,
+      const std::string &name
+    )
+    {
+      notifications n;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+
+        const std::string new_name = port->m_client->m_name + ":" + name;
+        if (find_port_locked (new_name) != 0) return -1;
+
+        const std::string old_name = port->m_name;
+        port->m_name = new_name;
+        notify_port_rename_locked (n, port->m_id, old_name, new_name);
+      }
+      deliver (n);
+      return 0;
+    }
+
+    void set_active
+    (
+      dummy_client *client,
+      bool active
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      client->m_active = active;
+      m_order_dirty = true;
+
+      if (active) update_latencies_locked ();
+    }
+
+    int connect
+    (
+      const std::string &source,
+      const std::string &destination
+    )
+    {
+      notifications n;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+
+        dummy_port *s = find_port_locked (source);
+        dummy_port *d = find_port_locked (destination);
+
+        if (s == 0 || d == 0 || s->is_input () || !d->is_input () || s->m_type != d->m_type) return -1;
+        if (std::find (d->m_sources.begin (), d->m_sources.end (), s) != d->m_sources.end ()) return EEXIST;
+
+        d->m_sources.push_back (s);
+        s->m_destinations.push_back (d);
+        m_order_dirty = true;
+
+        update_latencies_locked ();
+        notify_port_connect_locked (n, s->m_id, d->m_id, 1);
+      }
+      deliver (n);
+      return 0;
+    }
+
+    int disconnect
+    (
+      const std::string &source,
+      const std::string &destination
+    )
+    {
+      notifications n;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+
+        dummy_port *s = find_port_locked (source);
+        dummy_port *d = find_port_locked (destination);
+
+        if (s == 0 || d == 0) return -1;
+
+        auto source_iterator = std::find (d->m_sources.begin (), d->m_sources.end (), s);
+        if (source_iterator == d->m_sources.end ()) return -1;
+
+        d->m_sources.erase (source_iterator);
+        s->m_destinations.erase (std::find (s->m_destinations.begin (), s->m_destinations.end (), d));
+        m_order_dirty = true;
+
+        update_latencies_locked ();
+        notify_port_connect_locked (n, s->m_id, d->m_id, 0);
+      }
+      deliver (n);
+      return 0;
+    }
+
+    std::vector<std::string> get_ports
+    (
+      const std::string &port_name_pattern,
+      const std::string &port_type_pattern,
+      unsigned long flags
+    )
+    {
+      const std::regex name_regex (port_name_pattern);
+      const std::regex type_regex (port_type_pattern);
+
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      std::vector<std::string> ports;
+      for (dummy_client *client : m_clients)
+      {
+        for (dummy_port_ptr &port : client->m_ports)
+        {
+          if ((port->m_flags & flags) != flags) continue;
+          if (!port_name_pattern.empty () && !std::regex_search (port->m_name, name_regex)) continue;
+          if (!port_type_pattern.empty () && !std::regex_search (port->m_type, type_regex)) continue;
+
+          ports.push_back (port->m_name);
+        }
+      }
+
+      return ports;
+    }
+
+    std::string port_name_by_id
+    (
+      jack_port_id_t id
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      auto it = m_ports_by_id.find (id);
+      return it == m_ports_by_id.end () ? "" : it->second->m_name;
+    }
+
+    std::vector<std::string> port_get_connections
+    (
+      const std::string &port_name
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      std::vector<std::string> connections;
+      dummy_port *port = find_port_locked (port_name);
+      if (port == 0) return connections;
+
+      for (dummy_port *peer : port->is_input () ? port->m_sources : port->m_destinations) connections.push_back (peer->m_name);
+      return connections;
+    }
+
+    /*
+     * For inputs in capture mode and outputs in playback mode this is
+     * the range over the connected ports, like with JACK.
+     */
+    void get_latency_range
+    (
+      dummy_port *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    )
+    {
+      const bool capture = mode == JackCaptureLatency;
+      const std::vector<dummy_port *> &peers = capture ? port->m_sources : port->m_destinations;
+
+      if (port->is_input () != capture || peers.empty ())
+      {
+        *range = capture ? port->m_capture_latency : port->m_playback_latency;
+        return;
+      }
+
+      for (size_t index = 0; index < peers.size (); ++index)
+      {
+        const jack_latency_range_t &r = capture ? peers[index]->m_capture_latency : peers[index]->m_playback_latency;
+        if (index == 0 || r.min < range->min) range->min = r.min;
+        if (index == 0 || r.max > range->max) range->max = r.max;
+      }
+    }
+
+    void set_latency_range
+    (
+      dummy_port *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    )
+    {
+      (mode == JackCaptureLatency ? port->m_capture_latency : port->m_playback_latency) = *range;
+    }
+
+  private:
+    /*
+     * Callbacks collected while holding m_mutex, to be called after
+     * releasing it
+     */
+    typedef std::vector<std::function<void ()>> notifications;
+
+    void deliver
+    (
+      const notifications &n
+    )
+    {
+      for (const auto &notification : n) notification ();
+    }
+
+    void notify_port_registration_locked
+    (
+      notifications &n,
+      jack_port_id_t id,
+      int registered
+    )
+    {
+      for (dummy_client *client : m_clients)
+      {
+        if (!client->m_active || client->m_port_registration_callback == 0) continue;
+
+        JackPortRegistrationCallback callback = client->m_port_registration_callback;
+        void *arg = client->m_port_registration_arg;
+        n.push_back ([=] () { callback (id, registered, arg); });
+      }
+    }
+
+    void notify_port_connect_locked
+    (
+      notifications &n,
+      jack_port_id_t source,
+      jack_port_id_t destination,
+      int connected
+    )
+    {
+      for (dummy_client *client : m_clients)
+      {
+        if (!client->m_active || client->m_port_connect_callback == 0) continue;
+
+        JackPortConnectCallback callback = client->m_port_connect_callback;
+        void *arg = client->m_port_connect_arg;
+        n.push_back ([=] () { callback (source, destination, connected, arg); });
+      }
+    }
+
+    void notify_port_rename_locked
+    (
+      notifications &n,
+      jack_port_id_t id,
+      const std::string &old_name,
+      const std::string &new_name
+    )
+    {
+      for (dummy_client *client : m_clients)
+      {
+        if (!client->m_active || client->m_port_rename_callback == 0) continue;
+
+        JackPortRenameCallback callback = client->m_port_rename_callback;
+        void *arg = client->m_port_rename_arg;
+        n.push_back ([=] () { callback (id, old_name.c_str (), new_name.c_str (), arg); });
+      }
+    }
+
+    dummy_port *add_port
+    (
+      dummy_client *client,
+      const std::string &name,
+      const std::string &type,
+      unsigned long flags
+    )
+    {
+      client->m_ports.push_back (dummy_port_ptr (new dummy_port (client->m_name + ":" + name, type, flags, client, m_next_port_id++, m_buffer_size)));
+      m_ports_by_id[client->m_ports.back ()->m_id] = client->m_ports.back ().get ();
+      return client->m_ports.back ().get ();
+    }
+
+    dummy_client *find_client_locked
+    (
+      const std::string &name
+    )
+    {
+      for (dummy_client *client : m_clients)
+      {
+        if (client->m_name == name) return client;
+      }
+      return 0;
+    }
+
+    dummy_port *find_port_locked
+    (
+      const std::string &name
+    )
+    {
+      for (dummy_client *client : m_clients)
+      {
+        for (dummy_port_ptr &port : client->m_ports)
+        {
+          if (port->m_name == name) return port.get ();
+        }
+      }
+      return 0;
+    }
+
+    void disconnect_all_locked
+    (
+      dummy_port *port,
+      notifications &n
+    )
+    {
+      for (dummy_port *source : port->m_sources)
+      {
+        notify_port_connect_locked (n, source->m_id, port->m_id, 0);
+        source->m_destinations.erase (std::remove (source->m_destinations.begin (), source->m_destinations.end (), port), source->m_destinations.end ());
+      }
+
+      for (dummy_port *destination : port->m_destinations)
+      {
+        notify_port_connect_locked (n, port->m_id, destination->m_id, 0);
+        destination->m_sources.erase (std::remove (destination->m_sources.begin (), destination->m_sources.end (), port), destination->m_sources.end ());
+      }
+
+      port->m_sources.clear ();
+      port->m_destinations.clear ();
+    }
+
+    /*
+     * Orders the active clients (without m_system) so that clients run
+     * after those feeding them. Clients in feedback loops are taken in
+     * registration order once nothing else is ready.
+     */
+    void update_order ()
+    {
+      std::vector<dummy_client *> pending;
+      for (dummy_client *client : m_clients)
+      {
+        if (client != &m_system && client->m_active) pending.push_back (client);
+      }
+
+      m_order.clear ();
+      while (!pending.empty ())
+      {
+        size_t ready = pending.size ();
+        for (size_t index = 0; index < pending.size () && ready == pending.size (); ++index)
+        {
+          if (!fed_by_any (pending[index], pending)) ready = index;
+        }
+
+        if (ready == pending.size ()) ready = 0;
+
+        m_order.push_back (pending[ready]);
+        pending.erase (pending.begin () + ready);
+      }
+
+      m_order_dirty = false;
+    }
+
+    bool fed_by_any
+    (
+      dummy_client *client,
+      const std::vector<dummy_client *> &clients
+    )
+    {
+      for (dummy_port_ptr &port : client->m_ports)
+      {
+        for (dummy_port *source : port->m_sources)
+        {
+          if (source->m_client != client && std::find (clients.begin (), clients.end (), source->m_client) != clients.end ()) return true;
+        }
+      }
+      return false;
+    }
+
+    void mix_inputs
+    (
+      dummy_client *client,
+      jack_nframes_t nframes
+    )
+    {
+      for (dummy_port_ptr &port : client->m_ports)
+      {
+        if (!port->is_input ()) continue;
+
+        if (port->is_midi ())
+        {
+          port->m_midi_buffer.clear ();
+          for (dummy_port *source : port->m_sources)
+          {
+            for (size_t index = 0; index < source->m_midi_buffer.m_number_of_events; ++index)
+            {
+              const dummy_midi_event &e = source->m_midi_buffer.m_events[index];
+              port->m_midi_buffer.write (e.m_time, &source->m_midi_buffer.m_data[e.m_offset], e.m_size);
+            }
+          }
+          continue;
+        }
+
+        float *buffer = &port->m_audio_buffer[0];
+        if (port->m_sources.size () == 1)
+        {
+          memcpy (buffer, &port->m_sources[0]->m_audio_buffer[0], nframes * sizeof (float));
+          continue;
+        }
+
+        std::fill (buffer, buffer + nframes, 0.0f);
+        for (dummy_port *source : port->m_sources)
+        {
+          const float *source_buffer = &source->m_audio_buffer[0];
+          for (jack_nframes_t frame = 0; frame < nframes; ++frame) buffer[frame] += source_buffer[frame];
+        }
+      }
+    }
+
+    /*
+     * Runs the latency callbacks: capture latency downstream, playback
+     * latency upstream
+     */
+    void update_latencies_locked ()
+    {
+      if (m_order_dirty) update_order ();
+
+      for (dummy_client *client : m_order)
+      {
+        if (client->m_latency_callback) client->m_latency_callback (JackCaptureLatency, client->m_latency_arg);
+      }
+
+      for (auto it = m_order.rbegin (); it != m_order.rend (); ++it)
+      {
+        if ((*it)->m_latency_callback) (*it)->m_latency_callback (JackPlaybackLatency, (*it)->m_latency_arg);
+      }
+    }
+
+    void run
+    (
+      bool realtime
+    )
+    {
+      auto deadline = std::chrono::steady_clock::now ();
+
+      while (m_atomic_running)
+      {
+        cycle ();
+        if (!realtime) continue;
+
+        // Re-read every period, the buffer size may change
+        deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration> (std::chrono::duration<double> (m_buffer_size / (double)m_sample_rate));
+        const auto now = std::chrono::steady_clock::now ();
+        if (now <= deadline)
+        {
+          std::this_thread::sleep_until (deadline);
+          continue;
+        }
+
+        ++m_atomic_xruns;
+        deadline = now;
+        report_xrun ();
+      }
+    }
+
+    void report_xrun ()
+    {
+      std::vector<std::pair<JackXRunCallback, void *>> callbacks;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        for (dummy_client *client : m_clients)
+        {
+          if (client->m_active && client->m_xrun_callback) callbacks.push_back (std::make_pair (client->m_xrun_callback, client->m_xrun_arg));
+        }
+      }
+
+      for (auto &callback : callbacks) callback.first (callback.second);
+    }
+  };
+
+  typedef std::shared_ptr<dummy_driver> dummy_driver_ptr;
+
+  /*
+   * audio_backend on a dummy_driver. Several backends (clients) can
+   * share one driver.
+   */
+  struct dummy_backend final : audio_backend
+  {
+    dummy_driver_ptr m_driver;
+    dummy_client m_client;
+    bool m_open;
+
+    dummy_backend
+    (
+      dummy_driver_ptr driver
+    ) :
+      m_driver (driver),
+      m_client (""),
+      m_open (false)
+    {
+      if (!m_driver) THROW("No dummy driver");
+    }
+
+    ~dummy_backend ()
+    {
+      close ();
+    }
+
+    void open
+    (
+      const std::string &client_name
+    ) override
+    {
+      if (m_open) THROW("Client already open: " + m_client.m_name);
+
+      m_driver->add_client (&m_client, client_name);
+      m_open = true;
+    }
+
+    void close () override
+    {
+      if (!m_open) return;
+
+      m_driver->set_active (&m_client, false);
+      m_driver->remove_client (&m_client);
+      m_open = false;
+    }
+
+    std::string client_name () const override
+    {
+      return m_client.m_name;
+    }
+
+    jack_nframes_t sample_rate () const override
+    {
+      return m_driver->m_sample_rate;
+    }
+
+    jack_nframes_t buffer_size () const override
+    {
+      return m_driver->m_buffer_size;
+    }
+
+    jack_port_t *port_register
+    (
+      const std::string &name,
+      const char *type,
+      unsigned long flags
+    ) override
+    {
+      return (jack_port_t*)m_driver->register_port (&m_client, name, type, flags);
+    }
+
+    void *port_get_buffer
+    (
+      jack_port_t *port,
+      jack_nframes_t nframes
+    ) override
+    {
+      dummy_port *p = (dummy_port*)port;
+      return p->is_midi () ? (void*)&p->m_midi_buffer : (void*)&p->m_audio_buffer[0];
+    }
+
+    void port_get_latency_range
+    (
+      jack_port_t *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    ) override
+    {
+      m_driver->get_latency_range ((dummy_port*)port, mode, range);
+    }
+
+    void port_set_latency_range
+    (
+      jack_port_t *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    ) override
+    {
+      m_driver->set_latency_range ((dummy_port*)port, mode, range);
+    }
+
+    int port_rename
+    (
+      jack_port_t *port,
+      const std::string &name
+    ) override
+    {
+      return m_driver->rename_port ((dummy_port*)port, name);
+    }
+
+    int set_process_callback
+    (
+      JackProcessCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_process_callback = callback;
+      m_client.m_process_arg = arg;
+      return 0;
+    }
+
+    int set_buffer_size_callback
+    (
+      JackBufferSizeCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_buffer_size_callback = callback;
+      m_client.m_buffer_size_arg = arg;
+      return 0;
+    }
+
+    int set_sample_rate_callback
+    (
+      JackSampleRateCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_sample_rate_callback = callback;
+      m_client.m_sample_rate_arg = arg;
+      return 0;
+    }
+
+    int set_thread_init_callback
+    (
+      JackThreadInitCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_thread_init_callback = callback;
+      m_client.m_thread_init_arg = arg;
+      return 0;
+    }
+
+    int set_latency_callback
+    (
+      JackLatencyCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_latency_callback = callback;
+      m_client.m_latency_arg = arg;
+      return 0;
+    }
+
+    int set_xrun_callback
+    (
+      JackXRunCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_xrun_callback = callback;
+      m_client.m_xrun_arg = arg;
+      return 0;
+    }
+
+    int set_port_registration_callback
+    (
+      JackPortRegistrationCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_port_registration_callback = callback;
+      m_client.m_port_registration_arg = arg;
+      return 0;
+    }
+
+    int set_port_connect_callback
+    (
+      JackPortConnectCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_port_connect_callback = callback;
+      m_client.m_port_connect_arg = arg;
+      return 0;
+    }
+
+    int set_port_rename_callback
+    (
+      JackPortRenameCallback callback,
+      void *arg
+    ) override
+    {
+      if (m_client.m_active) return -1;
+      m_client.m_port_rename_callback = callback;
+      m_client.m_port_rename_arg = arg;
+      return 0;
+    }
+
+    int activate () override
+    {
+      if (!m_open) return -1;
+      m_driver->set_active (&m_client, true);
+      return 0;
+    }
+
+    int deactivate () override
+    {
+      if (!m_open) return -1;
+      m_driver->set_active (&m_client, false);
+      return 0;
+    }
+
+    int connect
+    (
+      const std::string &source,
+      const std::string &destination
+    ) override
+    {
+      return m_driver->connect (source, destination);
+    }
+
+    int disconnect
+    (
+      const std::string &source,
+      const std::string &destination
+    ) override
+    {
+      return m_driver->disconnect (source, destination);
+    }
+
+    std::vector<std::string> get_ports
+    (
+      const std::string &port_name_pattern,
+      const std::string &port_type_pattern,
+      unsigned long flags
+    ) override
+    {
+      return m_driver->get_ports (port_name_pattern, port_type_pattern, flags);
+    }
+
+    std::string port_name_by_id
+    (
+      jack_port_id_t id
+    ) override
+    {
+      return m_driver->port_name_by_id (id);
+    }
+
+    std::vector<std::string> port_get_connections
+    (
+      const std::string &port_name
+    ) override
+    {
+      return m_driver->port_get_connections (port_name);
+    }
+
+    uint32_t midi_get_event_count
+    (
+      void *buffer
+    ) override
+    {
+      return ((dummy_midi_buffer*)buffer)->m_number_of_events;
+    }
+
+    int midi_event_get
+    (
+      jack_midi_event_t *event,
+      void *buffer,
+      uint32_t event_index
+    ) override
+    {
+      return ((dummy_midi_buffer*)buffer)->get (event, event_index);
+    }
+
+    void midi_clear_buffer
+    (
+      void *buffer
+    ) override
+    {
+      ((dummy_midi_buffer*)buffer)->clear ();
+    }
+
+    int midi_event_write
+    (
+      void *buffer,
+      jack_nframes_t time,
+      const jack_midi_data_t *data,
+      size_t size
+    ) override
+    {
+      return ((dummy_midi_buffer*)buffer)->write (time, data, size);
+    }
+  };
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <lv2_horst/horst.h>
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace lv2_horst
+{
+  enum class dummy_signal
+  {
+    silence,
+    noise,
+    sine
+  };
+
+  /*
+   * Buffers for all ports of a horst, so it can be run without JACK.
+   * Audio and CV inputs carry the chosen signal, control inputs their
+   * default values and atom inputs empty sequences.
+   */
+  struct dummy_ports
+  {
+    horst_ptr m_horst;
+    const size_t m_block_length;
+
+    std::vector<std::vector<float>> m_buffers;
+    std::vector<float> m_control_values;
+    std::vector<std::vector<uint64_t>> m_atom_buffers;
+
+    LV2_URID m_atom_sequence_urid;
+    LV2_URID m_atom_chunk_urid;
+
+    dummy_ports
+    (
+      horst_ptr h,
+      size_t block_length,
+      dummy_signal signal = dummy_signal::noise,
+      double sample_rate = 48000
+    ) :
+      m_horst (h),
+      m_block_length (block_length),
+      m_buffers (h->m_port_properties.size ()),
+      m_control_values (h->m_port_properties.size (), 0),
+      m_atom_buffers (h->m_port_properties.size ()),
+      m_atom_sequence_urid (h->urid_map (LV2_ATOM__Sequence)),
+      m_atom_chunk_urid (h->urid_map (LV2_ATOM__Chunk))
+    {
+      if (!m_horst->m_plugin_instance) THROW("No instance!");
+
+      uint32_t noise_state = 1;
+      for (size_t index = 0; index < m_horst->m_port_properties.size (); ++index)
+      {
+        const port_properties &p = m_horst->m_port_properties[index];
+
+        if (p.m_is_audio || p.m_is_cv)
+        {
+          m_buffers[index].resize (m_block_length, 0);
+          if (p.m_is_input)
+          {
+            for (size_t frame = 0; frame < m_block_length; ++frame)
+            {
+              switch (signal)
+              {
+                case dummy_signal::noise:
+                  // A cheap LCG is plenty to keep denormals and
+                  // silence detection out of the picture
+                  noise_state = noise_state * 1664525u + 1013904223u;
+                  m_buffers[index][frame] = 0.5f * ((float)(noise_state >> 8) / (1 << 24) * 2 - 1);
+                  break;
+                case dummy_signal::sine:
+                  m_buffers[index][frame] = 0.5f * sinf (2 * M_PI * 440 * frame / sample_rate);
+                  break;
+                default:
+                  break;
+              }
+            }
+          }
+          m_horst->connect_port (index, &m_buffers[index][0]);
+        }
+
+        if (p.m_is_control)
+        {
+          m_control_values[index] = std::isnan (p.m_default_value) ? (std::isnan (p.m_minimum_value) ? 0 : p.m_minimum_value) : p.m_default_value;
+          m_horst->connect_port (index, &m_control_values[index]);
+        }
+
+        if (p.m_is_atom)
+        {
+          const size_t size = std::max<size_t> (p.m_minimum_buffer_size, HORST_DEFAULT_ATOM_BUFFER_SIZE);
+          m_atom_buffers[index].resize ((size + sizeof (uint64_t) - 1) / sizeof (uint64_t), 0);
+          m_horst->connect_port (index, &m_atom_buffers[index][0]);
+        }
+      }
+    }
+
+    /*
+     * Resets the atom ports. Call before every run ().
+     */
+    inline void prepare ()
+    {
+      for (size_t index = 0; index < m_atom_buffers.size (); ++index)
+      {
+        if (m_atom_buffers[index].empty ()) continue;
+
+        LV2_Atom_Sequence *sequence = (LV2_Atom_Sequence*)&m_atom_buffers[index][0];
+        if (m_horst->m_port_properties[index].m_is_input)
+        {
+          sequence->atom.type = m_atom_sequence_urid;
+          sequence->atom.size = sizeof (LV2_Atom_Sequence_Body);
+          sequence->body.unit = 0;
+          sequence->body.pad = 0;
+        }
+        else
+        {
+          sequence->atom.type = m_atom_chunk_urid;
+          sequence->atom.size = m_atom_buffers[index].size () * sizeof (uint64_t) - sizeof (LV2_Atom);
+        }
+      }
+    }
+
+    inline void run ()
+    {
+      prepare ();
+      m_horst->run (m_block_length);
+    }
+  };
+}
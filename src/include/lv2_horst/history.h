@@ -0,0 +1,126 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace lv2_horst
+{
+  enum class history_source
+  {
+    control_value,
+    peak,
+    rms
+  };
+
+  struct history_column
+  {
+    size_t m_port_index;
+    history_source m_source;
+
+    history_column
+    (
+      size_t port_index = 0,
+      history_source source = history_source::control_value
+    ) :
+      m_port_index (port_index),
+      m_source (source)
+    {
+
+    }
+  };
+
+  /*
+   * Single producer / single consumer ring of fixed width rows of
+   * floats. The process thread appends one row per period, a control
+   * thread drains any number of rows in one go.
+   *
+   * m_head and m_tail count rows written and read since construction,
+   * so they never wrap in practice and full/empty are unambiguous.
+   */
+  struct history
+  {
+    const std::vector<history_column> m_columns;
+    const size_t m_capacity;
+
+    std::vector<float> m_data;
+
+    std::atomic<uint64_t> m_head;
+    std::atomic<uint64_t> m_tail;
+    std::atomic<uint64_t> m_overruns;
+
+    history
+    (
+      const std::vector<history_column> &columns,
+      size_t capacity
+    ) :
+      m_columns (columns),
+      m_capacity (capacity),
+      m_data (columns.size () * capacity, 0),
+      m_head (0),
+      m_tail (0),
+      m_overruns (0)
+    {
+      if (columns.empty ()) THROW("No history columns");
+      if (capacity == 0) THROW("History capacity must be at least one row");
+    }
+
+    size_t width () const
+    {
+      return m_columns.size ();
+    }
+
+    size_t read_available () const
+    {
+      return (size_t)(m_head.load (std::memory_order_acquire) - m_tail.load (std::memory_order_relaxed));
+    }
+
+    /*
+     * Returns a pointer to the next row to write or 0 if the ring is
+     * full, in which case the row is counted as an overrun.
+     */
+    inline float *write_pointer ()
+    {
+      const uint64_t head = m_head.load (std::memory_order_relaxed);
+      if (head - m_tail.load (std::memory_order_acquire) >= m_capacity)
+      {
+        m_overruns.store (m_overruns.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return 0;
+      }
+
+      return &m_data[(head % m_capacity) * width ()];
+    }
+
+    inline void write_advance ()
+    {
+      m_head.store (m_head.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /*
+     * Copies up to rows rows into data (row major). Returns the number
+     * of rows copied.
+     */
+    size_t read
+    (
+      float *data,
+      size_t rows
+    )
+    {
+      rows = std::min (rows, read_available ());
+
+      const uint64_t tail = m_tail.load (std::memory_order_relaxed);
+      for (size_t row = 0; row < rows; ++row)
+      {
+        memcpy (data + row * width (), &m_data[((tail + row) % m_capacity) * width ()], width () * sizeof (float));
+      }
+
+      m_tail.store (tail + rows, std::memory_order_release);
+      return rows;
+    }
+  };
+}
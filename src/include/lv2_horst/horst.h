@@ -2,6 +2,9 @@
 
 #include <lv2_horst/lv2.h>
 #include <lv2_horst/continuous_chunk_ringbuffer.h>
+#include <lv2_horst/dsp_timing.h>
+#include <lv2_horst/trace.h>
+#include <lv2_horst/state.h>
 
 #include <lv2/worker/worker.h>
 #include <lv2/state/state.h>
@@ -9,6 +12,8 @@
 #include <lv2/buf-size/buf-size.h>
 #include <lv2/atom/atom.h>
 #include <lv2/patch/patch.h>
+#include <lv2/midi/midi.h>
+#include <lv2/resize-port/resize-port.h>
 
 #include <algorithm>
 #include <cstring>
@@ -21,6 +26,8 @@
 
 namespace lv2_horst
 {
+  #define HORST_DEFAULT_ATOM_BUFFER_SIZE (1024 * 16)
+
   struct port_properties 
   {
     bool m_is_audio;
@@ -29,6 +36,9 @@ namespace lv2_horst
     bool m_is_input;
     bool m_is_output;
     bool m_is_side_chain;
+    bool m_is_atom;
+    bool m_supports_midi;
+    size_t m_minimum_buffer_size;
     float m_minimum_value;
     float m_default_value;
     float m_maximum_value;
@@ -116,16 +126,34 @@ namespace lv2_horst
     bool m_fixed_block_length_required;
     bool m_power_of_two_block_length_required;
 
+    /*
+     * Set while a jacked_horst runs this instance. Nothing else may
+     * run it then (see measure_cost ()).
+     */
+    std::atomic<bool> m_hosted;
+
     lilv_plugin_instance_ptr m_plugin_instance;
 
+    /*
+     * Where each port was last connected to (0 if never), so the
+     * connections can be restored after a calibration run.
+     */
+    std::vector<void *> m_port_connections;
+
     const std::string m_uri;
     std::string m_name;
 
+    /*
+     * m_name, interned for the trace recorder
+     */
+    const char *m_trace_name;
+
     uint32_t m_min_block_length;
     uint32_t m_max_block_length;
     uint32_t m_nominal_block_length;
 
     std::vector<LV2_Options_Option> m_options;
+    LV2_Options_Interface *m_options_interface;
 
     LV2_State_Interface *m_state_interface;
     bool m_state_interface_required;
@@ -137,7 +165,9 @@ namespace lv2_horst
     continuous_chunk_ringbuffer m_work_items_buffer;
     continuous_chunk_ringbuffer m_work_response_items_buffer;
     continuous_chunk_ringbuffer m_realtime_log_messages;
-    size_t m_missed_realtime_log_messages;
+    std::atomic<size_t> m_missed_realtime_log_messages;
+
+    dsp_timing m_timing;
 
     bool m_need_to_notify_worker_thread;
     std::mutex m_worker_mutex;
@@ -145,6 +175,13 @@ namespace lv2_horst
     std::atomic<bool> m_worker_quit;
     pthread_t m_worker_thread;
 
+    /*
+     * Held by the worker thread while it calls work (), so
+     * replace_instance () does not pull the instance from under it.
+     */
+    std::mutex m_work_mutex;
+
+    std::mutex m_urid_mutex;
     std::vector<std::string> m_mapped_uris;
 
     LV2_URID_Map m_urid_map;
@@ -179,6 +216,9 @@ namespace lv2_horst
 
       m_fixed_block_length_required (false),
       m_power_of_two_block_length_required (false),
+      m_hosted (false),
+
+      m_options_interface (0),
 
       m_state_interface (0),
       m_state_interface_required (false),
@@ -211,7 +251,7 @@ namespace lv2_horst
       DBG_ENTER
       m_options.push_back (LV2_Options_Option { .context = LV2_OPTIONS_INSTANCE, .subject = 0, .key = urid_map (LV2_BUF_SIZE__minBlockLength), .size = sizeof (int32_t), .type = urid_map (LV2_ATOM__Int), .value = &m_min_block_length });
       m_options.push_back (LV2_Options_Option { .context = LV2_OPTIONS_INSTANCE, .subject = 0, .key = urid_map (LV2_BUF_SIZE__maxBlockLength), .size = sizeof (int32_t), .type = urid_map (LV2_ATOM__Int), .value = &m_max_block_length });
-      m_options.push_back (LV2_Options_Option { .context = LV2_OPTIONS_INSTANCE, .subject = 0, .key = urid_map (LV2_BUF_SIZE__nominalBlockLength), .size = sizeof (int32_t), .type = urid_map (LV2_ATOM__Int), .value = &m_max_block_length });
+      m_options.push_back (LV2_Options_Option { .context = LV2_OPTIONS_INSTANCE, .subject = 0, .key = urid_map (LV2_BUF_SIZE__nominalBlockLength), .size = sizeof (int32_t), .type = urid_map (LV2_ATOM__Int), .value = &m_nominal_block_length });
       m_options.push_back (LV2_Options_Option { .context = LV2_OPTIONS_INSTANCE, .subject = 0, .key = 0, .size = 0, .type = 0, .value = 0 });
       m_options_feature.data = &m_options[0];
 
@@ -226,6 +266,8 @@ namespace lv2_horst
       m_supported_features.push_back (&m_worker_feature);
       m_supported_features.push_back (0);
 
+      std::unique_lock<std::recursive_mutex> lilv_lock (plugins->m_world->m_mutex);
+
       check_features (true);
       check_features (false);
 
@@ -270,8 +312,12 @@ namespace lv2_horst
       lilv_uri_node control (world, LILV_URI_CONTROL_PORT);
       lilv_uri_node cv (world, LILV_URI_CV_PORT);
       lilv_uri_node side_chain (world, "https://lv2plug.in/ns/lv2core#isSideChain");
+      lilv_uri_node atom (world, LV2_ATOM__AtomPort);
+      lilv_uri_node midi_event (world, LV2_MIDI__MidiEvent);
+      lilv_uri_node minimum_size (world, LV2_RESIZE_PORT__minimumSize);
 
       m_port_properties.resize (lilv_plugin_get_num_ports (plugin->m));
+      m_port_connections.resize (m_port_properties.size (), 0);
       for (size_t index = 0; index < m_port_properties.size(); ++index) 
       {
         const LilvPort *lilv_port = lilv_plugin_get_port_by_index (plugin->m, index);
@@ -285,6 +331,19 @@ namespace lv2_horst
         p.m_is_input = lilv_port_is_a (plugin->m, lilv_port, input.m);
         p.m_is_output = lilv_port_is_a (plugin->m, lilv_port, output.m);
         p.m_is_side_chain = lilv_port_has_property (plugin->m, lilv_port, side_chain.m);
+        p.m_is_atom = lilv_port_is_a (plugin->m, lilv_port, atom.m);
+        p.m_supports_midi = p.m_is_atom && lilv_port_supports_event (plugin->m, lilv_port, midi_event.m);
+        p.m_minimum_buffer_size = 0;
+
+        if (p.m_is_atom)
+        {
+          LilvNode *size = lilv_port_get (plugin->m, lilv_port, minimum_size.m);
+          if (size)
+          {
+            if (lilv_node_is_int (size)) p.m_minimum_buffer_size = (size_t)std::max (0, lilv_node_as_int (size));
+            lilv_node_free (size);
+          }
+        }
 
         if (p.m_is_input && p.m_is_control) 
         {
@@ -310,6 +369,10 @@ namespace lv2_horst
       m_name = lilv_node_as_string (name_node);
       lilv_node_free (name_node);
 
+      lilv_lock.unlock ();
+
+      m_trace_name = trace_recorder::instance ().intern (m_name);
+
       if (m_worker_required)
       {
         int ret = pthread_create (&m_worker_thread, 0, lv2_horst::worker_thread, this);
@@ -323,6 +386,21 @@ namespace lv2_horst
       double sample_rate,
       size_t buffer_size
     )
+    {
+      replace_instance (create_instance (sample_rate, buffer_size));
+    }
+
+    /*
+     * Instantiates and activates a new instance without touching the
+     * current one, so this can run on a background thread while the
+     * current instance keeps running. Only one create_instance () may
+     * run at a time.
+     */
+    lilv_plugin_instance_ptr create_instance
+    (
+      double sample_rate,
+      size_t buffer_size
+    )
     {
       DBG(sample_rate << " " << buffer_size)
       m_min_block_length = 0;
@@ -334,7 +412,32 @@ namespace lv2_horst
         m_min_block_length = (int32_t)buffer_size;
       }
 
-      m_plugin_instance = lilv_plugin_instance_ptr (new lilv_plugin_instance (m_lilv_plugin, sample_rate, &m_supported_features[0]));
+      return lilv_plugin_instance_ptr (new lilv_plugin_instance (m_lilv_plugin, sample_rate, &m_supported_features[0]));
+    }
+
+    /*
+     * Makes instance the current one and returns the previous one, so
+     * the caller decides where it gets deactivated and freed. Must not
+     * be called concurrently with run () or connect_port ().
+     *
+     * Pending work requests and responses belong to the previous
+     * instance and are dropped.
+     */
+    lilv_plugin_instance_ptr replace_instance
+    (
+      lilv_plugin_instance_ptr instance
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_work_mutex);
+
+      // Neither side writes meanwhile: the worker waits for
+      // m_work_mutex and run () is excluded by the caller
+      while (!m_work_items_buffer.isempty ()) m_work_items_buffer.read_advance (m_work_items_buffer.read_available ());
+      while (!m_work_response_items_buffer.isempty ()) m_work_response_items_buffer.read_advance (m_work_response_items_buffer.read_available ());
+
+      lilv_plugin_instance_ptr previous = m_plugin_instance;
+      m_plugin_instance = instance;
+      std::fill (m_port_connections.begin (), m_port_connections.end (), (void*)0);
 
       if (m_worker_required) m_worker_interface = (LV2_Worker_Interface*)lilv_instance_get_extension_data (m_plugin_instance->m, LV2_WORKER__interface); 
 
@@ -344,11 +447,39 @@ namespace lv2_horst
 
       DBG("state interface: " << m_state_interface);
 
+      m_options_interface = (LV2_Options_Interface*)lilv_instance_get_extension_data (m_plugin_instance->m, LV2_OPTIONS__interface);
+
+      DBG("options interface: " << m_options_interface);
+
       if (m_worker_interface)
       {
         DBG((void*)(m_worker_interface.load ()->work) << " " << (void*)(m_worker_interface.load ()->work_response) << " " << (void*)(m_worker_interface.load ()->end_run));
       }
-      // usleep (500000);
+
+      return previous;
+    }
+
+    /*
+     * Hands a new block length to the current instance through the
+     * options interface. Returns false if the plugin has no options
+     * interface or rejects the new values, in which case it needs to
+     * be re-instantiated. Must not be called concurrently with run ().
+     */
+    bool set_block_length
+    (
+      size_t block_length
+    )
+    {
+      if (!m_plugin_instance || !m_options_interface || !m_options_interface->set) return false;
+
+      m_min_block_length = m_fixed_block_length_required ? (int32_t)block_length : 0;
+      m_max_block_length = (int32_t)block_length;
+      m_nominal_block_length = (int32_t)block_length;
+
+      const uint32_t status = m_options_interface->set (m_plugin_instance->m_handle, &m_options[0]);
+      DBG("options status: " << status)
+
+      return status == LV2_OPTIONS_SUCCESS;
     }
 
     void check_features (bool required)
@@ -399,7 +530,7 @@ namespace lv2_horst
     void connect_port
     (
       size_t port_index,
-      float *data
+      void *data
     )
     {
       if (port_index >= m_port_properties.size ())
@@ -408,6 +539,7 @@ namespace lv2_horst
       }
 
       lilv_instance_connect_port (m_plugin_instance->m, port_index, data);
+      m_port_connections[port_index] = data;
     }
 
     void run
@@ -420,6 +552,11 @@ namespace lv2_horst
         THROW("No instance!");
       }
       
+      const bool timing = m_timing.enabled ();
+      const uint64_t start_ticks = timing ? cycle_counter () : 0;
+
+      trace_begin (m_trace_name, (uint32_t)nframes);
+
       LV2_Worker_Interface *interface = m_worker_interface;
       if (interface) 
       {
@@ -430,6 +567,7 @@ namespace lv2_horst
 
           if (interface->work_response)
           {
+            trace_instant ("work_response", (uint32_t)item_size);
             LOG_REALTIME_MESSAGE("Calling interface->work_response()")
             interface->work_response (m_plugin_instance->m_handle, item_size, m_work_response_items_buffer.read_pointer ());
           }
@@ -442,8 +580,17 @@ namespace lv2_horst
         LOG_REALTIME_MESSAGE("no interface")
       }
 
+      const uint64_t run_start_ticks = timing ? cycle_counter () : 0;
+
       lilv_instance_run (m_plugin_instance->m, nframes);
 
+      if (timing)
+      {
+        const uint64_t run_end_ticks = cycle_counter ();
+        m_timing.add (dsp_timing_phase::work_response, run_start_ticks - start_ticks);
+        m_timing.add (dsp_timing_phase::run, run_end_ticks - run_start_ticks);
+      }
+
       if (m_need_to_notify_worker_thread)
       {
         LOG_REALTIME_MESSAGE("Need to notify worker thread")
@@ -459,21 +606,32 @@ namespace lv2_horst
 
       if (interface && interface->end_run) 
       {
+        const uint64_t end_run_start_ticks = timing ? cycle_counter () : 0;
+
         interface->end_run (m_plugin_instance->m_handle);
+
+        if (timing) m_timing.add (dsp_timing_phase::end_run, cycle_counter () - end_run_start_ticks);
       }
+
+      trace_end (m_trace_name, (uint32_t)nframes);
     }
 
+    /*
+     * Both can be called from any non realtime thread (plugins map in
+     * instantiate (), from their worker and when saving state).
+     */
     const std::string urid_unmap
     (
       LV2_URID urid
     )
     {
-      if (urid >= m_mapped_uris.size ()) 
+      std::lock_guard<std::mutex> lock (m_urid_mutex);
+      if (urid == 0 || urid > m_mapped_uris.size ()) 
       {
         THROW("URID out of bounds");
       }
 
-      return m_mapped_uris[urid];
+      return m_mapped_uris[urid - 1];
     }
 
     LV2_URID urid_map
@@ -481,6 +639,7 @@ namespace lv2_horst
       const char *uri
     )
     {
+      std::lock_guard<std::mutex> lock (m_urid_mutex);
       auto it = std::find (m_mapped_uris.begin (), m_mapped_uris.end (), uri);
       LV2_URID urid = it - m_mapped_uris.begin ();
       if (it == m_mapped_uris.end ()) 
@@ -521,6 +680,7 @@ namespace lv2_horst
       }
 
       LOG_REALTIME_MESSAGE ("Copying data into buffer");
+      trace_instant ("schedule_work", size);
       memcpy(m_work_items_buffer.write_pointer (), data, size);
       m_work_items_buffer.write_advance (size);
 
@@ -545,6 +705,7 @@ namespace lv2_horst
         if (m_work_response_items_buffer.write_available () >= (int)size)
         {
           DBG("Copying data into buffer. Size: " << size)
+          trace_instant ("worker_respond", size);
           memcpy (m_work_response_items_buffer.write_pointer (), data, size);
           m_work_response_items_buffer.write_advance (size);
         }
@@ -561,6 +722,7 @@ namespace lv2_horst
     void *worker_thread () 
     {
       DBG_ENTER
+      trace_recorder::instance ().register_thread ("worker: " + m_name);
       while (!m_worker_quit)
       {
         {
@@ -583,6 +745,8 @@ namespace lv2_horst
           m_realtime_log_messages.read_advance (chunk_size);
         }
 
+        std::lock_guard<std::mutex> work_lock (m_work_mutex);
+
         LV2_Worker_Interface *interface = m_worker_interface;
 
         if (!m_worker_interface) continue;
@@ -599,8 +763,10 @@ namespace lv2_horst
             size_t item_size = m_work_items_buffer.read_available ();
             DBG("item_size: " << item_size)
 
+            trace_begin ("work", (uint32_t)item_size);
             LV2_Worker_Status res =
               interface->work (m_plugin_instance->m_handle, &lv2_horst::worker_respond, (LV2_Worker_Respond_Handle)this, item_size, m_work_items_buffer.read_pointer ());
+            trace_end ("work", (uint32_t)item_size);
 
             if (res != LV2_WORKER_SUCCESS)
             {
@@ -659,34 +825,91 @@ namespace lv2_horst
       m_need_to_notify_worker_thread = true;
     }
 
+    /*
+     * Saves the plugin's state to a state file (see state.h). Files
+     * the plugin creates through make-path go to path + ".files".
+     * LV2 allows this concurrently with run (), but not with
+     * restoring or replacing the instance.
+     */
     void save_state
     (
       const std::string &path
     )
     {
-      if (m_state_interface) 
-      {
-        m_state_interface->save (m_plugin_instance->m_handle, state_store, 0, 0, 0);
-      }
-      else
-      {
-        DBG("No state interface - not saving")
-      }
+      state_paths paths (path + ".files");
+      collect_state (paths).write (path);
     }
 
+    /*
+     * Must not be called concurrently with run ().
+     */
     void restore_state
     (
       const std::string &path
     )
     {
-      if (m_state_interface) 
+      state_paths paths (path + ".files");
+      state_image image (path);
+      apply_state (image, paths);
+    }
+
+    /*
+     * Like save_state (), but returns the image instead of writing
+     * it. No path features are offered to the plugin.
+     */
+    std::vector<uint8_t> save_state_to_memory ()
+    {
+      state_paths paths ("");
+      return collect_state (paths).image ();
+    }
+
+    void restore_state_from_memory
+    (
+      const void *data,
+      size_t size
+    )
+    {
+      state_paths paths ("");
+      state_image image (data, size);
+      apply_state (image, paths);
+    }
+
+    state_writer collect_state
+    (
+      const state_paths &paths
+    )
+    {
+      state_writer writer ([this] (LV2_URID urid) { return urid_unmap (urid); });
+
+      if (m_state_interface && m_plugin_instance)
       {
-        m_state_interface->restore (m_plugin_instance->m_handle, state_retrieve, 0, 0, 0);
+        const LV2_State_Status status = m_state_interface->save (m_plugin_instance->m_handle, state_store, (LV2_State_Handle)&writer, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE, paths.features ());
+        if (status != LV2_STATE_SUCCESS) THROW("Failed to save state. Status: " + std::to_string (status));
       }
       else
+      {
+        DBG("No state interface - saving an empty state")
+      }
+
+      return writer;
+    }
+
+    void apply_state
+    (
+      state_image &image,
+      const state_paths &paths
+    )
+    {
+      if (!m_state_interface || !m_plugin_instance)
       {
         DBG("No state interface - not restoring")
+        return;
       }
+
+      image.map_uris ([this] (const char *uri) { return urid_map (uri); });
+
+      const LV2_State_Status status = m_state_interface->restore (m_plugin_instance->m_handle, state_retrieve, (LV2_State_Handle)&image, 0, paths.features ());
+      if (status != LV2_STATE_SUCCESS) THROW("Failed to restore state. Status: " + std::to_string (status));
     }
 
     ~horst ()
@@ -766,11 +989,7 @@ namespace lv2_horst
       uint32_t flags
     )
     {
-      // TODO: Implement state_store ()
-      DBG_ENTER
-      DBG("key: " << key << " size: " << size << " type: " << type << " flags: " << flags)
-      DBG_EXIT
-      return LV2_STATE_ERR_UNKNOWN;
+      return ((state_writer*)handle)->store (key, value, size, type, flags);
     }
 
     const void *state_retrieve
@@ -782,11 +1001,7 @@ namespace lv2_horst
       uint32_t *flags
     )
     {
-      // TODO:: implement state_retrieve ()
-      DBG_ENTER
-      DBG("key: " << key << " size: " << size << " type: " << type << " flags: " << flags)
-      DBG_EXIT
-      return 0;
+      return ((const state_image*)handle)->retrieve (key, size, type, flags);
     }
   }
 
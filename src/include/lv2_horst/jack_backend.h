@@ -0,0 +1,307 @@
+#pragma once
+
+#include <lv2_horst/audio_backend.h>
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+
+#include <cstdlib>
+
+namespace lv2_horst
+{
+  /*
+   * audio_backend on a JACK client.
+   */
+  struct jack_backend final : audio_backend
+  {
+    jack_client_t *m_jack_client;
+
+    jack_backend () :
+      m_jack_client (0)
+    {
+
+    }
+
+    ~jack_backend ()
+    {
+      close ();
+    }
+
+    void open
+    (
+      const std::string &client_name
+    ) override
+    {
+      m_jack_client = jack_client_open (client_name.c_str (), JackNullOption, 0);
+      if (m_jack_client == 0) THROW("Failed to open jack client: " + client_name);
+    }
+
+    void close () override
+    {
+      if (m_jack_client == 0) return;
+      jack_client_close (m_jack_client);
+      m_jack_client = 0;
+    }
+
+    std::string client_name () const override
+    {
+      return jack_get_client_name (m_jack_client);
+    }
+
+    jack_nframes_t sample_rate () const override
+    {
+      return jack_get_sample_rate (m_jack_client);
+    }
+
+    jack_nframes_t buffer_size () const override
+    {
+      return jack_get_buffer_size (m_jack_client);
+    }
+
+    jack_port_t *port_register
+    (
+      const std::string &name,
+      const char *type,
+      unsigned long flags
+    ) override
+    {
+      return jack_port_register (m_jack_client, name.c_str (), type, flags, 0);
+    }
+
+    void *port_get_buffer
+    (
+      jack_port_t *port,
+      jack_nframes_t nframes
+    ) override
+    {
+      return jack_port_get_buffer (port, nframes);
+    }
+
+    void port_get_latency_range
+    (
+      jack_port_t *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    ) override
+    {
+      jack_port_get_latency_range (port, mode, range);
+    }
+
+    void port_set_latency_range
+    (
+      jack_port_t *port,
+      jack_latency_callback_mode_t mode,
+      jack_latency_range_t *range
+    ) override
+    {
+      jack_port_set_latency_range (port, mode, range);
+    }
+
+    int port_rename
+    (
+      jack_port_t *port,
+      const std::string &name
+    ) override
+    {
+      return jack_port_rename (m_jack_client, port, name.c_str ());
+    }
+
+    int set_process_callback
+    (
+      JackProcessCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_process_callback (m_jack_client, callback, arg);
+    }
+
+    int set_buffer_size_callback
+    (
+      JackBufferSizeCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_buffer_size_callback (m_jack_client, callback, arg);
+    }
+
+    int set_sample_rate_callback
+    (
+      JackSampleRateCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_sample_rate_callback (m_jack_client, callback, arg);
+    }
+
+    int set_thread_init_callback
+    (
+      JackThreadInitCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_thread_init_callback (m_jack_client, callback, arg);
+    }
+
+    int set_latency_callback
+    (
+      JackLatencyCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_latency_callback (m_jack_client, callback, arg);
+    }
+
+    int set_xrun_callback
+    (
+      JackXRunCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_xrun_callback (m_jack_client, callback, arg);
+    }
+
+    int set_port_registration_callback
+    (
+      JackPortRegistrationCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_port_registration_callback (m_jack_client, callback, arg);
+    }
+
+    int set_port_connect_callback
+    (
+      JackPortConnectCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_port_connect_callback (m_jack_client, callback, arg);
+    }
+
+    int set_port_rename_callback
+    (
+      JackPortRenameCallback callback,
+      void *arg
+    ) override
+    {
+      return jack_set_port_rename_callback (m_jack_client, callback, arg);
+    }
+
+    int activate () override
+    {
+      return jack_activate (m_jack_client);
+    }
+
+    int deactivate () override
+    {
+      return jack_deactivate (m_jack_client);
+    }
+
+    int connect
+    (
+      const std::string &source,
+      const std::string &destination
+    ) override
+    {
+      return jack_connect (m_jack_client, source.c_str (), destination.c_str ());
+    }
+
+    int disconnect
+    (
+      const std::string &source,
+      const std::string &destination
+    ) override
+    {
+      return jack_disconnect (m_jack_client, source.c_str (), destination.c_str ());
+    }
+
+    std::vector<std::string> get_ports
+    (
+      const std::string &port_name_pattern,
+      const std::string &port_type_pattern,
+      unsigned long flags
+    ) override
+    {
+      std::vector<std::string> ports;
+
+      const char **jack_ports = jack_get_ports (m_jack_client, port_name_pattern.c_str (), port_type_pattern.c_str (), flags);
+      if (0 == jack_ports) return ports;
+
+      for (const char **jack_ports_iterator = jack_ports; *jack_ports_iterator != 0; ++jack_ports_iterator)
+      {
+        DBG("port: " << (*jack_ports_iterator))
+        ports.push_back (*jack_ports_iterator);
+      }
+
+      jack_free (jack_ports);
+      return ports;
+    }
+
+    std::string port_name_by_id
+    (
+      jack_port_id_t id
+    ) override
+    {
+      jack_port_t *port = jack_port_by_id (m_jack_client, id);
+      return port ? jack_port_name (port) : "";
+    }
+
+    std::vector<std::string> port_get_connections
+    (
+      const std::string &port_name
+    ) override
+    {
+      std::vector<std::string> connections;
+
+      jack_port_t *port = jack_port_by_name (m_jack_client, port_name.c_str ());
+      if (port == 0) return connections;
+
+      const char **jack_connections = jack_port_get_all_connections (m_jack_client, port);
+      if (0 == jack_connections) return connections;
+
+      for (const char **iterator = jack_connections; *iterator != 0; ++iterator) connections.push_back (*iterator);
+
+      jack_free (jack_connections);
+      return connections;
+    }
+
+    uint32_t midi_get_event_count
+    (
+      void *buffer
+    ) override
+    {
+      return jack_midi_get_event_count (buffer);
+    }
+
+    int midi_event_get
+    (
+      jack_midi_event_t *event,
+      void *buffer,
+      uint32_t event_index
+    ) override
+    {
+      return jack_midi_event_get (event, buffer, event_index);
+    }
+
+    void midi_clear_buffer
+    (
+      void *buffer
+    ) override
+    {
+      jack_midi_clear_buffer (buffer);
+    }
+
+    int midi_event_write
+    (
+      void *buffer,
+      jack_nframes_t time,
+      const jack_midi_data_t *data,
+      size_t size
+    ) override
+    {
+      return jack_midi_event_write (buffer, time, data, size);
+    }
+  };
+}
@@ -3,15 +3,59 @@
 #include <lv2_horst/horst.h>
 #include <lv2_horst/midi_binding.h>
 #include <lv2_horst/ringbuffer.h>
+#include <lv2_horst/realtime_exchange.h>
+#include <lv2_horst/automation.h>
+#include <lv2_horst/preset.h>
+#include <lv2_horst/reblocker.h>
+#include <lv2_horst/meter.h>
+#include <lv2_horst/history.h>
+#include <lv2_horst/control_snapshot.h>
+#include <lv2_horst/dirty_set.h>
+#include <lv2_horst/cache_line.h>
+#include <lv2_horst/connection_plan.h>
+#include <lv2_horst/stats.h>
+#include <lv2_horst/overload.h>
+#include <lv2_horst/jack_backend.h>
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
 
+#include <lv2/atom/util.h>
+
 #include <cmath>
+#include <mutex>
+#include <thread>
+#include <array>
+#include <utility>
 
 namespace lv2_horst
 {
-  const int cc_mask = 128 + 32 + 16;
+  const int midi_status_mask = 0xf0;
+  const int midi_cc_status = 0xb0;
+
+  /*
+   * How MIDI driven parameter changes split the period:
+   *
+   * exact: Split exactly at the event's frame.
+   * quantized: Split at the event's frame rounded down to a multiple
+   *   of the split quantum.
+   * last_value: Never split. All changes are applied at the start of
+   *   the period, so only the last value per period takes effect.
+   */
+  enum class split_policy
+  {
+    exact,
+    quantized,
+    last_value
+  };
+
+  struct run_statistics
+  {
+    uint64_t m_cycles;
+    uint64_t m_run_calls;
+    uint32_t m_last_cycle_run_calls;
+    uint32_t m_max_cycle_run_calls;
+  };
 
   extern "C" 
   {
@@ -37,19 +81,74 @@ namespace lv2_horst
     (
       void *arg
     );
+
+    void jacked_horst_latency_callback
+    (
+      jack_latency_callback_mode_t mode,
+      void *arg
+    );
+
+    int jacked_horst_xrun_callback
+    (
+      void *arg
+    );
   }
 
+  struct jacked_horst;
+
+  /*
+   * A process callback specialisation (see jacked_horst::process ()).
+   */
+  typedef int (*process_function) (jacked_horst &, jack_nframes_t);
+
   struct jacked_horst
   {
+    /*
+     * The process callback specialisation matching the current flags.
+     * Swapped by select_process_function ().
+     */
+    std::atomic<process_function> m_atomic_process_function;
+    std::mutex m_process_function_mutex;
+
     std::atomic<bool> m_atomic_enabled;
     std::atomic<bool> m_atomic_control_input_updates_enabled;
+
+    /*
+     * Enables publishing m_control_outputs. Without it the process
+     * thread does no work for control outputs at all.
+     */
     std::atomic<bool> m_atomic_control_output_updates_enabled;
     std::atomic<bool> m_atomic_audio_input_monitoring_enabled;
     std::atomic<bool> m_atomic_audio_output_monitoring_enabled;
+    std::atomic<bool> m_atomic_automation_enabled;
+    std::atomic<jack_nframes_t> m_atomic_automation_control_period;
+    std::atomic<split_policy> m_atomic_split_policy;
+    std::atomic<jack_nframes_t> m_atomic_split_quantum;
+
+    /*
+     * Written by the process thread only. Resetting is requested
+     * through m_atomic_reset_run_statistics.
+     */
+    std::atomic<uint64_t> m_atomic_cycles;
+    std::atomic<uint64_t> m_atomic_run_calls;
+    std::atomic<uint32_t> m_atomic_last_cycle_run_calls;
+    std::atomic<uint32_t> m_atomic_max_cycle_run_calls;
+    std::atomic<bool> m_atomic_reset_run_statistics;
+
+    std::atomic<float> m_atomic_meter_peak_hold_time;
+    std::atomic<bool> m_atomic_reset_meters;
+
+    std::atomic<bool> m_atomic_history_enabled;
+
+    std::atomic<uint64_t> m_atomic_xruns;
 
     horst_ptr m_horst;
 
-    jack_client_t *m_jack_client;
+    /*
+     * The audio server connection. A jack_backend unless another
+     * backend was passed to the constructor.
+     */
+    audio_backend_ptr m_backend;
     jack_nframes_t m_sample_rate;
     jack_nframes_t m_buffer_size;
 
@@ -64,46 +163,262 @@ namespace lv2_horst
     std::vector<size_t> m_jack_input_port_indices;
     std::vector<size_t> m_jack_output_port_indices;
 
+    connection_plan m_connection_plan;
+
     jack_port_t *m_jack_midi_port;
-    std::vector<std::atomic<float>> m_atomic_port_values;
-    std::vector<float> m_port_values;
 
-    // TODO: allow more than one binding per port:
-    std::vector<std::atomic<midi_binding>> m_atomic_midi_bindings;
+    /*
+     * m_atomic_port_values is written by control threads,
+     * m_port_values is what the plugin sees. They live on separate
+     * cache lines. Control inputs changed by set_control_port_value ()
+     * are marked in m_control_inputs_dirty and only those are copied
+     * in the next period. m_atomic_control_input_versions holds the
+     * version of each port's last mark.
+     */
+    std::vector<std::atomic<float>, cache_aligned_allocator<std::atomic<float>>> m_atomic_port_values;
+    std::vector<float, cache_aligned_allocator<float>> m_port_values;
+    dirty_set m_control_inputs_dirty;
+    std::vector<std::atomic<uint64_t>> m_atomic_control_input_versions;
+
+    /*
+     * Control inputs not exposed as JACK ports, published by the
+     * process thread at the end of periods in which MIDI, automation
+     * or a preset changed any of them. This is the only place control
+     * threads read those changes from. Stamped with the
+     * m_control_inputs_dirty version consumed before (plus one), so
+     * readers can tell whether a value set since was applied yet.
+     */
+    control_snapshot m_control_inputs;
+    bool m_control_inputs_driven;
+
+    /*
+     * State for delivering midi-in events to atom input ports. Events
+     * up to m_midi_input_event_index have been delivered in the
+     * current cycle.
+     */
+    void *m_midi_input_buffer;
+    uint32_t m_midi_input_event_count;
+    uint32_t m_midi_input_event_index;
+
+    /*
+     * Atom sequence buffers, indexed by port index. Empty for non-atom
+     * ports. uint64_t makes them 8 byte aligned as atoms require.
+     */
+    std::vector<std::vector<uint64_t>> m_atom_buffers;
+    std::vector<size_t> m_atom_input_port_indices;
+    std::vector<size_t> m_atom_output_port_indices;
+
+    /*
+     * JACK MIDI output buffers for atom output ports supporting MIDI,
+     * indexed by port index. Fetched once per cycle.
+     */
+    std::vector<void *> m_jack_midi_output_buffers;
+
+    LV2_URID m_atom_sequence_urid;
+    LV2_URID m_atom_chunk_urid;
+    LV2_URID m_midi_event_urid;
+
+    /*
+     * The control thread's view of all bindings. Every change rebuilds
+     * m_midi_dispatch from it.
+     */
+    std::vector<std::vector<midi_binding>> m_midi_bindings;
+    realtime_exchange<midi_dispatch_table> m_midi_dispatch;
+
+    /*
+     * Peak, RMS, peak hold and clip counts of the JACK audio/cv ports,
+     * indexed by port index.
+     */
+    meter_block m_meters;
+    bool m_metering_active;
+
+    /*
+     * Control output values (of control ports not exposed as JACK
+     * ports), published at the end of each period.
+     */
+    control_snapshot m_control_outputs;
+
+    /*
+     * m_history_reader is the most recently published history. It is
+     * only touched by the control thread and stays valid until the next
+     * one is published.
+     */
+    realtime_exchange<history> m_history;
+    history *m_history_reader;
+
+    realtime_exchange<automation> m_automation;
+    double m_automation_position;
+
+    /*
+     * m_preset_bank_reader is the most recently published bank (see
+     * m_history_reader). Switching is requested through
+     * m_atomic_preset_request (see make_preset_request ()).
+     * m_preset_mutex serializes the control side. select_preset ()
+     * holds it from restoring a preset's state until the switch is
+     * requested, so concurrent selections and bank replacements can
+     * not interleave.
+     */
+    std::mutex m_preset_mutex;
+    realtime_exchange<preset_bank> m_preset_bank;
+    preset_bank *m_preset_bank_reader;
+    std::atomic<uint64_t> m_atomic_preset_request;
+    std::atomic<int> m_atomic_current_preset;
+
+    /*
+     * Non-zero if the plugin runs in blocks of this size independent
+     * of the JACK period (see reblocker).
+     */
+    const size_t m_internal_block_size;
+    reblocker_ptr m_reblocker;
+
+    jack_nframes_t m_processed_frames;
+    uint32_t m_cycle_run_calls;
+
+    /*
+     * Counts all periods since construction.
+     */
+    uint64_t m_period;
+
+    /*
+     * cycle_counter () ticks per frame at the current sample rate.
+     */
+    double m_ticks_per_frame;
+
+    /*
+     * This instance's slot in the process' stats segment
+     */
+    size_t m_stats_slot;
+
+    /*
+     * Load tracking, xrun attribution and load shedding (see
+     * overload_manager)
+     */
+    overload_unit_ptr m_overload_unit;
+
+    /*
+     * Held by the process callback (with try_lock) for the whole
+     * period and by everything that reconfigures or replaces the
+     * plugin instance. Periods in which the process callback does not
+     * get it are silenced instead of blocking.
+     */
+    std::mutex m_instance_mutex;
+
+    /*
+     * Serializes saving the plugin's state against everything else
+     * that may not run concurrently with it: restoring, replacing the
+     * instance and changing its block length. LV2 allows saving while
+     * the plugin runs, so saves do not take m_instance_mutex. Taken
+     * before m_instance_mutex.
+     */
+    std::mutex m_state_mutex;
+
+    /*
+     * The block length the current instance was set up for. Periods
+     * it cannot run are silenced until its replacement is swapped in.
+     * 0 while the period is one the plugin can not run at all.
+     */
+    std::atomic<size_t> m_atomic_instance_block_length;
+    std::atomic<uint64_t> m_atomic_silenced_periods;
+
+    /*
+     * Re-instantiation on a background thread (see request_rebuild ())
+     */
+    std::mutex m_rebuild_mutex;
+    std::thread m_rebuild_thread;
+    bool m_rebuild_running;
+    uint64_t m_rebuild_requests;
+    uint64_t m_rebuilds_done;
 
     jacked_horst
     (
       lilv_plugins_ptr plugins,
       const std::string &uri,
       const std::string &jack_client_name,
-      bool expose_control_ports
+      bool expose_control_ports,
+      size_t internal_block_size = 0,
+      audio_backend_ptr backend = audio_backend_ptr (),
+      bool active = true
     ) :
+      m_atomic_process_function (0),
       m_atomic_enabled (true),
       m_atomic_control_input_updates_enabled (true),
       m_atomic_control_output_updates_enabled (false),
       m_atomic_audio_input_monitoring_enabled (false),
       m_atomic_audio_output_monitoring_enabled (false),
+      m_atomic_automation_enabled (true),
+      m_atomic_automation_control_period (0),
+      m_atomic_split_policy (split_policy::exact),
+      m_atomic_split_quantum (32),
+      m_atomic_cycles (0),
+      m_atomic_run_calls (0),
+      m_atomic_last_cycle_run_calls (0),
+      m_atomic_max_cycle_run_calls (0),
+      m_atomic_reset_run_statistics (false),
+      m_atomic_meter_peak_hold_time (1.0f),
+      m_atomic_reset_meters (false),
+      m_atomic_history_enabled (true),
+      m_atomic_xruns (0),
       m_horst (new horst (plugins, uri)),
-      m_jack_client (jack_client_open ((jack_client_name == "" ? m_horst->m_name : jack_client_name).c_str (), JackNullOption, 0)),
+      m_backend (backend ? backend : audio_backend_ptr (new jack_backend)),
       m_expose_control_ports (expose_control_ports),
       m_jack_ports (m_horst->m_port_properties.size (), 0),
       m_jack_port_buffers (m_horst->m_port_properties.size (), 0),
       m_port_data_locations (m_horst->m_port_properties.size (), 0),
       m_atomic_port_values (m_horst->m_port_properties.size ()),
       m_port_values (m_horst->m_port_properties.size (), 0),
-      m_atomic_midi_bindings (m_horst->m_port_properties.size ())
+      m_control_inputs_dirty (m_horst->m_port_properties.size ()),
+      m_atomic_control_input_versions (m_horst->m_port_properties.size ()),
+      m_control_inputs (m_horst->m_port_properties.size (), control_input_port_indices (*m_horst, expose_control_ports)),
+      m_control_inputs_driven (false),
+      m_midi_input_buffer (0),
+      m_midi_input_event_count (0),
+      m_midi_input_event_index (0),
+      m_atom_buffers (m_horst->m_port_properties.size ()),
+      m_jack_midi_output_buffers (m_horst->m_port_properties.size (), 0),
+      m_atom_sequence_urid (m_horst->urid_map (LV2_ATOM__Sequence)),
+      m_atom_chunk_urid (m_horst->urid_map (LV2_ATOM__Chunk)),
+      m_midi_event_urid (m_horst->urid_map (LV2_MIDI__MidiEvent)),
+      m_midi_bindings (m_horst->m_port_properties.size ()),
+      m_meters (m_horst->m_port_properties.size ()),
+      m_metering_active (false),
+      m_control_outputs (m_horst->m_port_properties.size (), control_output_port_indices (*m_horst, expose_control_ports)),
+      m_history_reader (0),
+      m_automation_position (0),
+      m_preset_bank_reader (0),
+      m_atomic_preset_request (no_preset_request),
+      m_atomic_current_preset (-1),
+      m_internal_block_size (internal_block_size),
+      m_processed_frames (0),
+      m_cycle_run_calls (0),
+      m_period (0),
+      m_ticks_per_frame (0),
+      m_stats_slot (HORST_STATS_MAX_INSTANCES),
+      m_overload_unit (new overload_unit (m_horst->m_name)),
+      m_atomic_instance_block_length (0),
+      m_atomic_silenced_periods (0),
+      m_rebuild_running (false),
+      m_rebuild_requests (0),
+      m_rebuilds_done (0)
     {
       DBG_ENTER
 
-      if (m_jack_client == 0) THROW("Failed to open jack client: " + jack_client_name);
+      m_horst->m_hosted = true;
 
-      m_buffer_size = jack_get_buffer_size (m_jack_client);
-      m_sample_rate = jack_get_sample_rate (m_jack_client);
+      m_backend->open (jack_client_name == "" ? m_horst->m_name : jack_client_name);
+
+      m_buffer_size = m_backend->buffer_size ();
+      m_sample_rate = m_backend->sample_rate ();
+      m_ticks_per_frame = cycle_counter_ticks_per_second () / m_sample_rate;
       m_zero_buffers = std::vector<std::vector<float>> (m_horst->m_port_properties.size (), std::vector<float> (m_buffer_size, 0));
 
-      m_horst->instantiate (m_sample_rate, m_buffer_size);
+      if (!block_length_supported (plugin_block_length ()))
+      {
+        THROW("power of two block length required: " + std::to_string (plugin_block_length ()));
+      }
+      m_horst->instantiate (m_sample_rate, plugin_block_length ());
+      m_atomic_instance_block_length = plugin_block_length ();
 
-      m_jack_midi_port = jack_port_register (m_jack_client, "midi-in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+      m_jack_midi_port = m_backend->port_register ("midi-in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
       if (m_jack_midi_port == 0) THROW("Failed to register midi port: " + m_horst->m_name + ":midi-in");
 
       for (size_t index = 0; index < m_horst->m_port_properties.size(); ++index)
@@ -130,7 +445,7 @@ namespace lv2_horst
           if (p.m_is_input) 
           {
             DBG("port: index: " << index << " registering jack input port")
-            m_jack_ports[index] = jack_port_register (m_jack_client, p.m_symbol.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+            m_jack_ports[index] = m_backend->port_register (p.m_symbol, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
 
             if (m_jack_ports[index] == 0) THROW(std::string("Failed to register port: ") + m_horst->m_name + ":" + p.m_symbol);
             m_jack_input_port_indices.push_back (index);
@@ -138,35 +453,111 @@ namespace lv2_horst
           else 
           {
             DBG("port: index: " << index << " registering jack output port")
-            m_jack_ports[index] = jack_port_register (m_jack_client, p.m_symbol.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+            m_jack_ports[index] = m_backend->port_register (p.m_symbol, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
 
             if (m_jack_ports[index] == 0) THROW(std::string("Failed to register port: ") + m_horst->m_name + ":" + p.m_symbol);
 
             m_jack_output_port_indices.push_back (index);
           }
         }
+
+        if (p.m_is_atom)
+        {
+          const size_t size = std::max<size_t> (p.m_minimum_buffer_size, HORST_DEFAULT_ATOM_BUFFER_SIZE);
+          m_atom_buffers[index].resize ((size + sizeof (uint64_t) - 1) / sizeof (uint64_t), 0);
+
+          if (p.m_is_input)
+          {
+            m_atom_input_port_indices.push_back (index);
+          }
+          else
+          {
+            m_atom_output_port_indices.push_back (index);
+
+            if (p.m_supports_midi)
+            {
+              DBG("port: index: " << index << " registering jack midi output port")
+              m_jack_ports[index] = m_backend->port_register (p.m_symbol, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+
+              if (m_jack_ports[index] == 0) THROW(std::string("Failed to register port: ") + m_horst->m_name + ":" + p.m_symbol);
+            }
+          }
+        }
       }
 
-      connect_control_ports ();
+      for (size_t index = 0; index < m_horst->m_port_properties.size (); ++index)
+      {
+        const port_properties &p = m_horst->m_port_properties[index];
+        if ((p.m_is_control && m_expose_control_ports) || p.m_is_audio || p.m_is_cv)
+        {
+          m_connection_plan.add (index, m_jack_ports[index], p.m_is_input);
+        }
+      }
+
+      if (m_internal_block_size != 0)
+      {
+        m_reblocker = reblocker_ptr (new reblocker (m_internal_block_size, m_jack_input_port_indices, m_jack_output_port_indices));
+
+        // Input events collect here until the first block runs
+        reset_atom_inputs ();
+      }
+
+      connect_ports ();
+      select_process_function ();
 
       DBG("setting callbacks")
       int ret;
-      ret = jack_set_sample_rate_callback (m_jack_client, jacked_horst_sample_rate_callback, (void*)this);
+      ret = m_backend->set_sample_rate_callback (jacked_horst_sample_rate_callback, (void*)this);
       if (ret != 0) THROW("Failed to set sample rate callback");
 
-      ret = jack_set_buffer_size_callback (m_jack_client, jacked_horst_buffer_size_callback, (void*)this);
+      ret = m_backend->set_buffer_size_callback (jacked_horst_buffer_size_callback, (void*)this);
       if (ret != 0) THROW("Failed to set buffer size callback");
 
-      ret = jack_set_process_callback (m_jack_client, jacked_horst_process_callback, (void*)this);
+      ret = m_backend->set_process_callback (jacked_horst_process_callback, (void*)this);
       if (ret != 0) THROW("Failed to set process callback");
 
-      ret = jack_set_thread_init_callback (m_jack_client, jacked_horst_thread_init_callback, (void*)this);
+      ret = m_backend->set_thread_init_callback (jacked_horst_thread_init_callback, (void*)this);
       if (ret != 0) THROW("Failed to set thread init callback");
 
+      ret = m_backend->set_latency_callback (jacked_horst_latency_callback, (void*)this);
+      if (ret != 0) THROW("Failed to set latency callback");
+
+      ret = m_backend->set_xrun_callback (jacked_horst_xrun_callback, (void*)this);
+      if (ret != 0) THROW("Failed to set xrun callback");
+
+      m_stats_slot = stats_publisher::instance ().register_instance (m_backend->client_name (), [this] (stats_values &v) { collect_stats (v); });
+
+      m_overload_unit->m_name = m_backend->client_name ();
+      m_overload_unit->m_shed_changed = [this] () { select_process_function (); };
+      overload_manager::instance ().register_unit (m_overload_unit);
+
+      // Last, so nothing can throw once callbacks may run. No
+      // destructor runs if it throws itself
+      if (active)
+      {
+        try
+        {
+          activate ();
+        }
+        catch (...)
+        {
+          overload_manager::instance ().unregister_unit (m_overload_unit);
+          stats_publisher::instance ().unregister_instance (m_stats_slot);
+          throw;
+        }
+      }
+      DBG_EXIT
+    }
+
+    /*
+     * Only needed if the instance was constructed inactive, e.g. to
+     * set up values and bindings before the first period runs.
+     */
+    void activate ()
+    {
       DBG("activating jack client")
-      ret = jack_activate (m_jack_client);
+      const int ret = m_backend->activate ();
       if (ret != 0) THROW("Failed to activate client");
-      DBG_EXIT
     }
 
     horst_ptr get_horst ()
@@ -174,6 +565,88 @@ namespace lv2_horst
       return m_horst;
     }
 
+    /*
+     * Control inputs not exposed as JACK ports.
+     */
+    static std::vector<size_t> control_input_port_indices
+    (
+      const horst &h,
+      bool expose_control_ports
+    )
+    {
+      std::vector<size_t> indices;
+      if (expose_control_ports) return indices;
+
+      for (size_t index = 0; index < h.m_port_properties.size (); ++index)
+      {
+        if (h.m_port_properties[index].m_is_control && h.m_port_properties[index].m_is_input) indices.push_back (index);
+      }
+      return indices;
+    }
+
+    /*
+     * Control outputs not exposed as JACK ports.
+     */
+    static std::vector<size_t> control_output_port_indices
+    (
+      const horst &h,
+      bool expose_control_ports
+    )
+    {
+      std::vector<size_t> indices;
+      if (expose_control_ports) return indices;
+
+      for (size_t index = 0; index < h.m_port_properties.size (); ++index)
+      {
+        if (h.m_port_properties[index].m_is_control && h.m_port_properties[index].m_is_output) indices.push_back (index);
+      }
+      return indices;
+    }
+
+    /*
+     * The block length the plugin is instantiated with and run at.
+     */
+    size_t plugin_block_length () const
+    {
+      return m_internal_block_size != 0 ? m_internal_block_size : m_buffer_size;
+    }
+
+    bool block_length_supported
+    (
+      size_t block_length
+    ) const
+    {
+      return !m_horst->m_power_of_two_block_length_required || (block_length & (block_length - 1)) == 0;
+    }
+
+    /*
+     * The latency in frames added by re-blocking.
+     */
+    jack_nframes_t get_latency () const
+    {
+      return m_reblocker ? (jack_nframes_t)m_reblocker->latency () : 0;
+    }
+
+    /*
+     * Connects everything that does not get reconnected per period.
+     * Needs to be called after every (re-)instantiation.
+     */
+    void connect_ports ()
+    {
+      connect_control_ports ();
+      m_connection_plan.invalidate ();
+
+      for (size_t port_index = 0; port_index < m_atom_buffers.size (); ++port_index)
+      {
+        if (!m_atom_buffers[port_index].empty ())
+        {
+          m_horst->connect_port (port_index, &m_atom_buffers[port_index][0]);
+        }
+      }
+
+      if (m_reblocker) m_reblocker->connect (*m_horst);
+    }
+
     void connect_control_ports ()
     {
       for (size_t port_index = 0; port_index < m_horst->m_port_properties.size (); ++port_index)
@@ -190,290 +663,1546 @@ namespace lv2_horst
     ~jacked_horst ()
     {
       DBG_ENTER
-      jack_deactivate (m_jack_client);
-      jack_client_close (m_jack_client);
+      overload_manager::instance ().unregister_unit (m_overload_unit);
+      stats_publisher::instance ().unregister_instance (m_stats_slot);
+      m_backend->deactivate ();
+
+      // No more callbacks can request one now
+      if (m_rebuild_thread.joinable ()) m_rebuild_thread.join ();
+      m_horst->m_hosted = false;
+
+      m_backend->close ();
       DBG_EXIT
     }
 
-    inline int process_callback
+    inline LV2_Atom_Sequence *atom_sequence
     (
-      jack_nframes_t nframes
+      size_t port_index
     )
     {
-      const size_t number_of_ports = m_horst->m_port_properties.size ();
-      const size_t number_of_jack_input_ports = m_jack_input_port_indices.size ();
-      const size_t number_of_jack_output_ports = m_jack_output_port_indices.size ();
+      return (LV2_Atom_Sequence*)&m_atom_buffers[port_index][0];
+    }
 
-      const bool enabled = m_atomic_enabled;
-      const bool control_input_updates_enabled = m_atomic_control_input_updates_enabled;
-      const bool control_output_updates_enabled = m_atomic_control_output_updates_enabled;
-      const bool audio_input_monitoring_enabled = m_atomic_audio_input_monitoring_enabled;
-      const bool audio_output_monitoring_enabled = m_atomic_audio_output_monitoring_enabled;
+    inline uint32_t atom_buffer_capacity
+    (
+      size_t port_index
+    )
+    {
+      return (uint32_t)(m_atom_buffers[port_index].size () * sizeof (uint64_t));
+    }
 
-      for (size_t index = 0; index < number_of_ports; ++index)
+    inline void reset_atom_inputs ()
+    {
+      for (size_t index = 0; index < m_atom_input_port_indices.size (); ++index)
       {
-        const port_properties &p = m_horst->m_port_properties[index];
-        if (p.m_is_audio || (m_expose_control_ports && p.m_is_control) || p.m_is_cv)
-        {
-          m_jack_port_buffers[index] = (float*)jack_port_get_buffer (m_jack_ports[index], nframes);
-          m_port_data_locations[index] = m_jack_port_buffers[index];
-
-          if (p.m_is_input && !enabled)
-          {
-            m_port_data_locations[index] = &m_zero_buffers[index][0];
-          }
-
-          m_horst->connect_port (index, m_port_data_locations[index]);
-        }
+        LV2_Atom_Sequence *sequence = atom_sequence (m_atom_input_port_indices[index]);
+        sequence->atom.type = m_atom_sequence_urid;
+        sequence->atom.size = sizeof (LV2_Atom_Sequence_Body);
+        sequence->body.unit = 0;
+        sequence->body.pad = 0;
       }
+    }
 
-      if (control_input_updates_enabled)
+    inline void reset_atom_outputs ()
+    {
+      for (size_t index = 0; index < m_atom_output_port_indices.size (); ++index)
       {
-        for (size_t index = 0; index < number_of_ports; ++index)
-        {
-          const port_properties &p = m_horst->m_port_properties[index];
-          if (p.m_is_control && p.m_is_input && !m_expose_control_ports)
-          {
-            m_port_values[index] = m_atomic_port_values[index];
-          }
-        }
+        const size_t port_index = m_atom_output_port_indices[index];
+        LV2_Atom_Sequence *sequence = atom_sequence (port_index);
+        sequence->atom.type = m_atom_chunk_urid;
+        sequence->atom.size = atom_buffer_capacity (port_index) - sizeof (LV2_Atom);
       }
+    }
 
-      if (control_output_updates_enabled)
+    /*
+     * Appends the midi-in events before frame to that have not been
+     * delivered yet to the atom input ports. An event at frame from
+     * lands at position in the plugin's block.
+     */
+    inline void deliver_midi_input
+    (
+      jack_nframes_t from,
+      jack_nframes_t to,
+      size_t position
+    )
+    {
+      while (m_midi_input_event_index < m_midi_input_event_count)
       {
-        for (size_t index = 0; index < number_of_ports; ++index)
+        jack_midi_event_t event;
+        m_backend->midi_event_get (&event, m_midi_input_buffer, m_midi_input_event_index);
+
+        if (event.time >= to) break;
+        ++m_midi_input_event_index;
+
+        const uint32_t event_size = sizeof (LV2_Atom_Event) + (uint32_t)event.size;
+
+        for (size_t index = 0; index < m_atom_input_port_indices.size (); ++index)
         {
-          const port_properties &p = m_horst->m_port_properties[index];
-          if (p.m_is_control && p.m_is_output && !m_expose_control_ports)
+          const size_t port_index = m_atom_input_port_indices[index];
+          if (!m_horst->m_port_properties[port_index].m_supports_midi) continue;
+
+          LV2_Atom_Sequence *sequence = atom_sequence (port_index);
+          if (sizeof (LV2_Atom) + sequence->atom.size + lv2_atom_pad_size (event_size) > atom_buffer_capacity (port_index))
           {
-            m_atomic_port_values[index] = m_port_values[index];
+            m_horst->log_realtime_message ("Atom input buffer full. Dropping MIDI event");
+            continue;
           }
+
+          LV2_Atom_Event *atom_event = lv2_atom_sequence_end (&sequence->body, sequence->atom.size);
+          atom_event->time.frames = position + (event.time > from ? event.time - from : 0);
+          atom_event->body.type = m_midi_event_urid;
+          atom_event->body.size = (uint32_t)event.size;
+          memcpy (LV2_ATOM_BODY (&atom_event->body), event.buffer, event.size);
+
+          sequence->atom.size += lv2_atom_pad_size (event_size);
         }
       }
-      
-      jack_nframes_t processed_frames = 0;
+    }
 
-      void *midi_port_buffer = jack_port_get_buffer (m_jack_midi_port, nframes);
-      int event_count = jack_midi_get_event_count (midi_port_buffer);
+    /*
+     * Fills the atom input ports with the midi-in events in [from, to)
+     * that have not been delivered yet, timestamped relative to from,
+     * and resets the atom output ports.
+     */
+    inline void prepare_atom_ports
+    (
+      jack_nframes_t from,
+      jack_nframes_t to
+    )
+    {
+      reset_atom_inputs ();
+      reset_atom_outputs ();
+      deliver_midi_input (from, to, 0);
+    }
 
-      for (int event_index = 0; event_index < event_count; ++event_index) 
+    /*
+     * Forwards the MIDI events the plugin wrote to its atom output
+     * ports with times in [position, position + nframes) to the JACK
+     * MIDI outputs, at offset + time - position. Earlier events go to
+     * offset. With last, later events go to the last frame.
+     */
+    inline void forward_atom_outputs
+    (
+      jack_nframes_t offset,
+      size_t position,
+      jack_nframes_t nframes,
+      bool last
+    )
+    {
+      for (size_t index = 0; index < m_atom_output_port_indices.size (); ++index)
       {
-        jack_midi_event_t event;
-        jack_midi_event_get (&event, midi_port_buffer, event_index);
+        const size_t port_index = m_atom_output_port_indices[index];
+        void *midi_buffer = m_jack_midi_output_buffers[port_index];
+        if (midi_buffer == 0) continue;
 
-        if (event.size != 3) continue;
-        if ((event.buffer[0] & cc_mask) != cc_mask) continue;
+        LV2_Atom_Sequence *sequence = atom_sequence (port_index);
+        if (sequence->atom.type != m_atom_sequence_urid) continue;
 
-        const int channel = event.buffer[0] & 15;
-        const int cc = event.buffer[1];
-        const float value = event.buffer[2] / 127.0f;
+        LV2_ATOM_SEQUENCE_FOREACH (sequence, atom_event)
+        {
+          if (atom_event->body.type != m_midi_event_urid) continue;
 
-        bool changed = false;
+          const int64_t time = atom_event->time.frames - (int64_t)position;
+          if (time >= (int64_t)nframes && !last) break;
+          if (time < 0 && position > 0) continue;
 
-        for (size_t port_index = 0; port_index < m_atomic_midi_bindings.size (); ++port_index) 
-        {
-          const port_properties &props = m_horst->m_port_properties[port_index];
-          if (!(props.m_is_input && props.m_is_control)) continue;
+          const jack_nframes_t frame = offset + (jack_nframes_t)std::clamp<int64_t> (time, 0, nframes - 1);
+          m_backend->midi_event_write (midi_buffer, frame, (const jack_midi_data_t*)LV2_ATOM_BODY (&atom_event->body), atom_event->body.size);
+        }
+      }
+    }
 
-          const midi_binding &binding = m_atomic_midi_bindings[port_index];
+    /*
+     * Runs the plugin on frames [m_processed_frames, m_processed_frames + nframes)
+     */
+    inline void run_plugin
+    (
+      jack_nframes_t nframes
+    )
+    {
+      const bool has_atom_ports = !m_atom_input_port_indices.empty () || !m_atom_output_port_indices.empty ();
 
-          if (!binding.m_enabled) continue;
-          if (binding.m_cc != cc) continue;
-          if (binding.m_channel != channel) continue;
+      if (has_atom_ports) prepare_atom_ports (m_processed_frames, m_processed_frames + nframes);
 
-          // DBG("calling run (" << event.time - processed_frames <<")")
-          if (!m_horst->m_fixed_block_length_required && processed_frames != event.time)
-          {
-            m_horst->run (event.time - processed_frames);
-            processed_frames = event.time;
-            changed = true;
-          }
+      m_horst->run (nframes);
+      ++m_cycle_run_calls;
 
-          const float transformed_value = binding.m_offset + binding.m_factor * value;
+      if (has_atom_ports) forward_atom_outputs (m_processed_frames, 0, nframes, true);
+    }
 
-          const float mapped_value = props.m_minimum_value + (props.m_maximum_value - props.m_minimum_value) * transformed_value;
+    /*
+     * With re-blocking the plugin's blocks are not aligned with the
+     * period. MIDI is treated like audio: input events collect in the
+     * atom input ports at the position their frame has in the block
+     * being filled, across periods if need be, and output events of
+     * the previous block come out at the frame the corresponding
+     * audio output does. Both are delayed by one block like the audio.
+     */
+    struct reblocked_plugin
+    {
+      jacked_horst &m;
+      bool m_has_atom_ports;
+
+      inline void chunk
+      (
+        size_t offset,
+        size_t position,
+        size_t nframes
+      )
+      {
+        if (!m_has_atom_ports) return;
 
-          // std::cout << event.time << " " << port_index << " " << mapped_value << "\n";
+        m.deliver_midi_input (offset, offset + nframes, position);
+        m.forward_atom_outputs (offset, position, nframes, position + nframes == m.m_reblocker->m_block_size);
+      }
 
-          m_port_values[port_index] = m_atomic_port_values[port_index] = mapped_value;
-        }
+      inline void run
+      (
+        size_t nframes
+      )
+      {
+        if (m_has_atom_ports) m.reset_atom_outputs ();
 
-        if (changed) 
-        {
-          for (size_t port_index = 0; port_index < m_jack_port_buffers.size (); ++port_index) 
-          {
-            const port_properties &p = m_horst->m_port_properties[port_index];
-            if ((p.m_is_control && m_expose_control_ports) || p.m_is_audio || p.m_is_cv) 
-            {
-              m_horst->connect_port (port_index, m_port_data_locations[port_index] + processed_frames);
-            }
-          }
-        }
+        m.m_horst->run (nframes);
+
+        if (m_has_atom_ports) m.reset_atom_inputs ();
+      }
+    };
+
+    /*
+     * Runs the plugin up to the given frame and reconnects the audio
+     * and cv ports so the next sub-block starts there.
+     */
+    template<bool Reblocking, bool Splitting>
+    inline void split
+    (
+      jack_nframes_t frame
+    )
+    {
+      if constexpr (Reblocking)
+      {
+        if (frame <= m_processed_frames) return;
+
+        reblocked_plugin plugin { *this, !m_atom_input_port_indices.empty () || !m_atom_output_port_indices.empty () };
+        m_cycle_run_calls += m_reblocker->process (plugin, &m_port_data_locations[0], m_processed_frames, frame - m_processed_frames);
+        m_processed_frames = frame;
+        return;
       }
 
-      // DBG("calling run (" << nframes - processed_frames << ")")
-      m_horst->run (nframes - processed_frames);
+      if (!Splitting || frame <= m_processed_frames) return;
 
-      if (!enabled) 
+      trace_instant ("split", frame);
+      run_plugin (frame - m_processed_frames);
+      m_processed_frames = frame;
+
+      for (size_t index = 0; index < m_connection_plan.size (); ++index)
       {
-        for (size_t port_index = 0; port_index < std::min (number_of_jack_input_ports, number_of_jack_output_ports); ++port_index) 
-        {
-          for (jack_nframes_t frame_index = 0; frame_index < nframes; ++frame_index) 
-          {
-            m_jack_port_buffers[m_jack_output_port_indices[port_index]][frame_index] += m_jack_port_buffers[m_jack_input_port_indices[port_index]][frame_index];
-          }
-        }
+        const size_t port_index = m_connection_plan.m_port_indices[index];
+        float *location = m_port_data_locations[port_index] + m_processed_frames;
+        m_horst->connect_port (port_index, location);
+        m_connection_plan.m_connected[index] = location;
       }
+    }
 
-      if (audio_input_monitoring_enabled) 
+    inline void update_run_statistics ()
+    {
+      if (m_atomic_reset_run_statistics.exchange (false, std::memory_order_relaxed))
       {
-        for (size_t index = 0; index < number_of_jack_input_ports; ++index)
-        {
-          float max_value = 0;
-          const float * const buffer = m_jack_port_buffers[m_jack_input_port_indices[index]];
-          for (size_t frame = 0; frame < nframes; ++frame) 
-          {
-            if (fabs(buffer[frame]) > max_value) max_value = buffer[frame];
-          }
-          m_atomic_port_values[m_jack_input_port_indices[index]] = max_value;
-        }
+        m_atomic_cycles.store (0, std::memory_order_relaxed);
+        m_atomic_run_calls.store (0, std::memory_order_relaxed);
+        m_atomic_max_cycle_run_calls.store (0, std::memory_order_relaxed);
       }
-      else
+
+      m_atomic_cycles.store (m_atomic_cycles.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      m_atomic_run_calls.store (m_atomic_run_calls.load (std::memory_order_relaxed) + m_cycle_run_calls, std::memory_order_relaxed);
+      m_atomic_last_cycle_run_calls.store (m_cycle_run_calls, std::memory_order_relaxed);
+
+      if (m_cycle_run_calls > m_atomic_max_cycle_run_calls.load (std::memory_order_relaxed))
       {
-        for (size_t index = 0; index < number_of_jack_input_ports; ++index) m_atomic_port_values[m_jack_input_port_indices[index]] = 0.f;
+        m_atomic_max_cycle_run_calls.store (m_cycle_run_calls, std::memory_order_relaxed);
       }
+    }
+
+    inline void update_meters
+    (
+      jack_nframes_t nframes,
+      bool inputs_enabled,
+      bool outputs_enabled
+    )
+    {
+      if (m_atomic_reset_meters.exchange (false, std::memory_order_relaxed)) m_meters.reset ();
+
+      const float hold_time = m_atomic_meter_peak_hold_time.load (std::memory_order_relaxed);
+      const float hold_decay = hold_time > 0 ? expf (-(float)nframes / (hold_time * m_sample_rate)) : 0.0f;
 
-      if (audio_output_monitoring_enabled)
+      m_meters.write_begin ();
+
+      for (size_t index = 0; index < m_jack_input_port_indices.size (); ++index)
       {
-        for (size_t index = 0; index < number_of_jack_output_ports; ++index)
-        {
-          float max_value = 0;
-          const float * const buffer = m_jack_port_buffers[m_jack_output_port_indices[index]];
-          for (size_t frame = 0; frame < nframes; ++frame) 
-          {
-            if (fabs(buffer[frame]) > max_value) max_value = buffer[frame];
-          }
-          m_atomic_port_values[m_jack_output_port_indices[index]] = max_value;
-        }
+        const size_t port_index = m_jack_input_port_indices[index];
+        if (inputs_enabled) m_meters.update (port_index, m_jack_port_buffers[port_index], nframes, hold_decay);
+        else m_meters.clear (port_index);
       }
-      else
+
+      for (size_t index = 0; index < m_jack_output_port_indices.size (); ++index)
       {
-        for (size_t index = 0; index < number_of_jack_output_ports; ++index) m_atomic_port_values[m_jack_output_port_indices[index]] = 0.f;
+        const size_t port_index = m_jack_output_port_indices[index];
+        if (outputs_enabled) m_meters.update (port_index, m_jack_port_buffers[port_index], nframes, hold_decay);
+        else m_meters.clear (port_index);
       }
 
-      return 0;
+      m_meters.write_end ();
     }
 
-    void change_buffer_sizes () 
+    inline void record_history ()
     {
-      if (m_horst->m_power_of_two_block_length_required)
+      history &h = *m_history.m_current;
+
+      float *row = h.write_pointer ();
+      if (row == 0) return;
+
+      for (size_t column = 0; column < h.m_columns.size (); ++column)
       {
-        if (!(m_buffer_size & (m_buffer_size - 1))) 
+        const history_column &c = h.m_columns[column];
+        switch (c.m_source)
         {
-          THROW("power of two buffer size required");
+          case history_source::peak:
+            row[column] = m_meters.m_peak[c.m_port_index].load (std::memory_order_relaxed);
+            break;
+          case history_source::rms:
+            row[column] = m_meters.m_rms[c.m_port_index].load (std::memory_order_relaxed);
+            break;
+          case history_source::control_value:
+          default:
+            row[column] = m_port_values[c.m_port_index];
+            break;
         }
       }
-      for (size_t port_index = 0; port_index < m_horst->m_port_properties.size (); ++port_index)
-      {
-        m_zero_buffers[port_index].resize (m_buffer_size, 0);
-      }
+
+      h.write_advance ();
     }
 
-    int buffer_size_callback
+    inline void apply_automation
     (
-      jack_nframes_t buffer_size
+      jack_nframes_t frame
     )
     {
-      DBG_ENTER
-      DBG("buffer_size: " << buffer_size)
-      if (buffer_size != m_buffer_size) 
-      {
-        m_buffer_size = buffer_size;
+      const double time = (m_automation_position + frame) / (double)m_sample_rate;
 
-        change_buffer_sizes ();
-
-        DBG("re-instantiating")
-        m_horst->instantiate ((double)m_sample_rate, m_buffer_size);
-        connect_control_ports ();
+      for (size_t index = 0; index < m_automation.m_current->m_curves.size (); ++index)
+      {
+        automation_curve &curve = m_automation.m_current->m_curves[index];
+        m_port_values[curve.m_port_index] = curve.value_at (time);
       }
-      DBG_EXIT
-      return 0;
+      m_control_inputs_driven = true;
     }
 
-    int sample_rate_callback
+    /*
+     * Applies all automation ticks up to and including the given frame,
+     * splitting the block at each of them.
+     */
+    template<bool Reblocking, bool Splitting>
+    inline void run_automation_until
     (
-      jack_nframes_t sample_rate
+      jack_nframes_t frame,
+      jack_nframes_t &next_automation_frame,
+      jack_nframes_t control_period
     )
     {
-      DBG_ENTER
-      if (sample_rate != m_sample_rate) 
+      while (next_automation_frame <= frame)
       {
-        m_sample_rate = sample_rate;
-        // std::cout << "sample rate callback. sample rate: " << sample_rate << "\n";
-        DBG("re-instantiating")
-        m_horst->instantiate ((double)m_sample_rate, m_buffer_size);
-        connect_control_ports ();
+        split<Reblocking, Splitting> (next_automation_frame);
+        apply_automation (next_automation_frame);
+        next_automation_frame += control_period;
       }
-      DBG_EXIT
-      return 0;
     }
 
-    int get_number_of_ports () 
+    /*
+     * Switches to the pending preset if it is due by frame. Automation
+     * ticks before it are applied first.
+     */
+    template<bool Reblocking, bool Splitting>
+    inline void run_preset_until
+    (
+      jack_nframes_t frame,
+      jack_nframes_t &preset_frame,
+      size_t preset_index,
+      jack_nframes_t &next_automation_frame,
+      jack_nframes_t control_period
+    )
     {
-      return (int)(m_horst->m_port_properties.size ());
+      if (preset_frame > frame) return;
+
+      if (preset_frame > 0) run_automation_until<Reblocking, Splitting> (preset_frame - 1, next_automation_frame, control_period);
+      split<Reblocking, Splitting> (preset_frame);
+
+      m_preset_bank.m_current->apply (preset_index, [this] (size_t port_index, float value)
+      {
+        m_port_values[port_index] = value;
+      });
+      m_control_inputs_driven = true;
+
+      m_atomic_current_preset.store ((int)preset_index, std::memory_order_relaxed);
+      preset_frame = std::numeric_limits<jack_nframes_t>::max ();
     }
 
-    void set_control_port_value
+    /*
+     * The process callback, specialised over flags that change rarely
+     * or never:
+     *
+     * Enabled: The plugin is not bypassed (see set_enabled ()).
+     * Metering: Audio input or output monitoring is on.
+     * Reblocking: The plugin runs in internal blocks (see reblocker).
+     * Splitting: The plugin accepts blocks of varying length, so
+     *   periods can be split at MIDI events and automation ticks.
+     */
+    template<bool Enabled, bool Metering, bool Reblocking, bool Splitting>
+    inline int process
     (
-      size_t index,
-      float value
+      jack_nframes_t nframes
     )
     {
-      DBG("index: " << index << ", value: " << value)
-      if (index >= m_port_values.size ()) 
+      const size_t number_of_jack_input_ports = m_jack_input_port_indices.size ();
+      const size_t number_of_jack_output_ports = m_jack_output_port_indices.size ();
+
+      const bool control_input_updates_enabled = m_atomic_control_input_updates_enabled;
+      const bool control_output_updates_enabled = m_atomic_control_output_updates_enabled;
+
+      for (size_t index = 0; index < m_connection_plan.size (); ++index)
+      {
+        const size_t port_index = m_connection_plan.m_port_indices[index];
+
+        float *buffer = (float*)m_backend->port_get_buffer (m_connection_plan.m_jack_ports[index], nframes);
+        m_jack_port_buffers[port_index] = buffer;
+
+        float *location = (!Enabled && m_connection_plan.m_is_input[index]) ? &m_zero_buffers[port_index][0] : buffer;
+        m_port_data_locations[port_index] = location;
+
+        if (!Reblocking && location != m_connection_plan.m_connected[index])
+        {
+          m_horst->connect_port (port_index, location);
+          m_connection_plan.m_connected[index] = location;
+        }
+      }
+
+      if (control_input_updates_enabled)
+      {
+        m_control_inputs_dirty.consume ([this] (size_t index)
+        {
+          m_port_values[index] = m_atomic_port_values[index].load (std::memory_order_relaxed);
+        });
+      }
+
+      m_processed_frames = 0;
+      m_cycle_run_calls = 0;
+
+      const split_policy midi_split_policy = m_overload_unit->m_splitting_reduced.load (std::memory_order_relaxed) ? split_policy::last_value : m_atomic_split_policy.load ();
+      const jack_nframes_t split_quantum = std::max<jack_nframes_t> (1, m_atomic_split_quantum);
+
+      if (m_automation.receive ()) m_automation_position = 0;
+      m_midi_dispatch.receive ();
+      m_preset_bank.receive ();
+
+      // Only the most recent request counts. Without splitting it takes effect for the whole period.
+      const uint64_t preset_request = m_atomic_preset_request.exchange (no_preset_request, std::memory_order_acquire);
+      const size_t preset_index = preset_request >> 32;
+      jack_nframes_t preset_frame = std::numeric_limits<jack_nframes_t>::max ();
+      if (preset_request != no_preset_request && m_preset_bank.m_current && preset_index < m_preset_bank.m_current->size ())
+      {
+        preset_frame = std::min<jack_nframes_t> (preset_request & 0xffffffff, nframes - 1);
+      }
+
+      const bool automation_active = m_automation.m_current && m_atomic_automation_enabled;
+
+      jack_nframes_t automation_control_period = m_atomic_automation_control_period;
+      if (automation_control_period == 0 || (!Splitting && !Reblocking))
+      {
+        automation_control_period = nframes;
+      }
+
+      jack_nframes_t next_automation_frame = automation_active ? 0 : nframes;
+
+      const midi_dispatch_table *midi_dispatch = m_midi_dispatch.m_current;
+
+      void *midi_port_buffer = m_backend->port_get_buffer (m_jack_midi_port, nframes);
+      // Every event is traced, only control changes need the dispatch table
+      const bool midi_tracing = tracing ();
+      const int event_count = (midi_dispatch || midi_tracing) ? m_backend->midi_get_event_count (midi_port_buffer) : 0;
+
+      m_midi_input_buffer = midi_port_buffer;
+      m_midi_input_event_count = m_atom_input_port_indices.empty () ? 0 : m_backend->midi_get_event_count (midi_port_buffer);
+      m_midi_input_event_index = 0;
+
+      for (size_t index = 0; index < m_atom_output_port_indices.size (); ++index)
+      {
+        const size_t port_index = m_atom_output_port_indices[index];
+        if (m_jack_ports[port_index] == 0) continue;
+
+        m_jack_midi_output_buffers[port_index] = m_backend->port_get_buffer (m_jack_ports[port_index], nframes);
+        m_backend->midi_clear_buffer (m_jack_midi_output_buffers[port_index]);
+      }
+
+      for (int event_index = 0; event_index < event_count; ++event_index) 
+      {
+        jack_midi_event_t event;
+        m_backend->midi_event_get (&event, midi_port_buffer, event_index);
+
+        if (midi_tracing)
+        {
+          // Up to the first three bytes, status byte highest
+          uint32_t bytes = 0;
+          for (size_t byte = 0; byte < 3; ++byte) bytes = bytes << 8 | (byte < event.size ? event.buffer[byte] : 0);
+          trace_instant ("midi", bytes);
+        }
+
+        if (!midi_dispatch || event.size != 3) continue;
+        if ((event.buffer[0] & midi_status_mask) != midi_cc_status) continue;
+
+        const int channel = event.buffer[0] & 15;
+        const int cc = event.buffer[1] & 127;
+        const int value = event.buffer[2] & 127;
+
+        jack_nframes_t split_frame = event.time;
+        if (midi_split_policy == split_policy::quantized) split_frame -= split_frame % split_quantum;
+        if (midi_split_policy == split_policy::last_value) split_frame = 0;
+
+        run_preset_until<Reblocking, Splitting> (split_frame, preset_frame, preset_index, next_automation_frame, automation_control_period);
+        run_automation_until<Reblocking, Splitting> (split_frame, next_automation_frame, automation_control_period);
+
+        const midi_dispatch_table::entry *end = midi_dispatch->end (channel, cc);
+        for (const midi_dispatch_table::entry *entry = midi_dispatch->begin (channel, cc); entry != end; ++entry)
+        {
+          split<Reblocking, Splitting> (split_frame);
+
+          m_port_values[entry->m_port_index] = entry->m_values[value];
+          m_control_inputs_driven = true;
+        }
+      }
+
+      run_preset_until<Reblocking, Splitting> (nframes - 1, preset_frame, preset_index, next_automation_frame, automation_control_period);
+      run_automation_until<Reblocking, Splitting> (nframes - 1, next_automation_frame, automation_control_period);
+
+      if constexpr (Reblocking)
+      {
+        split<Reblocking, Splitting> (nframes);
+      }
+      else
+      {
+        // DBG("calling run (" << nframes - m_processed_frames << ")")
+        run_plugin (nframes - m_processed_frames);
+      }
+
+      update_run_statistics ();
+
+      if (automation_active) m_automation_position += nframes;
+
+      if constexpr (!Enabled)
+      {
+        for (size_t port_index = 0; port_index < std::min (number_of_jack_input_ports, number_of_jack_output_ports); ++port_index) 
+        {
+          for (jack_nframes_t frame_index = 0; frame_index < nframes; ++frame_index) 
+          {
+            m_jack_port_buffers[m_jack_output_port_indices[port_index]][frame_index] += m_jack_port_buffers[m_jack_input_port_indices[port_index]][frame_index];
+          }
+        }
+      }
+
+      // One more update after monitoring was turned off clears the meters
+      if (Metering || m_metering_active)
+      {
+        update_meters (nframes, m_atomic_audio_input_monitoring_enabled, m_atomic_audio_output_monitoring_enabled);
+        m_metering_active = Metering;
+      }
+
+      if (control_output_updates_enabled)
+      {
+        m_control_outputs.publish (m_period, m_port_values.data ());
+      }
+
+      if (m_control_inputs_driven)
+      {
+        m_control_inputs.publish (m_control_inputs_dirty.m_consumed_version + 1, m_port_values.data ());
+        m_control_inputs_driven = false;
+      }
+
+      ++m_period;
+
+      m_history.receive ();
+      if (m_history.m_current && m_atomic_history_enabled.load (std::memory_order_relaxed))
+      {
+        record_history ();
+      }
+
+      return 0;
+    }
+
+    template<size_t Flags>
+    static int process_variant
+    (
+      jacked_horst &h,
+      jack_nframes_t nframes
+    )
+    {
+      return h.process<(Flags & 1) != 0, (Flags & 2) != 0, (Flags & 4) != 0, (Flags & 8) != 0> (nframes);
+    }
+
+    template<size_t... Flags>
+    static constexpr std::array<process_function, sizeof... (Flags)> make_process_variants
+    (
+      std::index_sequence<Flags...>
+    )
+    {
+      return {{ &process_variant<Flags>... }};
+    }
+
+    /*
+     * Picks the process () specialisation matching the current flags.
+     * Needs to be called whenever one of them changes.
+     */
+    void select_process_function ()
+    {
+      static constexpr std::array<process_function, 16> variants = make_process_variants (std::make_index_sequence<16> ());
+
+      std::lock_guard<std::mutex> lock (m_process_function_mutex);
+
+      const bool enabled = m_atomic_enabled && !m_overload_unit->m_shed;
+      const bool metering = m_atomic_audio_input_monitoring_enabled || m_atomic_audio_output_monitoring_enabled;
+      const bool reblocking = (bool)m_reblocker;
+      const bool splitting = !m_horst->m_fixed_block_length_required;
+
+      m_atomic_process_function.store (variants[enabled | (metering << 1) | (reblocking << 2) | (splitting << 3)], std::memory_order_release);
+    }
+
+    inline int process_callback
+    (
+      jack_nframes_t nframes
+    )
+    {
+      std::unique_lock<std::mutex> instance_lock (m_instance_mutex, std::try_to_lock);
+      if (!instance_lock.owns_lock () || !instance_can_run (nframes))
+      {
+        output_silence (nframes);
+        return 0;
+      }
+
+      trace_begin ("process", nframes);
+
+      dsp_timing &timing = m_horst->m_timing;
+      overload_unit &unit = *m_overload_unit;
+      const bool timed = timing.enabled ();
+      const bool tracked = unit.m_tracking.load (std::memory_order_relaxed);
+
+      if (!timed && !tracked)
+      {
+        const int ret = m_atomic_process_function.load (std::memory_order_acquire) (*this, nframes);
+        trace_end ("process", nframes);
+        return ret;
+      }
+
+      const uint64_t start_ticks = cycle_counter ();
+      const int ret = m_atomic_process_function.load (std::memory_order_acquire) (*this, nframes);
+      const uint64_t ticks = cycle_counter () - start_ticks;
+
+      if (timed)
+      {
+        timing.add (dsp_timing_phase::process, ticks);
+        timing.end_period (nframes * m_ticks_per_frame);
+      }
+
+      if (tracked) unit.update_load (ticks / (nframes * m_ticks_per_frame));
+
+      trace_end ("process", nframes);
+      return ret;
+    }
+
+    void change_buffer_sizes () 
+    {
+      for (size_t port_index = 0; port_index < m_horst->m_port_properties.size (); ++port_index)
+      {
+        m_zero_buffers[port_index].resize (m_buffer_size, 0);
+      }
+    }
+
+    inline bool instance_can_run
+    (
+      jack_nframes_t nframes
+    ) const
+    {
+      if (m_reblocker) return true;
+
+      const size_t block_length = m_atomic_instance_block_length.load (std::memory_order_relaxed);
+      return nframes <= block_length && (!m_horst->m_fixed_block_length_required || nframes == block_length);
+    }
+
+    void output_silence
+    (
+      jack_nframes_t nframes
+    )
+    {
+      m_atomic_silenced_periods.fetch_add (1, std::memory_order_relaxed);
+
+      for (size_t port_index : m_jack_output_port_indices)
+      {
+        memset (m_backend->port_get_buffer (m_jack_ports[port_index], nframes), 0, nframes * sizeof (float));
+      }
+
+      for (size_t port_index : m_atom_output_port_indices)
+      {
+        if (m_jack_ports[port_index] != 0) m_backend->midi_clear_buffer (m_backend->port_get_buffer (m_jack_ports[port_index], nframes));
+      }
+    }
+
+    /*
+     * Plugins with the options interface get the new block length
+     * handed to the running instance. All others are re-instantiated
+     * in the background (see request_rebuild ()).
+     */
+    int buffer_size_callback
+    (
+      jack_nframes_t buffer_size
+    )
+    {
+      DBG_ENTER
+      DBG("buffer_size: " << buffer_size)
+      if (buffer_size != m_buffer_size) 
+      {
+        // While a rebuild runs it owns the block length options
+        const bool rebuilding = is_reinstantiating ();
+        bool rebuild = false;
+        {
+          std::lock_guard<std::mutex> state_lock (m_state_mutex);
+          std::lock_guard<std::mutex> lock (m_instance_mutex);
+          m_buffer_size = buffer_size;
+
+          change_buffer_sizes ();
+
+          // With re-blocking the plugin's block length does not depend
+          // on the JACK period. Throwing here would unwind through
+          // JACK, so an unsupported period only silences the instance
+          // until a supported one comes along
+          if (!m_reblocker)
+          {
+            if (!block_length_supported (m_buffer_size))
+            {
+              INFO(m_horst->m_name << " can not run at a period of " << m_buffer_size << " frames (power of two required). Silencing it")
+              m_atomic_instance_block_length = 0;
+            }
+            else if (!rebuilding && m_horst->set_block_length (m_buffer_size))
+            {
+              DBG("block length set through the options interface")
+              m_atomic_instance_block_length = m_buffer_size;
+            }
+            else
+            {
+              rebuild = true;
+            }
+          }
+        }
+
+        if (rebuild) request_rebuild ();
+      }
+      DBG_EXIT
+      return 0;
+    }
+
+    /*
+     * The current instance keeps running at the old sample rate until
+     * its replacement is ready.
+     */
+    int sample_rate_callback
+    (
+      jack_nframes_t sample_rate
+    )
+    {
+      DBG_ENTER
+      if (sample_rate != m_sample_rate) 
+      {
+        {
+          std::lock_guard<std::mutex> lock (m_instance_mutex);
+          m_sample_rate = sample_rate;
+          m_ticks_per_frame = cycle_counter_ticks_per_second () / m_sample_rate;
+        }
+
+        request_rebuild ();
+      }
+      DBG_EXIT
+      return 0;
+    }
+
+    /*
+     * Builds a new instance for the current sample rate and block
+     * length on a background thread and swaps it in under
+     * m_instance_mutex. The new instance is connected to the same
+     * port values, so control values carry over. Requests arriving
+     * during a rebuild are folded into one more rebuild.
+     */
+    void request_rebuild ()
+    {
+      std::lock_guard<std::mutex> lock (m_rebuild_mutex);
+      ++m_rebuild_requests;
+      if (m_rebuild_running) return;
+
+      if (m_rebuild_thread.joinable ()) m_rebuild_thread.join ();
+
+      m_rebuild_running = true;
+      m_rebuild_thread = std::thread ([this] () { rebuild (); });
+    }
+
+    void rebuild ()
+    {
+      while (true)
+      {
+        uint64_t request;
+        {
+          std::lock_guard<std::mutex> lock (m_rebuild_mutex);
+          if (m_rebuilds_done == m_rebuild_requests)
+          {
+            m_rebuild_running = false;
+            return;
+          }
+          request = m_rebuild_requests;
+        }
+
+        double sample_rate;
+        size_t block_length;
+        {
+          std::lock_guard<std::mutex> lock (m_instance_mutex);
+          sample_rate = m_sample_rate;
+          block_length = plugin_block_length ();
+        }
+
+        // Stays silenced. The next supported period requests another
+        // rebuild
+        if (!block_length_supported (block_length))
+        {
+          std::lock_guard<std::mutex> lock (m_rebuild_mutex);
+          m_rebuilds_done = request;
+          continue;
+        }
+
+        // Deactivated and freed when this goes out of scope, outside
+        // of m_instance_mutex
+        lilv_plugin_instance_ptr previous;
+
+        try
+        {
+          DBG("re-instantiating")
+          lilv_plugin_instance_ptr instance = m_horst->create_instance (sample_rate, block_length);
+
+          std::lock_guard<std::mutex> state_lock (m_state_mutex);
+          std::lock_guard<std::mutex> lock (m_instance_mutex);
+          previous = m_horst->replace_instance (instance);
+          connect_ports ();
+          m_atomic_instance_block_length = block_length;
+        }
+        catch (const std::exception &e)
+        {
+          INFO("Failed to re-instantiate " << m_horst->m_name << ": " << e.what ())
+        }
+
+        std::lock_guard<std::mutex> lock (m_rebuild_mutex);
+        m_rebuilds_done = request;
+      }
+    }
+
+    bool is_reinstantiating ()
+    {
+      std::lock_guard<std::mutex> lock (m_rebuild_mutex);
+      return m_rebuild_running;
+    }
+
+    uint64_t get_silenced_periods () const
+    {
+      return m_atomic_silenced_periods;
+    }
+
+    void latency_callback
+    (
+      jack_latency_callback_mode_t mode
+    )
+    {
+      const jack_nframes_t latency = get_latency ();
+
+      // Capture latency flows from the inputs to the outputs, playback
+      // latency the other way around
+      const std::vector<size_t> &from = (mode == JackCaptureLatency) ? m_jack_input_port_indices : m_jack_output_port_indices;
+      const std::vector<size_t> &to = (mode == JackCaptureLatency) ? m_jack_output_port_indices : m_jack_input_port_indices;
+
+      jack_latency_range_t range { 0, 0 };
+      for (size_t index = 0; index < from.size (); ++index)
+      {
+        jack_latency_range_t port_range;
+        m_backend->port_get_latency_range (m_jack_ports[from[index]], mode, &port_range);
+
+        if (index == 0 || port_range.min < range.min) range.min = port_range.min;
+        if (index == 0 || port_range.max > range.max) range.max = port_range.max;
+      }
+
+      range.min += latency;
+      range.max += latency;
+
+      for (size_t index = 0; index < to.size (); ++index)
+      {
+        m_backend->port_set_latency_range (m_jack_ports[to[index]], mode, &range);
+      }
+    }
+
+    int get_number_of_ports () 
+    {
+      return (int)(m_horst->m_port_properties.size ());
+    }
+
+    void set_control_port_value
+    (
+      size_t index,
+      float value
+    )
+    {
+      DBG("index: " << index << ", value: " << value)
+      if (index >= m_port_values.size ()) 
+      {
+        THROW("index out of bounds");
+      }
+      m_atomic_port_values [index].store (value, std::memory_order_relaxed);
+
+      const port_properties &p = m_horst->m_port_properties[index];
+      if (p.m_is_control && p.m_is_input && !m_expose_control_ports)
+      {
+        m_atomic_control_input_versions[index].store (m_control_inputs_dirty.mark (index), std::memory_order_relaxed);
+      }
+    }
+
+    float get_control_port_value (size_t index) 
+    {
+      DBG("index: " << index << ", value: " << m_atomic_port_values[index])
+      if (index >= m_port_values.size ()) 
+      {
+        THROW("index out of bounds");
+      }
+
+      // Audio and cv ports report their peak (see set_audio_*_monitoring_enabled ())
+      if (m_jack_ports[index] && !m_horst->m_port_properties[index].m_is_control && !m_horst->m_port_properties[index].m_is_atom)
+      {
+        return m_meters.m_peak[index].load (std::memory_order_relaxed);
+      }
+
+      if (m_horst->m_port_properties[index].m_is_control && m_horst->m_port_properties[index].m_is_output && !m_expose_control_ports)
+      {
+        return m_control_outputs.value (index);
+      }
+
+      // Whichever came last: the value set here or the one MIDI,
+      // automation or a preset put in after it was applied
+      if (m_horst->m_port_properties[index].m_is_control && m_horst->m_port_properties[index].m_is_input && !m_expose_control_ports)
+      {
+        uint64_t stamp;
+        const float value = m_control_inputs.value (index, stamp);
+        if (m_atomic_control_input_versions[index].load (std::memory_order_relaxed) < stamp) return value;
+      }
+
+      return m_atomic_port_values [index];
+    }
+
+    /*
+     * Returns the values of all control outputs from a single period
+     * (see set_control_output_updates_enabled ()).
+     */
+    control_values get_control_outputs ()
+    {
+      return m_control_outputs.read ();
+    }
+
+    /*
+     * Returns a consistent snapshot of all meters, indexed by port
+     * index. Only ports exposed as JACK audio/cv ports are metered
+     * and only while monitoring is enabled for their direction.
+     */
+    std::vector<meter_values> get_meters ()
+    {
+      return m_meters.read ();
+    }
+
+    /*
+     * Clears peak hold values and clip counts. Takes effect at the
+     * start of the next period.
+     */
+    void reset_meters ()
+    {
+      m_atomic_reset_meters = true;
+    }
+
+    /*
+     * The time constant (in seconds) of the peak hold decay. 0 disables
+     * peak hold.
+     */
+    void set_meter_peak_hold_time
+    (
+      float seconds
+    )
+    {
+      m_atomic_meter_peak_hold_time = std::max (0.0f, seconds);
+    }
+
+    /*
+     * Rebuilds the dispatch table from m_midi_bindings and hands it to
+     * the process thread.
+     */
+    void update_midi_dispatch ()
+    {
+      bool any_enabled = false;
+      std::vector<float> minimums (m_midi_bindings.size (), 0);
+      std::vector<float> maximums (m_midi_bindings.size (), 0);
+
+      for (size_t port_index = 0; port_index < m_midi_bindings.size (); ++port_index)
+      {
+        const port_properties &p = m_horst->m_port_properties[port_index];
+        minimums[port_index] = p.m_minimum_value;
+        maximums[port_index] = p.m_maximum_value;
+
+        for (const midi_binding &binding : m_midi_bindings[port_index])
+        {
+          any_enabled = any_enabled || binding.m_enabled;
+        }
+      }
+
+      m_midi_dispatch.publish (any_enabled ? new midi_dispatch_table (m_midi_bindings, minimums, maximums) : 0);
+    }
+
+    void check_midi_binding_port_index
+    (
+      size_t index
+    )
+    {
+      if (index >= m_port_values.size ())
       {
         THROW("index out of bounds");
       }
-      m_atomic_port_values [index] = value;
+
+      const port_properties &p = m_horst->m_port_properties[index];
+      if (!(p.m_is_control && p.m_is_input))
+      {
+        THROW("Not a control input port: " + p.m_symbol);
+      }
     }
 
-    float get_control_port_value (size_t index) 
+    /*
+     * Replaces all bindings of the port with the given one.
+     */
+    void set_midi_binding
+    (
+      size_t index,
+      const midi_binding &binding
+    )
+    {
+      check_midi_binding_port_index (index);
+
+      m_midi_bindings[index].clear ();
+      if (binding.m_enabled) m_midi_bindings[index].push_back (binding);
+
+      update_midi_dispatch ();
+    }
+
+    /*
+     * Returns the first binding of the port or a disabled one if there
+     * is none.
+     */
+    midi_binding get_midi_binding (size_t index) 
     {
-      DBG("index: " << index << ", value: " << m_atomic_port_values[index])
       if (index >= m_port_values.size ()) 
       {
         THROW("index out of bounds");
       }
-      return m_atomic_port_values [index];
+
+      if (m_midi_bindings[index].empty ()) return midi_binding ();
+
+      return m_midi_bindings[index][0];
     }
 
-    void set_midi_binding
+    void add_midi_binding
     (
       size_t index,
       const midi_binding &binding
     )
     {
-      if (index >= m_port_values.size ())
+      check_midi_binding_port_index (index);
+
+      m_midi_bindings[index].push_back (binding);
+
+      update_midi_dispatch ();
+    }
+
+    void set_midi_bindings
+    (
+      size_t index,
+      const std::vector<midi_binding> &bindings
+    )
+    {
+      check_midi_binding_port_index (index);
+
+      m_midi_bindings[index] = bindings;
+
+      update_midi_dispatch ();
+    }
+
+    /*
+     * Replaces the bindings of all ports (indexed by port index) with
+     * a single update of the dispatch table.
+     */
+    void set_all_midi_bindings
+    (
+      const std::vector<std::vector<midi_binding>> &bindings
+    )
+    {
+      if (bindings.size () != m_midi_bindings.size ())
       {
-        THROW("index out of bounds");
+        THROW("Expected bindings for " + std::to_string (m_midi_bindings.size ()) + " ports");
       }
 
-      m_atomic_midi_bindings[index] = binding;
+      for (size_t index = 0; index < bindings.size (); ++index)
+      {
+        if (!bindings[index].empty ()) check_midi_binding_port_index (index);
+      }
+
+      m_midi_bindings = bindings;
+
+      update_midi_dispatch ();
     }
 
-    midi_binding get_midi_binding (size_t index) 
+    std::vector<midi_binding> get_midi_bindings (size_t index) 
     {
       if (index >= m_port_values.size ()) 
       {
         THROW("index out of bounds");
       }
 
-      return m_atomic_midi_bindings[index];
+      return m_midi_bindings[index];
+    }
+
+    void clear_midi_bindings ()
+    {
+      for (size_t index = 0; index < m_midi_bindings.size (); ++index)
+      {
+        m_midi_bindings[index].clear ();
+      }
+
+      update_midi_dispatch ();
+    }
+
+    /*
+     * Replaces all automation curves of this instance in one go and
+     * restarts playback from the beginning. An empty list removes all
+     * automation. Curves may only drive control inputs that are not
+     * exposed as JACK ports.
+     */
+    void set_automation
+    (
+      const std::vector<automation_curve> &curves
+    )
+    {
+      for (size_t index = 0; index < curves.size (); ++index)
+      {
+        const size_t port_index = curves[index].m_port_index;
+        if (port_index >= m_port_values.size ())
+        {
+          THROW("index out of bounds");
+        }
+
+        const port_properties &p = m_horst->m_port_properties[port_index];
+        if (!(p.m_is_control && p.m_is_input) || m_jack_ports[port_index])
+        {
+          THROW("Not a control input port: " + p.m_symbol);
+        }
+      }
+
+      m_automation.publish (curves.empty () ? 0 : new automation (curves));
+    }
+
+    void clear_automation ()
+    {
+      set_automation (std::vector<automation_curve> ());
+    }
+
+    /*
+     * Replaces the preset bank. Presets may only set control inputs
+     * that are not exposed as JACK ports. Pending switches are
+     * dropped.
+     */
+    void set_preset_bank
+    (
+      const std::vector<preset> &presets
+    )
+    {
+      for (size_t index = 0; index < presets.size (); ++index)
+      {
+        for (auto it = presets[index].m_values.begin (); it != presets[index].m_values.end (); ++it)
+        {
+          if (it->first >= m_port_values.size ())
+          {
+            THROW("index out of bounds");
+          }
+
+          const port_properties &p = m_horst->m_port_properties[it->first];
+          if (!(p.m_is_control && p.m_is_input) || m_jack_ports[it->first])
+          {
+            THROW("Not a control input port: " + p.m_symbol);
+          }
+        }
+      }
+
+      std::lock_guard<std::mutex> lock (m_preset_mutex);
+      m_atomic_preset_request = no_preset_request;
+      m_atomic_current_preset = -1;
+
+      preset_bank *bank = presets.empty () ? 0 : new preset_bank (presets);
+      m_preset_bank.publish (bank);
+      m_preset_bank_reader = bank;
+    }
+
+    std::vector<preset> get_preset_bank ()
+    {
+      std::lock_guard<std::mutex> lock (m_preset_mutex);
+      if (m_preset_bank_reader == 0) return std::vector<preset> ();
+      return m_preset_bank_reader->m_presets;
+    }
+
+    /*
+     * Switches all of the preset's values at once at the given frame
+     * of the next period (or at its start if the plugin can not run
+     * split periods). A preset's state is restored right away, which
+     * silences the periods it takes (see restore_state ()).
+     */
+    void select_preset
+    (
+      size_t index,
+      jack_nframes_t frame
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_preset_mutex);
+      if (m_preset_bank_reader == 0 || index >= m_preset_bank_reader->size ())
+      {
+        THROW("No such preset: " + std::to_string (index));
+      }
+
+      const std::string &state = m_preset_bank_reader->m_presets[index].m_state;
+      if (!state.empty ()) restore_state_from_memory (state.data (), state.size ());
+
+      m_atomic_preset_request.store (make_preset_request (index, frame), std::memory_order_release);
+    }
+
+    void select_preset_by_name
+    (
+      const std::string &name,
+      jack_nframes_t frame
+    )
+    {
+      size_t index;
+      {
+        std::lock_guard<std::mutex> lock (m_preset_mutex);
+        if (m_preset_bank_reader == 0)
+        {
+          THROW("No such preset: " + name);
+        }
+        index = m_preset_bank_reader->find (name);
+      }
+
+      select_preset (index, frame);
+    }
+
+    /*
+     * The index of the preset switched to last, -1 if none was since
+     * the bank was set.
+     */
+    int get_current_preset ()
+    {
+      return m_atomic_current_preset;
+    }
+
+    void set_automation_enabled
+    (
+      bool enabled
+    )
+    {
+      m_atomic_automation_enabled = enabled;
+    }
+
+    /*
+     * The number of frames between automation evaluations. 0 means
+     * once per period.
+     */
+    void set_automation_control_period
+    (
+      jack_nframes_t frames
+    )
+    {
+      m_atomic_automation_control_period = frames;
+    }
+
+    void set_split_policy
+    (
+      split_policy policy
+    )
+    {
+      m_atomic_split_policy = policy;
+    }
+
+    split_policy get_split_policy ()
+    {
+      return m_atomic_split_policy;
+    }
+
+    /*
+     * The grid (in frames) split points are quantized to with
+     * split_policy::quantized.
+     */
+    void set_split_quantum
+    (
+      jack_nframes_t frames
+    )
+    {
+      if (frames == 0)
+      {
+        THROW("Split quantum must be at least one frame");
+      }
+
+      m_atomic_split_quantum = frames;
+    }
+
+    run_statistics get_run_statistics ()
+    {
+      return run_statistics
+      {
+        m_atomic_cycles.load (std::memory_order_relaxed),
+        m_atomic_run_calls.load (std::memory_order_relaxed),
+        m_atomic_last_cycle_run_calls.load (std::memory_order_relaxed),
+        m_atomic_max_cycle_run_calls.load (std::memory_order_relaxed)
+      };
+    }
+
+    /*
+     * Takes effect at the start of the next period.
+     */
+    void reset_run_statistics ()
+    {
+      m_atomic_reset_run_statistics = true;
+    }
+
+    /*
+     * Starts recording one row per period with the given columns into
+     * a ring of capacity rows. Peak and rms columns require monitoring
+     * to be enabled for the port's direction. An empty list stops
+     * recording.
+     */
+    void set_history_columns
+    (
+      const std::vector<history_column> &columns,
+      size_t capacity
+    )
+    {
+      for (size_t index = 0; index < columns.size (); ++index)
+      {
+        const size_t port_index = columns[index].m_port_index;
+        if (port_index >= m_port_values.size ())
+        {
+          THROW("index out of bounds");
+        }
+
+        const port_properties &p = m_horst->m_port_properties[port_index];
+        if (columns[index].m_source == history_source::control_value && !p.m_is_control)
+        {
+          THROW("Not a control port: " + p.m_symbol);
+        }
+
+        if (columns[index].m_source != history_source::control_value && (m_jack_ports[port_index] == 0 || p.m_is_control || p.m_is_atom))
+        {
+          THROW("Not a metered port: " + p.m_symbol);
+        }
+      }
+
+      history *h = columns.empty () ? 0 : new history (columns, capacity);
+      m_history.publish (h);
+      m_history_reader = h;
+    }
+
+    std::vector<history_column> get_history_columns ()
+    {
+      if (m_history_reader == 0) return std::vector<history_column> ();
+      return m_history_reader->m_columns;
+    }
+
+    void set_history_enabled
+    (
+      bool enabled
+    )
+    {
+      m_atomic_history_enabled = enabled;
+    }
+
+    size_t get_history_rows_available ()
+    {
+      if (m_history_reader == 0) return 0;
+      return m_history_reader->read_available ();
+    }
+
+    /*
+     * Copies up to rows rows of get_history_columns ().size () floats
+     * each into data. Returns the number of rows copied.
+     */
+    size_t read_history
+    (
+      float *data,
+      size_t rows
+    )
+    {
+      if (m_history_reader == 0) return 0;
+      return m_history_reader->read (data, rows);
+    }
+
+    /*
+     * The number of rows dropped because the ring was full.
+     */
+    uint64_t get_history_overruns ()
+    {
+      if (m_history_reader == 0) return 0;
+      return m_history_reader->m_overruns.load (std::memory_order_relaxed);
+    }
+
+    /*
+     * Times the process callback and the plugin's run (), worker
+     * responses and end_run () per period. See get_dsp_timing ().
+     */
+    void set_dsp_timing_enabled
+    (
+      bool enabled
+    )
+    {
+      m_horst->m_timing.m_atomic_enabled = enabled;
+    }
+
+    /*
+     * Returns the statistics for one phase. Times are fractions of
+     * the period length.
+     */
+    timing_summary get_dsp_timing
+    (
+      dsp_timing_phase phase
+    )
+    {
+      return m_horst->m_timing.read (phase);
+    }
+
+    /*
+     * Takes effect at the end of the next timed period.
+     */
+    void reset_dsp_timing ()
+    {
+      m_horst->m_timing.reset ();
+    }
+
+    /*
+     * Runs on the stats publisher thread.
+     */
+    void collect_stats
+    (
+      stats_values &v
+    )
+    {
+      if (m_horst->m_timing.enabled ())
+      {
+        const timing_summary t = m_horst->m_timing.read (dsp_timing_phase::process);
+        v.m_dsp_mean = t.m_mean;
+        v.m_dsp_p99 = t.m_p99;
+        v.m_dsp_max = t.m_max;
+      }
+      else
+      {
+        v.m_dsp_mean = v.m_dsp_p99 = v.m_dsp_max = -1;
+      }
+
+      v.m_cycles = m_atomic_cycles.load (std::memory_order_relaxed);
+      v.m_run_calls = m_atomic_run_calls.load (std::memory_order_relaxed);
+      v.m_xruns = m_atomic_xruns.load (std::memory_order_relaxed);
+      v.m_work_queue_bytes = m_horst->m_work_items_buffer.used ();
+      v.m_work_response_queue_bytes = m_horst->m_work_response_items_buffer.used ();
+      v.m_log_queue_bytes = m_horst->m_realtime_log_messages.used ();
+      v.m_missed_log_messages = m_horst->m_missed_realtime_log_messages.load (std::memory_order_relaxed);
+      v.m_attributed_xruns = m_overload_unit->m_attributed_xruns.load (std::memory_order_relaxed);
+      v.m_enabled = m_atomic_enabled.load (std::memory_order_relaxed) && !m_overload_unit->m_shed.load (std::memory_order_relaxed);
+
+      v.m_output_peak = 0;
+      for (size_t index = 0; index < m_jack_output_port_indices.size (); ++index)
+      {
+        v.m_output_peak = std::max (v.m_output_peak, m_meters.m_peak[m_jack_output_port_indices[index]].load (std::memory_order_relaxed));
+      }
+    }
+
+    /*
+     * Every client gets called for every xrun. Each one checks whether
+     * its own load spiked and counts the xrun as attributed to itself
+     * if so.
+     */
+    int xrun_callback ()
+    {
+      m_atomic_xruns.fetch_add (1, std::memory_order_relaxed);
+      trace_recorder::instance ().dump_on_xrun ();
+
+      if (m_overload_unit->m_tracking && m_overload_unit->spiked ())
+      {
+        m_overload_unit->m_attributed_xruns.fetch_add (1, std::memory_order_relaxed);
+        INFO("xrun attributed to: " << m_overload_unit->m_name << " (peak load: " << m_overload_unit->m_peak_load << ", mean load: " << m_overload_unit->m_load << ")")
+      }
+
+      overload_manager::instance ().report_xrun ();
+      return 0;
+    }
+
+    /*
+     * Units with lower priorities are bypassed first when the overload
+     * policy sheds load. See overload_policy.
+     */
+    void set_priority
+    (
+      int priority
+    )
+    {
+      m_overload_unit->m_priority = priority;
+    }
+
+    int get_priority () const
+    {
+      return m_overload_unit->m_priority;
+    }
+
+    uint64_t get_attributed_xruns () const
+    {
+      return m_overload_unit->m_attributed_xruns;
+    }
+
+    /*
+     * Whether the overload manager currently bypasses this instance.
+     * Independent of set_enabled ().
+     */
+    bool is_shed () const
+    {
+      return m_overload_unit->m_shed;
+    }
+
+    /*
+     * Mean and recent peak DSP load as fractions of the period length.
+     * Only tracked while overload management is enabled.
+     */
+    float get_load () const
+    {
+      return m_overload_unit->m_load;
+    }
+
+    float get_peak_load () const
+    {
+      return m_overload_unit->m_peak_load;
     }
 
     std::string get_jack_client_name () const 
     {
-      return jack_get_client_name (m_jack_client);
+      return m_backend->client_name ();
     }
 
     void set_enabled
@@ -482,6 +2211,7 @@ namespace lv2_horst
     )
     {
       m_atomic_enabled = enabled;
+      select_process_function ();
     }
 
     void set_control_input_updates_enabled
@@ -506,6 +2236,7 @@ namespace lv2_horst
     )
     {
       m_atomic_audio_input_monitoring_enabled = enabled;
+      select_process_function ();
     }
 
     void set_audio_output_monitoring_enabled
@@ -514,13 +2245,19 @@ namespace lv2_horst
     )
     {
       m_atomic_audio_output_monitoring_enabled = enabled;
+      select_process_function ();
     }
 
+    /*
+     * The plugin keeps running while its state is saved. It is not run
+     * while its state is restored, the affected periods are silenced.
+     */
     void save_state
     (
       const std::string &path
     )
     {
+      std::lock_guard<std::mutex> lock (m_state_mutex);
       m_horst->save_state (path);
     }
 
@@ -529,8 +2266,27 @@ namespace lv2_horst
       const std::string &path
     )
     {
+      std::lock_guard<std::mutex> state_lock (m_state_mutex);
+      std::lock_guard<std::mutex> lock (m_instance_mutex);
       m_horst->restore_state (path);
     }
+
+    std::vector<uint8_t> save_state_to_memory ()
+    {
+      std::lock_guard<std::mutex> lock (m_state_mutex);
+      return m_horst->save_state_to_memory ();
+    }
+
+    void restore_state_from_memory
+    (
+      const void *data,
+      size_t size
+    )
+    {
+      std::lock_guard<std::mutex> state_lock (m_state_mutex);
+      std::lock_guard<std::mutex> lock (m_instance_mutex);
+      m_horst->restore_state_from_memory (data, size);
+    }
   };
 
   typedef std::shared_ptr<jacked_horst> jacked_horst_ptr;
@@ -563,13 +2319,31 @@ namespace lv2_horst
     {
       return ((jacked_horst*)arg)->process_callback (nframes);
     }
+
+    void jacked_horst_latency_callback
+    (
+      jack_latency_callback_mode_t mode,
+      void *arg
+    )
+    {
+      ((jacked_horst*)arg)->latency_callback (mode);
+    }
     
+    int jacked_horst_xrun_callback
+    (
+      void *arg
+    )
+    {
+      return ((jacked_horst*)arg)->xrun_callback ();
+    }
+
     void jacked_horst_thread_init_callback
     (
       void *arg
     )
     {
       DBG_ENTER
+      trace_recorder::instance ().register_thread (std::string ("jack: ") + ((jacked_horst*)arg)->m_backend->client_name ());
       DBG("Doing some denormal magic...")
       /* Taken from cras/src/dsp/dsp_util.c in Chromium OS code. * Copyright (c) 
         2013 The Chromium OS Authors. */
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <lv2_horst/error.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+namespace lv2_horst
+{
+  enum class json_type
+  {
+    null,
+    boolean,
+    number,
+    string,
+    array,
+    object
+  };
+
+  /*
+   * A parsed JSON document. Objects keep their keys in document
+   * order. The accessors throw on type mismatches and missing keys.
+   */
+  struct json_value
+  {
+    json_type m_type;
+    bool m_boolean;
+    double m_number;
+    std::string m_string;
+    std::vector<json_value> m_array;
+    std::vector<std::pair<std::string, json_value>> m_object;
+
+    json_value () :
+      m_type (json_type::null),
+      m_boolean (false),
+      m_number (0)
+    {
+
+    }
+
+    bool is_null () const { return m_type == json_type::null; }
+
+    bool as_bool () const
+    {
+      if (m_type != json_type::boolean) THROW("Not a boolean");
+      return m_boolean;
+    }
+
+    double as_number () const
+    {
+      if (m_type != json_type::number) THROW("Not a number");
+      return m_number;
+    }
+
+    const std::string &as_string () const
+    {
+      if (m_type != json_type::string) THROW("Not a string");
+      return m_string;
+    }
+
+    const std::vector<json_value> &as_array () const
+    {
+      if (m_type != json_type::array) THROW("Not an array");
+      return m_array;
+    }
+
+    const json_value *find
+    (
+      const std::string &key
+    ) const
+    {
+      if (m_type != json_type::object) THROW("Not an object");
+      for (const auto &member : m_object) if (member.first == key) return &member.second;
+      return 0;
+    }
+
+    const json_value &operator[]
+    (
+      const std::string &key
+    ) const
+    {
+      const json_value *value = find (key);
+      if (value == 0) THROW("No such key: " + key);
+      return *value;
+    }
+
+    /*
+     * The member's value if it exists and is not null, fallback
+     * otherwise.
+     */
+    bool get_bool
+    (
+      const std::string &key,
+      bool fallback
+    ) const
+    {
+      const json_value *value = find (key);
+      return (value && !value->is_null ()) ? value->as_bool () : fallback;
+    }
+
+    double get_number
+    (
+      const std::string &key,
+      double fallback
+    ) const
+    {
+      const json_value *value = find (key);
+      return (value && !value->is_null ()) ? value->as_number () : fallback;
+    }
+  };
+
+  /*
+   * A recursive descent parser for RFC 8259 JSON. Numbers are parsed
+   * locale independently.
+   */
+  struct json_parser
+  {
+    const char *m_begin;
+    const char *m_position;
+    const char *m_end;
+
+    json_parser
+    (
+      const std::string &text
+    ) :
+      m_begin (text.data ()),
+      m_position (text.data ()),
+      m_end (text.data () + text.size ())
+    {
+
+    }
+
+    json_value parse ()
+    {
+      json_value value = parse_value (0);
+      skip_whitespace ();
+      if (m_position != m_end) fail ("Trailing characters");
+      return value;
+    }
+
+    [[noreturn]] void fail
+    (
+      const std::string &what
+    )
+    {
+      size_t line = 1;
+      for (const char *c = m_begin; c < m_position; ++c) if (*c == '\n') ++line;
+      THROW(what + " at line " + std::to_string (line) + " (offset " + std::to_string (m_position - m_begin) + ")");
+    }
+
+    void skip_whitespace ()
+    {
+      while (m_position != m_end && (*m_position == ' ' || *m_position == '\t' || *m_position == '\n' || *m_position == '\r')) ++m_position;
+    }
+
+    void expect
+    (
+      char c
+    )
+    {
+      skip_whitespace ();
+      if (m_position == m_end || *m_position != c) fail (std::string ("Expected '") + c + "'");
+      ++m_position;
+    }
+
+    bool consume
+    (
+      const char *literal
+    )
+    {
+      const char *p = m_position;
+      for (; *literal; ++literal, ++p) if (p == m_end || *p != *literal) return false;
+      m_position = p;
+      return true;
+    }
+
+    json_value parse_value
+    (
+      size_t depth
+    )
+    {
+      if (depth > 256) fail ("Nesting too deep");
+
+      skip_whitespace ();
+      if (m_position == m_end) fail ("Unexpected end");
+
+      json_value value;
+      switch (*m_position)
+      {
+        case '{':
+          value.m_type = json_type::object;
+          ++m_position;
+          skip_whitespace ();
+          if (m_position != m_end && *m_position == '}')
+          {
+            ++m_position;
+            return value;
+          }
+          do
+          {
+            skip_whitespace ();
+            std::string key = parse_string ();
+            expect (':');
+            value.m_object.emplace_back (std::move (key), parse_value (depth + 1));
+          }
+          while (consume_separator ('}'));
+          return value;
+
+        case '[':
+          value.m_type = json_type::array;
+          ++m_position;
+          skip_whitespace ();
+          if (m_position != m_end && *m_position == ']')
+          {
+            ++m_position;
+            return value;
+          }
+          do
+          {
+            value.m_array.push_back (parse_value (depth + 1));
+          }
+          while (consume_separator (']'));
+          return value;
+
+        case '"':
+          value.m_type = json_type::string;
+          value.m_string = parse_string ();
+          return value;
+
+        case 't':
+        case 'f':
+          value.m_type = json_type::boolean;
+          value.m_boolean = *m_position == 't';
+          if (!consume (value.m_boolean ? "true" : "false")) fail ("Invalid literal");
+          return value;
+
+        case 'n':
+          if (!consume ("null")) fail ("Invalid literal");
+          return value;
+
+        default:
+          value.m_type = json_type::number;
+          value.m_number = parse_number ();
+          return value;
+      }
+    }
+
+    /*
+     * After an element: true on ',', false on close.
+     */
+    bool consume_separator
+    (
+      char close
+    )
+    {
+      skip_whitespace ();
+      if (m_position != m_end && *m_position == ',')
+      {
+        ++m_position;
+        return true;
+      }
+      expect (close);
+      return false;
+    }
+
+    double parse_number ()
+    {
+      // from_chars would also accept inf and nan
+      const char *digit = *m_position == '-' ? m_position + 1 : m_position;
+      if (digit == m_end || *digit < '0' || *digit > '9') fail ("Invalid value");
+
+      double number = 0;
+      const std::from_chars_result result = std::from_chars (m_position, m_end, number);
+      if (result.ec != std::errc () || result.ptr == m_position) fail ("Invalid number");
+      m_position = result.ptr;
+      return number;
+    }
+
+    uint32_t parse_hex4 ()
+    {
+      if (m_end - m_position < 4) fail ("Truncated escape");
+      uint32_t code = 0;
+      const std::from_chars_result result = std::from_chars (m_position, m_position + 4, code, 16);
+      if (result.ptr != m_position + 4) fail ("Invalid escape");
+      m_position += 4;
+      return code;
+    }
+
+    static void append_utf8
+    (
+      std::string &s,
+      uint32_t code
+    )
+    {
+      if (code < 0x80)
+      {
+        s += (char)code;
+      }
+      else if (code < 0x800)
+      {
+        s += (char)(0xc0 | code >> 6);
+        s += (char)(0x80 | (code & 0x3f));
+      }
+      else if (code < 0x10000)
+      {
+        s += (char)(0xe0 | code >> 12);
+        s += (char)(0x80 | (code >> 6 & 0x3f));
+        s += (char)(0x80 | (code & 0x3f));
+      }
+      else
+      {
+        s += (char)(0xf0 | code >> 18);
+        s += (char)(0x80 | (code >> 12 & 0x3f));
+        s += (char)(0x80 | (code >> 6 & 0x3f));
+        s += (char)(0x80 | (code & 0x3f));
+      }
+    }
+
+    std::string parse_string ()
+    {
+      if (m_position == m_end || *m_position != '"') fail ("Expected a string");
+      ++m_position;
+
+      std::string s;
+      while (true)
+      {
+        const char *run = m_position;
+        while (m_position != m_end && *m_position != '"' && *m_position != '\\' && (unsigned char)*m_position >= 0x20) ++m_position;
+        s.append (run, m_position);
+
+        if (m_position == m_end) fail ("Unterminated string");
+        if (*m_position == '"')
+        {
+          ++m_position;
+          return s;
+        }
+        if (*m_position != '\\') fail ("Control character in string");
+
+        ++m_position;
+        if (m_position == m_end) fail ("Unterminated string");
+        const char escape = *m_position++;
+        switch (escape)
+        {
+          case '"': s += '"'; break;
+          case '\\': s += '\\'; break;
+          case '/': s += '/'; break;
+          case 'b': s += '\b'; break;
+          case 'f': s += '\f'; break;
+          case 'n': s += '\n'; break;
+          case 'r': s += '\r'; break;
+          case 't': s += '\t'; break;
+          case 'u':
+          {
+            uint32_t code = parse_hex4 ();
+            if (code >= 0xd800 && code < 0xdc00)
+            {
+              if (!consume ("\\u")) fail ("Unpaired surrogate");
+              const uint32_t low = parse_hex4 ();
+              if (low < 0xdc00 || low >= 0xe000) fail ("Unpaired surrogate");
+              code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            else if (code >= 0xdc00 && code < 0xe000)
+            {
+              fail ("Unpaired surrogate");
+            }
+            append_utf8 (s, code);
+            break;
+          }
+          default:
+            fail ("Invalid escape");
+        }
+      }
+    }
+  };
+
+  inline json_value parse_json
+  (
+    const std::string &text
+  )
+  {
+    return json_parser (text).parse ();
+  }
+
+  inline json_value parse_json_file
+  (
+    const std::string &path
+  )
+  {
+    std::ifstream file (path, std::ios::binary);
+    if (!file) THROW("Failed to open: " + path);
+
+    std::stringstream text;
+    text << file.rdbuf ();
+    return parse_json (text.str ());
+  }
+}
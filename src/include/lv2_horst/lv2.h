@@ -5,6 +5,8 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <chrono>
+#include <mutex>
 
 #include <lv2_horst/dbg.h>
 #include <lv2_horst/error.h>
@@ -15,6 +17,13 @@ namespace lv2_horst
   {
     LilvWorld *m;
 
+    /*
+     * lilv is not thread safe, not even for queries (it loads data
+     * lazily and interns nodes). Everything touching the world holds
+     * this. Recursive since the wrappers below lock on their own.
+     */
+    std::recursive_mutex m_mutex;
+
     lilv_world () :
       m(lilv_world_new())
     {
@@ -49,19 +58,34 @@ namespace lv2_horst
     ) :
       m_uri (uri),
       m_world (world),
-      m (lilv_new_uri (world->m, uri.c_str ())) 
+      m (new_uri (*world, uri)) 
     {
       if (m == 0) THROW("Failed to create lilv uri node. URI: \"" + uri + "\"");
     }
 
+    static LilvNode *new_uri
+    (
+      lilv_world &world,
+      const std::string &uri
+    )
+    {
+      std::lock_guard<std::recursive_mutex> lock (world.m_mutex);
+      return lilv_new_uri (world.m, uri.c_str ());
+    }
+
     ~lilv_uri_node () 
     {
+      std::lock_guard<std::recursive_mutex> lock (m_world->m_mutex);
       lilv_node_free (m);
     }
   };
 
   typedef std::shared_ptr<lilv_uri_node> lilv_uri_node_ptr;
 
+  /*
+   * Scanning happens in the world's constructor and can take seconds.
+   * Separate worlds can be created concurrently.
+   */
   struct lilv_plugins 
   {
     const LilvPlugins *m;
@@ -73,10 +97,12 @@ namespace lv2_horst
     (
       lilv_world_ptr world = lilv_world_ptr (new lilv_world)
     ) :
-      m (lilv_world_get_all_plugins (world->m)),
+      m (0),
       m_world (world) 
     {
       DBG_ENTER
+      std::lock_guard<std::recursive_mutex> lock (m_world->m_mutex);
+      m = lilv_world_get_all_plugins (m_world->m);
       LILV_FOREACH (plugins, i, m)
       {
         const LilvPlugin* p = lilv_plugins_get(m, i);
@@ -105,11 +131,15 @@ namespace lv2_horst
       lilv_plugins_ptr plugins,
       lilv_uri_node_ptr node
     ) :
-      m (lilv_plugins_get_by_uri (plugins->m, node->m)),
+      m (0),
       m_uri_node (node),
       m_plugins (plugins) 
     {
       DBG_ENTER
+      {
+        std::lock_guard<std::recursive_mutex> lock (plugins->m_world->m_mutex);
+        m = lilv_plugins_get_by_uri (plugins->m, node->m);
+      }
       if (m == 0) THROW("Plugin not found. URI: " + m_uri_node->m_uri);
       DBG_EXIT
     }
@@ -125,17 +155,26 @@ namespace lv2_horst
 
     std::vector<std::vector<float>> m_initial_port_buffers;
 
+    // How long lilv_instance_activate () took
+    double m_activate_seconds;
+
     lilv_plugin_instance
     (
       lilv_plugin_ptr plugin,
       double sample_rate,
       LV2_Feature *const *supported_features
     ) :
-      m (lilv_plugin_instantiate (plugin->m, sample_rate, supported_features)),
+      m (0),
       m_plugin (plugin),
-      m_initial_port_buffers (lilv_plugin_get_num_ports (m_plugin->m), std::vector<float>(128))
+      m_activate_seconds (0)
     {
       DBG_ENTER
+      {
+        // This includes the plugin's instantiate ()
+        std::lock_guard<std::recursive_mutex> lock (plugin->m_plugins->m_world->m_mutex);
+        m = lilv_plugin_instantiate (plugin->m, sample_rate, supported_features);
+        m_initial_port_buffers.resize (lilv_plugin_get_num_ports (m_plugin->m), std::vector<float>(128));
+      }
       if (m == 0) THROW("Failed to instantiate plugin");
 
       m_handle = lilv_instance_get_handle (m);
@@ -146,7 +185,9 @@ namespace lv2_horst
         lilv_instance_connect_port (m, port_index, &m_initial_port_buffers[port_index][0]);
       }
 
+      const auto start = std::chrono::steady_clock::now ();
       lilv_instance_activate (m);
+      m_activate_seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
       DBG_EXIT
     }
 
@@ -154,6 +195,8 @@ namespace lv2_horst
     {
       DBG_ENTER
       lilv_instance_deactivate (m);
+
+      std::lock_guard<std::recursive_mutex> lock (m_plugin->m_plugins->m_world->m_mutex);
       lilv_instance_free (m);
       DBG_EXIT
     }
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <lv2_horst/seqlock.h>
+
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
+namespace lv2_horst
+{
+  struct meter_values
+  {
+    float m_peak;
+    float m_rms;
+    float m_peak_hold;
+    uint32_t m_clip_count;
+  };
+
+  /*
+   * The result of a single pass over a buffer.
+   */
+  struct meter_measurement
+  {
+    float m_peak;
+    float m_sum_of_squares;
+    uint32_t m_clip_count;
+  };
+
+  /*
+   * Samples with an absolute value above this count as clipped. Full
+   * scale itself is still a legal sample value.
+   */
+  const float meter_clip_level = 1.0f;
+
+  inline meter_measurement measure_scalar
+  (
+    const float *buffer,
+    size_t nframes
+  )
+  {
+    meter_measurement m { 0, 0, 0 };
+    for (size_t frame = 0; frame < nframes; ++frame)
+    {
+      const float a = fabsf (buffer[frame]);
+      if (a > m.m_peak) m.m_peak = a;
+      m.m_sum_of_squares += buffer[frame] * buffer[frame];
+      if (a > meter_clip_level) ++m.m_clip_count;
+    }
+    return m;
+  }
+
+  /*
+   * Computes peak, sum of squares and clip count in a single pass. Uses
+   * the widest vector unit the build targets (see OPTIMIZATION_FLAGS in
+   * the makefile).
+   */
+  inline meter_measurement measure
+  (
+    const float *buffer,
+    size_t nframes
+  )
+  {
+    size_t frame = 0;
+    meter_measurement m { 0, 0, 0 };
+
+    #if defined(__AVX2__)
+      const __m256 abs_mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+      const __m256 clip_level = _mm256_set1_ps (meter_clip_level);
+      __m256 peak = _mm256_setzero_ps ();
+      __m256 sum = _mm256_setzero_ps ();
+      __m256i clips = _mm256_setzero_si256 ();
+
+      for (; frame + 8 <= nframes; frame += 8)
+      {
+        const __m256 x = _mm256_loadu_ps (buffer + frame);
+        const __m256 a = _mm256_and_ps (x, abs_mask);
+        peak = _mm256_max_ps (peak, a);
+        sum = _mm256_add_ps (sum, _mm256_mul_ps (x, x));
+        // Comparison results are all ones (-1) per clipped lane
+        clips = _mm256_sub_epi32 (clips, _mm256_castps_si256 (_mm256_cmp_ps (a, clip_level, _CMP_GT_OQ)));
+      }
+
+      alignas(32) float peaks[8];
+      alignas(32) float sums[8];
+      alignas(32) uint32_t clip_counts[8];
+      _mm256_store_ps (peaks, peak);
+      _mm256_store_ps (sums, sum);
+      _mm256_store_si256 ((__m256i*)clip_counts, clips);
+
+      for (int lane = 0; lane < 8; ++lane)
+      {
+        if (peaks[lane] > m.m_peak) m.m_peak = peaks[lane];
+        m.m_sum_of_squares += sums[lane];
+        m.m_clip_count += clip_counts[lane];
+      }
+    #elif defined(__SSE2__)
+      const __m128 abs_mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+      const __m128 clip_level = _mm_set1_ps (meter_clip_level);
+      __m128 peak = _mm_setzero_ps ();
+      __m128 sum = _mm_setzero_ps ();
+      __m128i clips = _mm_setzero_si128 ();
+
+      for (; frame + 4 <= nframes; frame += 4)
+      {
+        const __m128 x = _mm_loadu_ps (buffer + frame);
+        const __m128 a = _mm_and_ps (x, abs_mask);
+        peak = _mm_max_ps (peak, a);
+        sum = _mm_add_ps (sum, _mm_mul_ps (x, x));
+        clips = _mm_sub_epi32 (clips, _mm_castps_si128 (_mm_cmpgt_ps (a, clip_level)));
+      }
+
+      alignas(16) float peaks[4];
+      alignas(16) float sums[4];
+      alignas(16) uint32_t clip_counts[4];
+      _mm_store_ps (peaks, peak);
+      _mm_store_ps (sums, sum);
+      _mm_store_si128 ((__m128i*)clip_counts, clips);
+
+      for (int lane = 0; lane < 4; ++lane)
+      {
+        if (peaks[lane] > m.m_peak) m.m_peak = peaks[lane];
+        m.m_sum_of_squares += sums[lane];
+        m.m_clip_count += clip_counts[lane];
+      }
+    #elif defined(__ARM_NEON) && defined(__aarch64__)
+      const float32x4_t clip_level = vdupq_n_f32 (meter_clip_level);
+      float32x4_t peak = vdupq_n_f32 (0);
+      float32x4_t sum = vdupq_n_f32 (0);
+      uint32x4_t clips = vdupq_n_u32 (0);
+
+      for (; frame + 4 <= nframes; frame += 4)
+      {
+        const float32x4_t x = vld1q_f32 (buffer + frame);
+        const float32x4_t a = vabsq_f32 (x);
+        peak = vmaxq_f32 (peak, a);
+        sum = vmlaq_f32 (sum, x, x);
+        clips = vsubq_u32 (clips, vcgtq_f32 (a, clip_level));
+      }
+
+      m.m_peak = vmaxvq_f32 (peak);
+      m.m_sum_of_squares = vaddvq_f32 (sum);
+      m.m_clip_count = vaddvq_u32 (clips);
+    #endif
+
+    const meter_measurement tail = measure_scalar (buffer + frame, nframes - frame);
+    if (tail.m_peak > m.m_peak) m.m_peak = tail.m_peak;
+    m.m_sum_of_squares += tail.m_sum_of_squares;
+    m.m_clip_count += tail.m_clip_count;
+
+    return m;
+  }
+
+  /*
+   * Meter values for a set of ports, published once per period by the
+   * process thread and read as a consistent snapshot by any number of
+   * readers.
+   */
+  struct meter_block
+  {
+    seqlock m_lock;
+
+    std::vector<std::atomic<float>> m_peak;
+    std::vector<std::atomic<float>> m_rms;
+    std::vector<std::atomic<float>> m_peak_hold;
+    std::vector<std::atomic<uint32_t>> m_clip_count;
+
+    /*
+     * Process thread only state
+     */
+    std::vector<float> m_held_peak;
+    std::vector<uint32_t> m_clips;
+
+    meter_block
+    (
+      size_t number_of_ports
+    ) :
+      m_peak (number_of_ports),
+      m_rms (number_of_ports),
+      m_peak_hold (number_of_ports),
+      m_clip_count (number_of_ports),
+      m_held_peak (number_of_ports, 0),
+      m_clips (number_of_ports, 0)
+    {
+      for (size_t index = 0; index < number_of_ports; ++index)
+      {
+        m_peak[index] = 0;
+        m_rms[index] = 0;
+        m_peak_hold[index] = 0;
+        m_clip_count[index] = 0;
+      }
+    }
+
+    inline void reset ()
+    {
+      std::fill (m_held_peak.begin (), m_held_peak.end (), 0.0f);
+      std::fill (m_clips.begin (), m_clips.end (), 0);
+    }
+
+    inline void write_begin ()
+    {
+      m_lock.write_begin ();
+    }
+
+    inline void write_end ()
+    {
+      m_lock.write_end ();
+    }
+
+    /*
+     * Must be called between write_begin () and write_end ().
+     * hold_decay is the factor the held peak decays by in this period.
+     */
+    inline void update
+    (
+      size_t port_index,
+      const float *buffer,
+      size_t nframes,
+      float hold_decay
+    )
+    {
+      const meter_measurement m = measure (buffer, nframes);
+
+      m_held_peak[port_index] = std::max (m.m_peak, m_held_peak[port_index] * hold_decay);
+      m_clips[port_index] += m.m_clip_count;
+
+      m_peak[port_index].store (m.m_peak, std::memory_order_relaxed);
+      m_rms[port_index].store (nframes ? sqrtf (m.m_sum_of_squares / nframes) : 0.0f, std::memory_order_relaxed);
+      m_peak_hold[port_index].store (m_held_peak[port_index], std::memory_order_relaxed);
+      m_clip_count[port_index].store (m_clips[port_index], std::memory_order_relaxed);
+    }
+
+    /*
+     * Must be called between write_begin () and write_end ().
+     */
+    inline void clear
+    (
+      size_t port_index
+    )
+    {
+      m_held_peak[port_index] = 0;
+      m_peak[port_index].store (0, std::memory_order_relaxed);
+      m_rms[port_index].store (0, std::memory_order_relaxed);
+      m_peak_hold[port_index].store (0, std::memory_order_relaxed);
+    }
+
+    std::vector<meter_values> read () const
+    {
+      std::vector<meter_values> values (m_peak.size ());
+
+      uint64_t sequence;
+      do
+      {
+        sequence = m_lock.read_begin ();
+
+        for (size_t index = 0; index < values.size (); ++index)
+        {
+          values[index].m_peak = m_peak[index].load (std::memory_order_relaxed);
+          values[index].m_rms = m_rms[index].load (std::memory_order_relaxed);
+          values[index].m_peak_hold = m_peak_hold[index].load (std::memory_order_relaxed);
+          values[index].m_clip_count = m_clip_count[index].load (std::memory_order_relaxed);
+        }
+      } while (m_lock.read_retry (sequence));
+
+      return values;
+    }
+  };
+}
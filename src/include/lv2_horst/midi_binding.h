@@ -1,7 +1,21 @@
+#pragma once
+
 #include <lv2_horst/dbg.h>
 
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+
 namespace lv2_horst
 {
+  enum class midi_binding_mode
+  {
+    linear,
+    logarithmic,
+    toggle
+  };
+
   struct midi_binding
   {
     bool m_enabled;
@@ -9,6 +23,9 @@ namespace lv2_horst
     int m_cc;
     float m_factor;
     float m_offset;
+    int m_cc_minimum;
+    int m_cc_maximum;
+    midi_binding_mode m_mode;
 
     midi_binding
     (
@@ -16,15 +33,153 @@ namespace lv2_horst
       int channel = 0,
       int cc = 0,
       float factor = 1.0f,
-      float offset = 0.0f
+      float offset = 0.0f,
+      int cc_minimum = 0,
+      int cc_maximum = 127,
+      midi_binding_mode mode = midi_binding_mode::linear
     ) :
       m_enabled (enabled),
       m_channel (channel),
       m_cc (cc),
       m_factor (factor),
-      m_offset (offset)
+      m_offset (offset),
+      m_cc_minimum (cc_minimum),
+      m_cc_maximum (cc_maximum),
+      m_mode (mode)
+    {
+      DBG("enabled: " << enabled << " channel: " << channel << " cc: " << cc << " factor: " << factor << " offset: " << offset << " cc_minimum: " << cc_minimum << " cc_maximum: " << cc_maximum << " mode: " << (int)mode)
+    }
+
+    /*
+     * Maps a 7 bit CC value to a value in the port range
+     * [minimum, maximum].
+     */
+    float map
+    (
+      int value,
+      float minimum,
+      float maximum
+    ) const
+    {
+      float x = 0;
+      if (m_cc_maximum != m_cc_minimum)
+      {
+        x = std::clamp ((value - m_cc_minimum) / (float)(m_cc_maximum - m_cc_minimum), 0.0f, 1.0f);
+      }
+      else
+      {
+        x = value >= m_cc_minimum ? 1.0f : 0.0f;
+      }
+
+      if (m_mode == midi_binding_mode::toggle)
+      {
+        x = x >= 0.5f ? 1.0f : 0.0f;
+      }
+
+      const float transformed_value = m_offset + m_factor * x;
+
+      if (m_mode == midi_binding_mode::logarithmic && minimum > 0 && maximum > 0)
+      {
+        return minimum * powf (maximum / minimum, transformed_value);
+      }
+
+      return minimum + (maximum - minimum) * transformed_value;
+    }
+  };
+
+  /*
+   * A precomputed (channel, cc) -> bindings table. Every entry carries
+   * a lookup table with the mapped port value for each of the 128
+   * possible CC values, so dispatching an event is two lookups and a
+   * copy per bound port.
+   *
+   * Tables are built on the control thread and swapped in as a whole
+   * (see realtime_exchange).
+   */
+  struct midi_dispatch_table
+  {
+    struct entry
+    {
+      size_t m_port_index;
+      std::array<float, 128> m_values;
+    };
+
+    /*
+     * Entries for (channel, cc) are
+     * m_entries[m_offsets[channel * 128 + cc]] up to (excluding)
+     * m_entries[m_offsets[channel * 128 + cc + 1]].
+     */
+    std::array<uint32_t, 16 * 128 + 1> m_offsets;
+    std::vector<entry> m_entries;
+
+    /*
+     * bindings[port_index] holds all bindings for that port. minimums
+     * and maximums are the port ranges.
+     */
+    midi_dispatch_table
+    (
+      const std::vector<std::vector<midi_binding>> &bindings,
+      const std::vector<float> &minimums,
+      const std::vector<float> &maximums
+    )
+    {
+      std::array<uint32_t, 16 * 128> counts;
+      counts.fill (0);
+
+      for (size_t port_index = 0; port_index < bindings.size (); ++port_index)
+      {
+        for (const midi_binding &binding : bindings[port_index])
+        {
+          if (!binding.m_enabled) continue;
+          ++counts[slot (binding.m_channel, binding.m_cc)];
+        }
+      }
+
+      m_offsets[0] = 0;
+      for (size_t index = 0; index < counts.size (); ++index)
+      {
+        m_offsets[index + 1] = m_offsets[index] + counts[index];
+      }
+
+      m_entries.resize (m_offsets[counts.size ()]);
+
+      std::array<uint32_t, 16 * 128> fill;
+      std::copy (m_offsets.begin (), m_offsets.end () - 1, fill.begin ());
+
+      for (size_t port_index = 0; port_index < bindings.size (); ++port_index)
+      {
+        for (const midi_binding &binding : bindings[port_index])
+        {
+          if (!binding.m_enabled) continue;
+
+          entry &e = m_entries[fill[slot (binding.m_channel, binding.m_cc)]++];
+          e.m_port_index = port_index;
+
+          for (int value = 0; value < 128; ++value)
+          {
+            e.m_values[value] = binding.map (value, minimums[port_index], maximums[port_index]);
+          }
+        }
+      }
+    }
+
+    static inline size_t slot
+    (
+      int channel,
+      int cc
+    )
+    {
+      return (size_t)(channel & 15) * 128 + (size_t)(cc & 127);
+    }
+
+    inline const entry *begin (int channel, int cc) const
+    {
+      return m_entries.data () + m_offsets[slot (channel, cc)];
+    }
+
+    inline const entry *end (int channel, int cc) const
     {
-      DBG("enabled: " << enabled << " channel: " << channel << " cc: " << cc << " factor: " << factor << " offset: " << offset)
+      return m_entries.data () + m_offsets[slot (channel, cc) + 1];
     }
   };
 }
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <lv2_horst/json.h>
+#include <lv2_horst/midi_binding.h>
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+namespace lv2_horst
+{
+  /*
+   * The parts of an ogfx setup file (see
+   * dev/ogfx-setup-many-plugins.json) a rig is built from. Connection
+   * lists hold one list of JACK port names per channel/port.
+   */
+  struct ogfx_control
+  {
+    std::string m_symbol;
+    float m_value;
+
+    bool m_cc_enabled;
+    int m_channel;
+    int m_cc;
+    int m_cc_minimum;
+    int m_cc_maximum;
+    float m_target_minimum;
+    float m_target_maximum;
+    midi_binding_mode m_mode;
+  };
+
+  struct ogfx_unit
+  {
+    std::string m_uri;
+    std::string m_name;
+    bool m_enabled;
+    std::vector<ogfx_control> m_controls;
+    std::vector<std::vector<std::string>> m_input_connections;
+    std::vector<std::vector<std::string>> m_output_connections;
+  };
+
+  struct ogfx_rack
+  {
+    bool m_enabled;
+    bool m_autoconnect;
+    std::vector<ogfx_unit> m_units;
+    std::vector<std::vector<std::string>> m_input_connections;
+    std::vector<std::vector<std::string>> m_output_connections;
+  };
+
+  struct ogfx_setup
+  {
+    std::vector<ogfx_rack> m_racks;
+    std::vector<std::string> m_input_midi_connections;
+  };
+
+  inline std::vector<std::string> ogfx_port_names
+  (
+    const json_value &names
+  )
+  {
+    std::vector<std::string> result;
+    for (const json_value &name : names.as_array ()) result.push_back (name.as_string ());
+    return result;
+  }
+
+  inline std::vector<std::vector<std::string>> ogfx_connections
+  (
+    const json_value &parent,
+    const std::string &key
+  )
+  {
+    std::vector<std::vector<std::string>> result;
+    const json_value *connections = parent.find (key);
+    if (connections == 0 || connections->is_null ()) return result;
+
+    for (const json_value &names : connections->as_array ()) result.push_back (ogfx_port_names (names));
+    return result;
+  }
+
+  inline midi_binding_mode ogfx_mode
+  (
+    const std::string &mode
+  )
+  {
+    if (mode == "linear") return midi_binding_mode::linear;
+    if (mode == "logarithmic") return midi_binding_mode::logarithmic;
+    if (mode == "toggle") return midi_binding_mode::toggle;
+    THROW("Unknown cc mode: " + mode);
+  }
+
+  inline ogfx_setup parse_ogfx_setup
+  (
+    const json_value &root
+  )
+  {
+    ogfx_setup setup;
+
+    const json_value *midi_connections = root.find ("input_midi_connections");
+    if (midi_connections && !midi_connections->is_null ()) setup.m_input_midi_connections = ogfx_port_names (*midi_connections);
+
+    for (const json_value &r : root["racks"].as_array ())
+    {
+      ogfx_rack rack;
+      rack.m_enabled = r.get_bool ("enabled", true);
+      rack.m_autoconnect = r.get_bool ("autoconnect", true);
+      rack.m_input_connections = ogfx_connections (r, "input_connections");
+      rack.m_output_connections = ogfx_connections (r, "output_connections");
+
+      for (const json_value &u : r["units"].as_array ())
+      {
+        ogfx_unit unit;
+        unit.m_uri = u["uri"].as_string ();
+        unit.m_name = u["name"].as_string ();
+        unit.m_enabled = u.get_bool ("enabled", true);
+        unit.m_input_connections = ogfx_connections (u, "input_connections");
+        unit.m_output_connections = ogfx_connections (u, "output_connections");
+
+        for (const json_value &p : u["input_control_ports"].as_array ())
+        {
+          ogfx_control control {};
+          control.m_symbol = p["symbol"].as_string ();
+          control.m_value = (float)p["value"].as_number ();
+
+          const json_value *cc = p.find ("cc");
+          if (cc && !cc->is_null ())
+          {
+            control.m_cc_enabled = cc->get_bool ("enabled", false);
+            control.m_channel = (int)cc->get_number ("channel", 0);
+            control.m_cc = (int)cc->get_number ("cc", 0);
+            control.m_cc_minimum = (int)cc->get_number ("cc_minimum", 0);
+            control.m_cc_maximum = (int)cc->get_number ("cc_maximum", 127);
+            control.m_target_minimum = (float)cc->get_number ("target_minimum", 0);
+            control.m_target_maximum = (float)cc->get_number ("target_maximum", 1);
+
+            const json_value *mode = cc->find ("mode");
+            control.m_mode = (mode && !mode->is_null ()) ? ogfx_mode (mode->as_string ()) : midi_binding_mode::linear;
+          }
+
+          unit.m_controls.push_back (control);
+        }
+
+        rack.m_units.push_back (unit);
+      }
+
+      setup.m_racks.push_back (rack);
+    }
+
+    return setup;
+  }
+
+  /*
+   * A binding mapping the CC range to [target minimum, target maximum]
+   * within the port range [minimum, maximum].
+   */
+  inline midi_binding ogfx_midi_binding
+  (
+    const ogfx_control &control,
+    float minimum,
+    float maximum
+  )
+  {
+    float factor = 1;
+    float offset = 0;
+
+    if (control.m_mode == midi_binding_mode::logarithmic && minimum > 0 && maximum > minimum && control.m_target_minimum > 0 && control.m_target_maximum > 0)
+    {
+      const float range = logf (maximum / minimum);
+      offset = logf (control.m_target_minimum / minimum) / range;
+      factor = logf (control.m_target_maximum / control.m_target_minimum) / range;
+    }
+    else if (maximum != minimum)
+    {
+      offset = (control.m_target_minimum - minimum) / (maximum - minimum);
+      factor = (control.m_target_maximum - control.m_target_minimum) / (maximum - minimum);
+    }
+
+    return midi_binding (true, control.m_channel, control.m_cc, factor, offset, control.m_cc_minimum, control.m_cc_maximum, control.m_mode);
+  }
+}
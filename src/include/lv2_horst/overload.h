@@ -0,0 +1,363 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+namespace lv2_horst
+{
+  /*
+   * The overload manager's handle on one instance. The instance's
+   * process thread keeps m_load and m_peak_load up to date while
+   * m_tracking is set and honours m_shed and m_splitting_reduced.
+   */
+  struct overload_unit
+  {
+    std::string m_name;
+
+    /*
+     * Lower priorities are shed first. Only units below the policy's
+     * m_bypass_below_priority are shed at all.
+     */
+    std::atomic<int> m_priority;
+
+    std::atomic<bool> m_tracking;
+
+    /*
+     * Fractions of the period length. m_load is a slow moving
+     * average, m_peak_load decays within a few periods.
+     */
+    std::atomic<float> m_load;
+    std::atomic<float> m_peak_load;
+
+    std::atomic<uint64_t> m_attributed_xruns;
+
+    std::atomic<bool> m_shed;
+    std::atomic<bool> m_splitting_reduced;
+
+    /*
+     * Called after m_shed changed
+     */
+    std::function<void ()> m_shed_changed;
+
+    overload_unit
+    (
+      const std::string &name
+    ) :
+      m_name (name),
+      m_priority (0),
+      m_tracking (false),
+      m_load (0),
+      m_peak_load (0),
+      m_attributed_xruns (0),
+      m_shed (false),
+      m_splitting_reduced (false)
+    {
+
+    }
+
+    /*
+     * Process thread only
+     */
+    inline void update_load
+    (
+      float load
+    )
+    {
+      m_load.store (0.99f * m_load.load (std::memory_order_relaxed) + 0.01f * load, std::memory_order_relaxed);
+      m_peak_load.store (std::max (load, 0.9f * m_peak_load.load (std::memory_order_relaxed)), std::memory_order_relaxed);
+    }
+
+    /*
+     * Whether the unit ran long recently compared to its usual load.
+     */
+    bool spiked () const
+    {
+      const float load = m_load.load (std::memory_order_relaxed);
+      const float peak = m_peak_load.load (std::memory_order_relaxed);
+      return peak > 0.05f && peak > 2 * load;
+    }
+  };
+
+  typedef std::shared_ptr<overload_unit> overload_unit_ptr;
+
+  /*
+   * reduce_splitting: First stop splitting periods at MIDI events
+   *   (see split_policy::last_value) in all units.
+   * bypass_low_priority: Then bypass units with a priority below
+   *   bypass_below_priority one at a time, lowest priority and
+   *   highest load first.
+   *
+   * Xruns closer together than xrun_grouping_seconds count as one.
+   * After recovery_seconds without an xrun the most recent action is
+   * undone.
+   */
+  struct overload_policy
+  {
+    bool m_reduce_splitting;
+    bool m_bypass_low_priority;
+    int m_bypass_below_priority;
+    double m_xrun_grouping_seconds;
+    double m_recovery_seconds;
+
+    overload_policy
+    (
+      bool reduce_splitting = true,
+      bool bypass_low_priority = true,
+      int bypass_below_priority = 0,
+      double xrun_grouping_seconds = 0.5,
+      double recovery_seconds = 10
+    ) :
+      m_reduce_splitting (reduce_splitting),
+      m_bypass_low_priority (bypass_low_priority),
+      m_bypass_below_priority (bypass_below_priority),
+      m_xrun_grouping_seconds (xrun_grouping_seconds),
+      m_recovery_seconds (recovery_seconds)
+    {
+
+    }
+  };
+
+  struct overload_action
+  {
+    // Seconds since the manager was created
+    double m_time;
+    std::string m_description;
+  };
+
+  /*
+   * Process wide load shedding. Instances register their
+   * overload_unit, JACK xrun callbacks report xruns and a thread of
+   * its own undoes actions once the graph has recovered. Every action
+   * and every undo is logged.
+   */
+  struct overload_manager
+  {
+    std::mutex m_mutex;
+
+    std::vector<overload_unit_ptr> m_units;
+    overload_policy m_policy;
+    bool m_enabled;
+
+    /*
+     * Undo functions of the actions taken, most recent last
+     */
+    std::vector<std::pair<std::string, std::function<void ()>>> m_undo;
+    std::vector<overload_action> m_log;
+
+    const std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_last_xrun;
+    std::chrono::steady_clock::time_point m_last_shed;
+    bool m_shed_once;
+    bool m_thread_started;
+
+    overload_manager () :
+      m_enabled (false),
+      m_start (std::chrono::steady_clock::now ()),
+      m_last_xrun (m_start),
+      m_last_shed (m_start),
+      m_shed_once (false),
+      m_thread_started (false)
+    {
+
+    }
+
+    /*
+     * Never destroyed (see stats_publisher::instance ())
+     */
+    static overload_manager &instance ()
+    {
+      static overload_manager *manager = new overload_manager;
+      return *manager;
+    }
+
+    void register_unit
+    (
+      overload_unit_ptr unit
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      unit->m_tracking = m_enabled;
+      m_units.push_back (unit);
+    }
+
+    /*
+     * Pending undo functions keep the unit alive, but must not call
+     * back into the instance anymore.
+     */
+    void unregister_unit
+    (
+      overload_unit_ptr unit
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      unit->m_shed_changed = nullptr;
+      m_units.erase (std::remove (m_units.begin (), m_units.end (), unit), m_units.end ());
+    }
+
+    void set_policy
+    (
+      const overload_policy &policy
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_policy = policy;
+    }
+
+    /*
+     * Disabling undoes all actions taken.
+     */
+    void set_enabled
+    (
+      bool enabled
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_enabled = enabled;
+
+      for (overload_unit_ptr &unit : m_units) unit->m_tracking = enabled;
+
+      if (!enabled)
+      {
+        while (!m_undo.empty ()) undo ();
+      }
+
+      if (enabled && !m_thread_started)
+      {
+        std::thread (&overload_manager::run, this).detach ();
+        m_thread_started = true;
+      }
+    }
+
+    std::vector<overload_action> get_log ()
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      return m_log;
+    }
+
+    /*
+     * Called from JACK xrun callbacks, i.e. not from a realtime
+     * thread. Every client sees the same xrun, so reports within
+     * m_xrun_grouping_seconds of the last action only restart the
+     * recovery period.
+     */
+    void report_xrun ()
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      if (!m_enabled) return;
+
+      const auto now = std::chrono::steady_clock::now ();
+      m_last_xrun = now;
+
+      if (m_shed_once && std::chrono::duration<double> (now - m_last_shed).count () < m_policy.m_xrun_grouping_seconds) return;
+
+      m_last_shed = now;
+      m_shed_once = true;
+      shed ();
+    }
+
+    void log
+    (
+      const std::string &description
+    )
+    {
+      INFO("overload: " << description)
+      m_log.push_back (overload_action { std::chrono::duration<double> (std::chrono::steady_clock::now () - m_start).count (), description });
+    }
+
+    /*
+     * Takes the next action. Requires m_mutex to be held.
+     */
+    void shed ()
+    {
+      if (m_policy.m_reduce_splitting)
+      {
+        bool reduced = false;
+        for (overload_unit_ptr &unit : m_units) reduced = reduced || unit->m_splitting_reduced;
+
+        if (!reduced && !m_units.empty ())
+        {
+          std::vector<overload_unit_ptr> units = m_units;
+          for (overload_unit_ptr &unit : units) unit->m_splitting_reduced = true;
+
+          log ("reduced splitting in " + std::to_string (units.size ()) + " units");
+          m_undo.push_back ({ "restored splitting", [units] () { for (const overload_unit_ptr &unit : units) unit->m_splitting_reduced = false; } });
+          return;
+        }
+      }
+
+      if (m_policy.m_bypass_low_priority)
+      {
+        overload_unit_ptr candidate;
+        for (overload_unit_ptr &unit : m_units)
+        {
+          if (unit->m_shed || unit->m_priority >= m_policy.m_bypass_below_priority) continue;
+
+          if
+          (
+            !candidate ||
+            unit->m_priority < candidate->m_priority ||
+            (unit->m_priority == candidate->m_priority && unit->m_load > candidate->m_load)
+          )
+          {
+            candidate = unit;
+          }
+        }
+
+        if (candidate)
+        {
+          candidate->m_shed = true;
+          if (candidate->m_shed_changed) candidate->m_shed_changed ();
+
+          log ("bypassed " + candidate->m_name + " (priority " + std::to_string (candidate->m_priority) + ", load " + std::to_string (candidate->m_load) + ")");
+          m_undo.push_back ({ "restored " + candidate->m_name, [candidate] ()
+          {
+            candidate->m_shed = false;
+            if (candidate->m_shed_changed) candidate->m_shed_changed ();
+          }});
+          return;
+        }
+      }
+
+      log ("xrun, but nothing left to shed");
+    }
+
+    /*
+     * Undoes the most recent action. Requires m_mutex to be held.
+     */
+    void undo ()
+    {
+      m_undo.back ().second ();
+      log (m_undo.back ().first);
+      m_undo.pop_back ();
+    }
+
+    void run ()
+    {
+      while (true)
+      {
+        std::this_thread::sleep_for (std::chrono::milliseconds (100));
+
+        std::lock_guard<std::mutex> lock (m_mutex);
+        if (!m_enabled || m_undo.empty ()) continue;
+
+        const auto now = std::chrono::steady_clock::now ();
+        if (std::chrono::duration<double> (now - m_last_xrun).count () < m_policy.m_recovery_seconds) continue;
+
+        undo ();
+
+        // Give the graph another recovery period before the next step
+        m_last_xrun = now;
+      }
+    }
+  };
+}
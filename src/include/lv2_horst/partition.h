@@ -0,0 +1,298 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <utility>
+#include <numeric>
+#include <algorithm>
+
+namespace lv2_horst
+{
+  /*
+   * (from, to): unit to consumes the output of unit from.
+   */
+  typedef std::pair<size_t, size_t> dependency;
+
+  /*
+   * Groups of units, each meant to run serially on one core (one JACK
+   * client or engine thread). Units within a group and the groups
+   * themselves are in an order that respects all dependencies. Loads
+   * are fractions of the period length.
+   *
+   * m_critical_path_load is the longest chain of dependent groups.
+   * Dependent groups cannot run in parallel, so it bounds what the
+   * plan can achieve even when every single core load is fine.
+   */
+  struct partition_plan
+  {
+    std::vector<std::vector<size_t>> m_groups;
+    std::vector<double> m_predicted_loads;
+    double m_max_load;
+    double m_critical_path_load;
+  };
+
+  /*
+   * Orders units so that every unit comes after the ones it depends on
+   * and chains stay together where possible (a depth first post-order
+   * over predecessors). If costs are given, costlier units and their
+   * predecessors come first. Throws if the dependencies form a cycle.
+   */
+  inline std::vector<size_t> topological_order
+  (
+    size_t number_of_units,
+    const std::vector<dependency> &dependencies,
+    const std::vector<double> &costs = std::vector<double> ()
+  )
+  {
+    std::vector<std::vector<size_t>> predecessors (number_of_units);
+    for (const dependency &d : dependencies)
+    {
+      if (d.first >= number_of_units || d.second >= number_of_units) THROW("Dependency refers to unknown unit");
+      predecessors[d.second].push_back (d.first);
+    }
+
+    enum { unvisited, visiting, done };
+    std::vector<int> states (number_of_units, unvisited);
+    std::vector<size_t> order;
+
+    // (unit, index of the next predecessor to visit)
+    std::vector<std::pair<size_t, size_t>> stack;
+
+    std::vector<size_t> roots (number_of_units);
+    std::iota (roots.begin (), roots.end (), 0);
+    if (costs.size () == number_of_units)
+    {
+      std::stable_sort (roots.begin (), roots.end (), [&] (size_t a, size_t b) { return costs[a] > costs[b]; });
+    }
+
+    for (size_t root : roots)
+    {
+      if (states[root] != unvisited) continue;
+
+      states[root] = visiting;
+      stack.push_back ({ root, 0 });
+
+      while (!stack.empty ())
+      {
+        const size_t unit = stack.back ().first;
+        if (stack.back ().second == predecessors[unit].size ())
+        {
+          states[unit] = done;
+          order.push_back (unit);
+          stack.pop_back ();
+          continue;
+        }
+
+        const size_t predecessor = predecessors[unit][stack.back ().second++];
+        if (states[predecessor] == visiting) THROW("Dependencies form a cycle");
+        if (states[predecessor] == done) continue;
+
+        states[predecessor] = visiting;
+        stack.push_back ({ predecessor, 0 });
+      }
+    }
+
+    return order;
+  }
+
+  /*
+   * Splits units with the given costs into at most number_of_groups
+   * groups.
+   *
+   * Units are placed in topological order, costly ones early. A unit may only join a
+   * group if that keeps the graph of groups acyclic (a JACK graph with
+   * a cycle adds a period of latency), which a group no other group
+   * depends on always does. Among the allowed groups it joins a
+   * predecessor's group while that stays below the average load, to
+   * keep chains together, and the least loaded group otherwise.
+   */
+  inline partition_plan partition
+  (
+    const std::vector<double> &costs,
+    const std::vector<dependency> &dependencies,
+    size_t number_of_groups
+  )
+  {
+    if (number_of_groups == 0) THROW("Need at least one group");
+
+    const size_t number_of_units = costs.size ();
+    const std::vector<size_t> order = topological_order (number_of_units, dependencies, costs);
+
+    std::vector<std::vector<size_t>> predecessors (number_of_units);
+    for (const dependency &d : dependencies) predecessors[d.second].push_back (d.first);
+
+    const double target_load = std::accumulate (costs.begin (), costs.end (), 0.0) / number_of_groups;
+
+    std::vector<std::vector<size_t>> groups (number_of_groups);
+    std::vector<double> loads (number_of_groups, 0);
+    std::vector<size_t> unit_groups (number_of_units, 0);
+
+    // reaches[a][b]: group b depends on group a, directly or not
+    std::vector<std::vector<bool>> reaches (number_of_groups, std::vector<bool> (number_of_groups, false));
+
+    for (size_t unit : order)
+    {
+      std::vector<size_t> predecessor_groups;
+      for (size_t predecessor : predecessors[unit]) predecessor_groups.push_back (unit_groups[predecessor]);
+
+      auto allowed = [&] (size_t group)
+      {
+        for (size_t p : predecessor_groups)
+        {
+          if (p != group && reaches[group][p]) return false;
+        }
+        return true;
+      };
+
+      size_t chosen = number_of_groups;
+
+      for (size_t p : predecessor_groups)
+      {
+        if (allowed (p) && loads[p] + costs[unit] <= target_load && (chosen == number_of_groups || loads[p] < loads[chosen])) chosen = p;
+      }
+
+      if (chosen == number_of_groups)
+      {
+        for (size_t group = 0; group < number_of_groups; ++group)
+        {
+          if (allowed (group) && (chosen == number_of_groups || loads[group] < loads[chosen])) chosen = group;
+        }
+      }
+
+      groups[chosen].push_back (unit);
+      loads[chosen] += costs[unit];
+      unit_groups[unit] = chosen;
+
+      for (size_t p : predecessor_groups)
+      {
+        if (p == chosen) continue;
+
+        for (size_t from = 0; from < number_of_groups; ++from)
+        {
+          if (from != p && !reaches[from][p]) continue;
+
+          reaches[from][chosen] = true;
+          for (size_t to = 0; to < number_of_groups; ++to)
+          {
+            if (reaches[chosen][to]) reaches[from][to] = true;
+          }
+        }
+      }
+    }
+
+    // A group depends on strictly more groups than any of the groups
+    // it depends on, so sorting by that count orders them
+    std::vector<size_t> ancestors (number_of_groups, 0);
+    for (size_t from = 0; from < number_of_groups; ++from)
+    {
+      for (size_t to = 0; to < number_of_groups; ++to) ancestors[to] += reaches[from][to];
+    }
+
+    std::vector<size_t> group_order (number_of_groups);
+    std::iota (group_order.begin (), group_order.end (), 0);
+    std::stable_sort (group_order.begin (), group_order.end (), [&] (size_t a, size_t b) { return ancestors[a] < ancestors[b]; });
+
+    partition_plan plan;
+    plan.m_max_load = 0;
+    plan.m_critical_path_load = 0;
+
+    std::vector<double> path_loads (number_of_groups, 0);
+    for (size_t group : group_order)
+    {
+      for (size_t from = 0; from < number_of_groups; ++from)
+      {
+        if (reaches[from][group]) path_loads[group] = std::max (path_loads[group], path_loads[from]);
+      }
+      path_loads[group] += loads[group];
+
+      if (groups[group].empty ()) continue;
+
+      plan.m_groups.push_back (groups[group]);
+      plan.m_predicted_loads.push_back (loads[group]);
+      plan.m_max_load = std::max (plan.m_max_load, loads[group]);
+      plan.m_critical_path_load = std::max (plan.m_critical_path_load, path_loads[group]);
+    }
+
+    return plan;
+  }
+
+  /*
+   * Keeps a plan for a rack and re-plans when measured costs drift
+   * away from the ones it was made with.
+   */
+  struct partitioner
+  {
+    std::vector<double> m_costs;
+    const std::vector<dependency> m_dependencies;
+    const size_t m_number_of_groups;
+
+    /*
+     * A group has drifted when its measured load differs from the
+     * predicted one by more than this fraction of the prediction (or
+     * of 5% of the period, whichever is larger).
+     */
+    double m_tolerance;
+
+    partition_plan m_plan;
+
+    partitioner
+    (
+      const std::vector<double> &costs,
+      const std::vector<dependency> &dependencies,
+      size_t number_of_groups,
+      double tolerance = 0.25
+    ) :
+      m_costs (costs),
+      m_dependencies (dependencies),
+      m_number_of_groups (number_of_groups),
+      m_tolerance (tolerance),
+      m_plan (partition (costs, dependencies, number_of_groups))
+    {
+
+    }
+
+    bool drifted
+    (
+      const std::vector<double> &measured_costs
+    ) const
+    {
+      if (measured_costs.size () != m_costs.size ()) THROW("Number of measured costs does not match the number of units");
+
+      for (size_t group = 0; group < m_plan.m_groups.size (); ++group)
+      {
+        double measured = 0;
+        for (size_t unit : m_plan.m_groups[group]) measured += measured_costs[unit];
+
+        const double predicted = m_plan.m_predicted_loads[group];
+        if (fabs (measured - predicted) > m_tolerance * std::max (predicted, 0.05)) return true;
+      }
+
+      return false;
+    }
+
+    /*
+     * Takes per unit costs measured while running (e.g. the mean of
+     * dsp_timing_phase::process). Returns true if the plan was
+     * replaced.
+     */
+    bool update
+    (
+      const std::vector<double> &measured_costs
+    )
+    {
+      if (!drifted (measured_costs)) return false;
+
+      const double previous_max_load = m_plan.m_max_load;
+
+      m_costs = measured_costs;
+      m_plan = partition (m_costs, m_dependencies, m_number_of_groups);
+
+      INFO("Costs drifted. Re-planned: max load: " << previous_max_load << " (predicted) -> " << m_plan.m_max_load)
+      return true;
+    }
+  };
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <lv2_horst/error.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+namespace lv2_horst
+{
+  /*
+   * Control input values by port index and optionally a state image
+   * (see state_writer) to restore along with them.
+   */
+  struct preset
+  {
+    std::string m_name;
+    std::map<size_t, float> m_values;
+    std::string m_state;
+
+    preset
+    (
+      const std::string &name = "",
+      const std::map<size_t, float> &values = std::map<size_t, float> (),
+      const std::string &state = ""
+    ) :
+      m_name (name),
+      m_values (values),
+      m_state (state)
+    {
+
+    }
+  };
+
+  /*
+   * A set of presets, flattened for the process thread: preset k
+   * sets the ports m_port_indices[m_offsets[k]] up to (excluding)
+   * m_port_indices[m_offsets[k + 1]] to the corresponding m_values.
+   * Built on a control thread and handed over as a whole (see
+   * realtime_exchange), so switching presets never allocates.
+   */
+  struct preset_bank
+  {
+    std::vector<preset> m_presets;
+
+    std::vector<size_t> m_offsets;
+    std::vector<size_t> m_port_indices;
+    std::vector<float> m_values;
+
+    preset_bank
+    (
+      const std::vector<preset> &presets
+    ) :
+      m_presets (presets)
+    {
+      m_offsets.push_back (0);
+      for (size_t index = 0; index < m_presets.size (); ++index)
+      {
+        for (auto it = m_presets[index].m_values.begin (); it != m_presets[index].m_values.end (); ++it)
+        {
+          m_port_indices.push_back (it->first);
+          m_values.push_back (it->second);
+        }
+        m_offsets.push_back (m_port_indices.size ());
+      }
+    }
+
+    size_t size () const
+    {
+      return m_presets.size ();
+    }
+
+    /*
+     * Writes preset index's values through value (port_index, value).
+     */
+    template<class F>
+    inline void apply
+    (
+      size_t index,
+      F &&value
+    ) const
+    {
+      for (size_t position = m_offsets[index]; position < m_offsets[index + 1]; ++position)
+      {
+        value (m_port_indices[position], m_values[position]);
+      }
+    }
+
+    /*
+     * The index of the first preset called name
+     */
+    size_t find
+    (
+      const std::string &name
+    ) const
+    {
+      for (size_t index = 0; index < m_presets.size (); ++index)
+      {
+        if (m_presets[index].m_name == name) return index;
+      }
+      THROW("No such preset: " + name);
+    }
+  };
+
+  /*
+   * A preset switch request packed into one word for an atomic hand
+   * over: the preset index in the upper and the frame in the lower 32
+   * bits.
+   */
+  const uint64_t no_preset_request = std::numeric_limits<uint64_t>::max ();
+
+  inline uint64_t make_preset_request
+  (
+    size_t index,
+    uint32_t frame
+  )
+  {
+    return (uint64_t)index << 32 | frame;
+  }
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <lv2_horst/jacked_horst.h>
+#include <lv2_horst/connection.h>
+#include <lv2_horst/ogfx_setup.h>
+
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <cstdio>
+
+namespace lv2_horst
+{
+  /*
+   * Runs f (index) for all indices in [0, count) on up to threads
+   * threads (0: one per core). Rethrows the first failure after all
+   * threads are done.
+   */
+  template<class F>
+  void parallel_for
+  (
+    size_t count,
+    size_t threads,
+    F &&f
+  )
+  {
+    if (threads == 0) threads = std::max<size_t> (1, std::thread::hardware_concurrency ());
+    threads = std::min (threads, count);
+
+    std::atomic<size_t> next (0);
+    std::vector<std::string> errors (count);
+
+    auto work = [&] ()
+    {
+      for (size_t index = next++; index < count; index = next++)
+      {
+        try
+        {
+          f (index);
+        }
+        catch (const std::exception &e)
+        {
+          errors[index] = e.what ();
+          if (errors[index].empty ()) errors[index] = "Unknown error";
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t thread = 1; thread < threads; ++thread) pool.emplace_back (work);
+    work ();
+    for (std::thread &t : pool) t.join ();
+
+    for (const std::string &error : errors) if (!error.empty ()) THROW(error);
+  }
+
+  typedef std::function<audio_backend_ptr ()> audio_backend_factory;
+
+  /*
+   * Seconds spent in each phase of loading a rig
+   */
+  struct rig_timing
+  {
+    double m_parse;
+    double m_instantiate;
+    double m_configure;
+    double m_activate;
+    double m_connect;
+
+    double total () const
+    {
+      return m_parse + m_instantiate + m_configure + m_activate + m_connect;
+    }
+  };
+
+  /*
+   * The units of all enabled racks, by rack, and the connections made
+   * between them.
+   */
+  struct rig
+  {
+    std::vector<std::vector<jacked_horst_ptr>> m_units;
+    std::vector<std::pair<std::string, std::string>> m_connections;
+    size_t m_failed_connections;
+    rig_timing m_timing;
+  };
+
+  typedef std::shared_ptr<rig> rig_ptr;
+
+  /*
+   * Builds a rig from a setup:
+   *
+   * 1. Instantiates all units of enabled racks concurrently, as
+   *    inactive clients. Disabled units are bypassed (see
+   *    jacked_horst::set_enabled ()) but still wired up, so they can
+   *    be turned on later.
+   * 2. Applies values and MIDI bindings (the latter in one update per
+   *    unit).
+   * 3. Activates all clients concurrently.
+   * 4. Makes all connections in one batch: rack inputs to the first
+   *    unit, unit to unit (if autoconnect is set), the last unit to
+   *    the rack outputs, per unit extra connections and the MIDI
+   *    inputs to every unit.
+   *
+   * Client names are the unit names, made unique in file order like
+   * JACK would (name, name-01, ...). Without a backend factory all
+   * units and the connection manager use JACK.
+   */
+  inline rig_ptr load_rig
+  (
+    lilv_plugins_ptr plugins,
+    const ogfx_setup &setup,
+    size_t threads = 0,
+    audio_backend_factory backend_factory = audio_backend_factory ()
+  )
+  {
+    typedef std::chrono::steady_clock clock;
+    auto seconds_since = [] (clock::time_point start) { return std::chrono::duration<double> (clock::now () - start).count (); };
+
+    rig_ptr r (new rig ());
+    r->m_timing = rig_timing {};
+    r->m_failed_connections = 0;
+
+    struct slot
+    {
+      size_t m_rack;
+      size_t m_unit;
+      std::string m_client_name;
+    };
+
+    std::vector<slot> slots;
+    std::map<std::string, size_t> name_counts;
+
+    r->m_units.resize (setup.m_racks.size ());
+    for (size_t rack = 0; rack < setup.m_racks.size (); ++rack)
+    {
+      if (!setup.m_racks[rack].m_enabled) continue;
+      r->m_units[rack].resize (setup.m_racks[rack].m_units.size ());
+
+      for (size_t unit = 0; unit < setup.m_racks[rack].m_units.size (); ++unit)
+      {
+        const std::string &name = setup.m_racks[rack].m_units[unit].m_name;
+        const size_t count = name_counts[name]++;
+
+        char suffix[8] = "";
+        if (count > 0) snprintf (suffix, sizeof (suffix), "-%02zu", count);
+        slots.push_back (slot { rack, unit, name + suffix });
+      }
+    }
+
+    auto start = clock::now ();
+    parallel_for (slots.size (), threads, [&] (size_t index)
+    {
+      const slot &s = slots[index];
+      const ogfx_unit &unit = setup.m_racks[s.m_rack].m_units[s.m_unit];
+
+      try
+      {
+        r->m_units[s.m_rack][s.m_unit] = jacked_horst_ptr (new jacked_horst (plugins, unit.m_uri, s.m_client_name, false, 0, backend_factory ? backend_factory () : audio_backend_ptr (), false));
+      }
+      catch (const std::exception &e)
+      {
+        THROW("rack " + std::to_string (s.m_rack) + " unit " + std::to_string (s.m_unit) + " (" + unit.m_uri + "): " + e.what ());
+      }
+    });
+    r->m_timing.m_instantiate = seconds_since (start);
+
+    start = clock::now ();
+    for (const slot &s : slots)
+    {
+      const ogfx_unit &unit = setup.m_racks[s.m_rack].m_units[s.m_unit];
+      jacked_horst &h = *r->m_units[s.m_rack][s.m_unit];
+      const std::vector<port_properties> &properties = h.m_horst->m_port_properties;
+
+      std::map<std::string, size_t> control_inputs;
+      for (size_t index = 0; index < properties.size (); ++index)
+      {
+        if (properties[index].m_is_control && properties[index].m_is_input) control_inputs[properties[index].m_symbol] = index;
+      }
+
+      std::vector<std::vector<midi_binding>> bindings = h.m_midi_bindings;
+      bool bound = false;
+
+      for (const ogfx_control &control : unit.m_controls)
+      {
+        auto it = control_inputs.find (control.m_symbol);
+        if (it == control_inputs.end ())
+        {
+          INFO("No control input \"" << control.m_symbol << "\" on " << unit.m_uri)
+          continue;
+        }
+
+        h.set_control_port_value (it->second, control.m_value);
+
+        if (control.m_cc_enabled)
+        {
+          bindings[it->second].push_back (ogfx_midi_binding (control, properties[it->second].m_minimum_value, properties[it->second].m_maximum_value));
+          bound = true;
+        }
+      }
+
+      if (bound) h.set_all_midi_bindings (bindings);
+
+      h.set_enabled (unit.m_enabled);
+    }
+    r->m_timing.m_configure = seconds_since (start);
+
+    start = clock::now ();
+    parallel_for (slots.size (), threads, [&] (size_t index)
+    {
+      r->m_units[slots[index].m_rack][slots[index].m_unit]->activate ();
+    });
+    r->m_timing.m_activate = seconds_since (start);
+
+    start = clock::now ();
+    std::vector<std::pair<std::string, std::string>> &connections = r->m_connections;
+
+    auto audio_ports = [] (jacked_horst &h, bool inputs)
+    {
+      std::vector<std::string> names;
+      const std::vector<size_t> &indices = inputs ? h.m_jack_input_port_indices : h.m_jack_output_port_indices;
+      for (size_t index : indices)
+      {
+        const port_properties &p = h.m_horst->m_port_properties[index];
+        if (p.m_is_audio && !p.m_is_side_chain) names.push_back (h.get_jack_client_name () + ":" + p.m_symbol);
+      }
+      return names;
+    };
+
+    auto connect_sources = [&] (const std::vector<std::vector<std::string>> &sources, const std::vector<std::string> &sinks)
+    {
+      for (size_t channel = 0; channel < std::min (sources.size (), sinks.size ()); ++channel)
+      {
+        for (const std::string &source : sources[channel]) connections.push_back ({ source, sinks[channel] });
+      }
+    };
+
+    auto connect_sinks = [&] (const std::vector<std::string> &sources, const std::vector<std::vector<std::string>> &sinks)
+    {
+      for (size_t channel = 0; channel < std::min (sources.size (), sinks.size ()); ++channel)
+      {
+        for (const std::string &sink : sinks[channel]) connections.push_back ({ sources[channel], sink });
+      }
+    };
+
+    for (size_t rack = 0; rack < setup.m_racks.size (); ++rack)
+    {
+      const ogfx_rack &ogfx = setup.m_racks[rack];
+      const std::vector<jacked_horst_ptr> &units = r->m_units[rack];
+      if (units.empty ()) continue;
+
+      connect_sources (ogfx.m_input_connections, audio_ports (*units.front (), true));
+      connect_sinks (audio_ports (*units.back (), false), ogfx.m_output_connections);
+
+      for (size_t unit = 0; unit < units.size (); ++unit)
+      {
+        connect_sources (ogfx.m_units[unit].m_input_connections, audio_ports (*units[unit], true));
+        connect_sinks (audio_ports (*units[unit], false), ogfx.m_units[unit].m_output_connections);
+
+        for (const std::string &source : setup.m_input_midi_connections) connections.push_back ({ source, units[unit]->get_jack_client_name () + ":midi-in" });
+
+        if (!ogfx.m_autoconnect || unit + 1 == units.size ()) continue;
+
+        const std::vector<std::string> outputs = audio_ports (*units[unit], false);
+        const std::vector<std::string> inputs = audio_ports (*units[unit + 1], true);
+        for (size_t channel = 0; channel < std::min (outputs.size (), inputs.size ()); ++channel) connections.push_back ({ outputs[channel], inputs[channel] });
+      }
+    }
+
+    if (!connections.empty ())
+    {
+      connection_manager manager (backend_factory ? backend_factory () : audio_backend_ptr (new jack_backend), "lv2_horst_rack_loader");
+      const connection_diff d = manager.apply (connections);
+      for (const auto &connection : d.m_failed)
+      {
+        INFO("Failed to connect: \"" << connection.first << "\" -> \"" << connection.second << "\"")
+      }
+      r->m_failed_connections = d.m_failed.size ();
+    }
+    r->m_timing.m_connect = seconds_since (start);
+
+    return r;
+  }
+
+  /*
+   * Parses an ogfx setup file and loads it (see load_rig ()).
+   */
+  inline rig_ptr load_ogfx_rig
+  (
+    lilv_plugins_ptr plugins,
+    const std::string &path,
+    size_t threads = 0,
+    audio_backend_factory backend_factory = audio_backend_factory ()
+  )
+  {
+    const auto start = std::chrono::steady_clock::now ();
+    const ogfx_setup setup = parse_ogfx_setup (parse_json_file (path));
+    const double parse_seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+    rig_ptr r = load_rig (plugins, setup, threads, backend_factory);
+    r->m_timing.m_parse = parse_seconds;
+    return r;
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <lv2_horst/ringbuffer.h>
+
+#include <atomic>
+
+namespace lv2_horst
+{
+  #define HORST_DEFAULT_REALTIME_EXCHANGE_QUEUE_SIZE 16
+
+  /*
+   * Hands complete objects from a control thread to the process
+   * thread, RCU style.
+   *
+   * The control thread builds a new object and publish ()es it. The
+   * process thread calls receive () once per cycle which swaps in the
+   * pending object and hands the replaced one back. The control
+   * thread deletes those on its next publish () (or collect_garbage ()).
+   * The process thread thus never allocates or frees.
+   *
+   * Objects are complete snapshots, so only the newest one matters:
+   * publishing again before the process thread received the last one
+   * replaces it. Publishing never fails, however often it happens
+   * between cycles (or while the process thread does not run at all).
+   *
+   * NOTE: Only one control thread and one process thread may use a
+   * single instance.
+   */
+  template<class T>
+  struct realtime_exchange
+  {
+    /*
+     * Only ever touched by the process thread (after construction).
+     */
+    T *m_current;
+
+    /*
+     * The object waiting for the process thread, no_update () if none
+     */
+    std::atomic<T*> m_pending;
+
+    ringbuffer<T*> m_garbage;
+
+    /*
+     * Only its address is used
+     */
+    char m_no_update;
+
+    realtime_exchange
+    (
+      size_t queue_size = HORST_DEFAULT_REALTIME_EXCHANGE_QUEUE_SIZE
+    ) :
+      m_current (0),
+      m_pending (no_update ()),
+      m_garbage (queue_size + 2)
+    {
+
+    }
+
+    inline T *no_update ()
+    {
+      return (T*)&m_no_update;
+    }
+
+    void collect_garbage ()
+    {
+      while (m_garbage.read_available () > 0)
+      {
+        delete m_garbage.read ();
+      }
+    }
+
+    /*
+     * Takes ownership of t. 0 clears the current object.
+     */
+    void publish
+    (
+      T *t
+    )
+    {
+      collect_garbage ();
+
+      // Never seen by the process thread, so it is ours to delete
+      T *replaced = m_pending.exchange (t, std::memory_order_acq_rel);
+      if (replaced != no_update ()) delete replaced;
+    }
+
+    /*
+     * Returns true if the current object was replaced.
+     */
+    inline bool receive ()
+    {
+      if (m_pending.load (std::memory_order_relaxed) == no_update () || m_garbage.write_available () == 0) return false;
+
+      T *t = m_pending.exchange (no_update (), std::memory_order_acq_rel);
+      if (t == no_update ()) return false;
+
+      if (m_current) m_garbage.write (m_current);
+      m_current = t;
+      return true;
+    }
+
+    /*
+     * NOTE: Only safe when the process thread is not running anymore.
+     */
+    ~realtime_exchange ()
+    {
+      collect_garbage ();
+      T *pending = m_pending.load ();
+      if (pending != no_update ()) delete pending;
+      delete m_current;
+    }
+  };
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+
+namespace lv2_horst
+{
+  /*
+   * Runs a plugin in blocks of a fixed size independent of the size
+   * of the chunks the host hands in.
+   *
+   * Input chunks are accumulated in per port FIFOs. Whenever a full
+   * block is available the plugin is run on it. Output chunks are
+   * taken from the previous block's output, so the added latency is
+   * exactly one block.
+   *
+   * The plugin's audio/cv ports are permanently connected to the
+   * internal buffers (see connect ()).
+   */
+  struct reblocker
+  {
+    const size_t m_block_size;
+
+    /*
+     * The number of frames accumulated for the next block.
+     */
+    size_t m_fill;
+
+    const std::vector<size_t> m_input_port_indices;
+    const std::vector<size_t> m_output_port_indices;
+
+    std::vector<std::vector<float>> m_input_buffers;
+    std::vector<std::vector<float>> m_output_buffers;
+
+    reblocker
+    (
+      size_t block_size,
+      const std::vector<size_t> &input_port_indices,
+      const std::vector<size_t> &output_port_indices
+    ) :
+      m_block_size (block_size),
+      m_fill (0),
+      m_input_port_indices (input_port_indices),
+      m_output_port_indices (output_port_indices),
+      m_input_buffers (input_port_indices.size (), std::vector<float> (block_size, 0)),
+      m_output_buffers (output_port_indices.size (), std::vector<float> (block_size, 0))
+    {
+      if (block_size == 0) THROW("Block size must be larger than zero");
+    }
+
+    template<class Plugin>
+    void connect
+    (
+      Plugin &h
+    )
+    {
+      for (size_t index = 0; index < m_input_port_indices.size (); ++index)
+      {
+        h.connect_port (m_input_port_indices[index], &m_input_buffers[index][0]);
+      }
+
+      for (size_t index = 0; index < m_output_port_indices.size (); ++index)
+      {
+        h.connect_port (m_output_port_indices[index], &m_output_buffers[index][0]);
+      }
+    }
+
+    /*
+     * The added latency in frames.
+     */
+    size_t latency () const
+    {
+      return m_block_size;
+    }
+
+    /*
+     * Feeds frames [offset, offset + nframes) of the host buffers
+     * (indexed by port index) through the plugin. Returns the number
+     * of times the plugin was run.
+     *
+     * h needs run (size_t) and chunk (offset, position, nframes)
+     * members, which keeps this testable without a plugin. chunk ()
+     * is called for every piece of a host buffer before it is copied:
+     * host frame offset goes to position in the block being filled,
+     * and gets output from position in the previous block.
+     */
+    template<class Plugin>
+    inline size_t process
+    (
+      Plugin &h,
+      float * const *port_buffers,
+      size_t offset,
+      size_t nframes
+    )
+    {
+      size_t runs = 0;
+      while (nframes > 0)
+      {
+        const size_t n = std::min (nframes, m_block_size - m_fill);
+
+        h.chunk (offset, m_fill, n);
+
+        for (size_t index = 0; index < m_input_port_indices.size (); ++index)
+        {
+          memcpy (&m_input_buffers[index][m_fill], port_buffers[m_input_port_indices[index]] + offset, n * sizeof (float));
+        }
+
+        for (size_t index = 0; index < m_output_port_indices.size (); ++index)
+        {
+          memcpy (port_buffers[m_output_port_indices[index]] + offset, &m_output_buffers[index][m_fill], n * sizeof (float));
+        }
+
+        m_fill += n;
+        offset += n;
+        nframes -= n;
+
+        if (m_fill == m_block_size)
+        {
+          h.run (m_block_size);
+          ++runs;
+          m_fill = 0;
+        }
+      }
+      return runs;
+    }
+  };
+
+  typedef std::shared_ptr<reblocker> reblocker_ptr;
+}
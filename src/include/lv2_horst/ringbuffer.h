@@ -62,26 +62,33 @@ namespace lv2_horst
 
     inline void write (const T &m)
     {
-      m_head = m_head % m_buffer.size ();
+      const size_t head = m_head % m_buffer.size ();
+      m_head = head;
 
       if (write_available () == 0)
       {
         THROW("No space left for writing")
       }
 
-      m_buffer[m_head++] = m;
+      // Only publish the new head after the item is in place
+      m_buffer[head] = m;
+      m_head = head + 1;
     }
 
     inline const T read ()
     {
-      m_tail = m_tail % m_buffer.size ();
+      const size_t tail = m_tail % m_buffer.size ();
+      m_tail = tail;
 
       if (read_available () == 0)
       {
         THROW("No space left for reading")
       }
 
-      return m_buffer[m_tail++];
+      // Copy the item out before handing the slot back to the writer
+      const T m = m_buffer[tail];
+      m_tail = tail + 1;
+      return m;
     }
   };
 }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace lv2_horst
+{
+  /*
+   * Sequence lock for data with a single (realtime) writer and any
+   * number of readers. The writer never waits. Readers retry if the
+   * writer was active while they copied the data.
+   *
+   * The protected data must be made of relaxed atomics, so concurrent
+   * access is well defined.
+   *
+   * Writer:
+   *
+   *   lock.write_begin ();
+   *   ... store values ...
+   *   lock.write_end ();
+   *
+   * Reader:
+   *
+   *   uint64_t sequence;
+   *   do
+   *   {
+   *     sequence = lock.read_begin ();
+   *     ... load values ...
+   *   } while (lock.read_retry (sequence));
+   */
+  struct seqlock
+  {
+    /*
+     * Odd while the writer is active
+     */
+    std::atomic<uint64_t> m_sequence;
+
+    seqlock () :
+      m_sequence (0)
+    {
+
+    }
+
+    inline void write_begin ()
+    {
+      m_sequence.store (m_sequence.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence (std::memory_order_release);
+    }
+
+    inline void write_end ()
+    {
+      m_sequence.store (m_sequence.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    inline uint64_t read_begin () const
+    {
+      uint64_t sequence;
+      while ((sequence = m_sequence.load (std::memory_order_acquire)) & 1) { }
+      return sequence;
+    }
+
+    inline bool read_retry
+    (
+      uint64_t sequence
+    ) const
+    {
+      std::atomic_thread_fence (std::memory_order_acquire);
+      return m_sequence.load (std::memory_order_relaxed) != sequence;
+    }
+  };
+}
@@ -0,0 +1,527 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+
+#include <lv2/state/state.h>
+#include <lv2/urid/urid.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <functional>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace lv2_horst
+{
+  #define HORST_STATE_MAGIC 0x68737474
+  #define HORST_STATE_VERSION 1
+  #define HORST_STATE_ALIGNMENT 8
+
+  /*
+   * A state image is laid out like this (native byte order, so a
+   * mismatch shows as a bad magic):
+   *
+   *   state_file_header
+   *   state_file_uri[m_number_of_uris]
+   *   state_file_property[m_number_of_properties]
+   *   data: the URIs (0 terminated) and the property values, each
+   *     starting at a multiple of HORST_STATE_ALIGNMENT
+   *
+   * Keys and types are indices into the URI table, since URIDs are
+   * only valid within one process. Offsets are relative to the start
+   * of the image. An image is used in place, so restoring is mapping
+   * the file, checking the bounds and mapping the URIs.
+   */
+  struct state_file_header
+  {
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint64_t m_size;
+    uint32_t m_number_of_uris;
+    uint32_t m_number_of_properties;
+  };
+
+  struct state_file_uri
+  {
+    uint64_t m_offset;
+    uint64_t m_length;
+  };
+
+  struct state_file_property
+  {
+    uint32_t m_key;
+    uint32_t m_type;
+    uint32_t m_flags;
+    uint32_t m_padding;
+    uint64_t m_offset;
+    uint64_t m_size;
+  };
+
+  inline size_t state_align
+  (
+    size_t size
+  )
+  {
+    return (size + HORST_STATE_ALIGNMENT - 1) & ~(size_t)(HORST_STATE_ALIGNMENT - 1);
+  }
+
+  /*
+   * The LV2_State_Handle during save (). Collects the stored
+   * properties and turns them into an image.
+   */
+  struct state_writer
+  {
+    std::function<std::string (LV2_URID)> m_unmap;
+
+    std::vector<LV2_URID> m_urids;
+    std::vector<state_file_property> m_properties;
+    std::vector<uint8_t> m_values;
+
+    state_writer
+    (
+      std::function<std::string (LV2_URID)> unmap
+    ) :
+      m_unmap (unmap)
+    {
+
+    }
+
+    uint32_t uri_index
+    (
+      LV2_URID urid
+    )
+    {
+      for (size_t index = 0; index < m_urids.size (); ++index)
+      {
+        if (m_urids[index] == urid) return (uint32_t)index;
+      }
+
+      m_urids.push_back (urid);
+      return (uint32_t)(m_urids.size () - 1);
+    }
+
+    /*
+     * Storing a key again replaces its value.
+     */
+    LV2_State_Status store
+    (
+      uint32_t key,
+      const void *value,
+      size_t size,
+      uint32_t type,
+      uint32_t flags
+    )
+    {
+      DBG("key: " << key << " size: " << size << " type: " << type << " flags: " << flags)
+      if (key == 0 || type == 0) return LV2_STATE_ERR_UNKNOWN;
+
+      state_file_property p { uri_index (key), uri_index (type), flags, 0, m_values.size (), size };
+
+      m_values.resize (state_align (m_values.size () + size), 0);
+      if (size != 0) memcpy (&m_values[p.m_offset], value, size);
+
+      for (state_file_property &existing : m_properties)
+      {
+        if (existing.m_key == p.m_key)
+        {
+          existing = p;
+          return LV2_STATE_SUCCESS;
+        }
+      }
+
+      m_properties.push_back (p);
+      return LV2_STATE_SUCCESS;
+    }
+
+    std::vector<uint8_t> image () const
+    {
+      std::vector<std::string> uris;
+      for (LV2_URID urid : m_urids) uris.push_back (m_unmap (urid));
+
+      const size_t uris_offset = sizeof (state_file_header);
+      const size_t properties_offset = uris_offset + uris.size () * sizeof (state_file_uri);
+      size_t data_offset = state_align (properties_offset + m_properties.size () * sizeof (state_file_property));
+
+      std::vector<state_file_uri> uri_entries;
+      for (const std::string &uri : uris)
+      {
+        uri_entries.push_back (state_file_uri { data_offset, uri.size () });
+        data_offset = state_align (data_offset + uri.size () + 1);
+      }
+
+      const size_t values_offset = data_offset;
+      const size_t size = values_offset + m_values.size ();
+
+      std::vector<uint8_t> image (size, 0);
+
+      const state_file_header header { HORST_STATE_MAGIC, HORST_STATE_VERSION, size, (uint32_t)uris.size (), (uint32_t)m_properties.size () };
+      memcpy (&image[0], &header, sizeof (header));
+
+      for (size_t index = 0; index < uris.size (); ++index)
+      {
+        memcpy (&image[uris_offset + index * sizeof (state_file_uri)], &uri_entries[index], sizeof (state_file_uri));
+        memcpy (&image[uri_entries[index].m_offset], uris[index].c_str (), uris[index].size () + 1);
+      }
+
+      for (size_t index = 0; index < m_properties.size (); ++index)
+      {
+        state_file_property p = m_properties[index];
+        p.m_offset += values_offset;
+        memcpy (&image[properties_offset + index * sizeof (state_file_property)], &p, sizeof (p));
+      }
+
+      if (!m_values.empty ()) memcpy (&image[values_offset], &m_values[0], m_values.size ());
+
+      return image;
+    }
+
+    /*
+     * Writes the image to a temporary file which is then renamed to
+     * path, so path is never left half written.
+     */
+    void write
+    (
+      const std::string &path
+    ) const
+    {
+      const std::vector<uint8_t> data = image ();
+      const std::string temporary_path = path + ".tmp";
+
+      FILE *f = fopen (temporary_path.c_str (), "wb");
+      if (f == 0) THROW("Failed to open state file for writing: " + temporary_path);
+
+      const bool written = fwrite (&data[0], 1, data.size (), f) == data.size ();
+      if (fclose (f) != 0 || !written)
+      {
+        unlink (temporary_path.c_str ());
+        THROW("Failed to write state file: " + temporary_path);
+      }
+
+      if (rename (temporary_path.c_str (), path.c_str ()) != 0) THROW("Failed to rename state file to: " + path);
+    }
+  };
+
+  /*
+   * The LV2_State_Handle during restore (). Either maps a state file
+   * or wraps an image in memory. retrieve () hands out pointers into
+   * the image, which stay valid for the lifetime of this object.
+   */
+  struct state_image
+  {
+    void *m_mapping;
+    size_t m_mapping_size;
+
+    // Only used for images in memory that are not aligned
+    std::vector<uint64_t> m_copy;
+
+    const uint8_t *m_data;
+    size_t m_size;
+
+    const state_file_header *m_header;
+    const state_file_uri *m_uris;
+    const state_file_property *m_properties;
+
+    // URI table index -> URID in this process
+    std::vector<LV2_URID> m_urids;
+
+    state_image
+    (
+      const std::string &path
+    ) :
+      m_mapping (0),
+      m_mapping_size (0)
+    {
+      const int fd = open (path.c_str (), O_RDONLY);
+      if (fd < 0) THROW("Failed to open state file: " + path);
+
+      struct stat s;
+      if (fstat (fd, &s) != 0 || s.st_size < (off_t)sizeof (state_file_header))
+      {
+        close (fd);
+        THROW("Not a state file: " + path);
+      }
+
+      m_mapping_size = s.st_size;
+      m_mapping = mmap (0, m_mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close (fd);
+
+      if (m_mapping == MAP_FAILED) THROW("Failed to map state file: " + path);
+
+      m_data = (const uint8_t*)m_mapping;
+      m_size = m_mapping_size;
+
+      try
+      {
+        validate ();
+      }
+      catch (...)
+      {
+        munmap (m_mapping, m_mapping_size);
+        throw;
+      }
+    }
+
+    state_image
+    (
+      const void *data,
+      size_t size
+    ) :
+      m_mapping (0),
+      m_mapping_size (0),
+      m_data ((const uint8_t*)data),
+      m_size (size)
+    {
+      if ((uintptr_t)data % HORST_STATE_ALIGNMENT != 0)
+      {
+        m_copy.resize ((size + sizeof (uint64_t) - 1) / sizeof (uint64_t));
+        memcpy (&m_copy[0], data, size);
+        m_data = (const uint8_t*)&m_copy[0];
+      }
+
+      validate ();
+    }
+
+    ~state_image ()
+    {
+      if (m_mapping) munmap (m_mapping, m_mapping_size);
+    }
+
+    state_image (const state_image&) = delete;
+    state_image &operator= (const state_image&) = delete;
+
+    /*
+     * Checks everything retrieve () relies on, so a truncated or
+     * foreign file can not make it read out of bounds.
+     */
+    void validate ()
+    {
+      if (m_size < sizeof (state_file_header)) THROW("State image too small");
+
+      m_header = (const state_file_header*)m_data;
+      if (m_header->m_magic != HORST_STATE_MAGIC) THROW("Not a state image (or wrong byte order)");
+      if (m_header->m_version != HORST_STATE_VERSION) THROW("Unsupported state image version: " + std::to_string (m_header->m_version));
+      if (m_header->m_size != m_size) THROW("State image size mismatch");
+
+      const uint64_t uris_end = sizeof (state_file_header) + (uint64_t)m_header->m_number_of_uris * sizeof (state_file_uri);
+      const uint64_t properties_end = uris_end + (uint64_t)m_header->m_number_of_properties * sizeof (state_file_property);
+      if (properties_end > m_size) THROW("State image truncated");
+
+      m_uris = (const state_file_uri*)(m_data + sizeof (state_file_header));
+      m_properties = (const state_file_property*)(m_data + uris_end);
+
+      for (uint32_t index = 0; index < m_header->m_number_of_uris; ++index)
+      {
+        const state_file_uri &u = m_uris[index];
+        if (u.m_offset > m_size || u.m_length >= m_size - u.m_offset || m_data[u.m_offset + u.m_length] != 0) THROW("Bad URI in state image");
+      }
+
+      for (uint32_t index = 0; index < m_header->m_number_of_properties; ++index)
+      {
+        const state_file_property &p = m_properties[index];
+        if (p.m_key >= m_header->m_number_of_uris || p.m_type >= m_header->m_number_of_uris) THROW("Bad URI index in state image");
+        if (p.m_offset > m_size || p.m_size > m_size - p.m_offset) THROW("Bad property in state image");
+      }
+    }
+
+    void map_uris
+    (
+      std::function<LV2_URID (const char*)> map
+    )
+    {
+      m_urids.resize (m_header->m_number_of_uris);
+      for (uint32_t index = 0; index < m_header->m_number_of_uris; ++index)
+      {
+        m_urids[index] = map ((const char*)(m_data + m_uris[index].m_offset));
+      }
+    }
+
+    const void *retrieve
+    (
+      uint32_t key,
+      size_t *size,
+      uint32_t *type,
+      uint32_t *flags
+    ) const
+    {
+      for (uint32_t index = 0; index < m_header->m_number_of_properties; ++index)
+      {
+        const state_file_property &p = m_properties[index];
+        if (m_urids[p.m_key] != key) continue;
+
+        *size = p.m_size;
+        *type = m_urids[p.m_type];
+        *flags = p.m_flags;
+        return m_data + p.m_offset;
+      }
+
+      DBG("no property for key: " << key)
+      return 0;
+    }
+
+    size_t number_of_properties () const
+    {
+      return m_header->m_number_of_properties;
+    }
+  };
+
+  extern "C"
+  {
+    char *state_abstract_path
+    (
+      LV2_State_Map_Path_Handle handle,
+      const char *absolute_path
+    );
+
+    char *state_absolute_path
+    (
+      LV2_State_Map_Path_Handle handle,
+      const char *abstract_path
+    );
+
+    char *state_make_path
+    (
+      LV2_State_Make_Path_Handle handle,
+      const char *path
+    );
+
+    void state_free_path
+    (
+      LV2_State_Free_Path_Handle handle,
+      char *path
+    );
+  }
+
+  /*
+   * The map-path, make-path and free-path features for one save or
+   * restore. Files the plugin creates live in m_directory, which is
+   * the state file's path with ".files" appended, and are stored as
+   * paths relative to it. Without a directory (images in memory) no
+   * path features are offered.
+   */
+  struct state_paths
+  {
+    const std::string m_directory;
+
+    LV2_State_Map_Path m_map_path;
+    LV2_State_Make_Path m_make_path;
+    LV2_State_Free_Path m_free_path;
+
+    LV2_Feature m_map_path_feature;
+    LV2_Feature m_make_path_feature;
+    LV2_Feature m_free_path_feature;
+
+    std::vector<const LV2_Feature*> m_features;
+
+    state_paths
+    (
+      const std::string &directory
+    ) :
+      m_directory (directory),
+      m_map_path { (LV2_State_Map_Path_Handle)this, state_abstract_path, state_absolute_path },
+      m_make_path { (LV2_State_Make_Path_Handle)this, state_make_path },
+      m_free_path { (LV2_State_Free_Path_Handle)this, state_free_path },
+      m_map_path_feature { LV2_STATE__mapPath, &m_map_path },
+      m_make_path_feature { LV2_STATE__makePath, &m_make_path },
+      m_free_path_feature { LV2_STATE__freePath, &m_free_path }
+    {
+      if (!m_directory.empty ())
+      {
+        m_features.push_back (&m_map_path_feature);
+        m_features.push_back (&m_make_path_feature);
+      }
+      m_features.push_back (&m_free_path_feature);
+      m_features.push_back (0);
+    }
+
+    const LV2_Feature *const *features () const
+    {
+      return &m_features[0];
+    }
+
+    std::string abstract_path
+    (
+      const std::string &absolute_path
+    ) const
+    {
+      const std::string prefix = m_directory + "/";
+      if (absolute_path.compare (0, prefix.size (), prefix) == 0) return absolute_path.substr (prefix.size ());
+      return absolute_path;
+    }
+
+    std::string absolute_path
+    (
+      const std::string &abstract_path
+    ) const
+    {
+      if (!abstract_path.empty () && abstract_path[0] == '/') return abstract_path;
+      return m_directory + "/" + abstract_path;
+    }
+
+    /*
+     * Creates the directories leading to the returned path
+     */
+    std::string make_path
+    (
+      const std::string &path
+    ) const
+    {
+      const std::string absolute = absolute_path (path);
+
+      for (size_t position = absolute.find ('/', 1); position != std::string::npos; position = absolute.find ('/', position + 1))
+      {
+        const std::string directory = absolute.substr (0, position);
+        if (mkdir (directory.c_str (), 0755) != 0 && errno != EEXIST) INFO("Failed to create directory: " << directory)
+      }
+
+      return absolute;
+    }
+  };
+
+  extern "C"
+  {
+    char *state_abstract_path
+    (
+      LV2_State_Map_Path_Handle handle,
+      const char *absolute_path
+    )
+    {
+      return strdup (((state_paths*)handle)->abstract_path (absolute_path).c_str ());
+    }
+
+    char *state_absolute_path
+    (
+      LV2_State_Map_Path_Handle handle,
+      const char *abstract_path
+    )
+    {
+      return strdup (((state_paths*)handle)->absolute_path (abstract_path).c_str ());
+    }
+
+    char *state_make_path
+    (
+      LV2_State_Make_Path_Handle handle,
+      const char *path
+    )
+    {
+      return strdup (((state_paths*)handle)->make_path (path).c_str ());
+    }
+
+    void state_free_path
+    (
+      LV2_State_Free_Path_Handle handle,
+      char *path
+    )
+    {
+      free (path);
+    }
+  }
+}
@@ -0,0 +1,407 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+#include <lv2_horst/seqlock.h>
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace lv2_horst
+{
+  #define HORST_STATS_MAGIC 0x686f7273
+  #define HORST_STATS_VERSION 2
+  #define HORST_STATS_MAX_INSTANCES 256
+  #define HORST_STATS_NAME_SIZE 64
+  #define HORST_STATS_SEGMENT_PREFIX "horst-stats-"
+  #define HORST_DEFAULT_STATS_PUBLISH_INTERVAL_MS 50
+
+  /*
+   * What is published about one instance. DSP times are fractions of
+   * the period length and negative while timing is disabled.
+   */
+  struct stats_values
+  {
+    float m_dsp_mean;
+    float m_dsp_p99;
+    float m_dsp_max;
+    uint64_t m_cycles;
+    uint64_t m_run_calls;
+    uint64_t m_xruns;
+    uint64_t m_attributed_xruns;
+    uint32_t m_work_queue_bytes;
+    uint32_t m_work_response_queue_bytes;
+    uint32_t m_log_queue_bytes;
+    uint64_t m_missed_log_messages;
+    float m_output_peak;
+    uint32_t m_enabled;
+  };
+
+  /*
+   * One instance's slot in a stats segment. The name is written before
+   * m_in_use is set and stays constant while it is. The values are
+   * protected by the seqlock.
+   */
+  struct stats_record
+  {
+    std::atomic<uint32_t> m_in_use;
+    char m_name[HORST_STATS_NAME_SIZE];
+
+    seqlock m_lock;
+
+    std::atomic<float> m_dsp_mean;
+    std::atomic<float> m_dsp_p99;
+    std::atomic<float> m_dsp_max;
+    std::atomic<uint64_t> m_cycles;
+    std::atomic<uint64_t> m_run_calls;
+    std::atomic<uint64_t> m_xruns;
+    std::atomic<uint64_t> m_attributed_xruns;
+    std::atomic<uint32_t> m_work_queue_bytes;
+    std::atomic<uint32_t> m_work_response_queue_bytes;
+    std::atomic<uint32_t> m_log_queue_bytes;
+    std::atomic<uint64_t> m_missed_log_messages;
+    std::atomic<float> m_output_peak;
+    std::atomic<uint32_t> m_enabled;
+
+    void write
+    (
+      const stats_values &v
+    )
+    {
+      m_lock.write_begin ();
+      m_dsp_mean.store (v.m_dsp_mean, std::memory_order_relaxed);
+      m_dsp_p99.store (v.m_dsp_p99, std::memory_order_relaxed);
+      m_dsp_max.store (v.m_dsp_max, std::memory_order_relaxed);
+      m_cycles.store (v.m_cycles, std::memory_order_relaxed);
+      m_run_calls.store (v.m_run_calls, std::memory_order_relaxed);
+      m_xruns.store (v.m_xruns, std::memory_order_relaxed);
+      m_attributed_xruns.store (v.m_attributed_xruns, std::memory_order_relaxed);
+      m_work_queue_bytes.store (v.m_work_queue_bytes, std::memory_order_relaxed);
+      m_work_response_queue_bytes.store (v.m_work_response_queue_bytes, std::memory_order_relaxed);
+      m_log_queue_bytes.store (v.m_log_queue_bytes, std::memory_order_relaxed);
+      m_missed_log_messages.store (v.m_missed_log_messages, std::memory_order_relaxed);
+      m_output_peak.store (v.m_output_peak, std::memory_order_relaxed);
+      m_enabled.store (v.m_enabled, std::memory_order_relaxed);
+      m_lock.write_end ();
+    }
+
+    stats_values read () const
+    {
+      stats_values v;
+
+      uint64_t sequence;
+      do
+      {
+        sequence = m_lock.read_begin ();
+        v.m_dsp_mean = m_dsp_mean.load (std::memory_order_relaxed);
+        v.m_dsp_p99 = m_dsp_p99.load (std::memory_order_relaxed);
+        v.m_dsp_max = m_dsp_max.load (std::memory_order_relaxed);
+        v.m_cycles = m_cycles.load (std::memory_order_relaxed);
+        v.m_run_calls = m_run_calls.load (std::memory_order_relaxed);
+        v.m_xruns = m_xruns.load (std::memory_order_relaxed);
+        v.m_attributed_xruns = m_attributed_xruns.load (std::memory_order_relaxed);
+        v.m_work_queue_bytes = m_work_queue_bytes.load (std::memory_order_relaxed);
+        v.m_work_response_queue_bytes = m_work_response_queue_bytes.load (std::memory_order_relaxed);
+        v.m_log_queue_bytes = m_log_queue_bytes.load (std::memory_order_relaxed);
+        v.m_missed_log_messages = m_missed_log_messages.load (std::memory_order_relaxed);
+        v.m_output_peak = m_output_peak.load (std::memory_order_relaxed);
+        v.m_enabled = m_enabled.load (std::memory_order_relaxed);
+      } while (m_lock.read_retry (sequence));
+
+      return v;
+    }
+  };
+
+  /*
+   * The layout of a stats segment. Every process hosting instances
+   * creates one named HORST_STATS_SEGMENT_PREFIX<pid> in /dev/shm.
+   * Only lock free atomics live in it, so other processes can read it
+   * without any coordination.
+   */
+  struct stats_segment
+  {
+    uint32_t m_magic;
+    uint32_t m_version;
+    int32_t m_pid;
+    uint32_t m_capacity;
+
+    /*
+     * Bumped on every publication, so readers can tell dead segments
+     * (of processes that crashed) from idle ones.
+     */
+    std::atomic<uint64_t> m_heartbeat;
+
+    stats_record m_records[HORST_STATS_MAX_INSTANCES];
+  };
+
+  inline std::string stats_segment_name
+  (
+    int pid
+  )
+  {
+    return std::string ("/") + HORST_STATS_SEGMENT_PREFIX + std::to_string (pid);
+  }
+
+  /*
+   * Owns this process' stats segment and a thread that fills it
+   * periodically. Instances register a function filling in their
+   * values. That function runs on the publisher thread, so it must
+   * only read what is safe to read outside the process thread.
+   *
+   * The thread is started with the first registration, the segment
+   * with the first one while publishing is enabled. Once the last
+   * instance unregisters the thread is joined and the segment
+   * removed. Failing to create the segment (e.g. without a usable
+   * /dev/shm) only means stats are not published.
+   */
+  struct stats_publisher
+  {
+    typedef std::function<void (stats_values &)> collector;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition_variable;
+
+    std::map<size_t, collector> m_collectors;
+    std::map<size_t, std::string> m_names;
+
+    stats_segment *m_segment;
+    std::atomic<bool> m_atomic_enabled;
+    std::atomic<uint32_t> m_atomic_interval_ms;
+
+    /*
+     * A thread runs until m_generation moves past the one it was
+     * started with, so a new one can start while the last is joined.
+     */
+    std::thread m_thread;
+    uint64_t m_generation;
+
+    stats_publisher () :
+      m_segment (0),
+      m_atomic_enabled (true),
+      m_atomic_interval_ms (HORST_DEFAULT_STATS_PUBLISH_INTERVAL_MS),
+      m_generation (0)
+    {
+
+    }
+
+    ~stats_publisher ()
+    {
+      std::unique_lock<std::mutex> lock (m_mutex);
+      stop_thread (lock);
+      remove_segment ();
+    }
+
+    /*
+     * Never destroyed, so instances destroyed during static
+     * destruction can still unregister. Segments of processes that
+     * exit with instances left are removed by their readers (see
+     * horst-top).
+     */
+    static stats_publisher &instance ()
+    {
+      static stats_publisher *publisher = new stats_publisher;
+      return *publisher;
+    }
+
+    void set_enabled
+    (
+      bool enabled
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_atomic_enabled = enabled;
+
+      if (!enabled || m_segment != 0 || m_collectors.empty ()) return;
+      if (!create_segment ()) return;
+
+      for (auto &c : m_collectors) claim_record (c.first);
+    }
+
+    void set_interval
+    (
+      uint32_t milliseconds
+    )
+    {
+      m_atomic_interval_ms = std::max<uint32_t> (1, milliseconds);
+    }
+
+    /*
+     * Returns a slot number to pass to unregister_instance (). If all
+     * slots are taken or the segment can not be created the instance
+     * is not published and HORST_STATS_MAX_INSTANCES is returned.
+     * Never throws.
+     */
+    size_t register_instance
+    (
+      const std::string &name,
+      collector c
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+
+      if (m_atomic_enabled && m_segment == 0 && !create_segment ())
+      {
+        INFO("Not publishing stats for: " << name)
+        return HORST_STATS_MAX_INSTANCES;
+      }
+
+      for (size_t slot = 0; slot < HORST_STATS_MAX_INSTANCES; ++slot)
+      {
+        if (m_collectors.count (slot)) continue;
+
+        m_collectors[slot] = c;
+        m_names[slot] = name;
+        if (m_segment != 0) claim_record (slot);
+
+        if (!m_thread.joinable ()) m_thread = std::thread (&stats_publisher::run, this, m_generation);
+        return slot;
+      }
+
+      INFO("All stats slots taken. Not publishing stats for: " << name)
+      return HORST_STATS_MAX_INSTANCES;
+    }
+
+    /*
+     * Called with m_mutex held
+     */
+    void claim_record
+    (
+      size_t slot
+    )
+    {
+      stats_record &r = m_segment->m_records[slot];
+      memset (r.m_name, 0, HORST_STATS_NAME_SIZE);
+      strncpy (r.m_name, m_names[slot].c_str (), HORST_STATS_NAME_SIZE - 1);
+      r.write (stats_values {-1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1});
+      r.m_in_use.store (1, std::memory_order_release);
+    }
+
+    void unregister_instance
+    (
+      size_t slot
+    )
+    {
+      std::unique_lock<std::mutex> lock (m_mutex);
+      if (slot >= HORST_STATS_MAX_INSTANCES) return;
+
+      m_collectors.erase (slot);
+      m_names.erase (slot);
+      if (m_segment != 0) m_segment->m_records[slot].m_in_use.store (0, std::memory_order_release);
+
+      if (!m_collectors.empty ()) return;
+
+      stop_thread (lock);
+
+      // Unless someone registered while the lock was released
+      if (m_collectors.empty ()) remove_segment ();
+    }
+
+    /*
+     * lock holds m_mutex. It is released while joining.
+     */
+    void stop_thread
+    (
+      std::unique_lock<std::mutex> &lock
+    )
+    {
+      if (m_thread.joinable ())
+      {
+        ++m_generation;
+        m_condition_variable.notify_all ();
+
+        std::thread thread (std::move (m_thread));
+        lock.unlock ();
+        thread.join ();
+        lock.lock ();
+      }
+    }
+
+    void remove_segment ()
+    {
+      if (m_segment == 0) return;
+
+      munmap (m_segment, sizeof (stats_segment));
+      m_segment = 0;
+      shm_unlink (stats_segment_name (getpid ()).c_str ());
+    }
+
+    /*
+     * False (and logged) on failure
+     */
+    bool create_segment ()
+    {
+      const std::string name = stats_segment_name (getpid ());
+
+      const int fd = shm_open (name.c_str (), O_CREAT | O_RDWR | O_TRUNC, 0644);
+      if (fd < 0)
+      {
+        INFO("Failed to create stats segment: " << name << ": " << strerror (errno))
+        return false;
+      }
+
+      if (ftruncate (fd, sizeof (stats_segment)) != 0)
+      {
+        INFO("Failed to size stats segment: " << name << ": " << strerror (errno))
+        close (fd);
+        shm_unlink (name.c_str ());
+        return false;
+      }
+
+      void *address = mmap (0, sizeof (stats_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close (fd);
+      if (address == MAP_FAILED)
+      {
+        INFO("Failed to map stats segment: " << name << ": " << strerror (errno))
+        shm_unlink (name.c_str ());
+        return false;
+      }
+
+      // The memory is zeroed by ftruncate, which is a valid state for
+      // all the atomics
+      m_segment = (stats_segment*)address;
+      m_segment->m_pid = getpid ();
+      m_segment->m_capacity = HORST_STATS_MAX_INSTANCES;
+      m_segment->m_version = HORST_STATS_VERSION;
+      std::atomic_thread_fence (std::memory_order_release);
+      m_segment->m_magic = HORST_STATS_MAGIC;
+      return true;
+    }
+
+    void run
+    (
+      uint64_t generation
+    )
+    {
+      std::unique_lock<std::mutex> lock (m_mutex);
+      while (generation == m_generation)
+      {
+        if (m_atomic_enabled && m_segment != 0)
+        {
+          for (auto &c : m_collectors)
+          {
+            stats_values v = m_segment->m_records[c.first].read ();
+            c.second (v);
+            m_segment->m_records[c.first].write (v);
+          }
+          m_segment->m_heartbeat.fetch_add (1, std::memory_order_release);
+        }
+
+        m_condition_variable.wait_for (lock, std::chrono::milliseconds (m_atomic_interval_ms.load ()), [this, generation] () { return generation != m_generation; });
+      }
+    }
+  };
+}
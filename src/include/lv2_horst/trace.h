@@ -0,0 +1,363 @@
+#pragma once
+
+#include <lv2_horst/dbg.h>
+#include <lv2_horst/error.h>
+#include <lv2_horst/dsp_timing.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+
+namespace lv2_horst
+{
+  #define HORST_DEFAULT_TRACE_BUFFER_SIZE (1024 * 64)
+
+  /*
+   * Chrome trace event phases
+   */
+  enum class trace_phase : uint8_t
+  {
+    begin = 'B',
+    end = 'E',
+    instant = 'i'
+  };
+
+  /*
+   * The events of a single thread. The owning thread overwrites the
+   * oldest events once the buffer is full (flight recorder). Fields are
+   * relaxed atomics so a reader can copy the buffer at any time and
+   * discard whatever was overwritten while it did.
+   */
+  struct trace_buffer
+  {
+    struct event
+    {
+      std::atomic<uint64_t> m_ticks;
+      std::atomic<const char*> m_name;
+      // argument << 8 | phase
+      std::atomic<uint64_t> m_data;
+    };
+
+    const std::string m_thread_name;
+    const uint32_t m_thread_id;
+
+    std::vector<event> m_events;
+    std::atomic<uint64_t> m_head;
+
+    trace_buffer
+    (
+      const std::string &thread_name,
+      uint32_t thread_id,
+      size_t capacity
+    ) :
+      m_thread_name (thread_name),
+      m_thread_id (thread_id),
+      m_events (capacity),
+      m_head (0)
+    {
+
+    }
+
+    inline void record
+    (
+      trace_phase phase,
+      const char *name,
+      uint32_t argument
+    )
+    {
+      const uint64_t head = m_head.load (std::memory_order_relaxed);
+      event &e = m_events[head % m_events.size ()];
+      e.m_ticks.store (cycle_counter (), std::memory_order_relaxed);
+      e.m_name.store (name, std::memory_order_relaxed);
+      e.m_data.store (((uint64_t)argument << 8) | (uint8_t)phase, std::memory_order_relaxed);
+      m_head.store (head + 1, std::memory_order_release);
+    }
+  };
+
+  typedef std::shared_ptr<trace_buffer> trace_buffer_ptr;
+
+  /*
+   * The buffer of the calling thread, if it was registered.
+   */
+  inline thread_local trace_buffer *t_trace_buffer = 0;
+
+  /*
+   * Frees the buffer of a registered thread when it exits.
+   */
+  struct trace_thread_guard
+  {
+    ~trace_thread_guard ();
+  };
+
+  /*
+   * The process wide trace recorder. Threads that want to be traced
+   * register once, outside of any realtime critical section (e.g. in
+   * a JACK thread init callback), and get a buffer of their own. After
+   * that recording an event never locks or allocates. The buffer is
+   * freed, along with its events, when the thread exits.
+   *
+   * Names passed to the trace functions must stay valid until the last
+   * dump, so dynamic ones go through intern ().
+   */
+  struct trace_recorder
+  {
+    std::atomic<bool> m_atomic_enabled;
+
+    std::mutex m_mutex;
+    std::vector<trace_buffer_ptr> m_buffers;
+    uint32_t m_thread_ids;
+    std::deque<std::string> m_names;
+
+    std::string m_xrun_dump_path;
+    size_t m_xrun_dumps;
+    uint64_t m_last_xrun_dump_ticks;
+
+    trace_recorder () :
+      m_atomic_enabled (false),
+      m_thread_ids (0),
+      m_xrun_dumps (0),
+      m_last_xrun_dump_ticks (0)
+    {
+
+    }
+
+    /*
+     * Never destroyed, so threads still tracing while the process
+     * exits do not touch a destroyed recorder.
+     */
+    static trace_recorder &instance ()
+    {
+      static trace_recorder *recorder = new trace_recorder;
+      return *recorder;
+    }
+
+    inline bool enabled () const
+    {
+      return m_atomic_enabled.load (std::memory_order_relaxed);
+    }
+
+    void set_enabled
+    (
+      bool enabled
+    )
+    {
+      // Make sure the tick rate is known before anyone records
+      cycle_counter_ticks_per_second ();
+      m_atomic_enabled = enabled;
+    }
+
+    /*
+     * Gives the calling thread a buffer. Does nothing if it has one
+     * already or if tracing is disabled, so threads started before
+     * tracing was enabled are not traced.
+     */
+    void register_thread
+    (
+      const std::string &thread_name,
+      size_t capacity = HORST_DEFAULT_TRACE_BUFFER_SIZE
+    )
+    {
+      if (t_trace_buffer || !enabled ()) return;
+
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_buffers.push_back (trace_buffer_ptr (new trace_buffer (thread_name, ++m_thread_ids, capacity)));
+      t_trace_buffer = m_buffers.back ().get ();
+
+      thread_local trace_thread_guard guard;
+    }
+
+    /*
+     * Called on exit of a registered thread
+     */
+    void unregister_thread ()
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_buffers.erase
+      (
+        std::remove_if (m_buffers.begin (), m_buffers.end (), [] (const trace_buffer_ptr &b) { return b.get () == t_trace_buffer; }),
+        m_buffers.end ()
+      );
+      t_trace_buffer = 0;
+    }
+
+    const char *intern
+    (
+      const std::string &name
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      for (const std::string &n : m_names)
+      {
+        if (n == name) return n.c_str ();
+      }
+      m_names.push_back (name);
+      return m_names.back ().c_str ();
+    }
+
+    static std::string json_escape
+    (
+      const std::string &s
+    )
+    {
+      std::string escaped;
+      for (const char c : s)
+      {
+        if (c == '"' || c == '\\')
+        {
+          escaped += '\\';
+          escaped += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+          const char *hex = "0123456789abcdef";
+          escaped += "\\u00";
+          escaped += hex[(unsigned char)c >> 4];
+          escaped += hex[c & 0xf];
+        }
+        else
+        {
+          escaped += c;
+        }
+      }
+      return escaped;
+    }
+
+    /*
+     * Writes all events recorded in the last seconds seconds (or all
+     * still available if seconds is 0) as a Chrome trace JSON file.
+     * Perfetto's UI opens those as well.
+     */
+    void dump
+    (
+      const std::string &path,
+      double seconds = 0
+    )
+    {
+      const double ticks_per_second = cycle_counter_ticks_per_second ();
+      const uint64_t now = cycle_counter ();
+      const uint64_t oldest = (seconds > 0 && now > seconds * ticks_per_second) ? now - (uint64_t)(seconds * ticks_per_second) : 0;
+
+      std::ofstream file (path);
+      if (!file.good ()) THROW("Failed to open trace file: " + path);
+
+      const int pid = getpid ();
+      bool first = true;
+
+      file << "{\"traceEvents\":[\n";
+
+      std::lock_guard<std::mutex> lock (m_mutex);
+      for (const trace_buffer_ptr &b : m_buffers)
+      {
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << b->m_thread_id << ",\"args\":{\"name\":\"" << json_escape (b->m_thread_name) << "\"}}";
+        first = false;
+
+        const uint64_t head = b->m_head.load (std::memory_order_acquire);
+        const uint64_t capacity = b->m_events.size ();
+        uint64_t start = head > capacity ? head - capacity : 0;
+
+        std::vector<uint64_t> ticks;
+        std::vector<const char*> names;
+        std::vector<uint64_t> data;
+        for (uint64_t index = start; index < head; ++index)
+        {
+          const trace_buffer::event &e = b->m_events[index % capacity];
+          ticks.push_back (e.m_ticks.load (std::memory_order_relaxed));
+          names.push_back (e.m_name.load (std::memory_order_relaxed));
+          data.push_back (e.m_data.load (std::memory_order_relaxed));
+        }
+
+        // Events the owner overwrote while we were copying are garbage
+        const uint64_t head_after = b->m_head.load (std::memory_order_acquire);
+        const uint64_t skip = (head_after > capacity && head_after - capacity > start) ? head_after - capacity - start : 0;
+
+        for (size_t index = std::min<size_t> (skip, ticks.size ()); index < ticks.size (); ++index)
+        {
+          if (ticks[index] < oldest || names[index] == 0) continue;
+
+          const char phase = (char)(data[index] & 0xff);
+          const double microseconds = 1e6 * ticks[index] / ticks_per_second;
+
+          file << ",\n{\"name\":\"" << json_escape (names[index]) << "\",\"ph\":\"" << phase << "\",\"ts\":" << std::fixed << microseconds << ",\"pid\":" << pid << ",\"tid\":" << b->m_thread_id;
+          if (phase == (char)trace_phase::instant) file << ",\"s\":\"t\"";
+          file << ",\"args\":{\"value\":" << (data[index] >> 8) << "}}";
+        }
+      }
+
+      file << "\n]}\n";
+    }
+
+    /*
+     * Dumps the last few seconds to a numbered file next to path
+     * whenever an xrun is reported (see dump_on_xrun ()). An empty
+     * path turns this off.
+     */
+    void set_xrun_dump_path
+    (
+      const std::string &path
+    )
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_xrun_dump_path = path;
+    }
+
+    /*
+     * Called from JACK's xrun callback, i.e. not from a realtime
+     * thread. Every client reports the same xrun, so dumps are at
+     * least a second apart.
+     */
+    void dump_on_xrun
+    (
+      double seconds = 2
+    )
+    {
+      std::string path;
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        if (m_xrun_dump_path.empty () || !enabled ()) return;
+
+        const uint64_t now = cycle_counter ();
+        if (m_last_xrun_dump_ticks != 0 && now - m_last_xrun_dump_ticks < cycle_counter_ticks_per_second ()) return;
+
+        m_last_xrun_dump_ticks = now;
+        path = m_xrun_dump_path + "." + std::to_string (m_xrun_dumps++) + ".json";
+      }
+
+      INFO("xrun. Writing trace: " << path)
+      dump (path, seconds);
+    }
+  };
+
+  inline trace_thread_guard::~trace_thread_guard ()
+  {
+    trace_recorder::instance ().unregister_thread ();
+  }
+
+  /*
+   * Whether trace () on this thread records anything
+   */
+  inline bool tracing ()
+  {
+    return t_trace_buffer && trace_recorder::instance ().enabled ();
+  }
+
+  inline void trace
+  (
+    trace_phase phase,
+    const char *name,
+    uint32_t argument = 0
+  )
+  {
+    if (tracing ()) t_trace_buffer->record (phase, name, argument);
+  }
+
+  inline void trace_begin (const char *name, uint32_t argument = 0) { trace (trace_phase::begin, name, argument); }
+  inline void trace_end (const char *name, uint32_t argument = 0) { trace (trace_phase::end, name, argument); }
+  inline void trace_instant (const char *name, uint32_t argument = 0) { trace (trace_phase::instant, name, argument); }
+}
@@ -1,11 +1,39 @@
 #include <jack/jack.h>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <unistd.h>
 
+/*
+ * Prints JACK's DSP load and the number of xruns seen so far, one line
+ * per interval.
+ *
+ * Usage: jack-cpu-load [interval in ms]
+ */
+
+static std::atomic<unsigned long> xruns (0);
+
+extern "C" {
+  int xrun (void *arg) {
+    ++xruns;
+    return 0;
+  }
+}
+
 int main(int argc, char *argv[]) {
+  const int interval_ms = argc > 1 ? atoi (argv[1]) : 1000;
+
   jack_client_t *client = jack_client_open ("cpu", JackNullOption, 0);
+  if (client == 0) {
+    std::cerr << "Failed to open jack client\n";
+    return 1;
+  }
+
+  jack_set_xrun_callback (client, xrun, 0);
+  jack_activate (client);
+
   while (true) {
-    std::cout << jack_cpu_load (client) << "\n";
-    usleep (1000000);
+    std::cout << jack_cpu_load (client) << " " << xruns << std::endl;
+    usleep (interval_ms * 1000);
   }
 }
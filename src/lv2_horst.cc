@@ -1,10 +1,24 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 #include <lv2_horst/jacked_horst.h>
 #include <lv2_horst/connection.h>
+#include <lv2_horst/aj_snapshot.h>
+#include <lv2_horst/dummy_backend.h>
+#include <lv2_horst/cost_model.h>
+#include <lv2_horst/partition.h>
+#include <lv2_horst/rack_loader.h>
 
 namespace bp = pybind11;
 
+/*
+ * For calls that may block (scanning, instantiation, talking to the
+ * server, file I/O, state save/restore): other Python threads keep
+ * running meanwhile. The C++ side must then be safe to call
+ * concurrently with anything else bound here (see README.md).
+ */
+typedef bp::call_guard<bp::gil_scoped_release> release_gil;
+
 PYBIND11_MODULE(lv2_horst, m)
 {
   m.attr("INPUT") = (int)JackPortIsInput;
@@ -13,19 +27,47 @@ PYBIND11_MODULE(lv2_horst, m)
   m.attr("TERMINAL") = (int)JackPortIsTerminal;
   m.attr("MONITORABLE") = (int)JackPortCanMonitor;
 
+  m.def ("set_trace_enabled", [] (bool enabled) { lv2_horst::trace_recorder::instance ().set_enabled (enabled); });
+  m.def ("dump_trace", [] (const std::string &path, double seconds) { lv2_horst::trace_recorder::instance ().dump (path, seconds); }, bp::arg("path"), bp::arg("seconds") = 0);
+  m.def ("set_trace_xrun_dump_path", [] (const std::string &path) { lv2_horst::trace_recorder::instance ().set_xrun_dump_path (path); }, bp::arg("path"));
+  m.def ("set_stats_publishing_enabled", [] (bool enabled) { lv2_horst::stats_publisher::instance ().set_enabled (enabled); });
+  m.def ("set_stats_publishing_interval", [] (uint32_t milliseconds) { lv2_horst::stats_publisher::instance ().set_interval (milliseconds); }, bp::arg("milliseconds"));
+  m.def ("set_overload_management_enabled", [] (bool enabled) { lv2_horst::overload_manager::instance ().set_enabled (enabled); });
+  m.def ("set_overload_policy", [] (const lv2_horst::overload_policy &policy) { lv2_horst::overload_manager::instance ().set_policy (policy); }, bp::arg("policy"));
+  m.def ("get_overload_log", [] () { return lv2_horst::overload_manager::instance ().get_log (); });
+  m.def ("measure_cost", &lv2_horst::measure_cost, release_gil (), bp::arg("horst"), bp::arg("sample_rate"), bp::arg("block_length"), bp::arg("periods") = 1000, bp::arg("warmup") = 100, bp::arg("signal") = lv2_horst::dummy_signal::noise);
+  m.def ("partition", &lv2_horst::partition, bp::arg("costs"), bp::arg("dependencies"), bp::arg("number_of_groups"));
+  m.def ("parse_aj_snapshot", &lv2_horst::parse_aj_snapshot, bp::arg("text"));
+  m.def ("load_aj_snapshot", &lv2_horst::load_aj_snapshot, release_gil (), bp::arg("path"));
+  m.def
+  (
+    "load_ogfx_rig",
+    [] (lv2_horst::lilv_plugins_ptr plugins, const std::string &path, size_t threads, lv2_horst::dummy_driver_ptr driver)
+    {
+      // Every unit needs its own backend (client)
+      lv2_horst::audio_backend_factory factory;
+      if (driver) factory = [driver] () { return lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver)); };
+      return lv2_horst::load_ogfx_rig (plugins, path, threads, factory);
+    },
+    release_gil (),
+    bp::arg("plugins"), bp::arg("path"), bp::arg("threads") = 0, bp::arg("driver") = bp::none ()
+  );
+
   bp::class_<lv2_horst::lilv_plugins, lv2_horst::lilv_plugins_ptr> (m, "plugins")
-    .def (bp::init<>())
+    .def (bp::init<>(), release_gil ())
     .def_readonly("uris", &lv2_horst::lilv_plugins::m_uris)
   ;
 
   bp::class_<lv2_horst::horst, lv2_horst::horst_ptr> (m, "horst")
-    .def (bp::init<lv2_horst::lilv_plugins_ptr, const std::string&> ())
-    .def ("instantiate", &lv2_horst::horst::instantiate)
+    .def (bp::init<lv2_horst::lilv_plugins_ptr, const std::string&> (), release_gil ())
+    .def ("instantiate", &lv2_horst::horst::instantiate, release_gil ())
     .def ("run", &lv2_horst::horst::run)
     .def ("urid_map", &lv2_horst::horst::urid_map)
     .def ("urid_unmap", &lv2_horst::horst::urid_unmap)
-    .def ("save_state", &lv2_horst::horst::save_state)
-    .def ("restore_state", &lv2_horst::horst::restore_state)
+    .def ("save_state", &lv2_horst::horst::save_state, release_gil ())
+    .def ("restore_state", &lv2_horst::horst::restore_state, release_gil ())
+    .def ("save_state_to_bytes", [] (lv2_horst::horst &h) { std::vector<uint8_t> image; { bp::gil_scoped_release release; image = h.save_state_to_memory (); } return bp::bytes ((const char*)image.data (), image.size ()); })
+    .def ("restore_state_from_bytes", [] (lv2_horst::horst &h, const bp::bytes &b) { const std::string image = b; bp::gil_scoped_release release; h.restore_state_from_memory (image.data (), image.size ()); }, bp::arg("image"))
     .def_readonly ("name", &lv2_horst::horst::m_name)
     .def_readonly ("port_properties", &lv2_horst::horst::m_port_properties)
   ;
@@ -37,6 +79,9 @@ PYBIND11_MODULE(lv2_horst, m)
     .def_readonly ("is_input", &lv2_horst::port_properties::m_is_input)
     .def_readonly ("is_output", &lv2_horst::port_properties::m_is_output)
     .def_readonly ("is_side_chain", &lv2_horst::port_properties::m_is_side_chain)
+    .def_readonly ("is_atom", &lv2_horst::port_properties::m_is_atom)
+    .def_readonly ("supports_midi", &lv2_horst::port_properties::m_supports_midi)
+    .def_readonly ("minimum_buffer_size", &lv2_horst::port_properties::m_minimum_buffer_size)
     .def_readonly ("minimum_value", &lv2_horst::port_properties::m_minimum_value)
     .def_readonly ("default_value", &lv2_horst::port_properties::m_default_value)
     .def_readonly ("maximum_value", &lv2_horst::port_properties::m_maximum_value)
@@ -45,33 +90,295 @@ PYBIND11_MODULE(lv2_horst, m)
     .def_readonly ("symbol", &lv2_horst::port_properties::m_symbol)
   ;
 
-  bp::class_<lv2_horst::connection_manager>(m, "connection_manager")
-    .def (bp::init<std::string>(), bp::arg("jack_client_name") = "lv2_horst_connection_manager")
-    .def ("connect", &lv2_horst::connection_manager::connect, bp::arg("the_connections"), bp::arg("throw_on_error") = false)
-    .def ("disconnect", &lv2_horst::connection_manager::disconnect)
-    .def ("get_ports", &lv2_horst::connection_manager::get_ports, bp::arg("port_name_pattern") = "", bp::arg("port_type_pattern") = "", bp::arg("flags") = 0)
+  bp::class_<lv2_horst::audio_backend, lv2_horst::audio_backend_ptr> (m, "audio_backend")
+    .def ("client_name", &lv2_horst::audio_backend::client_name)
+    .def ("sample_rate", &lv2_horst::audio_backend::sample_rate)
+    .def ("buffer_size", &lv2_horst::audio_backend::buffer_size)
+  ;
+
+  bp::class_<lv2_horst::dummy_driver, lv2_horst::dummy_driver_ptr> (m, "dummy_driver")
+    .def (bp::init<jack_nframes_t, jack_nframes_t, size_t, bool>(), bp::arg("sample_rate") = 48000, bp::arg("buffer_size") = 256, bp::arg("channels") = 2, bp::arg("loopback") = true)
+    .def ("cycle", &lv2_horst::dummy_driver::cycle, release_gil ())
+    .def ("start", &lv2_horst::dummy_driver::start, release_gil (), bp::arg("realtime") = true)
+    .def ("stop", &lv2_horst::dummy_driver::stop, release_gil ())
+    .def ("set_buffer_size", &lv2_horst::dummy_driver::set_buffer_size, release_gil (), bp::arg("buffer_size"))
+    .def ("get_frames", &lv2_horst::dummy_driver::get_frames)
+    .def ("get_xruns", &lv2_horst::dummy_driver::get_xruns)
+  ;
+
+  bp::class_<lv2_horst::dummy_backend, lv2_horst::audio_backend, std::shared_ptr<lv2_horst::dummy_backend>> (m, "dummy_backend")
+    .def (bp::init<lv2_horst::dummy_driver_ptr>(), bp::arg("driver"))
+  ;
+
+  bp::class_<lv2_horst::connection_diff>(m, "connection_diff")
+    .def_readonly ("connect", &lv2_horst::connection_diff::m_connect)
+    .def_readonly ("disconnect", &lv2_horst::connection_diff::m_disconnect)
+    .def_readonly ("failed", &lv2_horst::connection_diff::m_failed)
+  ;
+
+  bp::class_<lv2_horst::connection_manager, lv2_horst::connection_manager_ptr>(m, "connection_manager")
+    .def (bp::init<std::string>(), release_gil (), bp::arg("jack_client_name") = "lv2_horst_connection_manager")
+    .def (bp::init<lv2_horst::audio_backend_ptr, std::string>(), release_gil (), bp::arg("backend"), bp::arg("client_name") = "lv2_horst_connection_manager")
+    .def ("connect", &lv2_horst::connection_manager::connect, release_gil (), bp::arg("the_connections"), bp::arg("throw_on_error") = false)
+    .def ("disconnect", &lv2_horst::connection_manager::disconnect, release_gil ())
+    .def ("apply", &lv2_horst::connection_manager::apply, release_gil (), bp::arg("desired"), bp::arg("exclusive") = false)
+    .def ("diff", &lv2_horst::connection_manager::diff, release_gil (), bp::arg("desired"), bp::arg("exclusive") = false)
+    .def ("get_connections", &lv2_horst::connection_manager::get_connections, release_gil ())
+    .def ("refresh_graph", &lv2_horst::connection_manager::refresh_graph, release_gil ())
+    .def ("get_ports", &lv2_horst::connection_manager::get_ports, release_gil (), bp::arg("port_name_pattern") = "", bp::arg("port_type_pattern") = "", bp::arg("flags") = 0)
+  ;
+
+  bp::enum_<lv2_horst::midi_binding_mode>(m, "midi_binding_mode")
+    .value ("linear", lv2_horst::midi_binding_mode::linear)
+    .value ("logarithmic", lv2_horst::midi_binding_mode::logarithmic)
+    .value ("toggle", lv2_horst::midi_binding_mode::toggle)
   ;
 
   bp::class_<lv2_horst::midi_binding>(m, "midi_binding")
     .def (
-      bp::init<bool, int, int, float, float>(), 
-      bp::arg ("enabled") = false, bp::arg ("channel") = 0, bp::arg ("cc") = 0, bp::arg ("factor") = 1.0f, bp::arg ("offset") = 0.0f
+      bp::init<bool, int, int, float, float, int, int, lv2_horst::midi_binding_mode>(), 
+      bp::arg ("enabled") = false, bp::arg ("channel") = 0, bp::arg ("cc") = 0, bp::arg ("factor") = 1.0f, bp::arg ("offset") = 0.0f,
+      bp::arg ("cc_minimum") = 0, bp::arg ("cc_maximum") = 127, bp::arg ("mode") = lv2_horst::midi_binding_mode::linear
+    )
+    .def_readwrite ("enabled", &lv2_horst::midi_binding::m_enabled)
+    .def_readwrite ("channel", &lv2_horst::midi_binding::m_channel)
+    .def_readwrite ("cc", &lv2_horst::midi_binding::m_cc)
+    .def_readwrite ("factor", &lv2_horst::midi_binding::m_factor)
+    .def_readwrite ("offset", &lv2_horst::midi_binding::m_offset)
+    .def_readwrite ("cc_minimum", &lv2_horst::midi_binding::m_cc_minimum)
+    .def_readwrite ("cc_maximum", &lv2_horst::midi_binding::m_cc_maximum)
+    .def_readwrite ("mode", &lv2_horst::midi_binding::m_mode)
+  ;
+
+  bp::enum_<lv2_horst::automation_segment_type>(m, "automation_segment_type")
+    .value ("linear", lv2_horst::automation_segment_type::linear)
+    .value ("exponential", lv2_horst::automation_segment_type::exponential)
+    .value ("step", lv2_horst::automation_segment_type::step)
+  ;
+
+  bp::class_<lv2_horst::automation_point>(m, "automation_point")
+    .def (
+      bp::init<double, float, lv2_horst::automation_segment_type>(),
+      bp::arg ("time") = 0.0, bp::arg ("value") = 0.0f, bp::arg ("type") = lv2_horst::automation_segment_type::linear
+    )
+    .def_readwrite ("time", &lv2_horst::automation_point::m_time)
+    .def_readwrite ("value", &lv2_horst::automation_point::m_value)
+    .def_readwrite ("type", &lv2_horst::automation_point::m_type)
+  ;
+
+  bp::class_<lv2_horst::automation_curve>(m, "automation_curve")
+    .def (
+      bp::init<size_t, const std::vector<lv2_horst::automation_point>&, double, double>(),
+      bp::arg ("port_index") = 0, bp::arg ("points") = std::vector<lv2_horst::automation_point> (), bp::arg ("loop_start") = 0.0, bp::arg ("loop_end") = 0.0
+    )
+    .def_readwrite ("port_index", &lv2_horst::automation_curve::m_port_index)
+    .def_readwrite ("points", &lv2_horst::automation_curve::m_points)
+    .def_readwrite ("loop_start", &lv2_horst::automation_curve::m_loop_start)
+    .def_readwrite ("loop_end", &lv2_horst::automation_curve::m_loop_end)
+    .def ("value_at", &lv2_horst::automation_curve::value_at)
+  ;
+
+  bp::enum_<lv2_horst::split_policy>(m, "split_policy")
+    .value ("exact", lv2_horst::split_policy::exact)
+    .value ("quantized", lv2_horst::split_policy::quantized)
+    .value ("last_value", lv2_horst::split_policy::last_value)
+  ;
+
+  bp::class_<lv2_horst::run_statistics>(m, "run_statistics")
+    .def_readonly ("cycles", &lv2_horst::run_statistics::m_cycles)
+    .def_readonly ("run_calls", &lv2_horst::run_statistics::m_run_calls)
+    .def_readonly ("last_cycle_run_calls", &lv2_horst::run_statistics::m_last_cycle_run_calls)
+    .def_readonly ("max_cycle_run_calls", &lv2_horst::run_statistics::m_max_cycle_run_calls)
+  ;
+
+  bp::enum_<lv2_horst::dsp_timing_phase>(m, "dsp_timing_phase")
+    .value ("process", lv2_horst::dsp_timing_phase::process)
+    .value ("run", lv2_horst::dsp_timing_phase::run)
+    .value ("work_response", lv2_horst::dsp_timing_phase::work_response)
+    .value ("end_run", lv2_horst::dsp_timing_phase::end_run)
+  ;
+
+  bp::class_<lv2_horst::timing_summary>(m, "timing_summary")
+    .def_readonly ("count", &lv2_horst::timing_summary::m_count)
+    .def_readonly ("min", &lv2_horst::timing_summary::m_min)
+    .def_readonly ("mean", &lv2_horst::timing_summary::m_mean)
+    .def_readonly ("p99", &lv2_horst::timing_summary::m_p99)
+    .def_readonly ("max", &lv2_horst::timing_summary::m_max)
+    .def_readonly ("histogram", &lv2_horst::timing_summary::m_histogram)
+    .def_readonly ("bin_edges", &lv2_horst::timing_summary::m_bin_edges)
+  ;
+
+  bp::class_<lv2_horst::overload_policy>(m, "overload_policy")
+    .def (bp::init<bool, bool, int, double, double> (), bp::arg("reduce_splitting") = true, bp::arg("bypass_low_priority") = true, bp::arg("bypass_below_priority") = 0, bp::arg("xrun_grouping_seconds") = 0.5, bp::arg("recovery_seconds") = 10)
+    .def_readwrite ("reduce_splitting", &lv2_horst::overload_policy::m_reduce_splitting)
+    .def_readwrite ("bypass_low_priority", &lv2_horst::overload_policy::m_bypass_low_priority)
+    .def_readwrite ("bypass_below_priority", &lv2_horst::overload_policy::m_bypass_below_priority)
+    .def_readwrite ("xrun_grouping_seconds", &lv2_horst::overload_policy::m_xrun_grouping_seconds)
+    .def_readwrite ("recovery_seconds", &lv2_horst::overload_policy::m_recovery_seconds)
+  ;
+
+  bp::class_<lv2_horst::overload_action>(m, "overload_action")
+    .def_readonly ("time", &lv2_horst::overload_action::m_time)
+    .def_readonly ("description", &lv2_horst::overload_action::m_description)
+  ;
+
+  bp::enum_<lv2_horst::dummy_signal>(m, "dummy_signal")
+    .value ("silence", lv2_horst::dummy_signal::silence)
+    .value ("noise", lv2_horst::dummy_signal::noise)
+    .value ("sine", lv2_horst::dummy_signal::sine)
+  ;
+
+  bp::class_<lv2_horst::unit_cost>(m, "unit_cost")
+    .def_readonly ("block_length", &lv2_horst::unit_cost::m_block_length)
+    .def_readonly ("mean_seconds", &lv2_horst::unit_cost::m_mean_seconds)
+    .def_readonly ("max_seconds", &lv2_horst::unit_cost::m_max_seconds)
+    .def_readonly ("mean_load", &lv2_horst::unit_cost::m_mean_load)
+    .def_readonly ("max_load", &lv2_horst::unit_cost::m_max_load)
+  ;
+
+  bp::class_<lv2_horst::partition_plan>(m, "partition_plan")
+    .def_readonly ("groups", &lv2_horst::partition_plan::m_groups)
+    .def_readonly ("predicted_loads", &lv2_horst::partition_plan::m_predicted_loads)
+    .def_readonly ("max_load", &lv2_horst::partition_plan::m_max_load)
+    .def_readonly ("critical_path_load", &lv2_horst::partition_plan::m_critical_path_load)
+  ;
+
+  bp::class_<lv2_horst::partitioner>(m, "partitioner")
+    .def (bp::init<const std::vector<double>&, const std::vector<lv2_horst::dependency>&, size_t, double> (), bp::arg("costs"), bp::arg("dependencies"), bp::arg("number_of_groups"), bp::arg("tolerance") = 0.25)
+    .def ("drifted", &lv2_horst::partitioner::drifted, bp::arg("measured_costs"))
+    .def ("update", &lv2_horst::partitioner::update, bp::arg("measured_costs"))
+    .def_readonly ("plan", &lv2_horst::partitioner::m_plan)
+  ;
+
+  bp::class_<lv2_horst::control_values>(m, "control_values")
+    .def_readonly ("period", &lv2_horst::control_values::m_period)
+    .def_readonly ("port_indices", &lv2_horst::control_values::m_port_indices)
+    .def_readonly ("values", &lv2_horst::control_values::m_values)
+  ;
+
+  bp::class_<lv2_horst::meter_values>(m, "meter_values")
+    .def_readonly ("peak", &lv2_horst::meter_values::m_peak)
+    .def_readonly ("rms", &lv2_horst::meter_values::m_rms)
+    .def_readonly ("peak_hold", &lv2_horst::meter_values::m_peak_hold)
+    .def_readonly ("clip_count", &lv2_horst::meter_values::m_clip_count)
+  ;
+
+  bp::enum_<lv2_horst::history_source>(m, "history_source")
+    .value ("control_value", lv2_horst::history_source::control_value)
+    .value ("peak", lv2_horst::history_source::peak)
+    .value ("rms", lv2_horst::history_source::rms)
+  ;
+
+  bp::class_<lv2_horst::rig_timing>(m, "rig_timing")
+    .def_readonly ("parse", &lv2_horst::rig_timing::m_parse)
+    .def_readonly ("instantiate", &lv2_horst::rig_timing::m_instantiate)
+    .def_readonly ("configure", &lv2_horst::rig_timing::m_configure)
+    .def_readonly ("activate", &lv2_horst::rig_timing::m_activate)
+    .def_readonly ("connect", &lv2_horst::rig_timing::m_connect)
+    .def ("total", &lv2_horst::rig_timing::total)
+  ;
+
+  bp::class_<lv2_horst::rig, lv2_horst::rig_ptr>(m, "rig")
+    .def_readonly ("units", &lv2_horst::rig::m_units)
+    .def_readonly ("connections", &lv2_horst::rig::m_connections)
+    .def_readonly ("failed_connections", &lv2_horst::rig::m_failed_connections)
+    .def_readonly ("timing", &lv2_horst::rig::m_timing)
+  ;
+
+  bp::class_<lv2_horst::preset>(m, "preset")
+    .def
+    (
+      bp::init<const std::string&, const std::map<size_t, float>&, const std::string&>(),
+      bp::arg ("name") = "", bp::arg ("values") = std::map<size_t, float> (), bp::arg ("state") = ""
+    )
+    .def_readwrite ("name", &lv2_horst::preset::m_name)
+    .def_readwrite ("values", &lv2_horst::preset::m_values)
+    .def_property
+    (
+      "state",
+      [] (const lv2_horst::preset &p) { return bp::bytes (p.m_state); },
+      [] (lv2_horst::preset &p, const bp::bytes &b) { p.m_state = b; }
+    )
+  ;
+
+  bp::class_<lv2_horst::history_column>(m, "history_column")
+    .def (
+      bp::init<size_t, lv2_horst::history_source>(),
+      bp::arg ("port_index") = 0, bp::arg ("source") = lv2_horst::history_source::control_value
     )
+    .def_readwrite ("port_index", &lv2_horst::history_column::m_port_index)
+    .def_readwrite ("source", &lv2_horst::history_column::m_source)
   ;
 
   bp::class_<lv2_horst::jacked_horst, lv2_horst::jacked_horst_ptr> (m, "jacked_horst", bp::dynamic_attr ())
-    .def (bp::init<lv2_horst::lilv_plugins_ptr, const std::string&, const std::string&, bool>(), bp::arg("plugins"), bp::arg("uri"), bp::arg("jack_client_name") = "", bp::arg("expose_control_ports") = false)
+    .def (bp::init<lv2_horst::lilv_plugins_ptr, const std::string&, const std::string&, bool, size_t, lv2_horst::audio_backend_ptr, bool>(), release_gil (), bp::arg("plugins"), bp::arg("uri"), bp::arg("jack_client_name") = "", bp::arg("expose_control_ports") = false, bp::arg("internal_block_size") = 0, bp::arg("backend") = bp::none (), bp::arg("active") = true)
+    .def ("activate", &lv2_horst::jacked_horst::activate, release_gil ())
     .def ("get_horst", &lv2_horst::jacked_horst::get_horst)
+    .def_readonly ("expose_control_ports", &lv2_horst::jacked_horst::m_expose_control_ports)
     .def ("set_control_port_value", &lv2_horst::jacked_horst::set_control_port_value)
     .def ("get_control_port_value", &lv2_horst::jacked_horst::get_control_port_value)
+    .def ("get_control_outputs", &lv2_horst::jacked_horst::get_control_outputs)
     .def ("set_midi_binding", &lv2_horst::jacked_horst::set_midi_binding)
     .def ("get_midi_binding", &lv2_horst::jacked_horst::get_midi_binding)
+    .def ("add_midi_binding", &lv2_horst::jacked_horst::add_midi_binding)
+    .def ("set_midi_bindings", &lv2_horst::jacked_horst::set_midi_bindings)
+    .def ("set_all_midi_bindings", &lv2_horst::jacked_horst::set_all_midi_bindings)
+    .def ("get_midi_bindings", &lv2_horst::jacked_horst::get_midi_bindings)
+    .def ("clear_midi_bindings", &lv2_horst::jacked_horst::clear_midi_bindings)
     .def ("get_number_of_ports", &lv2_horst::jacked_horst::get_number_of_ports)
     .def ("set_enabled", &lv2_horst::jacked_horst::set_enabled)
     .def ("set_control_input_updates_enabled", &lv2_horst::jacked_horst::set_control_input_updates_enabled)
     .def ("set_control_output_updates_enabled", &lv2_horst::jacked_horst::set_control_output_updates_enabled)
     .def ("set_audio_input_monitoring_enabled", &lv2_horst::jacked_horst::set_audio_input_monitoring_enabled)
     .def ("set_audio_output_monitoring_enabled", &lv2_horst::jacked_horst::set_audio_output_monitoring_enabled)
+    .def ("get_meters", &lv2_horst::jacked_horst::get_meters)
+    .def ("reset_meters", &lv2_horst::jacked_horst::reset_meters)
+    .def ("set_meter_peak_hold_time", &lv2_horst::jacked_horst::set_meter_peak_hold_time, bp::arg("seconds"))
+    .def ("set_history_columns", &lv2_horst::jacked_horst::set_history_columns, bp::arg("columns"), bp::arg("capacity") = 4096)
+    .def ("get_history_columns", &lv2_horst::jacked_horst::get_history_columns)
+    .def ("set_history_enabled", &lv2_horst::jacked_horst::set_history_enabled)
+    .def ("get_history_overruns", &lv2_horst::jacked_horst::get_history_overruns)
+    .def (
+      "drain_history",
+      [] (lv2_horst::jacked_horst &h)
+      {
+        // One row per period, one column per history_column
+        const size_t rows = h.get_history_rows_available ();
+        bp::array_t<float> a (std::vector<size_t> { rows, h.get_history_columns ().size () });
+        h.read_history (a.mutable_data (), rows);
+        return a;
+      }
+    )
     .def ("get_jack_client_name", &lv2_horst::jacked_horst::get_jack_client_name)
+    .def ("get_latency", &lv2_horst::jacked_horst::get_latency)
+    .def ("set_split_policy", &lv2_horst::jacked_horst::set_split_policy)
+    .def ("get_split_policy", &lv2_horst::jacked_horst::get_split_policy)
+    .def ("set_split_quantum", &lv2_horst::jacked_horst::set_split_quantum, bp::arg("frames"))
+    .def ("set_dsp_timing_enabled", &lv2_horst::jacked_horst::set_dsp_timing_enabled)
+    .def ("get_dsp_timing", &lv2_horst::jacked_horst::get_dsp_timing)
+    .def ("reset_dsp_timing", &lv2_horst::jacked_horst::reset_dsp_timing)
+    .def ("set_priority", &lv2_horst::jacked_horst::set_priority)
+    .def ("get_priority", &lv2_horst::jacked_horst::get_priority)
+    .def ("get_attributed_xruns", &lv2_horst::jacked_horst::get_attributed_xruns)
+    .def ("is_reinstantiating", &lv2_horst::jacked_horst::is_reinstantiating)
+    .def ("get_silenced_periods", &lv2_horst::jacked_horst::get_silenced_periods)
+    .def ("save_state", &lv2_horst::jacked_horst::save_state, release_gil (), bp::arg("path"))
+    .def ("restore_state", &lv2_horst::jacked_horst::restore_state, release_gil (), bp::arg("path"))
+    .def ("save_state_to_bytes", [] (lv2_horst::jacked_horst &h) { std::vector<uint8_t> image; { bp::gil_scoped_release release; image = h.save_state_to_memory (); } return bp::bytes ((const char*)image.data (), image.size ()); })
+    .def ("restore_state_from_bytes", [] (lv2_horst::jacked_horst &h, const bp::bytes &b) { const std::string image = b; bp::gil_scoped_release release; h.restore_state_from_memory (image.data (), image.size ()); }, bp::arg("image"))
+    .def ("is_shed", &lv2_horst::jacked_horst::is_shed)
+    .def ("get_load", &lv2_horst::jacked_horst::get_load)
+    .def ("get_peak_load", &lv2_horst::jacked_horst::get_peak_load)
+    .def ("get_run_statistics", &lv2_horst::jacked_horst::get_run_statistics)
+    .def ("reset_run_statistics", &lv2_horst::jacked_horst::reset_run_statistics)
+    .def ("set_automation", &lv2_horst::jacked_horst::set_automation, bp::arg("curves"))
+    .def ("clear_automation", &lv2_horst::jacked_horst::clear_automation)
+    .def ("set_automation_enabled", &lv2_horst::jacked_horst::set_automation_enabled)
+    .def ("set_preset_bank", &lv2_horst::jacked_horst::set_preset_bank, bp::arg("presets"))
+    .def ("get_preset_bank", &lv2_horst::jacked_horst::get_preset_bank)
+    .def ("select_preset", &lv2_horst::jacked_horst::select_preset, release_gil (), bp::arg("index"), bp::arg("frame") = 0)
+    .def ("select_preset_by_name", &lv2_horst::jacked_horst::select_preset_by_name, release_gil (), bp::arg("name"), bp::arg("frame") = 0)
+    .def ("get_current_preset", &lv2_horst::jacked_horst::get_current_preset)
+    .def ("set_automation_control_period", &lv2_horst::jacked_horst::set_automation_control_period, bp::arg("frames"))
   ;
 }
@@ -3,6 +3,7 @@
 import lv2_horst as h
 
 import weakref
+import threading
 import subprocess
 import re
 from collections import namedtuple
@@ -98,8 +99,8 @@ class dict_with_attributes:
     return len(self.__d)
 
 class horst(with_ports):
-  def __init__(self, uri, jack_client_name = "", expose_control_ports = False):
-    self.h = h.jacked_horst(lv2_plugins, uri, jack_client_name, expose_control_ports)
+  def __init__(self, uri, jack_client_name = "", expose_control_ports = False, internal_block_size = 0):
+    self.h = h.jacked_horst(lv2_plugins, uri, jack_client_name, expose_control_ports, internal_block_size)
     self.jack_client_name = self.h.get_jack_client_name()
 
     self.ports = dict_with_attributes()
@@ -132,13 +133,55 @@ class horst(with_ports):
   def __dir__(self):
     return list(self.__dict__.keys()) + dir(self.h)
 
-  def bind_midi(self, port_index, channel, cc, factor = 1.0, offset = 0.0):
-    b = horst.midi_binding(True, channel, cc, factor, offset)
-    self.h.set_midi_binding(port_index, b)
+  def bind_midi(self, port_index, channel, cc, factor = 1.0, offset = 0.0, cc_minimum = 0, cc_maximum = 127, mode = h.midi_binding_mode.linear, add = False):
+    """Binds the port to the CC, replacing its other bindings unless add
+    is set."""
+    b = h.midi_binding(True, channel, cc, factor, offset, cc_minimum, cc_maximum, mode)
+    if add:
+      self.h.add_midi_binding(port_index, b)
+    else:
+      self.h.set_midi_bindings(port_index, [b])
 
   def unbind_midi(self, port_index):
-    b = horst.midi_binding(False, 0, 0, 0, 0)
-    self.h.set_midi_binding(port_index, b)
+    self.h.set_midi_bindings(port_index, [])
+
+  def load_ogfx_presets(self, setups, rack = 0, unit = 0):
+    self.h.set_preset_bank(ogfx_presets(self.h, setups, rack, unit))
+
+def ogfx_preset(jh, name, ogfx_unit):
+  """A preset with the values of the control inputs of an ogfx unit (a
+  dict from an ogfx setup's racks[n]["units"]). Ports are matched by
+  symbol. Ports jh does not have are skipped, and so are control inputs
+  exposed as JACK ports, which presets can not set."""
+  port_properties = jh.get_horst().port_properties
+  indices = {}
+  for index in range(len(port_properties)):
+    p = port_properties[index]
+    if p.is_control and p.is_input and not jh.expose_control_ports:
+      indices[p.symbol] = index
+
+  values = {}
+  for port in ogfx_unit["input_control_ports"]:
+    if port["symbol"] in indices:
+      values[indices[port["symbol"]]] = port["value"]
+
+  return h.preset(name, values)
+
+def ogfx_presets(jh, setups, rack = 0, unit = 0):
+  """One preset per ogfx setup taken from the unit at the given rack and
+  unit index. setups is a list of file names or (name, dict) tuples."""
+  import json
+  import os
+
+  presets = []
+  for setup in setups:
+    if isinstance(setup, str):
+      with open(setup) as f:
+        setup = (os.path.splitext(os.path.basename(setup))[0], json.load(f))
+
+    presets.append(ogfx_preset(jh, setup[0], setup[1]["racks"][rack]["units"][unit]))
+
+  return presets
 
 # class lv2(unit):
 #   def __init__(self, uri, jack_client_name = "", expose_control_ports = False):
@@ -208,7 +251,24 @@ def connect(*args):
   for c in cs:
     hcs.append((c[0], c[1]))
 
-  h.connection_manager().connect(hcs)
+  connection_manager().apply(hcs)
+
+_connection_manager = None
+_connection_manager_lock = threading.Lock()
+
+# One long lived client shared by all calls (and threads), so its mirror
+# of the graph stays warm and repeated connects only touch what changed
+def connection_manager():
+  global _connection_manager
+  with _connection_manager_lock:
+    if _connection_manager is None:
+      _connection_manager = h.connection_manager()
+    return _connection_manager
+
+# Makes the graph match an aj-snapshot file. With exclusive, connections
+# between the clients in the snapshot that are not in it are removed.
+def restore_snapshot(path, exclusive = False):
+  return connection_manager().apply(h.load_aj_snapshot(path), exclusive)
 
 from itertools import chain
 
@@ -0,0 +1,84 @@
+#include <lv2_horst/jacked_horst.h>
+#include <lv2_horst/dummy_backend.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Measures the host overhead of jacked_horst::process_callback () per
+ * instance and period. By default it uses the noop-test plugin from
+ * lv2/horst-plugins.lv2 (put it on the LV2_PATH), so what is measured
+ * is (almost) all host.
+ *
+ * The instances run on a dummy_driver, so no JACK server is needed.
+ * The driver is never started and the callback is called directly,
+ * so no scheduling is part of the numbers.
+ *
+ * Usage: bench_process_callback [uri] [instances] [periods]
+ */
+int main (int argc, char *argv[])
+{
+  const std::string uri = argc > 1 ? argv[1] : "https://dfdx.eu/plugins/horst-plugins/noop-test";
+  const size_t number_of_instances = argc > 2 ? std::stoul (argv[2]) : 50;
+  const size_t periods = argc > 3 ? std::stoul (argv[3]) : 10000;
+
+  lv2_horst::lilv_plugins_ptr plugins (new lv2_horst::lilv_plugins);
+
+  lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, 256));
+
+  std::vector<lv2_horst::jacked_horst_ptr> instances;
+  for (size_t index = 0; index < number_of_instances; ++index)
+  {
+    instances.push_back (lv2_horst::jacked_horst_ptr (new lv2_horst::jacked_horst (plugins, uri, "bench", false, 0, lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver)))));
+  }
+
+  const jack_nframes_t nframes = instances[0]->m_buffer_size;
+  const double period_ns = 1e9 * nframes / instances[0]->m_sample_rate;
+
+  struct configuration
+  {
+    const char *m_name;
+    bool m_enabled;
+    bool m_monitoring;
+    bool m_control_outputs;
+  };
+
+  const std::vector<configuration> configurations =
+  {
+    { "default", true, false, false },
+    { "bypassed", false, false, false },
+    { "monitoring", true, true, false },
+    { "control outputs", true, false, true },
+    { "everything", true, true, true }
+  };
+
+  std::cout << "instances: " << number_of_instances << " nframes: " << nframes << " periods: " << periods << "\n";
+
+  for (const configuration &c : configurations)
+  {
+    for (lv2_horst::jacked_horst_ptr &h : instances)
+    {
+      h->set_enabled (c.m_enabled);
+      h->set_audio_input_monitoring_enabled (c.m_monitoring);
+      h->set_audio_output_monitoring_enabled (c.m_monitoring);
+      h->set_control_output_updates_enabled (c.m_control_outputs);
+    }
+
+    const auto start = std::chrono::steady_clock::now ();
+    for (size_t period = 0; period < periods; ++period)
+    {
+      for (lv2_horst::jacked_horst_ptr &h : instances)
+      {
+        h->process_callback (nframes);
+      }
+    }
+    const auto end = std::chrono::steady_clock::now ();
+
+    const double ns_per_instance = std::chrono::duration<double, std::nano> (end - start).count () / (periods * number_of_instances);
+    std::cout << c.m_name << ": " << ns_per_instance << " ns per instance and period (" << 100.0 * ns_per_instance / period_ns << "% of the period)\n";
+  }
+
+  return 0;
+}
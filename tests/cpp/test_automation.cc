@@ -0,0 +1,85 @@
+#include <lv2_horst/automation.h>
+
+#include <iostream>
+
+/*
+ * The curve below, worked out by hand: linear from 0 to 1, exponential
+ * from 1 towards 5, then a step holding 4 until 3, looping over [1, 3).
+ */
+float expected_value (double time)
+{
+    if (time >= 3.0) time = 1.0 + fmod (time - 1.0, 2.0);
+
+    if (time < 1.0) return time;
+    if (time < 2.0) return pow (5.0, time - 1.0);
+    return 4.0;
+}
+
+int main ()
+{
+    // Out of order on purpose. Points with the same time keep their
+    // order: the exponential segment ends at 5, the step starts at 4
+    std::vector<lv2_horst::automation_point> points = {
+        lv2_horst::automation_point (3.0, 0.0),
+        lv2_horst::automation_point (1.0, 1.0, lv2_horst::automation_segment_type::exponential),
+        lv2_horst::automation_point (0.0, 0.0),
+        lv2_horst::automation_point (2.0, 5.0),
+        lv2_horst::automation_point (2.0, 4.0, lv2_horst::automation_segment_type::step)
+    };
+
+    lv2_horst::automation_curve curve (7, points, 1.0, 3.0);
+
+    const double times[] = { 0.0, 1.0, 2.0, 2.0, 3.0 };
+    for (size_t index = 0; index < curve.m_points.size (); ++index)
+    {
+        if (curve.m_points[index].m_time != times[index])
+        {
+            std::cout << "points not sorted by time\n";
+            return 1;
+        }
+    }
+    if (curve.m_points[2].m_value != 5.0f || curve.m_points[3].m_value != 4.0f)
+    {
+        std::cout << "points with the same time reordered\n";
+        return 1;
+    }
+
+    for (double time = 0; time < 6.0; time += 0.25)
+    {
+        const float value = curve.value_at (time);
+        std::cout << time << " " << value << "\n";
+        if (fabs (value - expected_value (time)) > 1e-5)
+        {
+            std::cout << "expected: " << expected_value (time) << "\n";
+            return 1;
+        }
+    }
+
+    // Going back in time (e.g. a loop) restarts the segment search
+    if (curve.value_at (0.5) != 0.5f)
+    {
+        std::cout << "bad value after going back in time\n";
+        return 1;
+    }
+
+    // Lanes stay in the order they were given in
+    lv2_horst::automation a ({ curve, lv2_horst::automation_curve (3, { lv2_horst::automation_point (0.0, 1.0) }) });
+    if (a.m_curves.size () != 2 || a.m_curves[0].m_port_index != 7 || a.m_curves[1].m_port_index != 3)
+    {
+        std::cout << "lanes reordered\n";
+        return 1;
+    }
+
+    try
+    {
+        lv2_horst::automation empty ({ lv2_horst::automation_curve (1) });
+        std::cout << "curve without points accepted\n";
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+
+    }
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include <lv2_horst/connection.h>
+#include <lv2_horst/dummy_backend.h>
+#include <lv2_horst/aj_snapshot.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+typedef std::vector<std::pair<std::string, std::string>> connections;
+
+/*
+ * Registers the clients and ports a set of connections needs on a
+ * dummy driver: sources as outputs, destinations as inputs.
+ */
+std::vector<std::shared_ptr<lv2_horst::dummy_backend>> make_clients (lv2_horst::dummy_driver_ptr driver, const connections &cs)
+{
+    std::map<std::string, std::map<std::string, unsigned long>> ports;
+    for (const auto &c : cs)
+    {
+        for (const std::string *name : { &c.first, &c.second })
+        {
+            const size_t colon = name->find (':');
+            if (name->substr (0, colon) == "system") continue;
+            ports[name->substr (0, colon)][name->substr (colon + 1)] = name == &c.first ? JackPortIsOutput : JackPortIsInput;
+        }
+    }
+
+    std::vector<std::shared_ptr<lv2_horst::dummy_backend>> clients;
+    for (const auto &client : ports)
+    {
+        clients.push_back (std::make_shared<lv2_horst::dummy_backend> (driver));
+        clients.back ()->open (client.first);
+        for (const auto &port : client.second) clients.back ()->port_register (port.first, JACK_DEFAULT_AUDIO_TYPE, port.second);
+        clients.back ()->activate ();
+    }
+    return clients;
+}
+
+bool same (const connections &a, const connections &b)
+{
+    return std::set<std::pair<std::string, std::string>> (a.begin (), a.end ()) == std::set<std::pair<std::string, std::string>> (b.begin (), b.end ());
+}
+
+/*
+ * Applies an aj-snapshot through a connection_manager on the dummy
+ * driver and checks that the mirror follows changes made by others,
+ * re-applying is a no-op and exclusive mode removes stray
+ * connections. Then hammers the manager from several threads (like
+ * Python threads with the GIL released) while clients come and go.
+ */
+int main (int argc, char *argv[])
+{
+    const std::string path = argc > 1 ? argv[1] : "dev/test.connections";
+    const connections snapshot = lv2_horst::load_aj_snapshot (path);
+    if (snapshot.empty () || snapshot[0] != std::make_pair (std::string ("system:capture_1"), std::string ("Calf Gate:in_l")))
+    {
+        std::cout << "unexpected snapshot contents\n";
+        return 1;
+    }
+
+    const connections entities = lv2_horst::parse_aj_snapshot ("<aj-snapshot><alsa><client name=\"a\"><port id=\"0\"><connection client=\"1\" port=\"0\" /></port></client></alsa><jack><!-- <client> --><client name=\"A &amp; B\"><port name='out'><connection port=\"C&#58;in\"/></port></client></jack></aj-snapshot>");
+    if (entities != connections { { "A & B:out", "C:in" } })
+    {
+        std::cout << "bad entity or section handling\n";
+        return 1;
+    }
+
+    lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, 256, 2, false));
+    auto clients = make_clients (driver, snapshot);
+
+    lv2_horst::connection_manager manager (lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver)));
+
+    lv2_horst::connection_diff d = manager.apply (snapshot);
+    if (d.m_connect.size () != snapshot.size () || !d.m_failed.empty () || !same (manager.get_connections (), snapshot))
+    {
+        std::cout << "first apply failed\n";
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now ();
+    d = manager.apply (snapshot);
+    std::cout << "re-apply " << snapshot.size () << " connections: " << std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now () - start).count () << " us\n";
+    if (!d.m_connect.empty () || !d.m_disconnect.empty ())
+    {
+        std::cout << "re-apply was not a no-op\n";
+        return 1;
+    }
+
+    // Changes made by another client
+    lv2_horst::dummy_backend other (driver);
+    other.open ("other");
+    other.disconnect (snapshot[0].first, snapshot[0].second);
+    other.connect ("system:capture_1", "Calf Gate:in_r");
+
+    connections expected (snapshot.begin () + 1, snapshot.end ());
+    expected.push_back ({ "system:capture_1", "Calf Gate:in_r" });
+    if (!same (manager.get_connections (), expected))
+    {
+        std::cout << "mirror missed an external change\n";
+        return 1;
+    }
+
+    d = manager.diff (snapshot);
+    if (d.m_connect != connections { snapshot[0] } || !d.m_disconnect.empty ())
+    {
+        std::cout << "bad diff\n";
+        return 1;
+    }
+
+    // A client the snapshot does not name, connected to one it does
+    lv2_horst::dummy_backend unrelated (driver);
+    unrelated.open ("unrelated");
+    unrelated.port_register ("out", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
+    unrelated.activate ();
+    unrelated.connect ("unrelated:out", "system:playback_1");
+
+    d = manager.apply (snapshot, true);
+    expected = snapshot;
+    expected.push_back ({ "unrelated:out", "system:playback_1" });
+    if (d.m_connect.size () != 1 || d.m_disconnect != connections { { "system:capture_1", "Calf Gate:in_r" } } || !same (manager.get_connections (), expected))
+    {
+        std::cout << "exclusive apply failed\n";
+        return 1;
+    }
+    unrelated.close ();
+
+    // Removing a client drops its connections
+    const std::string removed = clients.front ()->client_name ();
+    clients.erase (clients.begin ());
+
+    for (const auto &c : manager.get_connections ())
+    {
+        if (c.first.find (removed + ":") == 0 || c.second.find (removed + ":") == 0)
+        {
+            std::cout << "connection of removed client " << removed << " still mirrored\n";
+            return 1;
+        }
+    }
+
+    connections actual;
+    for (const std::string &source : driver->get_ports ("", "", JackPortIsOutput))
+    {
+        for (const std::string &destination : driver->port_get_connections (source)) actual.push_back ({ source, destination });
+    }
+    if (!same (manager.get_connections (), actual))
+    {
+        std::cout << "mirror out of sync with the graph\n";
+        return 1;
+    }
+
+    // Renaming a port renames its connections
+    {
+        lv2_horst::dummy_backend c (driver);
+        c.open ("renamed");
+        jack_port_t *port = c.port_register ("out", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
+        c.activate ();
+        manager.connect ({ { "renamed:out", "Calf Gate:in_r" } });
+        if (c.port_rename (port, "out_1") != 0 || !manager.diff ({ { "renamed:out_1", "Calf Gate:in_r" } }).m_connect.empty ())
+        {
+            std::cout << "mirror missed a port rename\n";
+            return 1;
+        }
+        manager.disconnect ({ { "renamed:out_1", "Calf Gate:in_r" } });
+        if (!driver->port_get_connections ("renamed:out_1").empty ())
+        {
+            std::cout << "renamed port not disconnected\n";
+            return 1;
+        }
+    }
+
+    std::atomic<bool> failed (false);
+    std::atomic<bool> done (false);
+    std::vector<std::thread> threads;
+
+    // Full reads racing with the notifications must not lose any
+    std::thread refresher ([&] ()
+    {
+        while (!done) manager.refresh_graph ();
+    });
+
+    for (size_t thread = 0; thread < 4; ++thread)
+    {
+        threads.emplace_back ([&, thread] ()
+        {
+            const std::string name = "thread-" + std::to_string (thread);
+            for (size_t round = 0; round < 50; ++round)
+            {
+                lv2_horst::dummy_backend a (driver);
+                lv2_horst::dummy_backend b (driver);
+                for (lv2_horst::dummy_backend *c : { &a, &b })
+                {
+                    c->open (name + (c == &a ? "-a" : "-b"));
+                    c->port_register ("in", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
+                    c->port_register ("out", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
+                    c->activate ();
+                }
+
+                // Exclusive only touches connections between the clients
+                // it names, so not the other threads' ones to system
+                const connections cs { { name + "-a:out", name + "-b:in" }, { "system:capture_1", name + "-a:in" } };
+                if (!manager.apply (cs).m_failed.empty ())
+                {
+                    std::cout << "concurrent apply failed\n";
+                    failed = true;
+                }
+                if (round % 2) manager.disconnect (cs);
+                else if (manager.apply (connections { cs[0], { "system:capture_2", name + "-a:in" } }, true).m_disconnect != connections { cs[1] })
+                {
+                    std::cout << "concurrent exclusive apply did not disconnect\n";
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread &t : threads) t.join ();
+    done = true;
+    refresher.join ();
+    if (failed) return 1;
+
+    actual.clear ();
+    for (const std::string &source : driver->get_ports ("", "", JackPortIsOutput))
+    {
+        for (const std::string &destination : driver->port_get_connections (source)) actual.push_back ({ source, destination });
+    }
+    if (!same (manager.get_connections (), actual))
+    {
+        std::cout << "mirror out of sync with the graph after concurrent use\n";
+        return 1;
+    }
+
+    return 0;
+}
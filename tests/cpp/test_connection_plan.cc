@@ -0,0 +1,75 @@
+#include <lv2_horst/connection_plan.h>
+#include <iostream>
+
+/*
+ * Builds a plan, marks its ports connected the way the process
+ * callback does and checks that invalidating forces all of them to be
+ * reconnected.
+ */
+int main ()
+{
+    lv2_horst::connection_plan plan;
+
+    // Stand-ins for JACK ports, only compared
+    jack_port_t *ports[3] = { (jack_port_t*)0x10, (jack_port_t*)0x20, (jack_port_t*)0x30 };
+    plan.add (0, ports[0], true);
+    plan.add (2, ports[1], false);
+    plan.add (5, ports[2], true);
+
+    if (plan.size () != 3 || plan.m_jack_ports.size () != 3 || plan.m_is_input.size () != 3 || plan.m_connected.size () != 3)
+    {
+        std::cout << "arrays out of step\n";
+        return 1;
+    }
+
+    const size_t port_indices[3] = { 0, 2, 5 };
+    const bool is_input[3] = { true, false, true };
+    for (size_t index = 0; index < plan.size (); ++index)
+    {
+        if (plan.m_port_indices[index] != port_indices[index] || plan.m_jack_ports[index] != ports[index] || (bool)plan.m_is_input[index] != is_input[index])
+        {
+            std::cout << "bad entry: " << index << "\n";
+            return 1;
+        }
+
+        // Nothing is connected yet
+        if (plan.m_connected[index] != 0)
+        {
+            std::cout << "new entry connected: " << index << "\n";
+            return 1;
+        }
+    }
+
+    // Reconnect only what moved, like the process callback
+    std::vector<float> buffers[3] = { std::vector<float> (64), std::vector<float> (64), std::vector<float> (64) };
+    size_t reconnections = 0;
+    auto connect = [&] ()
+    {
+        for (size_t index = 0; index < plan.size (); ++index)
+        {
+            float *location = &buffers[index][0];
+            if (location == plan.m_connected[index]) continue;
+
+            plan.m_connected[index] = location;
+            ++reconnections;
+        }
+    };
+
+    connect ();
+    connect ();
+    if (reconnections != 3)
+    {
+        std::cout << "unchanged locations reconnected: " << reconnections << "\n";
+        return 1;
+    }
+
+    plan.invalidate ();
+    connect ();
+    if (reconnections != 6)
+    {
+        std::cout << "invalidate did not force reconnecting: " << reconnections << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <lv2_horst/control_snapshot.h>
+#include <iostream>
+#include <thread>
+#include <atomic>
+
+/*
+ * One thread publishes snapshots where all values equal the period,
+ * the main thread checks it never sees values from different periods.
+ */
+int main ()
+{
+    const size_t number_of_ports = 64;
+
+    std::vector<size_t> port_indices;
+    for (size_t index = 0; index < number_of_ports; index += 2) port_indices.push_back (index);
+
+    lv2_horst::control_snapshot snapshot (number_of_ports, port_indices);
+
+    std::atomic<bool> done (false);
+    std::thread writer ([&] ()
+    {
+        std::vector<float> port_values (number_of_ports);
+        for (uint64_t period = 1; period <= 2000000; ++period)
+        {
+            std::fill (port_values.begin (), port_values.end (), (float)period);
+            snapshot.publish (period, port_values.data ());
+        }
+        done = true;
+    });
+
+    size_t reads = 0;
+    while (!done)
+    {
+        const lv2_horst::control_values values = snapshot.read ();
+        for (size_t index = 0; index < values.m_values.size (); ++index)
+        {
+            if (values.m_values[index] != (float)values.m_period)
+            {
+                std::cout << "torn read in period: " << values.m_period << " port: " << values.m_port_indices[index] << " value: " << values.m_values[index] << "\n";
+                writer.join ();
+                return 1;
+            }
+        }
+
+        uint64_t period;
+        const float value = snapshot.value (values.m_port_indices.back (), period);
+        if (value != (float)period)
+        {
+            std::cout << "torn single value read in period: " << period << " value: " << value << "\n";
+            writer.join ();
+            return 1;
+        }
+        ++reads;
+    }
+
+    writer.join ();
+    std::cout << "reads: " << reads << " last period: " << snapshot.read ().m_period << "\n";
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <lv2_horst/dirty_set.h>
+#include <iostream>
+#include <set>
+
+int main ()
+{
+    lv2_horst::dirty_set dirty (200);
+
+    std::set<size_t> marked = { 0, 1, 63, 64, 127, 150, 199 };
+    for (size_t index : marked) dirty.mark (index);
+    // Marking twice is the same as once
+    dirty.mark (63);
+
+    std::set<size_t> consumed;
+    dirty.consume ([&] (size_t index) { consumed.insert (index); });
+
+    if (consumed != marked)
+    {
+        std::cout << "consumed the wrong indices\n";
+        return 1;
+    }
+
+    size_t calls = 0;
+    dirty.consume ([&] (size_t) { ++calls; });
+    if (calls != 0)
+    {
+        std::cout << "consumed indices twice\n";
+        return 1;
+    }
+
+    // A mark is consumed once m_consumed_version reaches its version
+    const uint64_t version = dirty.mark (42);
+    if (dirty.m_consumed_version >= version)
+    {
+        std::cout << "mark consumed early\n";
+        return 1;
+    }
+    dirty.consume ([&] (size_t index) { calls += index; });
+    if (dirty.m_consumed_version < version)
+    {
+        std::cout << "consumed version behind the mark\n";
+        return 1;
+    }
+    std::cout << "consumed: " << calls << "\n";
+
+    return calls == 42 ? 0 : 1;
+}
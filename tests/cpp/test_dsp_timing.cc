@@ -0,0 +1,38 @@
+#include <lv2_horst/dsp_timing.h>
+#include <iostream>
+
+int main ()
+{
+    lv2_horst::timing_histogram h;
+
+    // 990 short periods and 10 long ones
+    for (int index = 0; index < 990; ++index) h.record (0.01f);
+    for (int index = 0; index < 10; ++index) h.record (0.5f);
+
+    const lv2_horst::timing_summary s = h.summary ();
+    std::cout << "count: " << s.m_count << " min: " << s.m_min << " mean: " << s.m_mean << " p99: " << s.m_p99 << " max: " << s.m_max << "\n";
+
+    if (s.m_count != 1000 || s.m_min != 0.01f || s.m_max != 0.5f) return 1;
+
+    // The p99 falls into the bin holding 0.01
+    const size_t bin = lv2_horst::timing_histogram::bin (0.01f);
+    if (!(s.m_bin_edges[bin] <= 0.01f && 0.01f < s.m_bin_edges[bin + 1])) return 1;
+    if (s.m_p99 != s.m_bin_edges[bin + 1]) return 1;
+
+    // Out of range times end up in the outer bins
+    if (lv2_horst::timing_histogram::bin (0) != 0) return 1;
+    if (lv2_horst::timing_histogram::bin (1e-9f) != 0) return 1;
+    if (lv2_horst::timing_histogram::bin (1000.0f) != lv2_horst::timing_histogram::number_of_bins - 1) return 1;
+
+    // The mean must not drift over hours worth of periods
+    lv2_horst::timing_histogram long_running;
+    for (int index = 0; index < 20000000; ++index) long_running.record (0.01f);
+    const float mean = long_running.summary ().m_mean;
+    std::cout << "mean after 20000000 periods: " << mean << "\n";
+    if (fabsf (mean - 0.01f) > 1e-6f) return 1;
+
+    const double ticks_per_second = lv2_horst::cycle_counter_ticks_per_second ();
+    std::cout << "ticks per second: " << ticks_per_second << "\n";
+
+    return ticks_per_second > 0 ? 0 : 1;
+}
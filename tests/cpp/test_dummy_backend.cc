@@ -0,0 +1,161 @@
+#include <lv2_horst/dummy_backend.h>
+#include <iostream>
+#include <thread>
+
+/*
+ * A client with an audio and a MIDI port in each direction
+ */
+struct test_client
+{
+    lv2_horst::dummy_backend m_backend;
+    jack_port_t *m_audio_in;
+    jack_port_t *m_audio_out;
+    jack_port_t *m_midi_in;
+    jack_port_t *m_midi_out;
+
+    float m_gain;
+    float m_constant;
+    std::vector<jack_nframes_t> m_midi_times;
+
+    std::vector<jack_nframes_t> m_received_midi_times;
+    jack_nframes_t m_buffer_size;
+
+    test_client (lv2_horst::dummy_driver_ptr driver, const std::string &name, float gain, float constant) :
+        m_backend (driver),
+        m_gain (gain),
+        m_constant (constant),
+        m_buffer_size (0)
+    {
+        m_backend.open (name);
+        m_audio_in = m_backend.port_register ("in", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
+        m_audio_out = m_backend.port_register ("out", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
+        m_midi_in = m_backend.port_register ("midi-in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
+        m_midi_out = m_backend.port_register ("midi-out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+        m_backend.set_process_callback (process, this);
+        m_backend.set_buffer_size_callback (buffer_size, this);
+        m_backend.activate ();
+    }
+
+    static int process (jack_nframes_t nframes, void *arg)
+    {
+        test_client &c = *(test_client*)arg;
+
+        const float *in = (const float*)c.m_backend.port_get_buffer (c.m_audio_in, nframes);
+        float *out = (float*)c.m_backend.port_get_buffer (c.m_audio_out, nframes);
+        for (jack_nframes_t frame = 0; frame < nframes; ++frame) out[frame] = c.m_gain * in[frame] + c.m_constant;
+
+        void *midi_in = c.m_backend.port_get_buffer (c.m_midi_in, nframes);
+        c.m_received_midi_times.clear ();
+        for (uint32_t index = 0; index < c.m_backend.midi_get_event_count (midi_in); ++index)
+        {
+            jack_midi_event_t event;
+            c.m_backend.midi_event_get (&event, midi_in, index);
+            c.m_received_midi_times.push_back (event.time);
+        }
+
+        void *midi_out = c.m_backend.port_get_buffer (c.m_midi_out, nframes);
+        c.m_backend.midi_clear_buffer (midi_out);
+        const jack_midi_data_t note_on[3] = { 0x90, 60, 100 };
+        for (jack_nframes_t time : c.m_midi_times) c.m_backend.midi_event_write (midi_out, time, note_on, 3);
+
+        return 0;
+    }
+
+    static int buffer_size (jack_nframes_t nframes, void *arg)
+    {
+        ((test_client*)arg)->m_buffer_size = nframes;
+        return 0;
+    }
+};
+
+int main ()
+{
+    lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, 64, 2, true));
+
+    // Registered before its source, so running it first would be wrong
+    test_client gain (driver, "gain", 2, 0);
+    test_client source (driver, "source", 0, 1);
+    test_client second_source (driver, "source", 0, 0);
+    test_client sink (driver, "sink", 1, 0);
+
+    if (second_source.m_backend.client_name () != "source-01")
+    {
+        std::cout << "client name not made unique: " << second_source.m_backend.client_name () << "\n";
+        return 1;
+    }
+
+    source.m_midi_times = { 5, 10 };
+    second_source.m_midi_times = { 7 };
+
+    gain.m_backend.connect ("source:out", "gain:in");
+    gain.m_backend.connect ("gain:out", "system:playback_1");
+    gain.m_backend.connect ("system:capture_1", "sink:in");
+    gain.m_backend.connect ("source:midi-out", "sink:midi-in");
+    gain.m_backend.connect ("source-01:midi-out", "sink:midi-in");
+
+    if (gain.m_backend.connect ("source:out", "gain:in") != EEXIST || gain.m_backend.connect ("gain:in", "source:out") == 0)
+    {
+        std::cout << "bad connection accepted\n";
+        return 1;
+    }
+
+    driver->cycle ();
+
+    const float played = driver->m_playback_ports[0]->m_audio_buffer[0];
+    if (played != 2)
+    {
+        std::cout << "clients not run in graph order: playback_1 " << played << "\n";
+        return 1;
+    }
+
+    if (sink.m_received_midi_times != std::vector<jack_nframes_t> { 5, 7, 10 })
+    {
+        std::cout << "MIDI not merged in time order\n";
+        return 1;
+    }
+
+    driver->cycle ();
+
+    const float looped = ((float*)sink.m_backend.port_get_buffer (sink.m_audio_in, 64))[0];
+    if (looped != 2)
+    {
+        std::cout << "no loopback: sink got " << looped << "\n";
+        return 1;
+    }
+
+    const std::vector<std::string> physical_inputs = gain.m_backend.get_ports ("", "audio", JackPortIsPhysical | JackPortIsInput);
+    if (physical_inputs != std::vector<std::string> { "system:playback_1", "system:playback_2" } || gain.m_backend.get_ports ("^gain:", "", 0).size () != 4)
+    {
+        std::cout << "bad get_ports result\n";
+        return 1;
+    }
+
+    driver->set_buffer_size (128);
+    if (gain.m_buffer_size != 128 || gain.m_backend.buffer_size () != 128)
+    {
+        std::cout << "buffer size callback not called\n";
+        return 1;
+    }
+
+    driver->start (false);
+    std::this_thread::sleep_for (std::chrono::milliseconds (50));
+    driver->stop ();
+
+    std::cout << "frames: " << driver->get_frames () << " xruns: " << driver->get_xruns () << "\n";
+    if (driver->get_frames () <= 2 * 64 || driver->get_xruns () != 0)
+    {
+        std::cout << "free running driver did not run\n";
+        return 1;
+    }
+
+    source.m_backend.close ();
+    if (gain.m_backend.disconnect ("source:out", "gain:in") == 0)
+    {
+        std::cout << "connections survived closing the client\n";
+        return 1;
+    }
+
+    driver->cycle ();
+
+    return 0;
+}
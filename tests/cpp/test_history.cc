@@ -0,0 +1,30 @@
+#include <lv2_horst/history.h>
+
+#define CAPACITY 4
+
+int main ()
+{
+    lv2_horst::history h ({ lv2_horst::history_column (0), lv2_horst::history_column (1, lv2_horst::history_source::peak) }, CAPACITY);
+
+    // Write more rows than fit. The last ones are counted as overruns
+    for (size_t index = 0; index < CAPACITY + 2; ++index)
+    {
+        float *row = h.write_pointer ();
+        if (row == 0) continue;
+        row[0] = index;
+        row[1] = -(float)index;
+        h.write_advance ();
+    }
+
+    float data[2 * CAPACITY];
+    size_t rows = h.read (data, CAPACITY);
+
+    for (size_t row = 0; row < rows; ++row)
+    {
+        std::cout << data[2 * row] << " " << data[2 * row + 1] << "\n";
+    }
+
+    std::cout << "rows: " << rows << " overruns: " << h.m_overruns << "\n";
+
+    return (rows == CAPACITY && h.m_overruns == 2) ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#include <lv2_horst/meter.h>
+#include <iostream>
+#include <cstdlib>
+
+/*
+ * Compares the vectorized meter kernel against the scalar one for
+ * buffer sizes that do and do not fill whole vectors.
+ */
+int main ()
+{
+    for (size_t nframes = 0; nframes < 100; ++nframes)
+    {
+        std::vector<float> buffer (nframes);
+        for (size_t frame = 0; frame < nframes; ++frame)
+        {
+            buffer[frame] = 2.5f * (rand () / (float)RAND_MAX) - 1.25f;
+        }
+
+        const lv2_horst::meter_measurement a = lv2_horst::measure (buffer.data (), nframes);
+        const lv2_horst::meter_measurement b = lv2_horst::measure_scalar (buffer.data (), nframes);
+
+        if (a.m_peak != b.m_peak || a.m_clip_count != b.m_clip_count || fabsf (a.m_sum_of_squares - b.m_sum_of_squares) > 1e-4f * (1 + b.m_sum_of_squares))
+        {
+            std::cout << "mismatch for nframes: " << nframes << " peak: " << a.m_peak << " " << b.m_peak << " clips: " << a.m_clip_count << " " << b.m_clip_count << " sum: " << a.m_sum_of_squares << " " << b.m_sum_of_squares << "\n";
+            return 1;
+        }
+    }
+
+    // Negative peaks count as well
+    std::vector<float> negative = { 0.1f, -0.9f, 0.2f, 0.3f, 0.1f, 0.0f, 0.0f, 0.0f, 0.0f };
+    const lv2_horst::meter_measurement n = lv2_horst::measure (negative.data (), negative.size ());
+    std::cout << "peak: " << n.m_peak << "\n";
+    if (n.m_peak != 0.9f)
+    {
+        std::cout << "negative peak missed\n";
+        return 1;
+    }
+
+    // Full scale is not clipping, anything beyond it is, on either side
+    std::vector<float> clipping = { 1.0f, -1.0f, 1.001f, -1.001f, 0.5f, -2.0f, 1.0f, 0.0f, 1.5f };
+    const lv2_horst::meter_measurement c = lv2_horst::measure (clipping.data (), clipping.size ());
+    if (c.m_clip_count != 4 || lv2_horst::measure_scalar (clipping.data (), clipping.size ()).m_clip_count != 4 || c.m_peak != 2.0f)
+    {
+        std::cout << "bad clip count: " << c.m_clip_count << " peak: " << c.m_peak << "\n";
+        return 1;
+    }
+
+    return 0;
+}
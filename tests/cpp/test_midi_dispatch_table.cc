@@ -0,0 +1,88 @@
+#include <lv2_horst/midi_binding.h>
+
+#include <iostream>
+
+bool near (float a, float b)
+{
+    return fabsf (a - b) <= 1e-4f * std::max (1.0f, fabsf (b));
+}
+
+int main ()
+{
+    std::vector<std::vector<lv2_horst::midi_binding>> bindings (3);
+
+    // Two bindings on port 0, one sharing its CC with port 2
+    bindings[0].push_back (lv2_horst::midi_binding (true, 0, 7));
+    bindings[0].push_back (lv2_horst::midi_binding (true, 1, 10, 1.0f, 0.0f, 0, 127, lv2_horst::midi_binding_mode::toggle));
+    bindings[1].push_back (lv2_horst::midi_binding (false, 0, 7));
+    bindings[2].push_back (lv2_horst::midi_binding (true, 0, 7, 1.0f, 0.0f, 0, 127, lv2_horst::midi_binding_mode::logarithmic));
+
+    std::vector<float> minimums = { 0.0f, 0.0f, 20.0f };
+    std::vector<float> maximums = { 1.0f, 1.0f, 20000.0f };
+
+    lv2_horst::midi_dispatch_table table (bindings, minimums, maximums);
+
+    size_t entries = 0;
+    for (int cc = 0; cc < 128; ++cc)
+    {
+        for (int channel = 0; channel < 16; ++channel)
+        {
+            for (const lv2_horst::midi_dispatch_table::entry *e = table.begin (channel, cc); e != table.end (channel, cc); ++e)
+            {
+                std::cout << "channel: " << channel << " cc: " << cc << " port: " << e->m_port_index << " 0: " << e->m_values[0] << " 64: " << e->m_values[64] << " 127: " << e->m_values[127] << "\n";
+                ++entries;
+            }
+        }
+    }
+
+    // The disabled binding of port 1 is left out
+    if (entries != 3)
+    {
+        std::cout << "expected 3 entries, got: " << entries << "\n";
+        return 1;
+    }
+
+    // Channel 0, CC 7 drives port 0 (linear) and port 2 (logarithmic),
+    // in port order
+    const lv2_horst::midi_dispatch_table::entry *e = table.begin (0, 7);
+    if (table.end (0, 7) - e != 2 || e[0].m_port_index != 0 || e[1].m_port_index != 2)
+    {
+        std::cout << "bad bindings for channel 0, cc 7\n";
+        return 1;
+    }
+
+    if (!near (e[0].m_values[0], 0.0f) || !near (e[0].m_values[64], 64.0f / 127.0f) || !near (e[0].m_values[127], 1.0f))
+    {
+        std::cout << "bad linear values\n";
+        return 1;
+    }
+
+    if (!near (e[1].m_values[0], 20.0f) || !near (e[1].m_values[64], 20.0f * powf (1000.0f, 64.0f / 127.0f)) || !near (e[1].m_values[127], 20000.0f))
+    {
+        std::cout << "bad logarithmic values\n";
+        return 1;
+    }
+
+    // Channel 1, CC 10 toggles port 0 at half way
+    e = table.begin (1, 10);
+    if (table.end (1, 10) - e != 1 || e[0].m_port_index != 0)
+    {
+        std::cout << "bad bindings for channel 1, cc 10\n";
+        return 1;
+    }
+
+    if (e[0].m_values[0] != 0.0f || e[0].m_values[63] != 0.0f || e[0].m_values[64] != 1.0f || e[0].m_values[127] != 1.0f)
+    {
+        std::cout << "bad toggle values\n";
+        return 1;
+    }
+
+    // The same CC on another channel does nothing
+    if (table.begin (1, 7) != table.end (1, 7))
+    {
+        std::cout << "channel not honoured\n";
+        return 1;
+    }
+
+    return 0;
+}
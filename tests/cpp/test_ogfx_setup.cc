@@ -0,0 +1,79 @@
+#include <lv2_horst/ogfx_setup.h>
+#include <iostream>
+#include <chrono>
+
+/*
+ * Parses JSON edge cases and an ogfx setup file.
+ *
+ * Usage: test_ogfx_setup [path]
+ */
+int main (int argc, char *argv[])
+{
+    const std::string path = argc > 1 ? argv[1] : "dev/ogfx-setup-many-plugins.json";
+
+    const lv2_horst::json_value v = lv2_horst::parse_json (" { \"a\": [1, -2.5e3, true, null, \"x\\u00e9\\ud83c\\udfb8\\n\"], \"b\": {} } ");
+    const std::vector<lv2_horst::json_value> &a = v["a"].as_array ();
+    if (a.size () != 5 || a[0].as_number () != 1 || a[1].as_number () != -2500 || !a[2].as_bool () || !a[3].is_null () || a[4].as_string () != "x\xc3\xa9\xf0\x9f\x8e\xb8\n" || !v["b"].m_object.empty ())
+    {
+        std::cout << "bad parse\n";
+        return 1;
+    }
+
+    for (const char *invalid : { "", "[1,]", "{\"a\" 1}", "[1] 2", "\"\\ud800\"", "nan", "-inf", "[\"a\nb\"]", "tru" })
+    {
+        try
+        {
+            lv2_horst::parse_json (invalid);
+            std::cout << "accepted invalid JSON: " << invalid << "\n";
+            return 1;
+        }
+        catch (const std::exception &e)
+        {
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now ();
+    const lv2_horst::ogfx_setup setup = lv2_horst::parse_ogfx_setup (lv2_horst::parse_json_file (path));
+    std::cout << "parse: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count () << " ms\n";
+
+    if (setup.m_racks.size () != 3 || setup.m_racks[0].m_units.size () != 17 || setup.m_racks[1].m_units.size () != 6 || setup.m_racks[2].m_units.size () != 1)
+    {
+        std::cout << "wrong number of racks or units\n";
+        return 1;
+    }
+
+    if (setup.m_racks[0].m_input_connections.size () != 2 || setup.m_racks[0].m_input_connections[0] != std::vector<std::string> { "system:capture_1" } || setup.m_input_midi_connections.size () != 1)
+    {
+        std::cout << "wrong connections\n";
+        return 1;
+    }
+
+    size_t bindings = 0;
+    for (const lv2_horst::ogfx_rack &rack : setup.m_racks)
+    {
+        for (const lv2_horst::ogfx_unit &unit : rack.m_units)
+        {
+            for (const lv2_horst::ogfx_control &control : unit.m_controls)
+            {
+                if (!control.m_cc_enabled) continue;
+                ++bindings;
+
+                // The binding must hit the targets at the ends of the CC range in a made up port range
+                const lv2_horst::midi_binding b = lv2_horst::ogfx_midi_binding (control, 20, 20000);
+                if (fabsf (b.map (control.m_cc_minimum, 20, 20000) - control.m_target_minimum) > 0.01f || fabsf (b.map (control.m_cc_maximum, 20, 20000) - control.m_target_maximum) > 0.01f)
+                {
+                    std::cout << "bad binding for " << control.m_symbol << "\n";
+                    return 1;
+                }
+            }
+        }
+    }
+
+    if (bindings != 1)
+    {
+        std::cout << "expected one binding, got " << bindings << "\n";
+        return 1;
+    }
+
+    return 0;
+}
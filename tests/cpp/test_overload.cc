@@ -0,0 +1,76 @@
+#include <lv2_horst/overload.h>
+#include <iostream>
+
+int main ()
+{
+    lv2_horst::overload_manager &manager = lv2_horst::overload_manager::instance ();
+    manager.set_policy (lv2_horst::overload_policy (true, true, 0, 0.2, 0.5));
+
+    lv2_horst::overload_unit_ptr reverb (new lv2_horst::overload_unit ("reverb"));
+    lv2_horst::overload_unit_ptr chorus (new lv2_horst::overload_unit ("chorus"));
+    lv2_horst::overload_unit_ptr synth (new lv2_horst::overload_unit ("synth"));
+    reverb->m_priority = -1;
+    chorus->m_priority = -2;
+
+    int shed_changes = 0;
+    reverb->m_shed_changed = [&] () { ++shed_changes; };
+
+    manager.register_unit (reverb);
+    manager.register_unit (chorus);
+    manager.register_unit (synth);
+    manager.set_enabled (true);
+
+    if (!synth->m_tracking)
+    {
+        std::cout << "units are not tracked\n";
+        return 1;
+    }
+
+    // A spike on top of a low mean load
+    for (int period = 0; period < 100; ++period) synth->update_load (0.01f);
+    synth->update_load (0.9f);
+    if (!synth->spiked () || reverb->spiked ())
+    {
+        std::cout << "wrong spike detection\n";
+        return 1;
+    }
+
+    // Three clients reporting the same xrun
+    for (int client = 0; client < 3; ++client) manager.report_xrun ();
+    if (!synth->m_splitting_reduced || chorus->m_shed)
+    {
+        std::cout << "splitting should be reduced first, and only once\n";
+        return 1;
+    }
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (300));
+    manager.report_xrun ();
+    std::this_thread::sleep_for (std::chrono::milliseconds (300));
+    manager.report_xrun ();
+
+    if (!chorus->m_shed || !reverb->m_shed || synth->m_shed || shed_changes != 1)
+    {
+        std::cout << "should shed lowest priorities first and never priority 0\n";
+        return 1;
+    }
+
+    // Recovery undoes one step per recovery period, most recent first
+    std::this_thread::sleep_for (std::chrono::milliseconds (700));
+    if (reverb->m_shed || !chorus->m_shed)
+    {
+        std::cout << "should restore the most recently shed unit first\n";
+        return 1;
+    }
+
+    manager.unregister_unit (reverb);
+    manager.set_enabled (false);
+    if (chorus->m_shed || synth->m_splitting_reduced)
+    {
+        std::cout << "disabling should undo everything\n";
+        return 1;
+    }
+
+    for (const lv2_horst::overload_action &action : manager.get_log ()) std::cout << action.m_time << ": " << action.m_description << "\n";
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <lv2_horst/partition.h>
+#include <iostream>
+#include <random>
+
+/*
+ * Checks that every dependency points forward: to a later group or to
+ * a later position in the same group.
+ */
+bool respects_dependencies (const lv2_horst::partition_plan &plan, const std::vector<lv2_horst::dependency> &dependencies, size_t number_of_units)
+{
+    std::vector<std::pair<size_t, size_t>> positions (number_of_units);
+    size_t placed = 0;
+    for (size_t group = 0; group < plan.m_groups.size (); ++group)
+    {
+        for (size_t index = 0; index < plan.m_groups[group].size (); ++index)
+        {
+            positions[plan.m_groups[group][index]] = { group, index };
+            ++placed;
+        }
+    }
+
+    if (placed != number_of_units) return false;
+
+    for (const lv2_horst::dependency &d : dependencies)
+    {
+        if (positions[d.first] >= positions[d.second]) return false;
+    }
+
+    return true;
+}
+
+int main ()
+{
+    // Two chains of three and four independent units
+    const std::vector<double> costs = { 0.1, 0.2, 0.1, 0.1, 0.2, 0.1, 0.3, 0.1, 0.1, 0.2 };
+    const std::vector<lv2_horst::dependency> dependencies = { {0, 1}, {1, 2}, {3, 4}, {4, 5} };
+
+    lv2_horst::partition_plan plan = lv2_horst::partition (costs, dependencies, 3);
+    for (size_t group = 0; group < plan.m_groups.size (); ++group)
+    {
+        std::cout << "group " << group << ": load " << plan.m_predicted_loads[group] << ":";
+        for (size_t unit : plan.m_groups[group]) std::cout << " " << unit;
+        std::cout << "\n";
+    }
+    std::cout << "max load: " << plan.m_max_load << " critical path: " << plan.m_critical_path_load << "\n";
+
+    if (!respects_dependencies (plan, dependencies, costs.size ()) || plan.m_max_load > 0.5 + 1e-9)
+    {
+        std::cout << "bad plan\n";
+        return 1;
+    }
+
+    try
+    {
+        lv2_horst::partition ({ 0.1, 0.1 }, { {0, 1}, {1, 0} }, 2);
+        std::cout << "a cycle was accepted\n";
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "cycle rejected: " << e.what () << "\n";
+    }
+
+    std::mt19937 random (42);
+    for (int round = 0; round < 1000; ++round)
+    {
+        const size_t number_of_units = 1 + random () % 40;
+        std::vector<double> random_costs (number_of_units);
+        for (double &cost : random_costs) cost = (random () % 100) / 1000.0;
+
+        std::vector<lv2_horst::dependency> random_dependencies;
+        for (size_t edge = 0; edge < number_of_units; ++edge)
+        {
+            const size_t a = random () % number_of_units;
+            const size_t b = random () % number_of_units;
+            if (a != b) random_dependencies.push_back ({ std::min (a, b), std::max (a, b) });
+        }
+
+        const size_t number_of_groups = 1 + random () % 8;
+        lv2_horst::partition_plan p = lv2_horst::partition (random_costs, random_dependencies, number_of_groups);
+        if (!respects_dependencies (p, random_dependencies, number_of_units) || p.m_groups.size () > number_of_groups)
+        {
+            std::cout << "bad random plan in round " << round << "\n";
+            return 1;
+        }
+    }
+
+    lv2_horst::partitioner partitioner (costs, dependencies, 3);
+    if (partitioner.update (costs))
+    {
+        std::cout << "re-planned without drift\n";
+        return 1;
+    }
+
+    std::vector<double> drifted = costs;
+    drifted[6] = 0.6;
+    if (!partitioner.update (drifted) || !respects_dependencies (partitioner.m_plan, dependencies, costs.size ()))
+    {
+        std::cout << "did not re-plan after drift\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <lv2_horst/preset.h>
+#include <iostream>
+
+int main ()
+{
+    lv2_horst::preset_bank bank ({
+        lv2_horst::preset ("empty"),
+        lv2_horst::preset ("a", { { 3, 0.5f }, { 1, 0.25f } }),
+        lv2_horst::preset ("b", { { 2, 1.0f } })
+    });
+
+    std::vector<float> values (4, 0);
+    auto write = [&] (size_t port_index, float value) { values[port_index] = value; };
+
+    bank.apply (bank.find ("a"), write);
+    if (values != std::vector<float> { 0, 0.25f, 0, 0.5f })
+    {
+        std::cout << "preset a not applied\n";
+        return 1;
+    }
+
+    bank.apply (0, write);
+    bank.apply (2, write);
+    if (values != std::vector<float> { 0, 0.25f, 1.0f, 0.5f })
+    {
+        std::cout << "presets touched other ports\n";
+        return 1;
+    }
+
+    const uint64_t request = lv2_horst::make_preset_request (2, 4096);
+    if (request >> 32 != 2 || (request & 0xffffffff) != 4096 || request == lv2_horst::no_preset_request)
+    {
+        std::cout << "bad request packing\n";
+        return 1;
+    }
+
+    try
+    {
+        bank.find ("c");
+        std::cout << "missing preset found\n";
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+    }
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <lv2_horst/rack_loader.h>
+#include <lv2_horst/dummy_backend.h>
+
+#include <iostream>
+#include <algorithm>
+
+/*
+ * The index of the port with the given symbol
+ */
+size_t port_index (lv2_horst::jacked_horst &h, const std::string &symbol)
+{
+    for (size_t index = 0; index < h.m_horst->m_port_properties.size (); ++index)
+    {
+        if (h.m_horst->m_port_properties[index].m_symbol == symbol) return index;
+    }
+    return h.m_horst->m_port_properties.size ();
+}
+
+bool connected (lv2_horst::dummy_driver_ptr driver, const std::string &source, const std::string &destination)
+{
+    const std::vector<std::string> connections = driver->port_get_connections (source);
+    return std::find (connections.begin (), connections.end (), destination) != connections.end ();
+}
+
+/*
+ * Loads a rack of two noop-test units (both named "noop") on a dummy
+ * driver and checks the client names, values, MIDI bindings, enabled
+ * state and connections. The first unit binds all of its 16 control
+ * inputs, one of them twice, so more bindings than the realtime
+ * exchange ever queued. Needs noop-test from lv2/horst-plugins.lv2 on
+ * the LV2_PATH.
+ */
+int main ()
+{
+    std::string controls;
+    for (int control = 1; control <= 16; ++control)
+    {
+        controls += std::string (control > 1 ? ", " : "") + "{ \"symbol\": \"control_" + std::to_string (control) + "\", \"value\": " + std::to_string (control / 32.0) + ", \"cc\": { \"enabled\": true, \"channel\": 0, \"cc\": " + std::to_string (control) + " } }";
+    }
+    controls += ", { \"symbol\": \"control_1\", \"value\": 0.03125, \"cc\": { \"enabled\": true, \"channel\": 1, \"cc\": 100 } }";
+
+    const std::string json =
+        "{ \"input_midi_connections\": [ \"controller:midi-out\" ], \"racks\": [ { \"autoconnect\": true,"
+        " \"input_connections\": [ [ \"system:capture_1\" ], [ \"system:capture_2\" ] ],"
+        " \"output_connections\": [ [ \"system:playback_1\" ], [ \"system:playback_2\" ] ],"
+        " \"units\": ["
+        " { \"uri\": \"https://dfdx.eu/plugins/horst-plugins/noop-test\", \"name\": \"noop\", \"input_control_ports\": [ " + controls + " ] },"
+        " { \"uri\": \"https://dfdx.eu/plugins/horst-plugins/noop-test\", \"name\": \"noop\", \"enabled\": false, \"input_control_ports\": [ { \"symbol\": \"control_2\", \"value\": 0.75 } ] }"
+        " ] } ] }";
+
+    lv2_horst::lilv_plugins_ptr plugins (new lv2_horst::lilv_plugins);
+    lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, 256, 2, false));
+
+    lv2_horst::dummy_backend controller (driver);
+    controller.open ("controller");
+    controller.port_register ("midi-out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+    controller.activate ();
+
+    lv2_horst::rig_ptr r = lv2_horst::load_rig (plugins, lv2_horst::parse_ogfx_setup (lv2_horst::parse_json (json)), 2, [driver] () { return lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver)); });
+
+    if (r->m_units.size () != 1 || r->m_units[0].size () != 2 || r->m_units[0][0]->get_jack_client_name () != "noop" || r->m_units[0][1]->get_jack_client_name () != "noop-01")
+    {
+        std::cout << "wrong units or client names\n";
+        return 1;
+    }
+
+    lv2_horst::jacked_horst &first = *r->m_units[0][0];
+    lv2_horst::jacked_horst &second = *r->m_units[0][1];
+
+    for (int control = 1; control <= 16; ++control)
+    {
+        const size_t index = port_index (first, "control_" + std::to_string (control));
+        const std::vector<lv2_horst::midi_binding> bindings = first.get_midi_bindings (index);
+
+        if (first.get_control_port_value (index) != (float)(control / 32.0))
+        {
+            std::cout << "wrong value for control_" << control << ": " << first.get_control_port_value (index) << "\n";
+            return 1;
+        }
+
+        if (bindings.size () != (control == 1 ? 2u : 1u) || !bindings[0].m_enabled || bindings[0].m_cc != control || (control == 1 && bindings[1].m_cc != 100))
+        {
+            std::cout << "wrong bindings for control_" << control << "\n";
+            return 1;
+        }
+    }
+
+    if (second.get_control_port_value (port_index (second, "control_2")) != 0.75f || !second.get_midi_bindings (port_index (second, "control_2")).empty ())
+    {
+        std::cout << "wrong value or bindings on the second unit\n";
+        return 1;
+    }
+
+    if (!first.m_atomic_enabled || second.m_atomic_enabled)
+    {
+        std::cout << "wrong enabled state\n";
+        return 1;
+    }
+
+    // The process thread picks up the bindings with the first period
+    driver->cycle ();
+    const lv2_horst::midi_dispatch_table *dispatch = first.m_midi_dispatch.m_current;
+    if (dispatch == 0 || dispatch->begin (0, 16) == dispatch->end (0, 16) || dispatch->begin (1, 100) == dispatch->end (1, 100))
+    {
+        std::cout << "bindings not dispatched\n";
+        return 1;
+    }
+
+    const std::vector<std::pair<std::string, std::string>> expected
+    {
+        { "system:capture_1", "noop:in_1" },
+        { "system:capture_2", "noop:in_2" },
+        { "noop:out_1", "noop-01:in_1" },
+        { "noop:out_2", "noop-01:in_2" },
+        { "noop-01:out_1", "system:playback_1" },
+        { "noop-01:out_2", "system:playback_2" },
+        { "controller:midi-out", "noop:midi-in" },
+        { "controller:midi-out", "noop-01:midi-in" }
+    };
+
+    if (r->m_failed_connections != 0)
+    {
+        std::cout << "failed connections: " << r->m_failed_connections << "\n";
+        return 1;
+    }
+
+    for (const auto &c : expected)
+    {
+        if (!connected (driver, c.first, c.second))
+        {
+            std::cout << "not connected: " << c.first << " -> " << c.second << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
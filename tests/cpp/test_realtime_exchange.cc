@@ -0,0 +1,62 @@
+#include <lv2_horst/realtime_exchange.h>
+#include <iostream>
+
+int live = 0;
+
+struct counted
+{
+    int m_value;
+
+    counted (int value) : m_value (value) { ++live; }
+    ~counted () { --live; }
+};
+
+/*
+ * Publishes far more updates than fit a queue without a cycle in
+ * between: none may fail, the process side must see the newest and
+ * nothing may leak.
+ */
+int main ()
+{
+    {
+        lv2_horst::realtime_exchange<counted> exchange;
+
+        for (int value = 0; value < 1000; ++value) exchange.publish (new counted (value));
+        if (live != 1)
+        {
+            std::cout << "replaced updates not deleted: " << live << "\n";
+            return 1;
+        }
+
+        if (!exchange.receive () || exchange.m_current->m_value != 999)
+        {
+            std::cout << "newest update not received\n";
+            return 1;
+        }
+
+        if (exchange.receive ())
+        {
+            std::cout << "received twice\n";
+            return 1;
+        }
+
+        // The replaced object is freed on the control side
+        exchange.publish (new counted (1000));
+        exchange.publish (0);
+        if (!exchange.receive () || exchange.m_current != 0)
+        {
+            std::cout << "clearing not received\n";
+            return 1;
+        }
+
+        exchange.publish (new counted (1001));
+    }
+
+    if (live != 0)
+    {
+        std::cout << "leaked: " << live << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <lv2_horst/reblocker.h>
+
+/*
+ * Stands in for a plugin: copies its input buffer to its output buffer.
+ * Checks that chunk () maps host frames to the block being filled the
+ * way the audio copies do (which is what MIDI relies on).
+ */
+struct identity
+{
+    lv2_horst::reblocker *m_reblocker;
+    size_t m_runs;
+    size_t m_frames;
+    bool m_chunks_ok;
+
+    void chunk (size_t offset, size_t position, size_t nframes)
+    {
+        if (offset != m_frames || position != m_frames % m_reblocker->m_block_size || position + nframes > m_reblocker->m_block_size) m_chunks_ok = false;
+        m_frames += nframes;
+    }
+
+    void run (size_t nframes)
+    {
+        std::copy (m_reblocker->m_input_buffers[0].begin (), m_reblocker->m_input_buffers[0].begin () + nframes, m_reblocker->m_output_buffers[0].begin ());
+        ++m_runs;
+    }
+};
+
+int main ()
+{
+    const size_t block_size = 8;
+    lv2_horst::reblocker r (block_size, { 0 }, { 1 });
+    identity plugin { &r, 0, 0, true };
+
+    std::vector<float> input (64);
+    std::vector<float> output (64, -1);
+
+    for (size_t index = 0; index < input.size (); ++index) input[index] = index;
+
+    float *buffers[2] = { &input[0], &output[0] };
+
+    // Feed chunks of varying sizes
+    size_t offset = 0;
+    size_t chunk = 1;
+    while (offset < input.size ())
+    {
+        const size_t n = std::min (chunk, input.size () - offset);
+        r.process (plugin, buffers, offset, n);
+        offset += n;
+        chunk = chunk % 5 + 1;
+    }
+
+    if (!plugin.m_chunks_ok || plugin.m_frames != input.size ())
+    {
+        std::cout << "bad chunk positions\n";
+        return 1;
+    }
+
+    // The output must be the input delayed by latency () frames
+    for (size_t index = 0; index < output.size (); ++index)
+    {
+        const float expected = index < r.latency () ? 0 : index - r.latency ();
+        if (output[index] != expected)
+        {
+            std::cout << "mismatch at: " << index << " " << output[index] << " != " << expected << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "runs: " << plugin.m_runs << " latency: " << r.latency () << "\n";
+
+    return 0;
+}
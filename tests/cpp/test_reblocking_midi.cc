@@ -0,0 +1,133 @@
+#include <lv2_horst/jacked_horst.h>
+#include <lv2_horst/dummy_backend.h>
+
+#include <iostream>
+
+/*
+ * Sends note-ons at fixed frames, counted from the first period
+ */
+struct sender
+{
+    lv2_horst::dummy_backend m_backend;
+    jack_port_t *m_midi_out;
+    std::vector<uint64_t> m_frames;
+    uint64_t m_position;
+
+    sender (lv2_horst::dummy_driver_ptr driver, const std::vector<uint64_t> &frames) :
+        m_backend (driver),
+        m_frames (frames),
+        m_position (0)
+    {
+        m_backend.open ("sender");
+        m_midi_out = m_backend.port_register ("midi-out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+        m_backend.set_process_callback (process, this);
+        m_backend.activate ();
+    }
+
+    static int process (jack_nframes_t nframes, void *arg)
+    {
+        sender &s = *(sender*)arg;
+
+        void *midi_out = s.m_backend.port_get_buffer (s.m_midi_out, nframes);
+        s.m_backend.midi_clear_buffer (midi_out);
+        for (uint64_t frame : s.m_frames)
+        {
+            if (frame < s.m_position || frame >= s.m_position + nframes) continue;
+
+            const jack_midi_data_t note_on[3] = { 0x90, (jack_midi_data_t)(frame % 128), 100 };
+            s.m_backend.midi_event_write (midi_out, (jack_nframes_t)(frame - s.m_position), note_on, 3);
+        }
+
+        s.m_position += nframes;
+        return 0;
+    }
+};
+
+/*
+ * Records the frames events arrive at, counted from the first period
+ */
+struct receiver
+{
+    lv2_horst::dummy_backend m_backend;
+    jack_port_t *m_midi_in;
+    std::vector<uint64_t> m_frames;
+    uint64_t m_position;
+
+    receiver (lv2_horst::dummy_driver_ptr driver) :
+        m_backend (driver),
+        m_position (0)
+    {
+        m_backend.open ("receiver");
+        m_midi_in = m_backend.port_register ("midi-in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
+        m_backend.set_process_callback (process, this);
+        m_backend.activate ();
+    }
+
+    static int process (jack_nframes_t nframes, void *arg)
+    {
+        receiver &r = *(receiver*)arg;
+
+        void *midi_in = r.m_backend.port_get_buffer (r.m_midi_in, nframes);
+        for (uint32_t index = 0; index < r.m_backend.midi_get_event_count (midi_in); ++index)
+        {
+            jack_midi_event_t event;
+            r.m_backend.midi_event_get (&event, midi_in, index);
+            r.m_frames.push_back (r.m_position + event.time);
+        }
+
+        r.m_position += nframes;
+        return 0;
+    }
+};
+
+/*
+ * Runs a MIDI through plugin re-blocked to 256 frames on 64 frame
+ * periods, so most periods do not complete a block. Every event must
+ * come out exactly one block later, at its own frame. Needs
+ * midi-through-test from lv2/horst-plugins.lv2 on the LV2_PATH.
+ *
+ * Usage: test_reblocking_midi [uri]
+ */
+int main (int argc, char *argv[])
+{
+    const std::string uri = argc > 1 ? argv[1] : "https://dfdx.eu/plugins/horst-plugins/midi-through-test";
+    const jack_nframes_t period = 64;
+    const size_t block = 256;
+
+    lv2_horst::lilv_plugins_ptr plugins (new lv2_horst::lilv_plugins);
+    lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, period, 2, false));
+
+    // Several events in one period and in one block, on both sides of
+    // period and block boundaries
+    const std::vector<uint64_t> frames { 3, 10, 70, 130, 131, 255, 256, 300, 511, 640, 1000 };
+
+    sender s (driver, frames);
+    lv2_horst::jacked_horst_ptr h (new lv2_horst::jacked_horst (plugins, uri, "reblocking-midi", false, block, lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver))));
+    receiver r (driver);
+
+    if (h->get_latency () != block)
+    {
+        std::cout << "unexpected latency: " << h->get_latency () << "\n";
+        return 1;
+    }
+
+    s.m_backend.connect ("sender:midi-out", "reblocking-midi:midi-in");
+    s.m_backend.connect ("reblocking-midi:midi_out", "receiver:midi-in");
+
+    for (size_t cycle = 0; cycle < (frames.back () + 2 * block) / period; ++cycle) driver->cycle ();
+
+    std::vector<uint64_t> expected;
+    for (uint64_t frame : frames) expected.push_back (frame + block);
+
+    if (r.m_frames != expected)
+    {
+        std::cout << "events arrived at:";
+        for (uint64_t frame : r.m_frames) std::cout << " " << frame;
+        std::cout << ", expected:";
+        for (uint64_t frame : expected) std::cout << " " << frame;
+        std::cout << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <lv2_horst/jacked_horst.h>
+#include <lv2_horst/dummy_backend.h>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+/*
+ * Changes the buffer size of a running dummy driver back and forth
+ * while a plugin runs on it. The process thread must never wait for a
+ * re-instantiation: at most a few periods get silenced. Then swaps
+ * the instance of worker-test while it has work requests and
+ * responses pending: they must not reach the new instance (the plugin
+ * aborts if they do). Finally switches power-of-two-test to a period
+ * that is not a power of two: it must be silenced rather than run
+ * (it aborts if it is) and come back with the next supported period.
+ * Needs a plugin (by default noop-test), worker-test and
+ * power-of-two-test from lv2/horst-plugins.lv2 on the LV2_PATH.
+ *
+ * Usage: test_reinstantiation [uri] [changes]
+ */
+int main (int argc, char *argv[])
+{
+  const std::string uri = argc > 1 ? argv[1] : "https://dfdx.eu/plugins/horst-plugins/noop-test";
+  const size_t changes = argc > 2 ? std::stoul (argv[2]) : 20;
+
+  lv2_horst::lilv_plugins_ptr plugins (new lv2_horst::lilv_plugins);
+  lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, 256));
+
+  lv2_horst::jacked_horst_ptr h (new lv2_horst::jacked_horst (plugins, uri, "reinstantiation", false, 0, lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver))));
+  h->set_control_port_value (0, 0.5f);
+
+  driver->start (true);
+
+  for (size_t change = 0; change < changes; ++change)
+  {
+    driver->set_buffer_size (change % 2 ? 256 : 1024);
+    std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  }
+
+  while (h->is_reinstantiating ()) std::this_thread::sleep_for (std::chrono::milliseconds (10));
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  driver->stop ();
+
+  std::cout << "silenced periods: " << h->get_silenced_periods () << " xruns: " << driver->get_xruns () << "\n";
+
+  if (h->m_atomic_instance_block_length != driver->m_buffer_size)
+  {
+    std::cout << "instance block length " << h->m_atomic_instance_block_length << " does not match the buffer size " << driver->m_buffer_size << "\n";
+    return 1;
+  }
+
+  if (h->m_horst->m_port_properties[0].m_is_control && h->m_port_values[0] != 0.5f)
+  {
+    std::cout << "control value lost\n";
+    return 1;
+  }
+
+  lv2_horst::dummy_driver_ptr worker_driver (new lv2_horst::dummy_driver (48000, 256));
+  lv2_horst::jacked_horst_ptr w (new lv2_horst::jacked_horst (plugins, "https://dfdx.eu/plugins/horst-plugins/worker-test", "reinstantiation-worker", false, 0, lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (worker_driver))));
+
+  auto swap_instance = [&] (jack_nframes_t buffer_size)
+  {
+    worker_driver->set_buffer_size (buffer_size);
+    while (w->is_reinstantiating ()) std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  };
+
+  // A pending request: the worker can not be woken while
+  // m_worker_mutex is held
+  {
+    std::lock_guard<std::mutex> lock (w->m_horst->m_worker_mutex);
+    worker_driver->cycle ();
+    if (w->m_horst->m_work_items_buffer.isempty ())
+    {
+      std::cout << "no work request scheduled\n";
+      return 1;
+    }
+    swap_instance (1024);
+  }
+  worker_driver->cycle ();
+
+  // A pending response: it is only delivered in the next run
+  while (w->m_horst->m_work_response_items_buffer.isempty ())
+  {
+    worker_driver->cycle ();
+    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  }
+  swap_instance (256);
+
+  // Let the new instance's own work go through
+  for (size_t cycle = 0; cycle < 10; ++cycle)
+  {
+    worker_driver->cycle ();
+    std::this_thread::sleep_for (std::chrono::milliseconds (5));
+  }
+
+  lv2_horst::dummy_driver_ptr power_of_two_driver (new lv2_horst::dummy_driver (48000, 256));
+  lv2_horst::jacked_horst_ptr p (new lv2_horst::jacked_horst (plugins, "https://dfdx.eu/plugins/horst-plugins/power-of-two-test", "reinstantiation-power-of-two", false, 0, lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (power_of_two_driver))));
+
+  // Must not throw through the buffer size callback
+  power_of_two_driver->set_buffer_size (384);
+  const uint64_t silenced = p->get_silenced_periods ();
+  for (size_t cycle = 0; cycle < 4; ++cycle) power_of_two_driver->cycle ();
+
+  if (p->m_atomic_instance_block_length != 0 || p->get_silenced_periods () != silenced + 4)
+  {
+    std::cout << "unsupported period not silenced\n";
+    return 1;
+  }
+
+  power_of_two_driver->set_buffer_size (512);
+  while (p->is_reinstantiating ()) std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  for (size_t cycle = 0; cycle < 4; ++cycle) power_of_two_driver->cycle ();
+
+  if (p->m_atomic_instance_block_length != 512 || p->get_silenced_periods () != silenced + 4)
+  {
+    std::cout << "no recovery after a supported period\n";
+    return 1;
+  }
+
+  return 0;
+}
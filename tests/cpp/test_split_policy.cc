@@ -0,0 +1,108 @@
+#include <lv2_horst/jacked_horst.h>
+#include <lv2_horst/dummy_backend.h>
+
+#include <iostream>
+
+/*
+ * Sends the same control changes (channel 0, CC 7) every period
+ */
+struct sender
+{
+    lv2_horst::dummy_backend m_backend;
+    jack_port_t *m_midi_out;
+    std::vector<std::pair<jack_nframes_t, jack_midi_data_t>> m_events;
+
+    sender (lv2_horst::dummy_driver_ptr driver, const std::vector<std::pair<jack_nframes_t, jack_midi_data_t>> &events) :
+        m_backend (driver),
+        m_events (events)
+    {
+        m_backend.open ("sender");
+        m_midi_out = m_backend.port_register ("midi-out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+        m_backend.set_process_callback (process, this);
+        m_backend.activate ();
+    }
+
+    static int process (jack_nframes_t nframes, void *arg)
+    {
+        sender &s = *(sender*)arg;
+
+        void *midi_out = s.m_backend.port_get_buffer (s.m_midi_out, nframes);
+        s.m_backend.midi_clear_buffer (midi_out);
+        for (const auto &event : s.m_events)
+        {
+            const jack_midi_data_t cc[3] = { 0xb0, 7, event.second };
+            s.m_backend.midi_event_write (midi_out, event.first, cc, 3);
+        }
+
+        return 0;
+    }
+};
+
+/*
+ * Drives a control input of noop-test by three control changes per
+ * period and checks the number of run () calls each split policy
+ * makes, and that the last value wins. Needs noop-test from
+ * lv2/horst-plugins.lv2 on the LV2_PATH.
+ *
+ * Usage: test_split_policy [uri]
+ */
+int main (int argc, char *argv[])
+{
+    const std::string uri = argc > 1 ? argv[1] : "https://dfdx.eu/plugins/horst-plugins/noop-test";
+    const size_t control_1 = 4;
+    const size_t cycles = 4;
+
+    lv2_horst::lilv_plugins_ptr plugins (new lv2_horst::lilv_plugins);
+    lv2_horst::dummy_driver_ptr driver (new lv2_horst::dummy_driver (48000, 256, 2, false));
+
+    sender s (driver, { { 10, 0 }, { 20, 64 }, { 100, 127 } });
+    lv2_horst::jacked_horst_ptr h (new lv2_horst::jacked_horst (plugins, uri, "split-policy", false, 0, lv2_horst::audio_backend_ptr (new lv2_horst::dummy_backend (driver))));
+
+    s.m_backend.connect ("sender:midi-out", "split-policy:midi-in");
+    h->set_midi_bindings (control_1, { lv2_horst::midi_binding (true, 0, 7) });
+
+    try
+    {
+        h->set_split_quantum (0);
+        std::cout << "split quantum of 0 accepted\n";
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+
+    }
+    h->set_split_quantum (16);
+
+    // exact: at 10, 20 and 100. quantized: at 16 and 96 (10 rounds
+    // down to the start of the period). last_value: never
+    const std::vector<std::pair<lv2_horst::split_policy, uint32_t>> policies
+    {
+        { lv2_horst::split_policy::exact, 4 },
+        { lv2_horst::split_policy::quantized, 3 },
+        { lv2_horst::split_policy::last_value, 1 }
+    };
+
+    for (const auto &policy : policies)
+    {
+        h->set_split_policy (policy.first);
+        h->reset_run_statistics ();
+        for (size_t cycle = 0; cycle < cycles; ++cycle) driver->cycle ();
+
+        const lv2_horst::run_statistics statistics = h->get_run_statistics ();
+        std::cout << "policy: " << (int)policy.first << " cycles: " << statistics.m_cycles << " run calls: " << statistics.m_run_calls << " last: " << statistics.m_last_cycle_run_calls << " max: " << statistics.m_max_cycle_run_calls << "\n";
+
+        if (statistics.m_cycles != cycles || statistics.m_run_calls != cycles * policy.second || statistics.m_last_cycle_run_calls != policy.second || statistics.m_max_cycle_run_calls != policy.second)
+        {
+            std::cout << "expected " << policy.second << " run calls per cycle\n";
+            return 1;
+        }
+
+        if (h->get_control_port_value (control_1) != 1.0f)
+        {
+            std::cout << "last value did not win: " << h->get_control_port_value (control_1) << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
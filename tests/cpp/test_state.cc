@@ -0,0 +1,106 @@
+#include <lv2_horst/state.h>
+#include <iostream>
+#include <chrono>
+
+/*
+ * Round trips properties through state images, in memory and through
+ * a file, with different URID mappings on both ends, like between two
+ * processes.
+ */
+int main ()
+{
+    const std::vector<std::string> save_uris = { "", "urn:key:gain", "urn:type:float", "urn:key:blob", "urn:type:chunk" };
+    const std::vector<std::string> restore_uris = { "", "urn:type:chunk", "urn:key:blob", "urn:type:float", "urn:key:gain" };
+
+    auto restore_map = [&] (const char *uri) -> LV2_URID
+    {
+        for (size_t index = 0; index < restore_uris.size (); ++index) if (restore_uris[index] == uri) return index;
+        return 0;
+    };
+
+    lv2_horst::state_writer writer ([&] (LV2_URID urid) { return save_uris[urid]; });
+
+    const float gain = 0.5f;
+    std::vector<uint8_t> blob (1024 * 1024 + 3);
+    for (size_t index = 0; index < blob.size (); ++index) blob[index] = index % 251;
+
+    writer.store (1, &gain, sizeof (gain), 2, LV2_STATE_IS_POD);
+    writer.store (3, &blob[0], blob.size (), 4, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+
+    const float replaced_gain = 0.25f;
+    writer.store (1, &replaced_gain, sizeof (replaced_gain), 2, LV2_STATE_IS_POD);
+
+    const std::vector<uint8_t> image = writer.image ();
+
+    auto check = [&] (lv2_horst::state_image &restored) -> bool
+    {
+        restored.map_uris (restore_map);
+
+        size_t size;
+        uint32_t type;
+        uint32_t flags;
+
+        const float *g = (const float*)restored.retrieve (4, &size, &type, &flags);
+        if (g == 0 || size != sizeof (float) || type != 3 || *g != replaced_gain || flags != LV2_STATE_IS_POD) return false;
+
+        const uint8_t *b = (const uint8_t*)restored.retrieve (2, &size, &type, &flags);
+        if (b == 0 || size != blob.size () || type != 1 || memcmp (b, &blob[0], size) != 0) return false;
+
+        if ((uintptr_t)g % HORST_STATE_ALIGNMENT != 0 || (uintptr_t)b % HORST_STATE_ALIGNMENT != 0) return false;
+
+        return restored.retrieve (3, &size, &type, &flags) == 0 && restored.number_of_properties () == 2;
+    };
+
+    lv2_horst::state_image in_memory (&image[0], image.size ());
+    if (!check (in_memory))
+    {
+        std::cout << "in memory round trip failed\n";
+        return 1;
+    }
+
+    std::vector<uint8_t> misaligned (image.size () + 1);
+    memcpy (&misaligned[1], &image[0], image.size ());
+    lv2_horst::state_image copied (&misaligned[1], image.size ());
+    if (!check (copied))
+    {
+        std::cout << "misaligned round trip failed\n";
+        return 1;
+    }
+
+    const std::string path = "/tmp/horst-test-state-" + std::to_string (getpid ());
+    writer.write (path);
+
+    const auto start = std::chrono::steady_clock::now ();
+    lv2_horst::state_image from_file (path);
+    const bool file_ok = check (from_file);
+    std::cout << "restore from file: " << std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now () - start).count () << " us\n";
+    unlink (path.c_str ());
+
+    if (!file_ok)
+    {
+        std::cout << "file round trip failed\n";
+        return 1;
+    }
+
+    for (size_t size : { (size_t)0, (size_t)10, sizeof (lv2_horst::state_file_header), image.size () - 1 })
+    {
+        try
+        {
+            lv2_horst::state_image truncated (&image[0], size);
+            std::cout << "truncated image of size " << size << " accepted\n";
+            return 1;
+        }
+        catch (const std::exception &e)
+        {
+        }
+    }
+
+    lv2_horst::state_paths paths ("/tmp/horst-state.files");
+    if (paths.abstract_path ("/tmp/horst-state.files/samples/a.wav") != "samples/a.wav" || paths.absolute_path ("samples/a.wav") != "/tmp/horst-state.files/samples/a.wav" || paths.abstract_path ("/usr/share/b.wav") != "/usr/share/b.wav")
+    {
+        std::cout << "bad path mapping\n";
+        return 1;
+    }
+
+    return 0;
+}
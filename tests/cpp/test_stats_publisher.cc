@@ -0,0 +1,63 @@
+#include <lv2_horst/stats.h>
+#include <iostream>
+
+bool segment_exists ()
+{
+    const int fd = shm_open (lv2_horst::stats_segment_name (getpid ()).c_str (), O_RDONLY, 0);
+    if (fd < 0) return false;
+    close (fd);
+    return true;
+}
+
+/*
+ * Registers an instance, waits for it to be published and checks that
+ * the thread is joined and the segment removed once it unregisters.
+ * Registering again must bring both back.
+ */
+int main ()
+{
+    lv2_horst::stats_publisher &publisher = lv2_horst::stats_publisher::instance ();
+    publisher.set_interval (1);
+
+    for (int round = 0; round < 2; ++round)
+    {
+        std::atomic<int> collected (0);
+        const size_t slot = publisher.register_instance ("test", [&] (lv2_horst::stats_values &v) { ++collected; });
+
+        if (!segment_exists ())
+        {
+            std::cout << "no segment\n";
+            return 1;
+        }
+
+        while (collected < 3) std::this_thread::sleep_for (std::chrono::milliseconds (1));
+
+        publisher.unregister_instance (slot);
+
+        if (segment_exists () || publisher.m_thread.joinable ())
+        {
+            std::cout << "segment or thread left after the last instance unregistered\n";
+            return 1;
+        }
+    }
+
+    // Registering while disabled creates no segment, enabling creates
+    // it with the instance already in it
+    publisher.set_enabled (false);
+    const size_t slot = publisher.register_instance ("disabled", [] (lv2_horst::stats_values &v) { });
+    if (slot >= HORST_STATS_MAX_INSTANCES || segment_exists ())
+    {
+        std::cout << "segment created while disabled\n";
+        return 1;
+    }
+
+    publisher.set_enabled (true);
+    if (!segment_exists () || !publisher.m_segment->m_records[slot].m_in_use || std::string (publisher.m_segment->m_records[slot].m_name) != "disabled")
+    {
+        std::cout << "instance registered while disabled not published\n";
+        return 1;
+    }
+    publisher.unregister_instance (slot);
+
+    return 0;
+}
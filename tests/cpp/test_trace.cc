@@ -0,0 +1,74 @@
+#include <lv2_horst/trace.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+/*
+ * Records more events than fit into the buffers from two threads and
+ * checks the dump only contains the most recent ones, that names are
+ * escaped and that the buffers are freed when the threads exit.
+ */
+int main ()
+{
+    lv2_horst::trace_recorder &recorder = lv2_horst::trace_recorder::instance ();
+    recorder.set_enabled (true);
+
+    std::atomic<int> recorded (0);
+    std::atomic<bool> dumped (false);
+
+    auto record = [&] (const char *thread_name)
+    {
+        recorder.register_thread (thread_name, 16);
+        for (uint32_t index = 0; index < 100; ++index)
+        {
+            lv2_horst::trace_begin ("run", index);
+            lv2_horst::trace_end ("run", index);
+        }
+        lv2_horst::trace_instant ("last", 4242);
+
+        ++recorded;
+        while (!dumped) std::this_thread::yield ();
+    };
+
+    std::thread a (record, "a");
+    std::thread b (record, "b \"quoted\\");
+    while (recorded != 2) std::this_thread::yield ();
+
+    // Threads that did not register are not traced
+    lv2_horst::trace_instant ("unregistered");
+
+    const std::string path = "/tmp/test_trace.json";
+    recorder.dump (path);
+
+    dumped = true;
+    a.join ();
+    b.join ();
+
+    std::ifstream file (path);
+    std::stringstream contents;
+    contents << file.rdbuf ();
+    const std::string json = contents.str ();
+
+    size_t events = 0;
+    for (size_t position = json.find ("\"ph\":\""); position != std::string::npos; position = json.find ("\"ph\":\"", position + 1)) ++events;
+
+    std::cout << "events: " << events << "\n";
+
+    // Two thread name records plus 16 events per thread
+    if (events != 2 + 2 * 16) return 1;
+    if (json.find ("\"value\":4242") == std::string::npos) return 1;
+    if (json.find ("\"value\":90") != std::string::npos) return 1;
+    if (json.find ("unregistered") != std::string::npos) return 1;
+    if (json.find ("\"name\":\"b \\\"quoted\\\\\"") == std::string::npos) return 1;
+
+    std::lock_guard<std::mutex> lock (recorder.m_mutex);
+    if (!recorder.m_buffers.empty ())
+    {
+        std::cout << "buffers of exited threads not freed\n";
+        return 1;
+    }
+
+    return 0;
+}